@@ -0,0 +1,83 @@
+/*
+ * bench_clients.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_load.h"
+#include "host_pipeline.h"
+#include "ws_client.h"
+
+// Load threads, as in bench_pipeline
+#define BENCH_CLIENTS_THREADS		2
+
+// Paced rate, low enough for every client count to keep up
+#define BENCH_CLIENTS_RATE			2000
+
+/**
+ * Load of one run, its result comes back from the run's process
+ */
+typedef struct bench_clients_load
+{
+	uint32_t seconds;
+	uint32_t rate;
+	bench_load_result_t result;
+} bench_clients_load_t;
+
+static void bench_clients_load(void *arg)
+{
+	bench_clients_load_t *load = arg;
+
+	bench_load_run(BENCH_CLIENTS_THREADS, load->seconds, load->rate, &load->result);
+}
+
+/**
+ * Runs the log pipeline with a number of clients and prints one row.
+ * @param clients websocket clients.
+ * @param seconds load duration.
+ * @param rate total lines per second, 0 flat out.
+ */
+static void bench_clients_run(uint32_t clients, uint32_t seconds, uint32_t rate)
+{
+	const char *name = rate ? "paced" : "flat_out";
+	bench_clients_load_t load = { .seconds = seconds, .rate = rate };
+	host_pipeline_stats_t stats;
+
+	if (host_pipeline_run(clients, bench_clients_load, &load, sizeof(load), &stats) != ESP_OK)
+	{
+		printf("%-8s %7u failed\n", name, clients);
+		return;
+	}
+
+	double expected = (double)stats.logged * clients;
+	double elapsed = load.result.elapsed_us / 1e6;
+	printf("%-8s %7u %11.0f %11.0f %11.0f %6.1f%% %7u %7u %9.1f %10lld\n",
+			name, clients, load.result.lines / elapsed, stats.received / elapsed,
+			stats.received / clients / elapsed, expected > 0 ? 100.0 * (1.0 - stats.received / expected) : 0.0,
+			stats.latency_us[0], stats.latency_us[2],
+			stats.httpd_frames ? (double)stats.httpd_send_us / stats.httpd_frames : 0.0,
+			(long long)stats.heap_peak);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t seconds = argc > 1 ? atoi(argv[1]) : 1;
+
+	printf("client scaling, %d load threads, %u s per run\n", BENCH_CLIENTS_THREADS, seconds);
+	printf("%-8s %7s %11s %11s %11s %7s %7s %7s %9s %10s\n", "run", "clients", "calls/s", "received/s",
+			"per_cl/s", "lost", "p50_us", "p99_us", "send_us", "heap_B");
+
+	for (uint32_t clients = 1; clients <= WS_CLIENT_MAX_CLIENTS; ++clients)
+	{
+		bench_clients_run(clients, seconds, 0);
+	}
+	for (uint32_t clients = 1; clients <= WS_CLIENT_MAX_CLIENTS; ++clients)
+	{
+		bench_clients_run(clients, seconds, BENCH_CLIENTS_RATE);
+	}
+	return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * bench_load.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "bench_load.h"
+#include "task_topology.h"
+
+/**
+ * Shared by the load threads of one run
+ */
+typedef struct bench_load
+{
+	int64_t end_us;
+	uint32_t period_us;				///> Time between two lines of one thread, 0 flat out
+	QueueHandle_t done;				///> One empty item per finished thread
+	_Atomic uint32_t lines;
+	_Atomic uint64_t late_us;
+	_Atomic uint32_t late_max_us;
+	_Atomic uint32_t wakeups;
+} bench_load_t;
+
+static const char bench_load_pad[BENCH_LOAD_LINE_PAD + 1] = "................................................";
+
+static void bench_load_task(void *arg)
+{
+	bench_load_t *load = arg;
+	uint32_t seq = 0;
+	int64_t next = esp_timer_get_time();
+
+	while (esp_timer_get_time() < load->end_us)
+	{
+		if (load->period_us)
+		{
+			next += load->period_us;
+			int64_t wait = next - esp_timer_get_time();
+			if (wait > 0)
+			{
+				struct timespec delay = { .tv_sec = wait / 1000000, .tv_nsec = (wait % 1000000) * 1000 };
+				nanosleep(&delay, NULL);
+			}
+
+			int64_t late = esp_timer_get_time() - next;
+			late = late > 0 ? late : 0;
+			atomic_fetch_add_explicit(&load->late_us, late, memory_order_relaxed);
+			atomic_fetch_add_explicit(&load->wakeups, 1, memory_order_relaxed);
+			uint32_t max = atomic_load_explicit(&load->late_max_us, memory_order_relaxed);
+			while (late > max && !atomic_compare_exchange_weak(&load->late_max_us, &max, (uint32_t)late))
+			{
+			}
+		}
+
+		int64_t now = esp_timer_get_time();
+		esp_log_write(ESP_LOG_INFO, "[bench]", LOG_FORMAT(I, "t=%lld seq=%u %s"), (unsigned)(now / 1000), "[bench]",
+				(long long)now, seq++, bench_load_pad);
+	}
+
+	atomic_fetch_add(&load->lines, seq);
+	xQueueSend(load->done, NULL, portMAX_DELAY);
+	vTaskDelete(NULL);
+}
+
+void bench_load_run(uint32_t threads, uint32_t seconds, uint32_t lines_per_s, bench_load_result_t *result)
+{
+	bench_load_t load;
+	int64_t start = esp_timer_get_time();
+
+	memset(&load, 0x00, sizeof(load));
+	load.end_us = start + (int64_t)seconds * 1000000;
+	load.period_us = lines_per_s ? (uint64_t)threads * 1000000 / lines_per_s : 0;
+	load.done = xQueueCreate(threads, 0);
+
+	for (uint32_t i = 0; i < threads; ++i)
+	{
+		task_topology_create(TASK_TOPOLOGY_BENCH, bench_load_task, &load, NULL);
+	}
+	for (uint32_t i = 0; i < threads; ++i)
+	{
+		xQueueReceive(load.done, NULL, portMAX_DELAY);
+	}
+	vQueueDelete(load.done);
+
+	uint32_t wakeups = atomic_load(&load.wakeups);
+	result->lines = atomic_load(&load.lines);
+	result->elapsed_us = esp_timer_get_time() - start;
+	result->jitter_mean_us = wakeups ? atomic_load(&load.late_us) / wakeups : 0;
+	result->jitter_max_us = atomic_load(&load.late_max_us);
+}
@@ -0,0 +1,37 @@
+/*
+ * bench_load.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_BENCH_LOAD_H_
+#define HOST_BENCH_LOAD_H_
+
+#include <stdint.h>
+
+// Filler characters per line, about 80 bytes with the esp_log prefix
+#define BENCH_LOAD_LINE_PAD			48
+
+/**
+ * What the load threads did
+ */
+typedef struct bench_load_result
+{
+	uint32_t lines;					///> Lines logged by every thread
+	uint32_t elapsed_us;			///> Time from the start to the last thread finishing
+	uint32_t jitter_mean_us;		///> Mean wake-up lateness of paced threads
+	uint32_t jitter_max_us;			///> Worst lateness
+} bench_load_result_t;
+
+/**
+ * Logs "I (<ms>) [bench]: t=<us> seq=<n> <pad>" lines through esp_log_write, as
+ * ESP_LOGI does, from load tasks placed as TASK_TOPOLOGY_BENCH, and waits for them.
+ * @param threads number of load threads.
+ * @param seconds how long they log.
+ * @param lines_per_s total rate of the threads, 0 to log as fast as possible.
+ * @param result receives what the threads did.
+ */
+void bench_load_run(uint32_t threads, uint32_t seconds, uint32_t lines_per_s, bench_load_result_t *result);
+
+#endif /* HOST_BENCH_LOAD_H_ */
@@ -0,0 +1,268 @@
+/*
+ * bench_log_ring.c
+ *
+ *  Created on: Jun 03, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+
+#include "log_ring.h"
+
+/**
+ * Log ring against the queue it replaced, with nothing else of the pipeline in the way.
+ * The queue is the one of the original http_server.c: 50 slots of 255 bytes, every line
+ * copied whole. The ring is the one of http_server.h, formatted into in place.
+ */
+
+// Same sizes as http_server.h
+#define BENCH_RING_SIZE				8192
+#define BENCH_LINE_MAX_LEN			255
+
+// The replaced queue
+#define BENCH_QUEUE_DEPTH			50
+#define BENCH_QUEUE_ITEM			255
+
+// Load threads
+#define BENCH_THREADS				2
+
+// Burst runs: lines per burst, time between bursts and consumer time per line
+#define BENCH_BURST_LINES			64
+#define BENCH_BURST_PERIOD_US		20000
+#define BENCH_BURST_CONSUME_US		20
+
+static const char bench_line[] = "I (%u) %s: t=%lld seq=%u %s\n";
+static const char bench_pad[] = "................................................";
+
+static QueueHandle_t bench_queue;
+static log_ring_t bench_ring;
+static uint8_t bench_ring_buff[BENCH_RING_SIZE] __attribute__((aligned(4)));
+static SemaphoreHandle_t bench_wake;
+
+static _Atomic uint32_t bench_calls;
+static _Atomic uint32_t bench_dropped;
+static _Atomic uint64_t bench_call_ns;
+static _Atomic uint32_t bench_consumed;
+static volatile bool bench_stop;
+static bool bench_use_ring;
+static uint32_t bench_consume_us;
+
+static int64_t bench_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * The original hook, with the shared static buffer made local so the threads do not race.
+ */
+static void bench_queue_vprintf(const char *format, va_list args)
+{
+	char buff[BENCH_QUEUE_ITEM];
+
+	if (vsnprintf(buff, sizeof(buff), format, args) > 0 && xQueueSend(bench_queue, buff, 0) != pdPASS)
+	{
+		atomic_fetch_add_explicit(&bench_dropped, 1, memory_order_relaxed);
+	}
+}
+
+/**
+ * The hook of http_server.c without the level and tag classification.
+ */
+static void bench_ring_vprintf(const char *format, va_list args)
+{
+	char *line = log_ring_reserve(&bench_ring, BENCH_LINE_MAX_LEN);
+
+	if (line == NULL)
+	{
+		atomic_fetch_add_explicit(&bench_dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	int written = vsnprintf(line, BENCH_LINE_MAX_LEN, format, args);
+	size_t len = written > 0 ? (size_t)written : 0;
+	log_ring_commit(&bench_ring, line, len < BENCH_LINE_MAX_LEN ? len : BENCH_LINE_MAX_LEN - 1);
+	xSemaphoreGive(bench_wake);
+}
+
+static void bench_log(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int64_t start = bench_ns();
+	if (bench_use_ring)
+	{
+		bench_ring_vprintf(format, args);
+	}
+	else
+	{
+		bench_queue_vprintf(format, args);
+	}
+	atomic_fetch_add_explicit(&bench_call_ns, bench_ns() - start, memory_order_relaxed);
+	atomic_fetch_add_explicit(&bench_calls, 1, memory_order_relaxed);
+	va_end(args);
+}
+
+static void bench_spin_us(uint32_t us)
+{
+	int64_t end = esp_timer_get_time() + us;
+	while (esp_timer_get_time() < end)
+	{
+	}
+}
+
+/**
+ * Takes lines off the queue or the ring like ws_print, spending bench_consume_us on each.
+ */
+static void bench_consumer(void *arg)
+{
+	SemaphoreHandle_t done = arg;
+	char line[BENCH_QUEUE_ITEM];
+
+	for (;;)
+	{
+		bool got = false;
+
+		if (bench_use_ring)
+		{
+			size_t len;
+			const void *record = log_ring_peek(&bench_ring, &len);
+			if (record)
+			{
+				memcpy(line, record, len);
+				log_ring_release(&bench_ring);
+				got = true;
+			}
+			else
+			{
+				xSemaphoreTake(bench_wake, 1);
+			}
+		}
+		else
+		{
+			got = xQueueReceive(bench_queue, line, 1) == pdPASS;
+		}
+
+		if (got)
+		{
+			bench_spin_us(bench_consume_us);
+			atomic_fetch_add_explicit(&bench_consumed, 1, memory_order_relaxed);
+		}
+		else if (bench_stop)
+		{
+			break;
+		}
+	}
+
+	xSemaphoreGive(done);
+	vTaskDelete(NULL);
+}
+
+/**
+ * Load thread, flat out or in bursts.
+ */
+static void bench_producer(void *arg)
+{
+	SemaphoreHandle_t done = arg;
+	uint32_t seq = 0;
+	int64_t next = esp_timer_get_time();
+
+	while (!bench_stop)
+	{
+		if (bench_consume_us)
+		{
+			for (int i = 0; i < BENCH_BURST_LINES / BENCH_THREADS; ++i)
+			{
+				int64_t now = esp_timer_get_time();
+				bench_log(bench_line, (unsigned)(now / 1000), "[bench]", (long long)now, seq++, bench_pad);
+			}
+			next += BENCH_BURST_PERIOD_US;
+			int64_t wait = next - esp_timer_get_time();
+			if (wait > 0)
+			{
+				vTaskDelay(wait / 1000);
+			}
+		}
+		else
+		{
+			int64_t now = esp_timer_get_time();
+			bench_log(bench_line, (unsigned)(now / 1000), "[bench]", (long long)now, seq++, bench_pad);
+		}
+	}
+
+	xSemaphoreGive(done);
+	vTaskDelete(NULL);
+}
+
+static void bench_run(const char *name, bool ring, uint32_t consume_us, uint32_t seconds)
+{
+	SemaphoreHandle_t done = xQueueCreate(BENCH_THREADS + 1, 0);
+
+	bench_use_ring = ring;
+	bench_consume_us = consume_us;
+	bench_stop = false;
+	atomic_store(&bench_calls, 0);
+	atomic_store(&bench_dropped, 0);
+	atomic_store(&bench_call_ns, 0);
+	atomic_store(&bench_consumed, 0);
+	bench_queue = xQueueCreate(BENCH_QUEUE_DEPTH, BENCH_QUEUE_ITEM);
+	log_ring_init(&bench_ring, bench_ring_buff, sizeof(bench_ring_buff));
+	bench_wake = xSemaphoreCreateBinary();
+
+	xTaskCreatePinnedToCore(bench_consumer, "websocket", 3072, done, 12, NULL, tskNO_AFFINITY);
+	for (int i = 0; i < BENCH_THREADS; ++i)
+	{
+		xTaskCreatePinnedToCore(bench_producer, "bench", 4096, done, 11, NULL, tskNO_AFFINITY);
+	}
+
+	int64_t start = esp_timer_get_time();
+	vTaskDelay(seconds * 1000);
+	bench_stop = true;
+	for (int i = 0; i < BENCH_THREADS + 1; ++i)
+	{
+		xQueueReceive(done, NULL, portMAX_DELAY);
+	}
+	double elapsed = (esp_timer_get_time() - start) / 1e6;
+
+	uint32_t calls = atomic_load(&bench_calls);
+	printf("%-6s %-6s %8u %11.0f %11.0f %7.1f%% %8.0f %7u\n", name, ring ? "ring" : "queue",
+			ring ? BENCH_RING_SIZE : BENCH_QUEUE_DEPTH * BENCH_QUEUE_ITEM,
+			calls / elapsed, atomic_load(&bench_consumed) / elapsed,
+			calls ? 100.0 * atomic_load(&bench_dropped) / calls : 0.0,
+			calls ? (double)atomic_load(&bench_call_ns) / calls : 0.0, ring ? bench_ring.high_water : 0);
+
+	vQueueDelete(bench_queue);
+	vSemaphoreDelete(bench_wake);
+	vQueueDelete(done);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t seconds = argc > 1 ? atoi(argv[1]) : 2;
+
+	printf("log ring against the %d x %d byte queue, %d load threads, %u s per run\n",
+			BENCH_QUEUE_DEPTH, BENCH_QUEUE_ITEM, BENCH_THREADS, seconds);
+	printf("flat: as fast as possible, burst: %d lines every %d ms and %d us per line to send them\n",
+			BENCH_BURST_LINES, BENCH_BURST_PERIOD_US / 1000, BENCH_BURST_CONSUME_US);
+	printf("%-6s %-6s %8s %11s %11s %8s %8s %7s\n", "run", "store", "ram_B", "calls/s", "consumed/s",
+			"dropped", "ns/call", "peak_B");
+
+	bench_run("flat", false, 0, seconds);
+	bench_run("flat", true, 0, seconds);
+	bench_run("burst", false, BENCH_BURST_CONSUME_US, seconds);
+	bench_run("burst", true, BENCH_BURST_CONSUME_US, seconds);
+	return 0;
+}
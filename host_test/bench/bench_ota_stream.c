@@ -0,0 +1,350 @@
+/*
+ * bench_ota_stream.c
+ *
+ *  Created on: Jun 03, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_crc.h"
+#include "esp_timer.h"
+
+#include "ota_stream.h"
+
+/**
+ * Firmware upload through ota_stream into a file-backed flash stand-in, against the
+ * serial loop it replaced: receive a sector, write it, receive the next one. A sender
+ * thread plays the browser on a socketpair, at the link rate or flat out, and the sink
+ * takes as long per sector as flash at the given rate would. The sender never has more
+ * than a TCP window in flight, which is the only buffering the serial loop gets. The sink
+ * checks the CRC of the image, so a row only counts if every byte arrived in order.
+ */
+
+// Receive size of one httpd_req_recv, about one TCP segment
+#define BENCH_OTA_SEGMENT			1460
+
+// Bytes in flight between sender and receiver, CONFIG_LWIP_TCP_WND_DEFAULT, and a one segment window
+#define BENCH_OTA_WINDOW			5744
+#define BENCH_OTA_WINDOW_SMALL		BENCH_OTA_SEGMENT
+
+// Rates of the paced rows in kB/s, a good SoftAP link and the flash erase and program speed
+#define BENCH_OTA_LINK_KBPS			800
+#define BENCH_OTA_FLASH_KBPS		800
+
+/**
+ * Flash stand-in: a temporary file written at a fixed rate
+ */
+typedef struct bench_sink
+{
+	FILE *file;
+	uint32_t flash_kbps;			///> Program rate, 0 for as fast as the file takes it
+	uint32_t expected_crc;			///> CRC of the image sent
+	uint32_t crc;
+	size_t size;
+	size_t written;
+} bench_sink_t;
+
+/**
+ * Sender thread state
+ */
+typedef struct bench_sender
+{
+	int fd;
+	const uint8_t *image;
+	size_t size;
+	uint32_t link_kbps;				///> Link rate, 0 for flat out
+	size_t window;					///> Bytes sent but not received yet, at most
+	_Atomic size_t received;		///> Bytes the receiver took, the window slides with it
+} bench_sender_t;
+
+/**
+ * Sleeps until a number of bytes is due at a rate.
+ * @param start_us esp_timer_get_time when the bytes started.
+ * @param bytes bytes transferred since then.
+ * @param kbps rate in kB/s, 0 does not wait.
+ */
+static void bench_pace(int64_t start_us, size_t bytes, uint32_t kbps)
+{
+	if (kbps == 0)
+	{
+		return;
+	}
+
+	int64_t wait = start_us + (int64_t)bytes * 1000 / kbps - esp_timer_get_time();
+	if (wait > 0)
+	{
+		usleep(wait);
+	}
+}
+
+static bench_sender_t *bench_sender;
+
+/**
+ * recv that opens the sender window by what it took.
+ */
+static ssize_t bench_recv(int fd, void *buf, size_t len)
+{
+	ssize_t received = recv(fd, buf, len, 0);
+	if (received > 0)
+	{
+		atomic_fetch_add(&bench_sender->received, received);
+	}
+	return received;
+}
+
+static esp_err_t bench_sink_begin(void *ctx, size_t size)
+{
+	bench_sink_t *sink = ctx;
+
+	sink->file = tmpfile();
+	sink->size = size;
+	sink->written = 0;
+	sink->crc = 0;
+	return sink->file ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t bench_sink_write(void *ctx, const void *data, size_t len)
+{
+	bench_sink_t *sink = ctx;
+	int64_t start = esp_timer_get_time();
+
+	if (sink->written + len > sink->size || fwrite(data, 1, len, sink->file) != len)
+	{
+		return ESP_ERR_INVALID_SIZE;
+	}
+	sink->crc = esp_crc32_le(sink->crc, data, len);
+	sink->written += len;
+
+	bench_pace(start, len, sink->flash_kbps);
+	return ESP_OK;
+}
+
+static esp_err_t bench_sink_finish(void *ctx)
+{
+	bench_sink_t *sink = ctx;
+	esp_err_t err = ESP_OK;
+
+	if (fflush(sink->file) != 0)
+	{
+		err = ESP_FAIL;
+	}
+	else if (sink->written != sink->size || sink->crc != sink->expected_crc)
+	{
+		err = ESP_ERR_INVALID_CRC;
+	}
+	fclose(sink->file);
+	sink->file = NULL;
+	return err;
+}
+
+static void bench_sink_abort(void *ctx)
+{
+	bench_sink_t *sink = ctx;
+
+	if (sink->file)
+	{
+		fclose(sink->file);
+		sink->file = NULL;
+	}
+}
+
+static void *bench_sender_thread(void *arg)
+{
+	bench_sender_t *sender = arg;
+	size_t sent = 0;
+
+	while (sent < sender->size)
+	{
+		size_t n = sender->size - sent;
+		n = (n < BENCH_OTA_SEGMENT) ? n : BENCH_OTA_SEGMENT;
+
+		// The kernel buffers far more than lwIP would, the window is kept here
+		while (sent + n - atomic_load(&sender->received) > sender->window)
+		{
+			usleep(50);
+		}
+
+		// Paced from when the segment went out, time spent waiting on a full window is lost
+		int64_t start = esp_timer_get_time();
+		ssize_t done = send(sender->fd, &sender->image[sent], n, 0);
+		if (done <= 0)
+		{
+			break;
+		}
+		sent += done;
+		bench_pace(start, done, sender->link_kbps);
+	}
+	return NULL;
+}
+
+/**
+ * Receives an image through ota_stream, as the /ota handler does.
+ * @return the result of ota_stream_finish.
+ */
+static esp_err_t bench_receive_stream(int fd, const ota_sink_t *sink, size_t size, ota_stream_stats_t *stats)
+{
+	ota_stream_t stream;
+	size_t remaining = size;
+
+	esp_err_t err = ota_stream_begin(&stream, sink, size);
+	if (err != ESP_OK)
+	{
+		return err;
+	}
+
+	while (remaining > 0)
+	{
+		size_t room;
+		uint8_t *buf = ota_stream_buffer(&stream, &room);
+		if (buf == NULL)
+		{
+			break;
+		}
+
+		ssize_t received = bench_recv(fd, buf, (room < remaining) ? room : remaining);
+		if (received <= 0)
+		{
+			break;
+		}
+		remaining -= received;
+
+		if (ota_stream_commit(&stream, received) != ESP_OK)
+		{
+			break;
+		}
+	}
+
+	*stats = stream.stats;
+	return remaining == 0 ? ota_stream_finish(&stream) : ota_stream_abort(&stream);
+}
+
+/**
+ * Receives an image one sector at a time on a single thread, the flash waits for the
+ * socket and the socket for the flash.
+ * @return ESP_OK if the sink accepted the image.
+ */
+static esp_err_t bench_receive_serial(int fd, const ota_sink_t *sink, size_t size)
+{
+	static uint8_t buf[OTA_STREAM_BUFFER_SIZE];
+	size_t remaining = size;
+
+	esp_err_t err = sink->begin(sink->ctx, size);
+	while (err == ESP_OK && remaining > 0)
+	{
+		size_t len = 0;
+		size_t want = (remaining < sizeof(buf)) ? remaining : sizeof(buf);
+
+		while (len < want)
+		{
+			ssize_t received = bench_recv(fd, &buf[len], want - len);
+			if (received <= 0)
+			{
+				sink->abort(sink->ctx);
+				return ESP_FAIL;
+			}
+			len += received;
+		}
+		remaining -= len;
+		err = sink->write(sink->ctx, buf, len);
+	}
+
+	if (err != ESP_OK)
+	{
+		sink->abort(sink->ctx);
+		return err;
+	}
+	return sink->finish(sink->ctx);
+}
+
+/**
+ * Uploads the image once and prints one row.
+ * @param pipelined true through ota_stream, false with the serial loop.
+ * @param image image to upload.
+ * @param size image size.
+ * @param link_kbps link rate, 0 flat out.
+ * @param flash_kbps flash rate, 0 as fast as the file.
+ * @param window TCP window in bytes.
+ */
+static void bench_ota_run(bool pipelined, const uint8_t *image, size_t size, uint32_t link_kbps, uint32_t flash_kbps,
+		size_t window)
+{
+	int fds[2];
+	pthread_t thread;
+	ota_stream_stats_t stats = { 0 };
+	bench_sink_t state = {
+		.flash_kbps = flash_kbps,
+		.expected_crc = esp_crc32_le(0, image, size),
+	};
+	const ota_sink_t sink = {
+		.begin = bench_sink_begin,
+		.write = bench_sink_write,
+		.finish = bench_sink_finish,
+		.abort = bench_sink_abort,
+		.ctx = &state,
+	};
+
+	socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	bench_sender_t sender = { .fd = fds[0], .image = image, .size = size, .link_kbps = link_kbps, .window = window };
+	atomic_init(&sender.received, 0);
+	bench_sender = &sender;
+
+	int64_t start = esp_timer_get_time();
+	pthread_create(&thread, NULL, bench_sender_thread, &sender);
+	esp_err_t err = pipelined ? bench_receive_stream(fds[1], &sink, size, &stats) : bench_receive_serial(fds[1], &sink, size);
+	int64_t elapsed = esp_timer_get_time() - start;
+
+	shutdown(fds[1], SHUT_RDWR);
+	pthread_join(thread, NULL);
+	close(fds[0]);
+	close(fds[1]);
+
+	char link[16];
+	char flash[16];
+	snprintf(link, sizeof(link), link_kbps ? "%u" : "-", link_kbps);
+	snprintf(flash, sizeof(flash), flash_kbps ? "%u" : "-", flash_kbps);
+
+	printf("%-9s %10s %11s %9zu %8.2f %8.1f%% %8.1f%%  %s\n", pipelined ? "pipelined" : "serial", link, flash, window,
+			(double)size / elapsed, pipelined ? 100.0 * stats.stall_us / elapsed : 0.0,
+			pipelined ? 100.0 * stats.write_us / elapsed : 0.0, err == ESP_OK ? "ok" : esp_err_to_name(err));
+}
+
+int main(int argc, char **argv)
+{
+	size_t size = (argc > 1 ? atoi(argv[1]) : 1024) * 1024;
+	const uint32_t runs[][3] = {
+		{ 0, 0, BENCH_OTA_WINDOW },
+		{ BENCH_OTA_LINK_KBPS, 0, BENCH_OTA_WINDOW },
+		{ 0, BENCH_OTA_FLASH_KBPS, BENCH_OTA_WINDOW },
+		{ BENCH_OTA_LINK_KBPS, BENCH_OTA_FLASH_KBPS, BENCH_OTA_WINDOW },
+		{ BENCH_OTA_LINK_KBPS, BENCH_OTA_FLASH_KBPS, BENCH_OTA_WINDOW_SMALL },
+	};
+
+	// Odd sizes on purpose, the last buffer is a partial one
+	size -= 100;
+	uint8_t *image = malloc(size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		image[i] = (uint8_t)(i * 2654435761U >> 24);
+	}
+
+	printf("ota upload of %zu bytes into a file-backed sink, rates in kB/s, - for flat out\n", size);
+	printf("%-9s %10s %11s %9s %8s %9s %9s  %s\n", "mode", "link_kB/s", "flash_kB/s", "window_B", "MB/s", "stall", "writing",
+			"image");
+
+	for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); ++i)
+	{
+		bench_ota_run(false, image, size, runs[i][0], runs[i][1], runs[i][2]);
+		bench_ota_run(true, image, size, runs[i][0], runs[i][1], runs[i][2]);
+	}
+
+	free(image);
+	return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * bench_pipeline.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench_load.h"
+#include "host_pipeline.h"
+#include "ws_client.h"
+
+// Load threads, like two application tasks logging at once
+#define BENCH_PIPELINE_THREADS		2
+
+// Paced rate of the latency runs, CONFIG_WS_BENCHMARK_LINES_PER_S on the device
+#define BENCH_PIPELINE_RATE			2000
+
+/**
+ * Load of one run, its result comes back from the run's process
+ */
+typedef struct bench_pipeline_load
+{
+	uint32_t seconds;
+	uint32_t rate;
+	bench_load_result_t result;
+} bench_pipeline_load_t;
+
+static void bench_pipeline_load(void *arg)
+{
+	bench_pipeline_load_t *load = arg;
+
+	bench_load_run(BENCH_PIPELINE_THREADS, load->seconds, load->rate, &load->result);
+}
+
+/**
+ * Runs the log pipeline once and prints one row.
+ * @param name run name.
+ * @param clients websocket clients.
+ * @param seconds load duration.
+ * @param rate total lines per second, 0 flat out.
+ */
+static void bench_pipeline_run(const char *name, uint32_t clients, uint32_t seconds, uint32_t rate)
+{
+	bench_pipeline_load_t load = { .seconds = seconds, .rate = rate };
+	host_pipeline_stats_t stats;
+
+	if (host_pipeline_run(clients, bench_pipeline_load, &load, sizeof(load), &stats) != ESP_OK)
+	{
+		printf("%-10s %7u failed\n", name, clients);
+		return;
+	}
+
+	// Lines lost anywhere on the way, full ring or overflowing client queue
+	double expected = (double)stats.logged * clients;
+	double elapsed = load.result.elapsed_us / 1e6;
+	printf("%-10s %7u %11.0f %11.0f %6.1f%% %7u %7u %7u %8u %10u %10lld\n",
+			name, clients, load.result.lines / elapsed, stats.received / clients / elapsed,
+			expected > 0 ? 100.0 * (1.0 - stats.received / expected) : 0.0,
+			stats.latency_us[0], stats.latency_us[1], stats.latency_us[2], stats.latency_us[3],
+			stats.queued_peak, (long long)(stats.heap_peak / clients));
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t seconds = argc > 1 ? atoi(argv[1]) : 2;
+	const uint32_t clients[] = { 1, WS_CLIENT_MAX_CLIENTS };
+
+	printf("log pipeline, %d load threads, %u s per run\n", BENCH_PIPELINE_THREADS, seconds);
+	printf("%-10s %7s %11s %11s %7s %7s %7s %7s %8s %10s %10s\n", "run", "clients", "calls/s", "received/s",
+			"lost", "p50_us", "p90_us", "p99_us", "max_us", "queued_B", "heap_B/cl");
+
+	for (size_t i = 0; i < sizeof(clients) / sizeof(clients[0]); ++i)
+	{
+		bench_pipeline_run("flat_out", clients[i], seconds, 0);
+		bench_pipeline_run("paced", clients[i], seconds, BENCH_PIPELINE_RATE);
+	}
+	return 0;
+}
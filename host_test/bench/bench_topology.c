@@ -0,0 +1,91 @@
+/*
+ * bench_topology.c
+ *
+ *  Created on: Jun 03, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench_load.h"
+#include "host_pipeline.h"
+#include "task_topology.h"
+
+/**
+ * The topology benchmark of main/APIs/BENCH on the host: the same log load through the
+ * pipeline under every built-in topology, flat out for throughput and paced for jitter.
+ * The httpd task, the log task and the load tasks are pinned to the host CPUs their cores
+ * map to. Priorities are not applied, so only the core placement is compared.
+ */
+
+// Load threads and clients, as CONFIG_WS_BENCHMARK_TASKS and one dashboard plus one script
+#define BENCH_TOPOLOGY_THREADS		2
+#define BENCH_TOPOLOGY_CLIENTS		2
+
+// Paced rate, CONFIG_WS_BENCHMARK_LINES_PER_S on the device
+#define BENCH_TOPOLOGY_RATE			2000
+
+/**
+ * Load of one run, its result comes back from the run's process
+ */
+typedef struct bench_topology_load
+{
+	uint32_t seconds;
+	uint32_t rate;
+	bench_load_result_t result;
+} bench_topology_load_t;
+
+static void bench_topology_load(void *arg)
+{
+	bench_topology_load_t *load = arg;
+
+	bench_load_run(BENCH_TOPOLOGY_THREADS, load->seconds, load->rate, &load->result);
+}
+
+/**
+ * Runs the log pipeline once under the topology in use and prints one row.
+ * @param seconds load duration.
+ * @param rate total lines per second, 0 flat out.
+ */
+static void bench_topology_run(uint32_t seconds, uint32_t rate)
+{
+	bench_topology_load_t load = { .seconds = seconds, .rate = rate };
+	host_pipeline_stats_t stats;
+	const char *name = task_topology_preset_name(task_topology_active());
+
+	// The run's process inherits the selected topology
+	if (host_pipeline_run(BENCH_TOPOLOGY_CLIENTS, bench_topology_load, &load, sizeof(load), &stats) != ESP_OK)
+	{
+		printf("%-10s %-8s failed\n", name, rate ? "paced" : "flat_out");
+		return;
+	}
+
+	double expected = (double)stats.logged * BENCH_TOPOLOGY_CLIENTS;
+	double elapsed = load.result.elapsed_us / 1e6;
+	printf("%-10s %-8s %11.0f %11.0f %6.1f%% %7u %7u %7u %10u %10u\n",
+			name, rate ? "paced" : "flat_out",
+			load.result.lines / elapsed, stats.received / BENCH_TOPOLOGY_CLIENTS / elapsed,
+			expected > 0 ? 100.0 * (1.0 - stats.received / expected) : 0.0,
+			stats.latency_us[0], stats.latency_us[2], stats.latency_us[3],
+			load.result.jitter_mean_us, load.result.jitter_max_us);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t seconds = argc > 1 ? atoi(argv[1]) : 2;
+
+	printf("task topologies, %d load threads, %d clients, %u s per run, %ld host CPUs\n",
+			BENCH_TOPOLOGY_THREADS, BENCH_TOPOLOGY_CLIENTS, seconds, sysconf(_SC_NPROCESSORS_ONLN));
+	printf("%-10s %-8s %11s %11s %7s %7s %7s %7s %10s %10s\n", "topology", "run", "calls/s", "received/s",
+			"lost", "p50_us", "p99_us", "max_us", "jitter_us", "jit_max_us");
+
+	for (uint32_t preset = 0; preset < task_topology_preset_count(); ++preset)
+	{
+		task_topology_select(preset);
+		bench_topology_run(seconds, 0);
+		bench_topology_run(seconds, BENCH_TOPOLOGY_RATE);
+	}
+	return 0;
+}
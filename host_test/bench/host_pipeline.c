@@ -0,0 +1,337 @@
+/*
+ * host_pipeline.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "host_httpd.h"
+#include "host_pipeline.h"
+#include "http_server.h"
+#include "ws_client.h"
+
+// Longest frame a reader takes, a whole batch of lines
+#define HOST_PIPELINE_FRAME_MAX			(WS_LOG_BATCH_SIZE + 64)
+
+// The run is over once nothing arrived for this long and no frame is queued
+#define HOST_PIPELINE_QUIET_MS			100
+
+// Memory in use is sampled this often
+#define HOST_PIPELINE_SAMPLE_MS			1
+
+/**
+ * Websocket client and the thread reading it
+ */
+typedef struct host_pipeline_client
+{
+	int server;						///> End written by host_httpd, the session socket
+	int client;						///> End read by the reader thread
+	pthread_t reader;
+	_Atomic uint32_t frames;
+	_Atomic uint32_t lines;
+	_Atomic uint64_t bytes;
+} host_pipeline_client_t;
+
+static host_pipeline_client_t host_pipeline_clients[WS_CLIENT_MAX_CLIENTS];
+static uint32_t host_pipeline_client_count;
+
+// Hook installed by log_for_websocket_setup, called behind the counter
+static vprintf_like_t host_pipeline_hook;
+static _Atomic uint32_t host_pipeline_logged;
+
+static uint32_t *host_pipeline_samples;
+static _Atomic uint32_t host_pipeline_sample_count;
+
+static _Atomic bool host_pipeline_sampling;
+static int64_t host_pipeline_heap_start;
+static int64_t host_pipeline_heap_peak;
+static uint32_t host_pipeline_queued_peak;
+
+static size_t host_pipeline_heap(void)
+{
+	return mallinfo2().uordblks;
+}
+
+static int host_pipeline_vprintf(const char *format, va_list args)
+{
+	atomic_fetch_add_explicit(&host_pipeline_logged, 1, memory_order_relaxed);
+	return host_pipeline_hook(format, args);
+}
+
+/**
+ * Reads exactly len bytes.
+ * @return false on EOF or error.
+ */
+static bool host_pipeline_read(int fd, uint8_t *out, size_t len)
+{
+	while (len)
+	{
+		ssize_t n = read(fd, out, len);
+		if (n <= 0)
+		{
+			return false;
+		}
+		out += n;
+		len -= n;
+	}
+	return true;
+}
+
+/**
+ * Reader thread, counts the lines of every frame and records how old they are.
+ * @param arg client.
+ */
+static void *host_pipeline_reader(void *arg)
+{
+	host_pipeline_client_t *client = arg;
+	uint8_t *frame = malloc(HOST_PIPELINE_FRAME_MAX + 1);
+	uint8_t header[4];
+
+	while (host_pipeline_read(client->client, header, sizeof(header)))
+	{
+		uint32_t len = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+		if (len > HOST_PIPELINE_FRAME_MAX || !host_pipeline_read(client->client, frame, len))
+		{
+			break;
+		}
+		frame[len] = '\0';
+
+		int64_t now = esp_timer_get_time();
+		uint32_t lines = 0;
+		for (char *t = strstr((char *)frame, "t="); t; t = strstr(t + 2, "t="))
+		{
+			int64_t sent = strtoll(t + 2, NULL, 10);
+			uint32_t index = atomic_fetch_add_explicit(&host_pipeline_sample_count, 1, memory_order_relaxed);
+			if (index < HOST_PIPELINE_MAX_SAMPLES)
+			{
+				host_pipeline_samples[index] = (uint32_t)(now - sent);
+			}
+			lines++;
+		}
+
+		atomic_fetch_add_explicit(&client->bytes, len, memory_order_relaxed);
+		atomic_fetch_add_explicit(&client->lines, lines, memory_order_relaxed);
+		atomic_fetch_add_explicit(&client->frames, 1, memory_order_relaxed);
+	}
+
+	free(frame);
+	return NULL;
+}
+
+/**
+ * Sampler thread, keeps the peaks of the client queues and of the heap.
+ * @param arg unused.
+ */
+static void *host_pipeline_sampler(void *arg)
+{
+	(void)arg;
+
+	while (atomic_load(&host_pipeline_sampling))
+	{
+		ws_client_stats_t stats[WS_CLIENT_MAX_CLIENTS];
+		size_t count = ws_client_get_stats(stats, WS_CLIENT_MAX_CLIENTS);
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (stats[i].queued_bytes > host_pipeline_queued_peak)
+			{
+				host_pipeline_queued_peak = stats[i].queued_bytes;
+			}
+		}
+
+		int64_t heap = (int64_t)host_pipeline_heap() - host_pipeline_heap_start;
+		if (heap > host_pipeline_heap_peak)
+		{
+			host_pipeline_heap_peak = heap;
+		}
+		vTaskDelay(pdMS_TO_TICKS(HOST_PIPELINE_SAMPLE_MS));
+	}
+	return NULL;
+}
+
+/**
+ * Frames still queued on the clients.
+ */
+static uint32_t host_pipeline_queued(void)
+{
+	ws_client_stats_t stats[WS_CLIENT_MAX_CLIENTS];
+	size_t count = ws_client_get_stats(stats, WS_CLIENT_MAX_CLIENTS);
+	uint32_t queued = 0;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		queued += stats[i].queued_frames;
+	}
+	return queued;
+}
+
+/**
+ * Lines received so far by every client.
+ */
+static uint32_t host_pipeline_received(void)
+{
+	uint32_t received = 0;
+
+	for (uint32_t i = 0; i < host_pipeline_client_count; ++i)
+	{
+		received += atomic_load(&host_pipeline_clients[i].lines);
+	}
+	return received;
+}
+
+static int host_pipeline_compare(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * One run, in the child process.
+ */
+static void host_pipeline_child(uint32_t clients, host_pipeline_load_t load, void *arg, host_pipeline_stats_t *stats)
+{
+	// http_websocket_vprintf echoes every line on the console
+	int null = open("/dev/null", O_WRONLY);
+	dup2(null, STDOUT_FILENO);
+	close(null);
+
+	host_pipeline_samples = malloc(HOST_PIPELINE_MAX_SAMPLES * sizeof(uint32_t));
+
+	// Same order as app_main, a station joining the SoftAP starts the server
+	log_for_websocket_setup();
+	host_pipeline_hook = esp_log_set_vprintf(host_pipeline_vprintf);
+	http_server_init();
+	http_server_acquire(HTTP_SERVER_USER_AP);
+	while (host_httpd_get() == NULL)
+	{
+		vTaskDelay(pdMS_TO_TICKS(1));
+	}
+	httpd_handle_t server = host_httpd_get();
+
+	host_pipeline_client_count = clients < WS_CLIENT_MAX_CLIENTS ? clients : WS_CLIENT_MAX_CLIENTS;
+	for (uint32_t i = 0; i < host_pipeline_client_count; ++i)
+	{
+		host_pipeline_client_t *client = &host_pipeline_clients[i];
+		int fds[2];
+
+		socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+		client->server = fds[0];
+		client->client = fds[1];
+		pthread_create(&client->reader, NULL, host_pipeline_reader, client);
+		ESP_ERROR_CHECK(host_httpd_open(server, client->server, "/ws"));
+	}
+
+	pthread_t sampler;
+	host_pipeline_heap_start = host_pipeline_heap();
+	atomic_store(&host_pipeline_sampling, true);
+	pthread_create(&sampler, NULL, host_pipeline_sampler, NULL);
+
+	load(arg);
+
+	// Drained once the clients stopped receiving and nothing is left in their queues
+	uint32_t received = host_pipeline_received();
+	int64_t quiet_since = esp_timer_get_time();
+	while (esp_timer_get_time() - quiet_since < HOST_PIPELINE_QUIET_MS * 1000LL || host_pipeline_queued())
+	{
+		vTaskDelay(pdMS_TO_TICKS(10));
+		uint32_t now = host_pipeline_received();
+		if (now != received)
+		{
+			received = now;
+			quiet_since = esp_timer_get_time();
+		}
+	}
+
+	atomic_store(&host_pipeline_sampling, false);
+	pthread_join(sampler, NULL);
+
+	memset(stats, 0x00, sizeof(host_pipeline_stats_t));
+	for (uint32_t i = 0; i < host_pipeline_client_count; ++i)
+	{
+		host_pipeline_client_t *client = &host_pipeline_clients[i];
+
+		stats->frames += atomic_load(&client->frames);
+		stats->received += atomic_load(&client->lines);
+		stats->received_bytes += atomic_load(&client->bytes);
+	}
+
+	host_httpd_stats(server, &stats->httpd_frames, &stats->httpd_send_us);
+	stats->logged = atomic_load(&host_pipeline_logged);
+	stats->queued_peak = host_pipeline_queued_peak;
+	stats->heap_peak = host_pipeline_heap_peak;
+
+	uint32_t samples = atomic_load(&host_pipeline_sample_count);
+	stats->samples = samples < HOST_PIPELINE_MAX_SAMPLES ? samples : HOST_PIPELINE_MAX_SAMPLES;
+	if (stats->samples)
+	{
+		static const uint32_t permille[] = { 500, 900, 990, 1000 };
+
+		qsort(host_pipeline_samples, stats->samples, sizeof(uint32_t), host_pipeline_compare);
+		for (size_t i = 0; i < 4; ++i)
+		{
+			uint32_t index = (uint64_t)stats->samples * permille[i] / 1000;
+			stats->latency_us[i] = host_pipeline_samples[index < stats->samples ? index : stats->samples - 1];
+		}
+	}
+}
+
+esp_err_t host_pipeline_run(uint32_t clients, host_pipeline_load_t load, void *arg, size_t arg_size,
+		host_pipeline_stats_t *stats)
+{
+	int result[2];
+
+	if (pipe(result) != 0)
+	{
+		return ESP_FAIL;
+	}
+
+	// Nothing buffered may be written twice
+	fflush(stdout);
+	fflush(stderr);
+
+	pid_t child = fork();
+	if (child < 0)
+	{
+		close(result[0]);
+		close(result[1]);
+		return ESP_FAIL;
+	}
+
+	if (child == 0)
+	{
+		close(result[0]);
+		host_pipeline_child(clients, load, arg, stats);
+
+		bool written = write(result[1], stats, sizeof(*stats)) == (ssize_t)sizeof(*stats) &&
+				write(result[1], arg, arg_size) == (ssize_t)arg_size;
+		_exit(written ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	close(result[1]);
+	bool complete = host_pipeline_read(result[0], (uint8_t *)stats, sizeof(*stats)) &&
+			host_pipeline_read(result[0], arg, arg_size);
+	close(result[0]);
+
+	int status;
+	waitpid(child, &status, 0);
+	return (complete && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) ? ESP_OK : ESP_FAIL;
+}
@@ -0,0 +1,67 @@
+/*
+ * host_pipeline.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_PIPELINE_H_
+#define HOST_PIPELINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Latency samples kept per run, later ones are counted but not kept
+#define HOST_PIPELINE_MAX_SAMPLES		(1 << 20)
+
+/**
+ * Log pipeline of http_server.c on the host, the firmware code itself: the load logs
+ * through esp_log_write into http_websocket_vprintf, ws_print batches the lines into
+ * frames, ws_client queues them and host_httpd writes them to socketpair clients that
+ * connected to "/ws" like a browser would. A reader thread per client takes the frames
+ * apart and measures how old every line is. Lines must carry "t=<esp_timer_get_time>"
+ * for the latency to be measured.
+ *
+ * http_server.c keeps its state in statics and ws_print never returns, so every run
+ * happens in a child process of its own. Console output of the child is discarded.
+ */
+
+/**
+ * Result of one run
+ */
+typedef struct host_pipeline_stats
+{
+	uint32_t logged;				///> Lines that reached the vprintf hook
+	uint32_t frames;				///> Frames the clients received, every client counted
+	uint32_t received;				///> Lines the clients received, every client counted
+	uint64_t received_bytes;		///> Frame payload bytes the clients received
+	uint32_t samples;				///> Latency samples kept
+	uint32_t latency_us[4];			///> Log call to client read latency: p50, p90, p99, max
+	uint32_t queued_peak;			///> Most bytes ever queued on a single client
+	int64_t heap_peak;				///> Most heap ever in use beyond the start of the load
+	uint32_t httpd_frames;			///> Frames written to sockets
+	uint64_t httpd_send_us;			///> Time the httpd task spent in sends
+} host_pipeline_stats_t;
+
+/**
+ * Load of a run, logs its lines and returns once it is done.
+ * @param arg argument handed to host_pipeline_run.
+ */
+typedef void (*host_pipeline_load_t)(void *arg);
+
+/**
+ * Starts the firmware log pipeline with its clients in a child process, runs the load
+ * there and waits until every line that got through has reached every client.
+ * @param clients number of websocket clients, at most WS_CLIENT_MAX_CLIENTS.
+ * @param load function logging the lines.
+ * @param arg argument of load, copied back from the child after the run.
+ * @param arg_size bytes of arg.
+ * @param stats receives the result of the run.
+ * @return ESP_OK, ESP_FAIL if the child did not finish the run.
+ */
+esp_err_t host_pipeline_run(uint32_t clients, host_pipeline_load_t load, void *arg, size_t arg_size,
+		host_pipeline_stats_t *stats);
+
+#endif /* HOST_PIPELINE_H_ */
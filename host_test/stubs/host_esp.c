@@ -0,0 +1,324 @@
+/*
+ * host_esp.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <malloc.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/param.h>
+#include <time.h>
+
+#include "esp_crc.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+/**
+ * esp_timer stand-in, armed while deadline is not 0
+ */
+struct esp_timer
+{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	esp_timer_cb_t callback;
+	void *arg;
+	int64_t deadline;				///> esp_timer_get_time to fire at
+	uint64_t period;				///> Microseconds between periodic firings, 0 for one-shot
+	bool quit;
+};
+
+// Shutdown handlers esp_restart runs, as many as the device takes
+#define HOST_ESP_MAX_SHUTDOWN_HANDLERS		5
+
+static shutdown_handler_t host_esp_shutdown_handlers[HOST_ESP_MAX_SHUTDOWN_HANDLERS];
+
+// Lowest free heap any esp_get_free_heap_size call saw
+static _Atomic uint32_t host_esp_free_heap_min = UINT32_MAX;
+
+static struct timespec host_esp_epoch;
+static pthread_once_t host_esp_once = PTHREAD_ONCE_INIT;
+
+static void host_esp_init(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &host_esp_epoch);
+}
+
+int64_t esp_timer_get_time(void)
+{
+	struct timespec now;
+
+	pthread_once(&host_esp_once, host_esp_init);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)(now.tv_sec - host_esp_epoch.tv_sec) * 1000000 + (now.tv_nsec - host_esp_epoch.tv_nsec) / 1000;
+}
+
+static int host_esp_log_stderr(const char *format, va_list args)
+{
+	return vfprintf(stderr, format, args);
+}
+
+static _Atomic(vprintf_like_t) host_esp_log_vprintf = host_esp_log_stderr;
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	host_esp_log_vprintf(format, args);
+	va_end(args);
+}
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
+{
+	return atomic_exchange(&host_esp_log_vprintf, func);
+}
+
+uint32_t esp_log_timestamp(void)
+{
+	return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler)
+{
+	for (int i = 0; i < HOST_ESP_MAX_SHUTDOWN_HANDLERS; ++i)
+	{
+		if (host_esp_shutdown_handlers[i] == handler)
+		{
+			return ESP_ERR_INVALID_STATE;
+		}
+		if (host_esp_shutdown_handlers[i] == NULL)
+		{
+			host_esp_shutdown_handlers[i] = handler;
+			return ESP_OK;
+		}
+	}
+	return ESP_ERR_NO_MEM;
+}
+
+void esp_restart(void)
+{
+	// Last registered runs first, as on the device
+	for (int i = HOST_ESP_MAX_SHUTDOWN_HANDLERS - 1; i >= 0; --i)
+	{
+		if (host_esp_shutdown_handlers[i])
+		{
+			host_esp_shutdown_handlers[i]();
+		}
+	}
+	fprintf(stderr, "esp_restart\n");
+	exit(0);
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+	uint32_t free_bytes = mallinfo2().fordblks;
+	uint32_t lowest = atomic_load(&host_esp_free_heap_min);
+
+	while (free_bytes < lowest && !atomic_compare_exchange_weak(&host_esp_free_heap_min, &lowest, free_bytes))
+	{
+		// A failed exchange reloaded lowest
+	}
+	return free_bytes;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+	esp_get_free_heap_size();
+	return atomic_load(&host_esp_free_heap_min);
+}
+
+uint32_t esp_random(void)
+{
+	// random returns 31 bits
+	return ((uint32_t)random() << 16) ^ (uint32_t)random();
+}
+
+static void *host_esp_timer_main(void *arg)
+{
+	esp_timer_handle_t timer = arg;
+
+	pthread_mutex_lock(&timer->lock);
+	while (!timer->quit)
+	{
+		if (timer->deadline == 0)
+		{
+			pthread_cond_wait(&timer->changed, &timer->lock);
+			continue;
+		}
+
+		int64_t left = timer->deadline - esp_timer_get_time();
+		if (left > 0)
+		{
+			// The condition variable runs on CLOCK_REALTIME, only the length of the wait matters
+			struct timespec until;
+			clock_gettime(CLOCK_REALTIME, &until);
+			until.tv_sec += left / 1000000;
+			until.tv_nsec += (left % 1000000) * 1000;
+			if (until.tv_nsec >= 1000000000)
+			{
+				until.tv_sec++;
+				until.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&timer->changed, &timer->lock, &until);
+			continue;
+		}
+
+		// A periodic timer that fell behind skips the firings it missed
+		timer->deadline = timer->period ? MAX(timer->deadline + (int64_t)timer->period, esp_timer_get_time() + 1) : 0;
+		pthread_mutex_unlock(&timer->lock);
+		timer->callback(timer->arg);
+		pthread_mutex_lock(&timer->lock);
+	}
+	pthread_mutex_unlock(&timer->lock);
+
+	return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+	esp_timer_handle_t timer = calloc(1, sizeof(struct esp_timer));
+	if (timer == NULL)
+	{
+		return ESP_ERR_NO_MEM;
+	}
+
+	pthread_mutex_init(&timer->lock, NULL);
+	pthread_cond_init(&timer->changed, NULL);
+	timer->callback = args->callback;
+	timer->arg = args->arg;
+	if (pthread_create(&timer->thread, NULL, host_esp_timer_main, timer) != 0)
+	{
+		free(timer);
+		return ESP_ERR_NO_MEM;
+	}
+
+	*handle = timer;
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+	esp_err_t err = ESP_ERR_INVALID_STATE;
+
+	pthread_mutex_lock(&timer->lock);
+	if (timer->deadline == 0)
+	{
+		// 0 means idle, a timer due right away fires a microsecond late
+		timer->period = 0;
+		timer->deadline = esp_timer_get_time() + (int64_t)timeout_us + 1;
+		pthread_cond_broadcast(&timer->changed);
+		err = ESP_OK;
+	}
+	pthread_mutex_unlock(&timer->lock);
+
+	return err;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+	esp_err_t err = ESP_ERR_INVALID_STATE;
+
+	pthread_mutex_lock(&timer->lock);
+	if (timer->deadline == 0)
+	{
+		timer->period = period;
+		timer->deadline = esp_timer_get_time() + (int64_t)period + 1;
+		pthread_cond_broadcast(&timer->changed);
+		err = ESP_OK;
+	}
+	pthread_mutex_unlock(&timer->lock);
+
+	return err;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+	esp_err_t err = ESP_ERR_INVALID_STATE;
+
+	pthread_mutex_lock(&timer->lock);
+	if (timer->deadline != 0)
+	{
+		timer->deadline = 0;
+		timer->period = 0;
+		pthread_cond_broadcast(&timer->changed);
+		err = ESP_OK;
+	}
+	pthread_mutex_unlock(&timer->lock);
+
+	return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+	pthread_mutex_lock(&timer->lock);
+	timer->quit = true;
+	pthread_cond_broadcast(&timer->changed);
+	pthread_mutex_unlock(&timer->lock);
+
+	pthread_join(timer->thread, NULL);
+	pthread_cond_destroy(&timer->changed);
+	pthread_mutex_destroy(&timer->lock);
+	free(timer);
+	return ESP_OK;
+}
+
+uint32_t esp_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+	crc = ~crc;
+	while (len--)
+	{
+		crc ^= *buf++;
+		for (int bit = 0; bit < 8; ++bit)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320U & -(crc & 1U));
+		}
+	}
+	return ~crc;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+	static const struct
+	{
+		esp_err_t code;
+		const char *name;
+	} names[] =
+	{
+		{ ESP_OK, "ESP_OK" },
+		{ ESP_FAIL, "ESP_FAIL" },
+		{ ESP_ERR_NO_MEM, "ESP_ERR_NO_MEM" },
+		{ ESP_ERR_INVALID_ARG, "ESP_ERR_INVALID_ARG" },
+		{ ESP_ERR_INVALID_STATE, "ESP_ERR_INVALID_STATE" },
+		{ ESP_ERR_INVALID_SIZE, "ESP_ERR_INVALID_SIZE" },
+		{ ESP_ERR_NOT_FOUND, "ESP_ERR_NOT_FOUND" },
+		{ ESP_ERR_NOT_SUPPORTED, "ESP_ERR_NOT_SUPPORTED" },
+		{ ESP_ERR_TIMEOUT, "ESP_ERR_TIMEOUT" },
+		{ ESP_ERR_INVALID_CRC, "ESP_ERR_INVALID_CRC" },
+		{ ESP_ERR_NOT_FINISHED, "ESP_ERR_NOT_FINISHED" },
+		{ ESP_ERR_OTA_PARTITION_CONFLICT, "ESP_ERR_OTA_PARTITION_CONFLICT" },
+		{ ESP_ERR_OTA_VALIDATE_FAILED, "ESP_ERR_OTA_VALIDATE_FAILED" },
+	};
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+	{
+		if (names[i].code == code)
+		{
+			return names[i].name;
+		}
+	}
+	return "UNKNOWN ERROR";
+}
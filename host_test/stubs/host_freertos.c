@@ -0,0 +1,537 @@
+/*
+ * host_freertos.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+/**
+ * Ring of fixed size items behind a mutex. Semaphores are queues of zero sized items
+ * where only the count matters.
+ */
+struct host_queue
+{
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	uint8_t *items;
+	UBaseType_t length;
+	UBaseType_t item_size;
+	UBaseType_t head;
+	UBaseType_t count;
+};
+
+/**
+ * Task behind a TaskHandle_t, with its notification count
+ */
+struct host_task
+{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t notified;
+	uint32_t notify;
+	TaskFunction_t fn;
+	void *arg;
+	char name[configMAX_TASK_NAME_LEN];
+	UBaseType_t number;				///> Unique for the life of the process, from 1
+	UBaseType_t priority;
+	BaseType_t core_id;
+	uint32_t stack_size;
+	bool ended;						///> Returned, deleted or cancelled
+	struct host_task *next;			///> Next task created
+};
+
+/**
+ * Event group bits behind a mutex
+ */
+struct host_event_group
+{
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	EventBits_t bits;
+};
+
+// Task of the calling thread, NULL outside of tasks
+static __thread TaskHandle_t host_task_self;
+
+// Every task ever created, for uxTaskGetSystemState
+static pthread_mutex_t host_task_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static TaskHandle_t host_task_first;
+static TaskHandle_t host_task_last;
+static UBaseType_t host_task_count;
+
+static struct timespec host_freertos_epoch;
+static pthread_once_t host_freertos_once = PTHREAD_ONCE_INIT;
+
+static void host_freertos_init(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &host_freertos_epoch);
+}
+
+/**
+ * Turns a wait in ticks into an absolute CLOCK_MONOTONIC deadline.
+ * @param wait ticks to wait, a tick is a millisecond.
+ * @param deadline receives the deadline.
+ */
+static void host_freertos_deadline(TickType_t wait, struct timespec *deadline)
+{
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += wait / 1000;
+	deadline->tv_nsec += (long)(wait % 1000) * 1000000L;
+	if (deadline->tv_nsec >= 1000000000L)
+	{
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+/**
+ * Waits for the queue to change. Caller holds the queue lock.
+ * @param queue queue to wait on.
+ * @param wait ticks to wait in total, portMAX_DELAY for ever.
+ * @param deadline deadline from host_freertos_deadline, unused with portMAX_DELAY.
+ * @return false once the deadline passed.
+ */
+static bool host_queue_wait(QueueHandle_t queue, TickType_t wait, const struct timespec *deadline)
+{
+	if (wait == 0)
+	{
+		return false;
+	}
+	if (wait == portMAX_DELAY)
+	{
+		pthread_cond_wait(&queue->changed, &queue->lock);
+		return true;
+	}
+	return pthread_cond_timedwait(&queue->changed, &queue->lock, deadline) != ETIMEDOUT;
+}
+
+static QueueHandle_t host_queue_create(UBaseType_t length, UBaseType_t item_size, UBaseType_t count)
+{
+	QueueHandle_t queue = calloc(1, sizeof(struct host_queue));
+	if (queue == NULL)
+	{
+		return NULL;
+	}
+
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&queue->changed, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_mutex_init(&queue->lock, NULL);
+
+	queue->items = item_size ? calloc(length, item_size) : NULL;
+	queue->length = length;
+	queue->item_size = item_size;
+	queue->count = count;
+	if (item_size && queue->items == NULL)
+	{
+		vQueueDelete(queue);
+		return NULL;
+	}
+	return queue;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+	return host_queue_create(length, item_size, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+	// Not recursive and without priority inheritance, as the code using it expects neither
+	return host_queue_create(1, 0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+	return host_queue_create(1, 0, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+	return host_queue_create(max_count, 0, initial_count);
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+	if (queue)
+	{
+		pthread_cond_destroy(&queue->changed);
+		pthread_mutex_destroy(&queue->lock);
+		free(queue->items);
+		free(queue);
+	}
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+	struct timespec deadline;
+	host_freertos_deadline(wait, &deadline);
+
+	pthread_mutex_lock(&queue->lock);
+	while (queue->count == queue->length)
+	{
+		if (!host_queue_wait(queue, wait, &deadline))
+		{
+			pthread_mutex_unlock(&queue->lock);
+			return pdFAIL;
+		}
+	}
+
+	if (queue->item_size)
+	{
+		UBaseType_t tail = (queue->head + queue->count) % queue->length;
+		memcpy(&queue->items[tail * queue->item_size], item, queue->item_size);
+	}
+	queue->count++;
+	pthread_cond_broadcast(&queue->changed);
+	pthread_mutex_unlock(&queue->lock);
+
+	return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken)
+{
+	if (woken)
+	{
+		*woken = pdFALSE;
+	}
+	return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+	struct timespec deadline;
+	host_freertos_deadline(wait, &deadline);
+
+	pthread_mutex_lock(&queue->lock);
+	while (queue->count == 0)
+	{
+		if (!host_queue_wait(queue, wait, &deadline))
+		{
+			pthread_mutex_unlock(&queue->lock);
+			return pdFAIL;
+		}
+	}
+
+	if (queue->item_size)
+	{
+		memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+		queue->head = (queue->head + 1) % queue->length;
+	}
+	queue->count--;
+	pthread_cond_broadcast(&queue->changed);
+	pthread_mutex_unlock(&queue->lock);
+
+	return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+	pthread_mutex_lock(&queue->lock);
+	UBaseType_t count = queue->count;
+	pthread_mutex_unlock(&queue->lock);
+
+	return count;
+}
+
+/**
+ * Marks a task ended, however its thread ended. The thread is still alive while the list
+ * lock is held, so uxTaskGetSystemState can read its CPU clock.
+ */
+static void host_task_end(void *arg)
+{
+	TaskHandle_t task = arg;
+
+	pthread_mutex_lock(&host_task_list_lock);
+	task->ended = true;
+	pthread_mutex_unlock(&host_task_list_lock);
+}
+
+static void *host_task_main(void *arg)
+{
+	TaskHandle_t task = arg;
+
+	host_task_self = task;
+	pthread_cleanup_push(host_task_end, task);
+	task->fn(task->arg);
+	pthread_cleanup_pop(1);
+	return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_size, void *arg,
+		UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id)
+{
+	// Never freed, a handle can be notified after its task ended
+	TaskHandle_t task = calloc(1, sizeof(struct host_task));
+	if (task == NULL)
+	{
+		return pdFAIL;
+	}
+	pthread_condattr_t cond_attr;
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&task->notified, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
+	pthread_mutex_init(&task->lock, NULL);
+	task->fn = fn;
+	task->arg = arg;
+	snprintf(task->name, sizeof(task->name), "%s", name);
+	task->priority = priority;
+	task->core_id = core_id;
+	task->stack_size = stack_size;
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (core_id != tskNO_AFFINITY)
+	{
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(core_id % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	}
+
+	// The handle is out before the task runs, as FreeRTOS hands it out before a higher priority task starts
+	if (handle)
+	{
+		*handle = task;
+	}
+
+	// Listed before it runs, so it can end before anybody looks
+	pthread_mutex_lock(&host_task_list_lock);
+	int err = pthread_create(&task->thread, &attr, host_task_main, task);
+	pthread_attr_destroy(&attr);
+	if (err)
+	{
+		pthread_mutex_unlock(&host_task_list_lock);
+		if (handle)
+		{
+			*handle = NULL;
+		}
+		free(task);
+		return pdFAIL;
+	}
+	task->number = ++host_task_count;
+	if (host_task_last)
+	{
+		host_task_last->next = task;
+	}
+	else
+	{
+		host_task_first = task;
+	}
+	host_task_last = task;
+	pthread_mutex_unlock(&host_task_list_lock);
+
+	// Linux keeps 15 characters of a thread name
+	char thread_name[16];
+	snprintf(thread_name, sizeof(thread_name), "%s", name);
+	pthread_setname_np(task->thread, thread_name);
+	return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+	if (task == NULL || task == host_task_self)
+	{
+		pthread_exit(NULL);
+	}
+	pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+	struct timespec delay = { .tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000L };
+
+	while (nanosleep(&delay, &delay) && errno == EINTR)
+	{
+	}
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t ticks)
+{
+	*previous_wake += ticks;
+
+	TickType_t now = xTaskGetTickCount();
+	if ((int32_t)(*previous_wake - now) > 0)
+	{
+		vTaskDelay(*previous_wake - now);
+	}
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	struct timespec now;
+
+	pthread_once(&host_freertos_once, host_freertos_init);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (TickType_t)((now.tv_sec - host_freertos_epoch.tv_sec) * 1000 +
+			(now.tv_nsec - host_freertos_epoch.tv_nsec) / 1000000L);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return host_task_self;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+	pthread_mutex_lock(&task->lock);
+	task->notify++;
+	pthread_cond_signal(&task->notified);
+	pthread_mutex_unlock(&task->lock);
+
+	return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t wait)
+{
+	TaskHandle_t task = host_task_self;
+	struct timespec deadline;
+	host_freertos_deadline(wait, &deadline);
+
+	pthread_mutex_lock(&task->lock);
+	while (task->notify == 0 && wait != 0)
+	{
+		if (wait == portMAX_DELAY)
+		{
+			pthread_cond_wait(&task->notified, &task->lock);
+		}
+		else if (pthread_cond_timedwait(&task->notified, &task->lock, &deadline) == ETIMEDOUT)
+		{
+			break;
+		}
+	}
+
+	uint32_t count = task->notify;
+	if (count)
+	{
+		task->notify = clear_on_exit ? 0 : count - 1;
+	}
+	pthread_mutex_unlock(&task->lock);
+
+	return count;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+	EventGroupHandle_t group = calloc(1, sizeof(struct host_event_group));
+	if (group)
+	{
+		pthread_mutex_init(&group->lock, NULL);
+		pthread_cond_init(&group->changed, NULL);
+	}
+	return group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+	pthread_mutex_lock(&group->lock);
+	group->bits |= bits;
+	EventBits_t now = group->bits;
+	pthread_cond_broadcast(&group->changed);
+	pthread_mutex_unlock(&group->lock);
+
+	return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+	pthread_mutex_lock(&group->lock);
+	EventBits_t before = group->bits;
+	group->bits &= ~bits;
+	pthread_mutex_unlock(&group->lock);
+
+	return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+	pthread_mutex_lock(&group->lock);
+	EventBits_t bits = group->bits;
+	pthread_mutex_unlock(&group->lock);
+
+	return bits;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+	UBaseType_t count = 0;
+
+	pthread_mutex_lock(&host_task_list_lock);
+	for (TaskHandle_t task = host_task_first; task; task = task->next)
+	{
+		count += !task->ended;
+	}
+	pthread_mutex_unlock(&host_task_list_lock);
+
+	return count;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t size, uint32_t *total_run_time)
+{
+	UBaseType_t count = 0;
+	struct timespec now;
+
+	pthread_mutex_lock(&host_task_list_lock);
+	for (TaskHandle_t task = host_task_first; task; task = task->next)
+	{
+		if (task->ended)
+		{
+			continue;
+		}
+		if (count == size)
+		{
+			count = 0;
+			break;
+		}
+
+		struct timespec cpu = { 0 };
+		clockid_t clock;
+		if (pthread_getcpuclockid(task->thread, &clock) == 0)
+		{
+			clock_gettime(clock, &cpu);
+		}
+
+		status[count++] = (TaskStatus_t)
+		{
+			.xHandle = task,
+			.pcTaskName = task->name,
+			.xTaskNumber = task->number,
+			.eCurrentState = (task == host_task_self) ? eRunning : eBlocked,
+			.uxCurrentPriority = task->priority,
+			.uxBasePriority = task->priority,
+			.ulRunTimeCounter = (uint32_t)(cpu.tv_sec * 1000000ULL + cpu.tv_nsec / 1000),
+			.usStackHighWaterMark = task->stack_size,
+			.xCoreID = task->core_id,
+		};
+	}
+	pthread_mutex_unlock(&host_task_list_lock);
+
+	if (total_run_time)
+	{
+		pthread_once(&host_freertos_once, host_freertos_init);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		*total_run_time = (uint32_t)((now.tv_sec - host_freertos_epoch.tv_sec) * 1000000ULL +
+				(now.tv_nsec - host_freertos_epoch.tv_nsec) / 1000);
+	}
+	return count;
+}
@@ -0,0 +1,863 @@
+/*
+ * host_httpd.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+
+#include "host_httpd.h"
+
+// Work items waiting at once, the real server is bounded by its control socket too
+#define HOST_HTTPD_WORK_QUEUE		64
+
+// Sessions and URI handlers the table can hold, the configured limits apply below that
+#define HOST_HTTPD_MAX_SESSIONS		16
+#define HOST_HTTPD_MAX_URIS			32
+
+// Response headers a handler can set, max_resp_headers of the default config
+#define HOST_HTTPD_MAX_RESP_HEADERS	8
+
+// Longest status line and header block of a response
+#define HOST_HTTPD_MAX_HEAD			1024
+
+/**
+ * Work item queued with httpd_queue_work
+ */
+typedef struct host_httpd_work
+{
+	httpd_work_fn_t fn;
+	void *arg;
+} host_httpd_work_t;
+
+/**
+ * Open session
+ */
+typedef struct host_httpd_session
+{
+	int fd;							///> -1 while the slot is free
+	const httpd_uri_t *uri;			///> Handler the session was opened on
+	bool websocket;
+} host_httpd_session_t;
+
+/**
+ * Server state, one at a time
+ */
+typedef struct host_httpd
+{
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	host_httpd_work_t work[HOST_HTTPD_WORK_QUEUE];
+	uint32_t head;
+	uint32_t count;
+	bool busy;						///> A work item is running
+	bool running;					///> The task has not ended yet
+	bool stop;
+	uint32_t send_wait_ms;
+	uint32_t recv_wait_ms;
+	httpd_close_func_t close_fn;
+	uint16_t max_open_sockets;
+	uint16_t max_uri_handlers;
+	httpd_uri_t uris[HOST_HTTPD_MAX_URIS];
+	uint16_t uri_count;
+	host_httpd_session_t sessions[HOST_HTTPD_MAX_SESSIONS];
+	uint32_t frames;
+	uint64_t send_us;
+} host_httpd_t;
+
+/**
+ * State of a handler call, req->aux: the frame handed in by host_httpd_ws_recv, or the
+ * request and the response of host_httpd_http_request
+ */
+typedef struct host_httpd_frame
+{
+	int fd;
+	httpd_ws_type_t type;
+	const uint8_t *payload;
+	size_t len;
+	size_t read;					///> Payload or body bytes the handler already received
+	const char *headers;			///> Request headers, "Name: value\r\n" each
+	const char *status;				///> Response status, "200 OK" until set
+	const char *content_type;
+	const char *resp_headers[HOST_HTTPD_MAX_RESP_HEADERS][2];
+	uint16_t resp_header_count;
+	bool chunked;					///> The header went out, chunks follow
+} host_httpd_frame_t;
+
+/**
+ * Arguments and result of the calls below, run on the httpd task
+ */
+typedef struct host_httpd_request
+{
+	host_httpd_t *server;
+	int fd;
+	httpd_method_t method;
+	const char *uri;
+	const char *headers;
+	host_httpd_frame_t *frame;
+	esp_err_t result;
+} host_httpd_request_t;
+
+static host_httpd_t host_httpd;
+static httpd_handle_t host_httpd_running = NULL;
+
+static void host_httpd_main(void *arg)
+{
+	host_httpd_t *server = arg;
+
+	pthread_mutex_lock(&server->lock);
+	for (;;)
+	{
+		while (server->count == 0 && !server->stop)
+		{
+			pthread_cond_wait(&server->changed, &server->lock);
+		}
+		if (server->count == 0)
+		{
+			break;
+		}
+
+		host_httpd_work_t work = server->work[server->head];
+		server->head = (server->head + 1) % HOST_HTTPD_WORK_QUEUE;
+		server->count--;
+		server->busy = true;
+		pthread_mutex_unlock(&server->lock);
+
+		work.fn(work.arg);
+
+		pthread_mutex_lock(&server->lock);
+		server->busy = false;
+		pthread_cond_broadcast(&server->changed);
+	}
+	server->running = false;
+	pthread_cond_broadcast(&server->changed);
+	pthread_mutex_unlock(&server->lock);
+
+	vTaskDelete(NULL);
+}
+
+/**
+ * Starts the httpd task.
+ * @param send_wait_ms longest wait for room in a client socket.
+ * @param recv_wait_ms longest wait for request body bytes.
+ * @param core_id core the task is pinned to, tskNO_AFFINITY for none.
+ * @return the server handle.
+ */
+static httpd_handle_t host_httpd_launch(uint32_t send_wait_ms, uint32_t recv_wait_ms, httpd_close_func_t close_fn, BaseType_t core_id)
+{
+	host_httpd_t *server = &host_httpd;
+
+	memset(server, 0, sizeof(*server));
+	pthread_mutex_init(&server->lock, NULL);
+	pthread_cond_init(&server->changed, NULL);
+	server->running = true;
+	server->send_wait_ms = send_wait_ms;
+	server->recv_wait_ms = recv_wait_ms;
+	server->close_fn = close_fn;
+	server->max_open_sockets = HOST_HTTPD_MAX_SESSIONS;
+	server->max_uri_handlers = HOST_HTTPD_MAX_URIS;
+	for (int i = 0; i < HOST_HTTPD_MAX_SESSIONS; ++i)
+	{
+		server->sessions[i].fd = -1;
+	}
+	xTaskCreatePinnedToCore(host_httpd_main, "httpd", 4096, server, 5, NULL, core_id);
+
+	host_httpd_running = server;
+	return server;
+}
+
+httpd_handle_t host_httpd_start(uint32_t send_wait_ms, httpd_close_func_t close_fn)
+{
+	return host_httpd_launch(send_wait_ms, send_wait_ms, close_fn, tskNO_AFFINITY);
+}
+
+void host_httpd_stop(httpd_handle_t hd)
+{
+	host_httpd_t *server = hd;
+
+	pthread_mutex_lock(&server->lock);
+	server->stop = true;
+	pthread_cond_broadcast(&server->changed);
+	while (server->running)
+	{
+		pthread_cond_wait(&server->changed, &server->lock);
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	host_httpd_running = NULL;
+	pthread_cond_destroy(&server->changed);
+	pthread_mutex_destroy(&server->lock);
+}
+
+httpd_handle_t host_httpd_get(void)
+{
+	return host_httpd_running;
+}
+
+void host_httpd_sync(httpd_handle_t hd)
+{
+	host_httpd_t *server = hd;
+
+	pthread_mutex_lock(&server->lock);
+	while (server->count || server->busy)
+	{
+		pthread_cond_wait(&server->changed, &server->lock);
+	}
+	pthread_mutex_unlock(&server->lock);
+}
+
+void host_httpd_call(httpd_handle_t hd, httpd_work_fn_t fn, void *arg)
+{
+	host_httpd_sync(hd);
+	httpd_queue_work(hd, fn, arg);
+	host_httpd_sync(hd);
+}
+
+void host_httpd_stats(httpd_handle_t hd, uint32_t *frames, uint64_t *send_us)
+{
+	host_httpd_t *server = hd;
+
+	pthread_mutex_lock(&server->lock);
+	*frames = server->frames;
+	*send_us = server->send_us;
+	pthread_mutex_unlock(&server->lock);
+}
+
+/**
+ * Finds an open session. Caller holds the server lock.
+ * @return the session, NULL if fd is not one.
+ */
+static host_httpd_session_t *host_httpd_session(host_httpd_t *server, int fd)
+{
+	for (int i = 0; i < HOST_HTTPD_MAX_SESSIONS; ++i)
+	{
+		if (server->sessions[i].fd == fd)
+		{
+			return &server->sessions[i];
+		}
+	}
+	return NULL;
+}
+
+static void host_httpd_do_open(void *arg)
+{
+	host_httpd_request_t *request = arg;
+	host_httpd_t *server = request->server;
+	const httpd_uri_t *uri = NULL;
+	host_httpd_session_t *session = NULL;
+	uint16_t open = 0;
+
+	pthread_mutex_lock(&server->lock);
+	for (uint16_t i = 0; i < server->uri_count; ++i)
+	{
+		if (strcmp(server->uris[i].uri, request->uri) == 0 && server->uris[i].method == HTTP_GET)
+		{
+			uri = &server->uris[i];
+		}
+	}
+	for (int i = 0; i < HOST_HTTPD_MAX_SESSIONS; ++i)
+	{
+		if (server->sessions[i].fd >= 0)
+		{
+			open++;
+		}
+		else if (session == NULL)
+		{
+			session = &server->sessions[i];
+		}
+	}
+
+	if (uri == NULL || session == NULL || open >= server->max_open_sockets)
+	{
+		pthread_mutex_unlock(&server->lock);
+		request->result = uri ? ESP_ERR_NO_MEM : ESP_ERR_NOT_FOUND;
+		return;
+	}
+
+	session->fd = request->fd;
+	session->uri = uri;
+	session->websocket = uri->is_websocket;
+	pthread_mutex_unlock(&server->lock);
+
+	httpd_req_t req = { .handle = server, .method = HTTP_GET, .uri = uri->uri, .user_ctx = uri->user_ctx };
+	host_httpd_frame_t none = { .fd = request->fd, .status = "200 OK", .content_type = HTTPD_TYPE_TEXT };
+	req.aux = &none;
+	request->result = uri->handler(&req);
+}
+
+esp_err_t host_httpd_open(httpd_handle_t hd, int fd, const char *uri)
+{
+	host_httpd_request_t request = { .server = hd, .fd = fd, .uri = uri };
+
+	host_httpd_call(hd, host_httpd_do_open, &request);
+	return request.result;
+}
+
+static void host_httpd_do_http(void *arg)
+{
+	host_httpd_request_t *request = arg;
+	host_httpd_t *server = request->server;
+	const httpd_uri_t *uri = NULL;
+
+	pthread_mutex_lock(&server->lock);
+	for (uint16_t i = 0; i < server->uri_count; ++i)
+	{
+		if (strcmp(server->uris[i].uri, request->uri) == 0 && server->uris[i].method == request->method &&
+				!server->uris[i].is_websocket)
+		{
+			uri = &server->uris[i];
+		}
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	if (uri == NULL)
+	{
+		request->result = ESP_ERR_NOT_FOUND;
+		return;
+	}
+
+	host_httpd_frame_t call =
+	{
+		.fd = request->fd,
+		.headers = request->headers,
+		.status = "200 OK",
+		.content_type = HTTPD_TYPE_TEXT,
+	};
+	httpd_req_t req =
+	{
+		.handle = server,
+		.method = request->method,
+		.uri = uri->uri,
+		.aux = &call,
+		.user_ctx = uri->user_ctx,
+	};
+
+	// The body follows on fd, as much as Content-Length announces
+	char length[16];
+	if (httpd_req_get_hdr_value_str(&req, "Content-Length", length, sizeof(length)) == ESP_OK)
+	{
+		req.content_len = strtoul(length, NULL, 10);
+	}
+	request->result = uri->handler(&req);
+}
+
+esp_err_t host_httpd_http_request(httpd_handle_t hd, int fd, httpd_method_t method, const char *uri, const char *headers)
+{
+	host_httpd_request_t request = { .server = hd, .fd = fd, .method = method, .uri = uri, .headers = headers };
+
+	host_httpd_call(hd, host_httpd_do_http, &request);
+	return request.result;
+}
+
+static void host_httpd_do_recv(void *arg)
+{
+	host_httpd_request_t *request = arg;
+	host_httpd_t *server = request->server;
+
+	// Only this task closes sessions, the handler stays valid after the lock is let go
+	pthread_mutex_lock(&server->lock);
+	host_httpd_session_t *session = host_httpd_session(server, request->fd);
+	const httpd_uri_t *uri = (session && session->websocket) ? session->uri : NULL;
+	pthread_mutex_unlock(&server->lock);
+
+	if (uri == NULL)
+	{
+		request->result = ESP_ERR_NOT_FOUND;
+		return;
+	}
+	if (request->frame->type >= HTTPD_WS_TYPE_CLOSE && !uri->handle_ws_control_frames)
+	{
+		request->result = ESP_OK;
+		return;
+	}
+
+	httpd_req_t req =
+	{
+		.handle = server,
+		.method = 0,
+		.uri = uri->uri,
+		.aux = (void *)request->frame,
+		.user_ctx = uri->user_ctx,
+	};
+	request->result = uri->handler(&req);
+}
+
+esp_err_t host_httpd_ws_recv(httpd_handle_t hd, int fd, httpd_ws_type_t type, const void *payload, size_t len)
+{
+	host_httpd_frame_t frame = { .fd = fd, .type = type, .payload = payload, .len = len };
+	host_httpd_request_t request = { .server = hd, .fd = fd, .frame = &frame };
+
+	host_httpd_call(hd, host_httpd_do_recv, &request);
+	return request.result;
+}
+
+void host_httpd_close(httpd_handle_t hd, int fd)
+{
+	httpd_sess_trigger_close(hd, fd);
+	host_httpd_sync(hd);
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+	host_httpd_t *server = host_httpd_launch(config->send_wait_timeout * 1000U, config->recv_wait_timeout * 1000U,
+			config->close_fn, config->core_id);
+
+	pthread_mutex_lock(&server->lock);
+	server->max_open_sockets = config->max_open_sockets;
+	server->max_uri_handlers = config->max_uri_handlers < HOST_HTTPD_MAX_URIS ? config->max_uri_handlers : HOST_HTTPD_MAX_URIS;
+	pthread_mutex_unlock(&server->lock);
+
+	*handle = server;
+	return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+	if (handle == NULL)
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+	host_httpd_stop(handle);
+	return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+	host_httpd_t *server = handle;
+	esp_err_t err = ESP_ERR_NO_MEM;
+
+	pthread_mutex_lock(&server->lock);
+	if (server->uri_count < server->max_uri_handlers)
+	{
+		server->uris[server->uri_count++] = *uri_handler;
+		err = ESP_OK;
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	return err;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r)
+{
+	return ((const host_httpd_frame_t *)r->aux)->fd;
+}
+
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t *fds, int *client_fds)
+{
+	host_httpd_t *server = handle;
+	size_t count = 0;
+	esp_err_t err = ESP_OK;
+
+	pthread_mutex_lock(&server->lock);
+	for (int i = 0; i < HOST_HTTPD_MAX_SESSIONS && err == ESP_OK; ++i)
+	{
+		int fd = server->sessions[i].fd;
+		if (fd >= 0)
+		{
+			if (count == *fds)
+			{
+				err = ESP_ERR_INVALID_ARG;
+				break;
+			}
+			client_fds[count++] = fd;
+		}
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	*fds = count;
+	return err;
+}
+
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd)
+{
+	host_httpd_t *server = hd;
+	httpd_ws_client_info_t info = HTTPD_WS_CLIENT_INVALID;
+
+	pthread_mutex_lock(&server->lock);
+	host_httpd_session_t *session = host_httpd_session(server, fd);
+	if (session)
+	{
+		info = session->websocket ? HTTPD_WS_CLIENT_WEBSOCKET : HTTPD_WS_CLIENT_HTTP;
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	return info;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *pkt, size_t max_len)
+{
+	host_httpd_frame_t *frame = req->aux;
+
+	if (max_len == 0)
+	{
+		pkt->type = frame->type;
+		pkt->len = frame->len;
+		pkt->final = true;
+		return ESP_OK;
+	}
+
+	// As from the socket, every call goes on where the previous one stopped
+	size_t left = frame->len - frame->read;
+	pkt->len = left < max_len ? left : max_len;
+	memcpy(pkt->payload, frame->payload + frame->read, pkt->len);
+	frame->read += pkt->len;
+	return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *pkt)
+{
+	return httpd_ws_send_frame_async(req->handle, httpd_req_to_sockfd(req), pkt);
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg)
+{
+	host_httpd_t *server = handle;
+	esp_err_t err = ESP_FAIL;
+
+	if (server == NULL)
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&server->lock);
+	if (server->count < HOST_HTTPD_WORK_QUEUE && !server->stop)
+	{
+		server->work[(server->head + server->count) % HOST_HTTPD_WORK_QUEUE] = (host_httpd_work_t){ work, arg };
+		server->count++;
+		pthread_cond_broadcast(&server->changed);
+		err = ESP_OK;
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	return err;
+}
+
+/**
+ * Writes bytes to a client socket, waiting for room until a deadline.
+ * @param fd client socket.
+ * @param data bytes to write.
+ * @param len number of bytes.
+ * @param deadline esp_timer_get_time after which a full socket fails the send.
+ * @return ESP_OK, ESP_FAIL on a timeout, ESP_ERR_INVALID_ARG if the session is gone.
+ */
+static esp_err_t host_httpd_write(int fd, const uint8_t *data, size_t len, int64_t deadline)
+{
+	while (len)
+	{
+		ssize_t n = send(fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+		if (n > 0)
+		{
+			data += n;
+			len -= n;
+		}
+		else if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			int64_t left = deadline - esp_timer_get_time();
+			struct pollfd room = { .fd = fd, .events = POLLOUT };
+
+			if (left <= 0 || poll(&room, 1, (int)((left + 999) / 1000)) == 0)
+			{
+				return ESP_FAIL;
+			}
+		}
+		else
+		{
+			return (errno == EPIPE || errno == EBADF || errno == ENOTCONN || errno == ENOTSOCK) ?
+					ESP_ERR_INVALID_ARG : ESP_FAIL;
+		}
+	}
+	return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame)
+{
+	host_httpd_t *server = hd;
+	int64_t start = esp_timer_get_time();
+	int64_t deadline = start + (int64_t)server->send_wait_ms * 1000;
+	uint8_t header[4] =
+	{
+		frame->len & 0xFF, (frame->len >> 8) & 0xFF, (frame->len >> 16) & 0xFF, (frame->len >> 24) & 0xFF,
+	};
+
+	esp_err_t err = host_httpd_write(fd, header, sizeof(header), deadline);
+	if (err == ESP_OK)
+	{
+		err = host_httpd_write(fd, frame->payload, frame->len, deadline);
+	}
+
+	pthread_mutex_lock(&server->lock);
+	server->frames += (err == ESP_OK);
+	server->send_us += esp_timer_get_time() - start;
+	pthread_mutex_unlock(&server->lock);
+
+	return err;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size)
+{
+	const host_httpd_frame_t *call = r->aux;
+	size_t field_len = strlen(field);
+
+	for (const char *line = call->headers; line && *line; )
+	{
+		const char *end = strstr(line, "\r\n");
+		if (end == NULL)
+		{
+			end = line + strlen(line);
+		}
+
+		if (strncasecmp(line, field, field_len) == 0 && line[field_len] == ':')
+		{
+			const char *value = line + field_len + 1;
+			while (value < end && *value == ' ')
+			{
+				value++;
+			}
+
+			size_t len = end - value;
+			if (val_size == 0)
+			{
+				return ESP_ERR_HTTPD_RESULT_TRUNC;
+			}
+			size_t copy = len < val_size ? len : val_size - 1;
+			memcpy(val, value, copy);
+			val[copy] = '\0';
+			return copy < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+		}
+		line = *end ? end + 2 : end;
+	}
+	return ESP_ERR_NOT_FOUND;
+}
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len)
+{
+	host_httpd_t *server = r->handle;
+	host_httpd_frame_t *call = r->aux;
+	size_t left = r->content_len - call->read;
+
+	if (buf_len > left)
+	{
+		buf_len = left;
+	}
+	if (buf_len == 0)
+	{
+		return 0;
+	}
+
+	struct pollfd ready = { .fd = call->fd, .events = POLLIN };
+	int polled;
+	while ((polled = poll(&ready, 1, server->recv_wait_ms)) < 0 && errno == EINTR)
+	{
+	}
+	if (polled == 0)
+	{
+		return HTTPD_SOCK_ERR_TIMEOUT;
+	}
+
+	ssize_t n;
+	while ((n = recv(call->fd, buf, buf_len, MSG_DONTWAIT)) < 0 && errno == EINTR)
+	{
+	}
+	if (n < 0)
+	{
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL;
+	}
+	call->read += n;
+	return n;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+	((host_httpd_frame_t *)r->aux)->status = status;
+	return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+	((host_httpd_frame_t *)r->aux)->content_type = type;
+	return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+	host_httpd_frame_t *call = r->aux;
+
+	// As with esp_http_server, the strings are kept by pointer until the response is sent
+	if (call->resp_header_count == HOST_HTTPD_MAX_RESP_HEADERS)
+	{
+		return ESP_ERR_HTTPD_RESP_HDR;
+	}
+	call->resp_headers[call->resp_header_count][0] = field;
+	call->resp_headers[call->resp_header_count][1] = value;
+	call->resp_header_count++;
+	return ESP_OK;
+}
+
+/**
+ * Writes part of a response to the client.
+ * @return ESP_OK, ESP_ERR_HTTPD_RESP_SEND if the socket failed or stayed full.
+ */
+static esp_err_t host_httpd_resp_write(httpd_req_t *r, const void *data, size_t len)
+{
+	host_httpd_t *server = r->handle;
+	const host_httpd_frame_t *call = r->aux;
+	int64_t deadline = esp_timer_get_time() + (int64_t)server->send_wait_ms * 1000;
+
+	return host_httpd_write(call->fd, data, len, deadline) == ESP_OK ? ESP_OK : ESP_ERR_HTTPD_RESP_SEND;
+}
+
+/**
+ * Writes the status line and the headers of a response.
+ * @param length body bytes for Content-Length, -1 for a chunked body.
+ * @return ESP_OK, ESP_ERR_HTTPD_RESP_HDR if they do not fit, ESP_ERR_HTTPD_RESP_SEND.
+ */
+static esp_err_t host_httpd_resp_head(httpd_req_t *r, ssize_t length)
+{
+	const host_httpd_frame_t *call = r->aux;
+	char head[HOST_HTTPD_MAX_HEAD];
+	size_t used = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: %s\r\n", call->status, call->content_type);
+
+	for (uint16_t i = 0; i < call->resp_header_count && used < sizeof(head); ++i)
+	{
+		used += snprintf(head + used, sizeof(head) - used, "%s: %s\r\n", call->resp_headers[i][0], call->resp_headers[i][1]);
+	}
+	if (used < sizeof(head))
+	{
+		used += (length < 0) ?
+				snprintf(head + used, sizeof(head) - used, "Transfer-Encoding: chunked\r\n\r\n") :
+				snprintf(head + used, sizeof(head) - used, "Content-Length: %zd\r\n\r\n", length);
+	}
+	if (used >= sizeof(head))
+	{
+		return ESP_ERR_HTTPD_RESP_HDR;
+	}
+	return host_httpd_resp_write(r, head, used);
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+	if (buf_len == HTTPD_RESP_USE_STRLEN)
+	{
+		buf_len = buf ? strlen(buf) : 0;
+	}
+
+	esp_err_t err = host_httpd_resp_head(r, buf_len);
+	if (err == ESP_OK && buf_len > 0)
+	{
+		err = host_httpd_resp_write(r, buf, buf_len);
+	}
+	return err;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+	host_httpd_frame_t *call = r->aux;
+	char size[20];
+
+	if (buf_len == HTTPD_RESP_USE_STRLEN)
+	{
+		buf_len = buf ? strlen(buf) : 0;
+	}
+
+	if (!call->chunked)
+	{
+		esp_err_t err = host_httpd_resp_head(r, -1);
+		if (err != ESP_OK)
+		{
+			return err;
+		}
+		call->chunked = true;
+	}
+
+	// An empty chunk ends the body
+	if (buf == NULL || buf_len == 0)
+	{
+		return host_httpd_resp_write(r, "0\r\n\r\n", 5);
+	}
+
+	int size_len = snprintf(size, sizeof(size), "%zx\r\n", buf_len);
+	esp_err_t err = host_httpd_resp_write(r, size, size_len);
+	if (err == ESP_OK)
+	{
+		err = host_httpd_resp_write(r, buf, buf_len);
+	}
+	if (err == ESP_OK)
+	{
+		err = host_httpd_resp_write(r, "\r\n", 2);
+	}
+	return err;
+}
+
+esp_err_t httpd_resp_sendstr(httpd_req_t *r, const char *str)
+{
+	return httpd_resp_send(r, str, HTTPD_RESP_USE_STRLEN);
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg)
+{
+	static const char *const status[] =
+	{
+		[HTTPD_500_INTERNAL_SERVER_ERROR] = "500 Internal Server Error",
+		[HTTPD_501_METHOD_NOT_IMPLEMENTED] = "501 Method Not Implemented",
+		[HTTPD_505_VERSION_NOT_SUPPORTED] = "505 Version Not Supported",
+		[HTTPD_400_BAD_REQUEST] = "400 Bad Request",
+		[HTTPD_401_UNAUTHORIZED] = "401 Unauthorized",
+		[HTTPD_403_FORBIDDEN] = "403 Forbidden",
+		[HTTPD_404_NOT_FOUND] = "404 Not Found",
+		[HTTPD_405_METHOD_NOT_ALLOWED] = "405 Method Not Allowed",
+		[HTTPD_408_REQ_TIMEOUT] = "408 Request Timeout",
+		[HTTPD_411_LENGTH_REQUIRED] = "411 Length Required",
+	};
+
+	httpd_resp_set_status(req, status[error]);
+	httpd_resp_set_type(req, HTTPD_TYPE_TEXT);
+	return httpd_resp_send(req, msg, HTTPD_RESP_USE_STRLEN);
+}
+
+static void host_httpd_do_close(void *arg)
+{
+	int fd = (int)(intptr_t)arg;
+
+	pthread_mutex_lock(&host_httpd.lock);
+	host_httpd_session_t *session = host_httpd_session(&host_httpd, fd);
+	if (session)
+	{
+		session->fd = -1;
+	}
+	pthread_mutex_unlock(&host_httpd.lock);
+
+	// The hook owns closing the socket, as with esp_http_server
+	shutdown(fd, SHUT_RDWR);
+	if (host_httpd.close_fn)
+	{
+		host_httpd.close_fn(&host_httpd, fd);
+	}
+	else
+	{
+		close(fd);
+	}
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd)
+{
+	return httpd_queue_work(handle, host_httpd_do_close, (void *)(intptr_t)sockfd);
+}
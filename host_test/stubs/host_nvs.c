@@ -0,0 +1,341 @@
+/*
+ * host_nvs.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include "host_nvs.h"
+
+// Longest namespace or key name, as on flash
+#define HOST_NVS_NAME_MAX			15
+
+// Namespaces and keys stored, handles open at once
+#define HOST_NVS_MAX_NAMESPACES		8
+#define HOST_NVS_MAX_ENTRIES		32
+#define HOST_NVS_MAX_HANDLES		8
+
+/**
+ * Stored blob
+ */
+typedef struct host_nvs_entry
+{
+	char ns[HOST_NVS_NAME_MAX + 1];
+	char key[HOST_NVS_NAME_MAX + 1];
+	void *value;					///> NULL while the entry is free
+	size_t length;
+} host_nvs_entry_t;
+
+/**
+ * Open handle, handles count from 1
+ */
+typedef struct host_nvs_handle
+{
+	char ns[HOST_NVS_NAME_MAX + 1];
+	bool open;
+	bool writable;
+} host_nvs_handle_t;
+
+static pthread_mutex_t host_nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static char host_nvs_namespaces[HOST_NVS_MAX_NAMESPACES][HOST_NVS_NAME_MAX + 1];
+static host_nvs_entry_t host_nvs_entries[HOST_NVS_MAX_ENTRIES];
+static host_nvs_handle_t host_nvs_handles[HOST_NVS_MAX_HANDLES];
+
+// Error the next nvs_set_blob returns, ESP_OK for none
+static esp_err_t host_nvs_set_fault = ESP_OK;
+
+/**
+ * Finds the handle state. Caller holds the lock.
+ * @return the handle, NULL if it is not open.
+ */
+static host_nvs_handle_t *host_nvs_handle(nvs_handle_t handle)
+{
+	if (handle == 0 || handle > HOST_NVS_MAX_HANDLES || !host_nvs_handles[handle - 1].open)
+	{
+		return NULL;
+	}
+	return &host_nvs_handles[handle - 1];
+}
+
+/**
+ * Finds a stored key. Caller holds the lock.
+ * @param ns namespace.
+ * @param key key, NULL for any key of the namespace.
+ * @return the entry, NULL if there is none.
+ */
+static host_nvs_entry_t *host_nvs_find(const char *ns, const char *key)
+{
+	for (int i = 0; i < HOST_NVS_MAX_ENTRIES; ++i)
+	{
+		host_nvs_entry_t *entry = &host_nvs_entries[i];
+		if (entry->value && strcmp(entry->ns, ns) == 0 && (key == NULL || strcmp(entry->key, key) == 0))
+		{
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Finds a namespace, creating it if asked to. Caller holds the lock.
+ * @param ns namespace.
+ * @param create true to create it when missing, as a read-write open does.
+ * @return false if it does not exist and was not created.
+ */
+static bool host_nvs_namespace(const char *ns, bool create)
+{
+	for (int i = 0; i < HOST_NVS_MAX_NAMESPACES; ++i)
+	{
+		if (strcmp(host_nvs_namespaces[i], ns) == 0)
+		{
+			return true;
+		}
+		if (host_nvs_namespaces[i][0] == '\0' && create)
+		{
+			strcpy(host_nvs_namespaces[i], ns);
+			return true;
+		}
+	}
+	return false;
+}
+
+static void host_nvs_free(host_nvs_entry_t *entry)
+{
+	free(entry->value);
+	entry->value = NULL;
+	entry->length = 0;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+	return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+	pthread_mutex_lock(&host_nvs_lock);
+	for (int i = 0; i < HOST_NVS_MAX_ENTRIES; ++i)
+	{
+		host_nvs_free(&host_nvs_entries[i]);
+	}
+	memset(host_nvs_namespaces, 0, sizeof(host_nvs_namespaces));
+	pthread_mutex_unlock(&host_nvs_lock);
+
+	return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+	if (strlen(name) > HOST_NVS_NAME_MAX)
+	{
+		return ESP_ERR_NVS_INVALID_NAME;
+	}
+
+	esp_err_t err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+	pthread_mutex_lock(&host_nvs_lock);
+	if (!host_nvs_namespace(name, open_mode == NVS_READWRITE))
+	{
+		// Only a read-write open creates a namespace
+		err = open_mode == NVS_READONLY ? ESP_ERR_NVS_NOT_FOUND : ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+	}
+	else
+	{
+		for (int i = 0; i < HOST_NVS_MAX_HANDLES; ++i)
+		{
+			if (!host_nvs_handles[i].open)
+			{
+				strcpy(host_nvs_handles[i].ns, name);
+				host_nvs_handles[i].open = true;
+				host_nvs_handles[i].writable = open_mode == NVS_READWRITE;
+				*out_handle = i + 1;
+				err = ESP_OK;
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&host_nvs_lock);
+
+	return err;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+	pthread_mutex_lock(&host_nvs_lock);
+	host_nvs_handle_t *state = host_nvs_handle(handle);
+	if (state)
+	{
+		state->open = false;
+	}
+	pthread_mutex_unlock(&host_nvs_lock);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+	pthread_mutex_lock(&host_nvs_lock);
+	esp_err_t err = host_nvs_handle(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+	pthread_mutex_unlock(&host_nvs_lock);
+
+	return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+	if (strlen(key) > HOST_NVS_NAME_MAX)
+	{
+		return ESP_ERR_NVS_INVALID_NAME;
+	}
+
+	esp_err_t err = ESP_OK;
+	pthread_mutex_lock(&host_nvs_lock);
+	host_nvs_handle_t *state = host_nvs_handle(handle);
+	host_nvs_entry_t *entry = NULL;
+	if (state == NULL)
+	{
+		err = ESP_ERR_NVS_INVALID_HANDLE;
+	}
+	else if (!state->writable)
+	{
+		err = ESP_ERR_NVS_READ_ONLY;
+	}
+	else if (host_nvs_set_fault != ESP_OK)
+	{
+		err = host_nvs_set_fault;
+		host_nvs_set_fault = ESP_OK;
+	}
+	else if ((entry = host_nvs_find(state->ns, key)) == NULL)
+	{
+		for (int i = 0; i < HOST_NVS_MAX_ENTRIES && entry == NULL; ++i)
+		{
+			if (host_nvs_entries[i].value == NULL)
+			{
+				entry = &host_nvs_entries[i];
+				strcpy(entry->ns, state->ns);
+				strcpy(entry->key, key);
+			}
+		}
+		err = entry ? ESP_OK : ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+	}
+
+	if (entry)
+	{
+		// malloc(0) may return NULL, which would mark the entry free
+		void *copy = malloc(length ? length : 1);
+		if (copy)
+		{
+			memcpy(copy, value, length);
+			free(entry->value);
+			entry->value = copy;
+			entry->length = length;
+		}
+		else
+		{
+			err = ESP_ERR_NO_MEM;
+		}
+	}
+	pthread_mutex_unlock(&host_nvs_lock);
+
+	return err;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+	esp_err_t err = ESP_OK;
+
+	pthread_mutex_lock(&host_nvs_lock);
+	host_nvs_handle_t *state = host_nvs_handle(handle);
+	host_nvs_entry_t *entry = state ? host_nvs_find(state->ns, key) : NULL;
+	if (state == NULL)
+	{
+		err = ESP_ERR_NVS_INVALID_HANDLE;
+	}
+	else if (entry == NULL)
+	{
+		err = ESP_ERR_NVS_NOT_FOUND;
+	}
+	else if (out_value == NULL)
+	{
+		*length = entry->length;
+	}
+	else if (*length < entry->length)
+	{
+		err = ESP_ERR_NVS_INVALID_LENGTH;
+	}
+	else
+	{
+		memcpy(out_value, entry->value, entry->length);
+		*length = entry->length;
+	}
+	pthread_mutex_unlock(&host_nvs_lock);
+
+	return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+	esp_err_t err = ESP_OK;
+
+	pthread_mutex_lock(&host_nvs_lock);
+	host_nvs_handle_t *state = host_nvs_handle(handle);
+	host_nvs_entry_t *entry = state ? host_nvs_find(state->ns, key) : NULL;
+	if (state == NULL)
+	{
+		err = ESP_ERR_NVS_INVALID_HANDLE;
+	}
+	else if (!state->writable)
+	{
+		err = ESP_ERR_NVS_READ_ONLY;
+	}
+	else if (entry == NULL)
+	{
+		err = ESP_ERR_NVS_NOT_FOUND;
+	}
+	else
+	{
+		host_nvs_free(entry);
+	}
+	pthread_mutex_unlock(&host_nvs_lock);
+
+	return err;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+	esp_err_t err = ESP_OK;
+
+	pthread_mutex_lock(&host_nvs_lock);
+	host_nvs_handle_t *state = host_nvs_handle(handle);
+	if (state == NULL)
+	{
+		err = ESP_ERR_NVS_INVALID_HANDLE;
+	}
+	else if (!state->writable)
+	{
+		err = ESP_ERR_NVS_READ_ONLY;
+	}
+	else
+	{
+		host_nvs_entry_t *entry;
+		while ((entry = host_nvs_find(state->ns, NULL)) != NULL)
+		{
+			host_nvs_free(entry);
+		}
+	}
+	pthread_mutex_unlock(&host_nvs_lock);
+
+	return err;
+}
+
+void host_nvs_fail_next_set(esp_err_t err)
+{
+	pthread_mutex_lock(&host_nvs_lock);
+	host_nvs_set_fault = err;
+	pthread_mutex_unlock(&host_nvs_lock);
+}
@@ -0,0 +1,259 @@
+/*
+ * host_partition.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+
+#define HOST_PARTITION_SECTOR_SIZE	4096
+
+/**
+ * Data or OTA app partition of partitions.csv, its flash is allocated erased on first use
+ */
+typedef struct host_partition
+{
+	esp_partition_t partition;
+	uint8_t *flash;
+} host_partition_t;
+
+static host_partition_t host_partitions[] =
+{
+	{ .partition = { .type = ESP_PARTITION_TYPE_DATA, .subtype = 0x40, .address = 0x110000, .size = 256 * 1024, .label = "logstore" } },
+	{ .partition = { .type = ESP_PARTITION_TYPE_APP, .subtype = ESP_PARTITION_SUBTYPE_APP_OTA_0, .address = 0x10000, .size = 1536 * 1024, .label = "ota_0" } },
+	{ .partition = { .type = ESP_PARTITION_TYPE_APP, .subtype = ESP_PARTITION_SUBTYPE_APP_OTA_1, .address = 0x190000, .size = 1536 * 1024, .label = "ota_1" } },
+};
+
+/**
+ * Image being written with esp_ota_write
+ */
+typedef struct host_ota
+{
+	esp_ota_handle_t handle;		///> 0 while no image is open
+	const esp_partition_t *partition;
+	bool sequential;				///> Sectors are erased as the writes reach them
+	size_t wrote;
+	size_t erased;					///> Bytes from the start already erased
+} host_ota_t;
+
+static pthread_mutex_t host_partition_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_ota_t host_ota;
+static esp_ota_handle_t host_ota_last_handle = 0;
+static const esp_partition_t *host_ota_boot = NULL;
+
+/**
+ * Flash behind a partition returned by esp_partition_find_first.
+ */
+static uint8_t *host_partition_flash(const esp_partition_t *partition)
+{
+	return ((const host_partition_t *)partition)->flash;
+}
+
+static bool host_partition_in_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+	return partition && offset <= partition->size && size <= partition->size - offset;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+	const esp_partition_t *found = NULL;
+
+	pthread_mutex_lock(&host_partition_lock);
+	for (size_t i = 0; i < sizeof(host_partitions) / sizeof(host_partitions[0]); ++i)
+	{
+		host_partition_t *partition = &host_partitions[i];
+
+		if (label && strcmp(partition->partition.label, label) == 0)
+		{
+			if (partition->flash == NULL)
+			{
+				partition->flash = malloc(partition->partition.size);
+				memset(partition->flash, 0xFF, partition->partition.size);
+			}
+			found = &partition->partition;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&host_partition_lock);
+
+	return found;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+	return esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, "ota_0");
+}
+
+const esp_partition_t *esp_ota_get_boot_partition(void)
+{
+	pthread_mutex_lock(&host_partition_lock);
+	const esp_partition_t *boot = host_ota_boot;
+	pthread_mutex_unlock(&host_partition_lock);
+
+	return boot ? boot : esp_ota_get_running_partition();
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+	if (start_from == NULL)
+	{
+		start_from = esp_ota_get_running_partition();
+	}
+	return start_from->subtype == ESP_PARTITION_SUBTYPE_APP_OTA_0 ?
+			esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, "ota_1") :
+			esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, "ota_0");
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+	if (partition == NULL || partition->type != ESP_PARTITION_TYPE_APP)
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (partition == esp_ota_get_running_partition())
+	{
+		return ESP_ERR_OTA_PARTITION_CONFLICT;
+	}
+
+	bool sequential = image_size == OTA_WITH_SEQUENTIAL_WRITES;
+	size_t erase = sequential ? 0 :
+			image_size == OTA_SIZE_UNKNOWN ? partition->size :
+			(image_size + HOST_PARTITION_SECTOR_SIZE - 1) / HOST_PARTITION_SECTOR_SIZE * HOST_PARTITION_SECTOR_SIZE;
+	if (erase > partition->size)
+	{
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	pthread_mutex_lock(&host_partition_lock);
+	if (host_ota.handle)
+	{
+		pthread_mutex_unlock(&host_partition_lock);
+		return ESP_ERR_NO_MEM;
+	}
+	host_ota = (host_ota_t){ .handle = ++host_ota_last_handle, .partition = partition, .sequential = sequential };
+	pthread_mutex_unlock(&host_partition_lock);
+
+	esp_err_t err = erase ? esp_partition_erase_range(partition, 0, erase) : ESP_OK;
+	host_ota.erased = erase;
+	*out_handle = host_ota.handle;
+	return err;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	if (handle == 0 || handle != host_ota.handle)
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (host_ota.wrote == 0 && size > 0 && bytes[0] != ESP_IMAGE_HEADER_MAGIC)
+	{
+		return ESP_ERR_OTA_VALIDATE_FAILED;
+	}
+	if (size > host_ota.partition->size - host_ota.wrote)
+	{
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	// Sequential writes erase the sectors they reach, the others were erased by esp_ota_begin
+	while (host_ota.sequential && host_ota.erased < host_ota.wrote + size)
+	{
+		esp_err_t err = esp_partition_erase_range(host_ota.partition, host_ota.erased, HOST_PARTITION_SECTOR_SIZE);
+		if (err != ESP_OK)
+		{
+			return err;
+		}
+		host_ota.erased += HOST_PARTITION_SECTOR_SIZE;
+	}
+
+	esp_err_t err = esp_partition_write(host_ota.partition, host_ota.wrote, data, size);
+	if (err == ESP_OK)
+	{
+		host_ota.wrote += size;
+	}
+	return err;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+	if (handle == 0 || handle != host_ota.handle)
+	{
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	esp_err_t err = host_ota.wrote < HOST_OTA_MIN_IMAGE_SIZE ? ESP_ERR_OTA_VALIDATE_FAILED : ESP_OK;
+	esp_ota_abort(handle);
+	return err;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+	pthread_mutex_lock(&host_partition_lock);
+	esp_err_t err = (handle != 0 && handle == host_ota.handle) ? ESP_OK : ESP_ERR_NOT_FOUND;
+	if (err == ESP_OK)
+	{
+		memset(&host_ota, 0, sizeof(host_ota));
+	}
+	pthread_mutex_unlock(&host_partition_lock);
+
+	return err;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+	if (partition == NULL || partition->type != ESP_PARTITION_TYPE_APP)
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&host_partition_lock);
+	host_ota_boot = partition;
+	pthread_mutex_unlock(&host_partition_lock);
+
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+	if (!host_partition_in_range(partition, src_offset, size))
+	{
+		return ESP_ERR_INVALID_SIZE;
+	}
+	memcpy(dst, host_partition_flash(partition) + src_offset, size);
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+	const uint8_t *bytes = src;
+
+	if (!host_partition_in_range(partition, dst_offset, size))
+	{
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	uint8_t *flash = host_partition_flash(partition) + dst_offset;
+	for (size_t i = 0; i < size; ++i)
+	{
+		flash[i] &= bytes[i];
+	}
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+	if (!host_partition_in_range(partition, offset, size) ||
+			offset % HOST_PARTITION_SECTOR_SIZE || size % HOST_PARTITION_SECTOR_SIZE)
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+	memset(host_partition_flash(partition) + offset, 0xFF, size);
+	return ESP_OK;
+}
@@ -0,0 +1,342 @@
+/*
+ * host_wifi.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+
+#include "host_wifi.h"
+
+// Handlers registered at once
+#define HOST_WIFI_MAX_HANDLERS		8
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+/**
+ * Registered event handler
+ */
+typedef struct host_wifi_handler
+{
+	esp_event_base_t base;
+	int32_t id;
+	esp_event_handler_t fn;
+	void *arg;
+} host_wifi_handler_t;
+
+/**
+ * Driver state, behind one lock
+ */
+typedef struct host_wifi
+{
+	pthread_mutex_t lock;
+	host_wifi_handler_t handlers[HOST_WIFI_MAX_HANDLERS];
+	uint32_t handler_count;
+	wifi_config_t config[2];		///> Per wifi_interface_t
+	bool associated;
+	wifi_ap_record_t ap;
+	int stations;
+	wifi_ap_record_t scan[HOST_WIFI_MAX_SCAN_RECORDS];
+	uint16_t scan_count;
+	host_wifi_stats_t stats;
+} host_wifi_t;
+
+static host_wifi_t host_wifi = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/**
+ * Network interface, only its addresses reach the application
+ */
+typedef struct host_wifi_netif
+{
+	esp_netif_ip_info_t ip_info;
+	esp_netif_dns_info_t dns[ESP_NETIF_DNS_MAX];
+	bool dhcpc_stopped;
+} host_wifi_netif_t;
+
+// One per wifi_interface_t
+static host_wifi_netif_t host_wifi_netif[2];
+
+esp_err_t esp_event_loop_create_default(void)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+		esp_event_handler_t event_handler, void *event_handler_arg, esp_event_handler_instance_t *instance)
+{
+	esp_err_t err = ESP_ERR_NO_MEM;
+
+	pthread_mutex_lock(&host_wifi.lock);
+	if (host_wifi.handler_count < HOST_WIFI_MAX_HANDLERS)
+	{
+		host_wifi.handlers[host_wifi.handler_count++] = (host_wifi_handler_t){ event_base, event_id, event_handler, event_handler_arg };
+		err = ESP_OK;
+	}
+	pthread_mutex_unlock(&host_wifi.lock);
+
+	if (instance)
+	{
+		*instance = NULL;
+	}
+	return err;
+}
+
+void host_wifi_post_event(esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+	host_wifi_handler_t handlers[HOST_WIFI_MAX_HANDLERS];
+
+	pthread_mutex_lock(&host_wifi.lock);
+	uint32_t count = host_wifi.handler_count;
+	memcpy(handlers, host_wifi.handlers, sizeof(handlers));
+	pthread_mutex_unlock(&host_wifi.lock);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (handlers[i].base == event_base && (handlers[i].id == ESP_EVENT_ANY_ID || handlers[i].id == event_id))
+		{
+			handlers[i].fn(handlers[i].arg, event_base, event_id, event_data);
+		}
+	}
+}
+
+void host_wifi_set_ap(const wifi_ap_record_t *ap)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	host_wifi.associated = ap != NULL;
+	if (ap)
+	{
+		host_wifi.ap = *ap;
+	}
+	pthread_mutex_unlock(&host_wifi.lock);
+}
+
+void host_wifi_set_stations(int num)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	host_wifi.stations = num;
+	pthread_mutex_unlock(&host_wifi.lock);
+}
+
+void host_wifi_set_scan(const wifi_ap_record_t *records, uint16_t count)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	host_wifi.scan_count = count < HOST_WIFI_MAX_SCAN_RECORDS ? count : HOST_WIFI_MAX_SCAN_RECORDS;
+	memcpy(host_wifi.scan, records, host_wifi.scan_count * sizeof(wifi_ap_record_t));
+	pthread_mutex_unlock(&host_wifi.lock);
+}
+
+void host_wifi_get_stats(host_wifi_stats_t *stats)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	*stats = host_wifi.stats;
+	stats->sta_dhcpc_stopped = host_wifi_netif[WIFI_IF_STA].dhcpc_stopped;
+	pthread_mutex_unlock(&host_wifi.lock);
+}
+
+esp_err_t esp_netif_init(void)
+{
+	return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+	return (esp_netif_t *)&host_wifi_netif[WIFI_IF_STA];
+}
+
+esp_netif_t *esp_netif_create_default_wifi_ap(void)
+{
+	return (esp_netif_t *)&host_wifi_netif[WIFI_IF_AP];
+}
+
+esp_err_t esp_netif_dhcps_start(esp_netif_t *esp_netif)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcps_stop(esp_netif_t *esp_netif)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_netif_set_ip_info(esp_netif_t *esp_netif, const esp_netif_ip_info_t *ip_info)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	((host_wifi_netif_t *)esp_netif)->ip_info = *ip_info;
+	pthread_mutex_unlock(&host_wifi.lock);
+	return ESP_OK;
+}
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_info)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	*ip_info = ((host_wifi_netif_t *)esp_netif)->ip_info;
+	pthread_mutex_unlock(&host_wifi.lock);
+	return ESP_OK;
+}
+
+esp_err_t esp_netif_set_dns_info(esp_netif_t *esp_netif, esp_netif_dns_type_t type, esp_netif_dns_info_t *dns)
+{
+	if (type >= ESP_NETIF_DNS_MAX)
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&host_wifi.lock);
+	((host_wifi_netif_t *)esp_netif)->dns[type] = *dns;
+	pthread_mutex_unlock(&host_wifi.lock);
+	return ESP_OK;
+}
+
+esp_err_t esp_netif_get_dns_info(esp_netif_t *esp_netif, esp_netif_dns_type_t type, esp_netif_dns_info_t *dns)
+{
+	if (type >= ESP_NETIF_DNS_MAX)
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&host_wifi.lock);
+	*dns = ((host_wifi_netif_t *)esp_netif)->dns[type];
+	pthread_mutex_unlock(&host_wifi.lock);
+	return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcpc_start(esp_netif_t *esp_netif)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	((host_wifi_netif_t *)esp_netif)->dhcpc_stopped = false;
+	pthread_mutex_unlock(&host_wifi.lock);
+	return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t *esp_netif)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	((host_wifi_netif_t *)esp_netif)->dhcpc_stopped = true;
+	pthread_mutex_unlock(&host_wifi.lock);
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	host_wifi.config[interface] = *conf;
+	pthread_mutex_unlock(&host_wifi.lock);
+
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *conf)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	*conf = host_wifi.config[interface];
+	pthread_mutex_unlock(&host_wifi.lock);
+
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_bandwidth(wifi_interface_t ifx, wifi_bandwidth_t bw)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	host_wifi.stats.connects++;
+	pthread_mutex_unlock(&host_wifi.lock);
+
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	host_wifi.stats.disconnects++;
+	pthread_mutex_unlock(&host_wifi.lock);
+
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+	esp_err_t err = ESP_ERR_WIFI_NOT_CONNECT;
+
+	pthread_mutex_lock(&host_wifi.lock);
+	if (host_wifi.associated)
+	{
+		*ap_info = host_wifi.ap;
+		err = ESP_OK;
+	}
+	pthread_mutex_unlock(&host_wifi.lock);
+
+	return err;
+}
+
+esp_err_t esp_wifi_ap_get_sta_list(wifi_sta_list_t *sta)
+{
+	memset(sta, 0, sizeof(*sta));
+
+	pthread_mutex_lock(&host_wifi.lock);
+	sta->num = host_wifi.stations;
+	pthread_mutex_unlock(&host_wifi.lock);
+
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *config, bool block)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	host_wifi.stats.scans++;
+	pthread_mutex_unlock(&host_wifi.lock);
+
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t *number, wifi_ap_record_t *ap_records)
+{
+	pthread_mutex_lock(&host_wifi.lock);
+	if (*number > host_wifi.scan_count)
+	{
+		*number = host_wifi.scan_count;
+	}
+	memcpy(ap_records, host_wifi.scan, *number * sizeof(wifi_ap_record_t));
+
+	// As on the device, the driver frees its list once it was read
+	host_wifi.scan_count = 0;
+	pthread_mutex_unlock(&host_wifi.lock);
+
+	return ESP_OK;
+}
@@ -0,0 +1,22 @@
+/*
+ * esp_crc.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_ESP_CRC_H_
+#define HOST_ESP_CRC_H_
+
+#include <stdint.h>
+
+/**
+ * CRC-32 as the ROM computes it, zlib compatible.
+ * @param crc CRC of the bytes before buf, 0 to start.
+ * @param buf bytes to add.
+ * @param len number of bytes.
+ * @return the CRC of everything so far.
+ */
+uint32_t esp_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif /* HOST_ESP_CRC_H_ */
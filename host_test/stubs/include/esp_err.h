@@ -0,0 +1,51 @@
+/*
+ * esp_err.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_ESP_ERR_H_
+#define HOST_ESP_ERR_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Same codes as ESP-IDF, so results read the same on the host and on the device
+typedef int esp_err_t;
+
+#define ESP_OK						0
+#define ESP_FAIL					-1
+#define ESP_ERR_NO_MEM				0x101
+#define ESP_ERR_INVALID_ARG			0x102
+#define ESP_ERR_INVALID_STATE		0x103
+#define ESP_ERR_INVALID_SIZE		0x104
+#define ESP_ERR_NOT_FOUND			0x105
+#define ESP_ERR_NOT_SUPPORTED		0x106
+#define ESP_ERR_TIMEOUT				0x107
+#define ESP_ERR_INVALID_RESPONSE	0x108
+#define ESP_ERR_INVALID_CRC			0x109
+#define ESP_ERR_INVALID_VERSION		0x10A
+#define ESP_ERR_INVALID_MAC			0x10B
+#define ESP_ERR_NOT_FINISHED		0x10C
+
+/**
+ * Names an error code.
+ * @param code error code.
+ * @return the name of the macro, or "UNKNOWN ERROR".
+ */
+const char *esp_err_to_name(esp_err_t code);
+
+// Aborts on an error, as on the device
+#define ESP_ERROR_CHECK(x) \
+	do { \
+		esp_err_t host_err_rc = (x); \
+		if (host_err_rc != ESP_OK) \
+		{ \
+			fprintf(stderr, "%s:%d: ESP_ERROR_CHECK failed: %s\n", __FILE__, __LINE__, esp_err_to_name(host_err_rc)); \
+			abort(); \
+		} \
+	} while (0)
+
+#endif /* HOST_ESP_ERR_H_ */
@@ -0,0 +1,36 @@
+/*
+ * esp_event.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_ESP_EVENT_H_
+#define HOST_ESP_EVENT_H_
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include "esp_err.h"
+
+typedef const char *esp_event_base_t;
+typedef void *esp_event_handler_instance_t;
+typedef void (*esp_event_handler_t)(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
+
+#define ESP_EVENT_ANY_ID				-1
+
+#define ESP_EVENT_DECLARE_BASE(id)		extern esp_event_base_t const id
+
+/**
+ * Handlers run on the thread that posts the event with host_wifi_post_event, there is
+ * no event loop task.
+ */
+esp_err_t esp_event_loop_create_default(void);
+esp_err_t esp_event_handler_instance_register(esp_event_base_t event_base, int32_t event_id,
+		esp_event_handler_t event_handler, void *event_handler_arg, esp_event_handler_instance_t *instance);
+
+#endif /* HOST_ESP_EVENT_H_ */
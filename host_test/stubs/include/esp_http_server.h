@@ -0,0 +1,180 @@
+/*
+ * esp_http_server.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_ESP_HTTP_SERVER_H_
+#define HOST_ESP_HTTP_SERVER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+// The parts of esp_http_server the application uses, served by host_httpd.c
+typedef void *httpd_handle_t;
+
+#define ESP_ERR_HTTPD_BASE				0xb000
+#define ESP_ERR_HTTPD_RESULT_TRUNC		(ESP_ERR_HTTPD_BASE + 3)
+#define ESP_ERR_HTTPD_RESP_HDR			(ESP_ERR_HTTPD_BASE + 4)
+#define ESP_ERR_HTTPD_RESP_SEND			(ESP_ERR_HTTPD_BASE + 5)
+
+#define HTTPD_RESP_USE_STRLEN			-1
+
+#define HTTPD_SOCK_ERR_FAIL				-1
+#define HTTPD_SOCK_ERR_INVALID			-2
+#define HTTPD_SOCK_ERR_TIMEOUT			-3
+
+#define HTTPD_TYPE_JSON					"application/json"
+#define HTTPD_TYPE_TEXT					"text/html"
+#define HTTPD_TYPE_OCTET				"application/octet-stream"
+
+typedef enum http_method
+{
+	HTTP_DELETE	= 0,
+	HTTP_GET	= 1,
+	HTTP_HEAD	= 2,
+	HTTP_POST	= 3,
+	HTTP_PUT	= 4,
+} httpd_method_t;
+
+typedef struct httpd_req
+{
+	httpd_handle_t handle;
+	int method;
+	const char *uri;
+	size_t content_len;
+	void *aux;						///> Host session state, see host_httpd.c
+	void *user_ctx;
+} httpd_req_t;
+
+typedef struct httpd_uri
+{
+	const char *uri;
+	httpd_method_t method;
+	esp_err_t (*handler)(httpd_req_t *r);
+	void *user_ctx;
+	bool is_websocket;
+	bool handle_ws_control_frames;
+	const char *supported_subprotocol;
+} httpd_uri_t;
+
+typedef void (*httpd_close_func_t)(httpd_handle_t hd, int sockfd);
+
+typedef struct httpd_config
+{
+	unsigned task_priority;
+	size_t stack_size;
+	BaseType_t core_id;
+	uint16_t server_port;
+	uint16_t ctrl_port;
+	uint16_t max_open_sockets;
+	uint16_t max_uri_handlers;
+	uint16_t max_resp_headers;
+	uint16_t backlog_conn;
+	bool lru_purge_enable;
+	uint16_t recv_wait_timeout;
+	uint16_t send_wait_timeout;
+	void *global_user_ctx;
+	httpd_close_func_t close_fn;
+} httpd_config_t;
+
+#define HTTPD_DEFAULT_CONFIG() { \
+		.task_priority = 5, \
+		.stack_size = 4096, \
+		.core_id = tskNO_AFFINITY, \
+		.server_port = 80, \
+		.ctrl_port = 32768, \
+		.max_open_sockets = 7, \
+		.max_uri_handlers = 8, \
+		.max_resp_headers = 8, \
+		.backlog_conn = 5, \
+		.lru_purge_enable = false, \
+		.recv_wait_timeout = 5, \
+		.send_wait_timeout = 5, \
+		.global_user_ctx = NULL, \
+		.close_fn = NULL, \
+	}
+
+typedef enum
+{
+	HTTPD_WS_TYPE_CONTINUE	= 0x0,
+	HTTPD_WS_TYPE_TEXT		= 0x1,
+	HTTPD_WS_TYPE_BINARY	= 0x2,
+	HTTPD_WS_TYPE_CLOSE		= 0x8,
+	HTTPD_WS_TYPE_PING		= 0x9,
+	HTTPD_WS_TYPE_PONG		= 0xA,
+} httpd_ws_type_t;
+
+typedef enum
+{
+	HTTPD_WS_CLIENT_INVALID		= 0x0,
+	HTTPD_WS_CLIENT_HTTP		= 0x1,
+	HTTPD_WS_CLIENT_WEBSOCKET	= 0x2,
+} httpd_ws_client_info_t;
+
+typedef struct httpd_ws_frame
+{
+	bool final;
+	bool fragmented;
+	httpd_ws_type_t type;
+	uint8_t *payload;
+	size_t len;
+} httpd_ws_frame_t;
+
+typedef enum
+{
+	HTTPD_500_INTERNAL_SERVER_ERROR = 0,
+	HTTPD_501_METHOD_NOT_IMPLEMENTED,
+	HTTPD_505_VERSION_NOT_SUPPORTED,
+	HTTPD_400_BAD_REQUEST,
+	HTTPD_401_UNAUTHORIZED,
+	HTTPD_403_FORBIDDEN,
+	HTTPD_404_NOT_FOUND,
+	HTTPD_405_METHOD_NOT_ALLOWED,
+	HTTPD_408_REQ_TIMEOUT,
+	HTTPD_411_LENGTH_REQUIRED,
+} httpd_err_code_t;
+
+typedef void (*httpd_work_fn_t)(void *arg);
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config);
+esp_err_t httpd_stop(httpd_handle_t handle);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler);
+int httpd_req_to_sockfd(httpd_req_t *r);
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t *fds, int *client_fds);
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd);
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *pkt, size_t max_len);
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *pkt);
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg);
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame);
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd);
+
+/**
+ * Reads the request body from the session socket, waiting up to recv_wait_timeout.
+ * @return bytes read, 0 once content_len bytes were read or the client closed,
+ * HTTPD_SOCK_ERR_TIMEOUT if nothing came in time, HTTPD_SOCK_ERR_FAIL.
+ */
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len);
+
+// Responses go out as HTTP/1.1, the header with the first send
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size);
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status);
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value);
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len);
+esp_err_t httpd_resp_sendstr(httpd_req_t *r, const char *str);
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg);
+
+#endif /* HOST_ESP_HTTP_SERVER_H_ */
@@ -0,0 +1,66 @@
+/*
+ * esp_log.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_ESP_LOG_H_
+#define HOST_ESP_LOG_H_
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sdkconfig.h"
+
+typedef enum
+{
+	ESP_LOG_NONE,
+	ESP_LOG_ERROR,
+	ESP_LOG_WARN,
+	ESP_LOG_INFO,
+	ESP_LOG_DEBUG,
+	ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+typedef int (*vprintf_like_t)(const char *format, va_list args);
+
+#define LOG_COLOR_BLACK				"30"
+#define LOG_COLOR_RED				"31"
+#define LOG_COLOR_GREEN				"32"
+#define LOG_COLOR_BROWN				"33"
+#define LOG_COLOR_BLUE				"34"
+#define LOG_COLOR_PURPLE			"35"
+#define LOG_COLOR_CYAN				"36"
+#define LOG_COLOR(COLOR)			"\033[0;" COLOR "m"
+#define LOG_RESET_COLOR
+
+// As built for the device, without CONFIG_LOG_COLORS
+#define LOG_FORMAT(letter, format)	#letter " (%u) %s: " format "\n"
+
+/**
+ * Sends a line through the vprintf hook, stderr until esp_log_set_vprintf replaces it.
+ */
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+/**
+ * Replaces the vprintf hook.
+ * @return the previous hook.
+ */
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func);
+
+// Milliseconds since the process started
+uint32_t esp_log_timestamp(void);
+
+// Levels are not filtered per tag on the host
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+
+// Warnings and errors reach the vprintf hook, the rest would only drown the test output
+#define ESP_LOGE(tag, format, ...)	esp_log_write(ESP_LOG_ERROR, tag, LOG_FORMAT(E, format), esp_log_timestamp(), tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)	esp_log_write(ESP_LOG_WARN, tag, LOG_FORMAT(W, format), esp_log_timestamp(), tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)	do { (void)(tag); } while (0)
+#define ESP_LOGD(tag, format, ...)	do { (void)(tag); } while (0)
+#define ESP_LOGV(tag, format, ...)	do { (void)(tag); } while (0)
+
+#endif /* HOST_ESP_LOG_H_ */
@@ -0,0 +1,83 @@
+/*
+ * esp_netif.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_ESP_NETIF_H_
+#define HOST_ESP_NETIF_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_wifi_types.h"
+
+typedef struct esp_netif_obj esp_netif_t;
+
+typedef struct
+{
+	uint32_t addr;
+} esp_ip4_addr_t;
+
+typedef struct
+{
+	esp_ip4_addr_t ip;
+	esp_ip4_addr_t netmask;
+	esp_ip4_addr_t gw;
+} esp_netif_ip_info_t;
+
+#define ESP_IPADDR_TYPE_V4			0
+
+typedef struct
+{
+	union
+	{
+		esp_ip4_addr_t ip4;
+	} u_addr;
+	uint8_t type;
+} esp_ip_addr_t;
+
+typedef struct
+{
+	esp_ip_addr_t ip;
+} esp_netif_dns_info_t;
+
+typedef enum
+{
+	ESP_NETIF_DNS_MAIN = 0,
+	ESP_NETIF_DNS_BACKUP,
+	ESP_NETIF_DNS_FALLBACK,
+	ESP_NETIF_DNS_MAX,
+} esp_netif_dns_type_t;
+
+#define IPSTR						"%d.%d.%d.%d"
+#define esp_ip4_addr_get_byte(ipaddr, idx)	(((const uint8_t *)(&(ipaddr)->addr))[idx])
+#define IP2STR(ipaddr)				esp_ip4_addr_get_byte(ipaddr, 0), esp_ip4_addr_get_byte(ipaddr, 1), \
+									esp_ip4_addr_get_byte(ipaddr, 2), esp_ip4_addr_get_byte(ipaddr, 3)
+
+ESP_EVENT_DECLARE_BASE(IP_EVENT);
+
+typedef enum
+{
+	IP_EVENT_STA_GOT_IP,
+	IP_EVENT_STA_LOST_IP,
+	IP_EVENT_AP_STAIPASSIGNED,
+} ip_event_t;
+
+esp_err_t esp_netif_init(void);
+esp_netif_t *esp_netif_create_default_wifi_sta(void);
+esp_netif_t *esp_netif_create_default_wifi_ap(void);
+esp_err_t esp_netif_dhcps_start(esp_netif_t *esp_netif);
+esp_err_t esp_netif_dhcps_stop(esp_netif_t *esp_netif);
+esp_err_t esp_netif_set_ip_info(esp_netif_t *esp_netif, const esp_netif_ip_info_t *ip_info);
+esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_info);
+esp_err_t esp_netif_set_dns_info(esp_netif_t *esp_netif, esp_netif_dns_type_t type, esp_netif_dns_info_t *dns);
+esp_err_t esp_netif_get_dns_info(esp_netif_t *esp_netif, esp_netif_dns_type_t type, esp_netif_dns_info_t *dns);
+
+// The DHCP client only has a state, host_wifi_get_stats reports it
+esp_err_t esp_netif_dhcpc_start(esp_netif_t *esp_netif);
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t *esp_netif);
+
+#endif /* HOST_ESP_NETIF_H_ */
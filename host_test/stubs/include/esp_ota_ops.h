@@ -0,0 +1,70 @@
+/*
+ * esp_ota_ops.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_ESP_OTA_OPS_H_
+#define HOST_ESP_OTA_OPS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_partition.h"
+
+// The ota_0 and ota_1 partitions of partitions.csv, kept in RAM by host_partition.c.
+// The host always runs from ota_0, a boot partition set with esp_ota_set_boot_partition
+// only shows in esp_ota_get_boot_partition.
+typedef uint32_t esp_ota_handle_t;
+
+#define OTA_SIZE_UNKNOWN					0xffffffff
+#define OTA_WITH_SEQUENTIAL_WRITES			0xfffffffe
+
+// First byte of an app image, esp_app_format.h
+#define ESP_IMAGE_HEADER_MAGIC				0xE9
+
+// Smallest image esp_ota_end accepts, the image header and its first segment header
+#define HOST_OTA_MIN_IMAGE_SIZE				32
+
+#define ESP_ERR_OTA_BASE					0x1500
+#define ESP_ERR_OTA_PARTITION_CONFLICT		(ESP_ERR_OTA_BASE + 0x01)
+#define ESP_ERR_OTA_SELECT_INFO_INVALID		(ESP_ERR_OTA_BASE + 0x02)
+#define ESP_ERR_OTA_VALIDATE_FAILED			(ESP_ERR_OTA_BASE + 0x03)
+
+const esp_partition_t *esp_ota_get_running_partition(void);
+const esp_partition_t *esp_ota_get_boot_partition(void);
+
+/**
+ * Gets the app partition after start_from, or after the running one.
+ * @return ota_1 unless start_from says otherwise, NULL if there is none.
+ */
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from);
+
+/**
+ * Starts writing an image, one at a time.
+ * @param image_size bytes to erase up front, OTA_SIZE_UNKNOWN for the whole partition,
+ * OTA_WITH_SEQUENTIAL_WRITES to erase each sector as the writes reach it.
+ * @return ESP_OK, ESP_ERR_OTA_PARTITION_CONFLICT for the running partition,
+ * ESP_ERR_INVALID_SIZE if the image does not fit, ESP_ERR_NO_MEM if an image is being written.
+ */
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle);
+
+/**
+ * Appends to the image.
+ * @return ESP_OK, ESP_ERR_OTA_VALIDATE_FAILED if the image does not start with
+ * ESP_IMAGE_HEADER_MAGIC, ESP_ERR_INVALID_SIZE past the end, ESP_ERR_INVALID_ARG for an unknown handle.
+ */
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size);
+
+/**
+ * Ends the image, the handle is released either way.
+ * @return ESP_OK, ESP_ERR_OTA_VALIDATE_FAILED for an image shorter than HOST_OTA_MIN_IMAGE_SIZE.
+ */
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition);
+
+#endif /* HOST_ESP_OTA_OPS_H_ */
@@ -0,0 +1,60 @@
+/*
+ * esp_partition.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_ESP_PARTITION_H_
+#define HOST_ESP_PARTITION_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum
+{
+	ESP_PARTITION_TYPE_APP	= 0x00,
+	ESP_PARTITION_TYPE_DATA	= 0x01,
+} esp_partition_type_t;
+
+typedef enum
+{
+	ESP_PARTITION_SUBTYPE_APP_OTA_0	= 0x10,
+	ESP_PARTITION_SUBTYPE_APP_OTA_1	= 0x11,
+	ESP_PARTITION_SUBTYPE_ANY		= 0xff,
+} esp_partition_subtype_t;
+
+typedef struct esp_partition
+{
+	esp_partition_type_t type;
+	esp_partition_subtype_t subtype;
+	uint32_t address;
+	uint32_t size;
+	char label[17];
+	bool encrypted;
+} esp_partition_t;
+
+/**
+ * Finds a partition of partitions.csv, host_partition.c keeps the data and OTA app ones in RAM.
+ * Type and subtype are not checked, the label decides.
+ * @return the partition, NULL if there is none with that label.
+ */
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label);
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size);
+
+/**
+ * Writes as NOR flash does, bits can only be cleared. Erase first to set them.
+ */
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size);
+
+/**
+ * Erases whole sectors to 0xFF.
+ * @return ESP_ERR_INVALID_ARG if the range is not sector aligned or past the end.
+ */
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
+
+#endif /* HOST_ESP_PARTITION_H_ */
@@ -0,0 +1,35 @@
+/*
+ * esp_system.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_ESP_SYSTEM_H_
+#define HOST_ESP_SYSTEM_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t)(void);
+
+/**
+ * Registers a function esp_restart runs before the process exits.
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if it is registered already, ESP_ERR_NO_MEM if the table is full.
+ */
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+
+// Runs the shutdown handlers and exits the process, there is nothing to boot into on the host
+void esp_restart(void) __attribute__((noreturn));
+
+// Free bytes of the malloc arena, the host heap has no fixed size
+uint32_t esp_get_free_heap_size(void);
+
+// Lowest free heap seen so far, sampled whenever either call runs
+uint32_t esp_get_minimum_free_heap_size(void);
+
+// Pseudo-random word from the C library, not the hardware generator
+uint32_t esp_random(void);
+
+#endif /* HOST_ESP_SYSTEM_H_ */
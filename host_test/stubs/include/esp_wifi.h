@@ -0,0 +1,51 @@
+/*
+ * esp_wifi.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_ESP_WIFI_H_
+#define HOST_ESP_WIFI_H_
+
+#include "esp_bit_defs.h"
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi_types.h"
+
+#define ESP_ERR_WIFI_BASE			0x3000
+#define ESP_ERR_WIFI_NOT_INIT		(ESP_ERR_WIFI_BASE + 1)
+#define ESP_ERR_WIFI_NOT_STARTED	(ESP_ERR_WIFI_BASE + 2)
+#define ESP_ERR_WIFI_CONN			(ESP_ERR_WIFI_BASE + 7)
+#define ESP_ERR_WIFI_NOT_CONNECT	(ESP_ERR_WIFI_BASE + 15)
+
+typedef struct
+{
+	int wifi_task_core_id;
+} wifi_init_config_t;
+
+#define WIFI_INIT_CONFIG_DEFAULT()	{ .wifi_task_core_id = 0 }
+
+/**
+ * Driver stand-in, see host_wifi.h. Calls only record what they were asked, the
+ * station connects and loses its link when a test says so.
+ */
+esp_err_t esp_wifi_init(const wifi_init_config_t *config);
+esp_err_t esp_wifi_set_storage(wifi_storage_t storage);
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode);
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *conf);
+esp_err_t esp_wifi_get_config(wifi_interface_t interface, wifi_config_t *conf);
+esp_err_t esp_wifi_set_bandwidth(wifi_interface_t ifx, wifi_bandwidth_t bw);
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_connect(void);
+esp_err_t esp_wifi_disconnect(void);
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info);
+esp_err_t esp_wifi_ap_get_sta_list(wifi_sta_list_t *sta);
+esp_err_t esp_wifi_scan_start(const wifi_scan_config_t *config, bool block);
+esp_err_t esp_wifi_scan_get_ap_records(uint16_t *number, wifi_ap_record_t *ap_records);
+
+#endif /* HOST_ESP_WIFI_H_ */
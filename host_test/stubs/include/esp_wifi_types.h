@@ -0,0 +1,167 @@
+/*
+ * esp_wifi_types.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_ESP_WIFI_TYPES_H_
+#define HOST_ESP_WIFI_TYPES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_event.h"
+
+// The fields the application uses, with the sizes of ESP-IDF
+typedef enum
+{
+	WIFI_MODE_NULL,
+	WIFI_MODE_STA,
+	WIFI_MODE_AP,
+	WIFI_MODE_APSTA,
+} wifi_mode_t;
+
+typedef enum
+{
+	WIFI_IF_STA,
+	WIFI_IF_AP,
+} wifi_interface_t;
+
+#define ESP_IF_WIFI_STA				WIFI_IF_STA
+#define ESP_IF_WIFI_AP				WIFI_IF_AP
+
+typedef enum
+{
+	WIFI_AUTH_OPEN,
+	WIFI_AUTH_WEP,
+	WIFI_AUTH_WPA_PSK,
+	WIFI_AUTH_WPA2_PSK,
+	WIFI_AUTH_WPA_WPA2_PSK,
+	WIFI_AUTH_WPA2_ENTERPRISE,
+	WIFI_AUTH_WPA3_PSK,
+	WIFI_AUTH_WPA2_WPA3_PSK,
+} wifi_auth_mode_t;
+
+typedef enum
+{
+	WIFI_BW_HT20 = 1,
+	WIFI_BW_HT40,
+} wifi_bandwidth_t;
+
+typedef enum
+{
+	WIFI_PS_NONE,
+	WIFI_PS_MIN_MODEM,
+	WIFI_PS_MAX_MODEM,
+} wifi_ps_type_t;
+
+typedef enum
+{
+	WIFI_STORAGE_FLASH,
+	WIFI_STORAGE_RAM,
+} wifi_storage_t;
+
+typedef struct
+{
+	uint8_t ssid[32];
+	uint8_t password[64];
+	uint8_t ssid_len;
+	uint8_t channel;
+	wifi_auth_mode_t authmode;
+	uint8_t ssid_hidden;
+	uint8_t max_connection;
+	uint16_t beacon_interval;
+} wifi_ap_config_t;
+
+typedef struct
+{
+	uint8_t ssid[32];
+	uint8_t password[64];
+	bool bssid_set;
+	uint8_t bssid[6];
+	uint8_t channel;
+} wifi_sta_config_t;
+
+typedef union
+{
+	wifi_ap_config_t ap;
+	wifi_sta_config_t sta;
+} wifi_config_t;
+
+typedef struct
+{
+	uint8_t bssid[6];
+	uint8_t ssid[33];
+	uint8_t primary;
+	int8_t rssi;
+	wifi_auth_mode_t authmode;
+} wifi_ap_record_t;
+
+typedef struct
+{
+	uint8_t *ssid;
+	uint8_t *bssid;
+	uint8_t channel;
+	bool show_hidden;
+} wifi_scan_config_t;
+
+typedef struct
+{
+	uint8_t mac[6];
+	int8_t rssi;
+} wifi_sta_info_t;
+
+typedef struct
+{
+	wifi_sta_info_t sta[10];
+	int num;
+} wifi_sta_list_t;
+
+ESP_EVENT_DECLARE_BASE(WIFI_EVENT);
+
+typedef enum
+{
+	WIFI_EVENT_WIFI_READY,
+	WIFI_EVENT_SCAN_DONE,
+	WIFI_EVENT_STA_START,
+	WIFI_EVENT_STA_STOP,
+	WIFI_EVENT_STA_CONNECTED,
+	WIFI_EVENT_STA_DISCONNECTED,
+	WIFI_EVENT_STA_AUTHMODE_CHANGE,
+	WIFI_EVENT_STA_WPS_ER_SUCCESS,
+	WIFI_EVENT_STA_WPS_ER_FAILED,
+	WIFI_EVENT_STA_WPS_ER_TIMEOUT,
+	WIFI_EVENT_STA_WPS_ER_PIN,
+	WIFI_EVENT_STA_WPS_ER_PBC_OVERLAP,
+	WIFI_EVENT_AP_START,
+	WIFI_EVENT_AP_STOP,
+	WIFI_EVENT_AP_STACONNECTED,
+	WIFI_EVENT_AP_STADISCONNECTED,
+} wifi_event_t;
+
+// The reasons wifi_app tells apart, with the values of ESP-IDF
+typedef enum
+{
+	WIFI_REASON_UNSPECIFIED = 1,
+	WIFI_REASON_AUTH_EXPIRE = 2,
+	WIFI_REASON_ASSOC_LEAVE = 8,
+	WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT = 15,
+	WIFI_REASON_802_1X_AUTH_FAILED = 23,
+	WIFI_REASON_BEACON_TIMEOUT = 200,
+	WIFI_REASON_NO_AP_FOUND = 201,
+	WIFI_REASON_AUTH_FAIL = 202,
+	WIFI_REASON_ASSOC_FAIL = 203,
+	WIFI_REASON_HANDSHAKE_TIMEOUT = 204,
+	WIFI_REASON_CONNECTION_FAIL = 205,
+} wifi_err_reason_t;
+
+typedef struct
+{
+	uint8_t ssid[32];
+	uint8_t ssid_len;
+	uint8_t bssid[6];
+	uint8_t reason;
+} wifi_event_sta_disconnected_t;
+
+#endif /* HOST_ESP_WIFI_TYPES_H_ */
@@ -0,0 +1,40 @@
+/*
+ * FreeRTOS.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_FREERTOS_H_
+#define HOST_FREERTOS_H_
+
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+/**
+ * POSIX stand-in for the parts of FreeRTOS the host build uses: tasks are threads,
+ * queues and semaphores are a mutex and condition variable, a tick is a millisecond.
+ * Priorities are recorded but not applied, the host scheduler is not real time.
+ */
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE						0
+#define pdTRUE						1
+#define pdFAIL						pdFALSE
+#define pdPASS						pdTRUE
+
+#define portMAX_DELAY				UINT32_MAX
+#define configTICK_RATE_HZ			1000
+#define portTICK_PERIOD_MS			(1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)			((TickType_t)(ms) * configTICK_RATE_HZ / 1000)
+
+#define tskNO_AFFINITY				0x7FFFFFFF
+
+// As on the ESP32, a core number only picks a host CPU
+#define portNUM_PROCESSORS			2
+#define configMAX_TASK_NAME_LEN		16
+
+#endif /* HOST_FREERTOS_H_ */
@@ -0,0 +1,25 @@
+/*
+ * semphr.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_FREERTOS_SEMPHR_H_
+#define HOST_FREERTOS_SEMPHR_H_
+
+#include "freertos/queue.h"
+
+// A semaphore is a queue of empty items, as in FreeRTOS
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+
+#define xSemaphoreTake(sem, wait)	xQueueReceive((sem), NULL, (wait))
+#define xSemaphoreGive(sem)			xQueueSend((sem), NULL, 0)
+#define xSemaphoreGiveFromISR(sem, woken)	xQueueSendFromISR((sem), NULL, (woken))
+#define vSemaphoreDelete(sem)		vQueueDelete(sem)
+
+#endif /* HOST_FREERTOS_SEMPHR_H_ */
@@ -0,0 +1,78 @@
+/*
+ * task.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_FREERTOS_TASK_H_
+#define HOST_FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+typedef enum
+{
+	eRunning = 0,
+	eReady,
+	eBlocked,
+	eSuspended,
+	eDeleted,
+	eInvalid,
+} eTaskState;
+
+/**
+ * Task as uxTaskGetSystemState reports it. The run time counter is the CPU time of the
+ * thread in microseconds, the stack high-water mark the whole stack since host threads
+ * do not share theirs.
+ */
+typedef struct xTASK_STATUS
+{
+	TaskHandle_t xHandle;
+	const char *pcTaskName;
+	UBaseType_t xTaskNumber;
+	eTaskState eCurrentState;
+	UBaseType_t uxCurrentPriority;
+	UBaseType_t uxBasePriority;
+	uint32_t ulRunTimeCounter;
+	uint32_t usStackHighWaterMark;
+	BaseType_t xCoreID;
+} TaskStatus_t;
+
+/**
+ * Starts a detached thread. A core other than tskNO_AFFINITY pins the thread to that
+ * host CPU, modulo the CPUs available. The stack size is ignored.
+ */
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_size, void *arg,
+		UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id);
+
+/**
+ * Ends the calling task for NULL or its own handle. Another task is cancelled at its
+ * next wait, a lock it holds stays taken.
+ */
+void vTaskDelete(TaskHandle_t task);
+
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+// Notification count of the task, ulTaskNotifyTake only works on tasks created above
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t wait);
+
+// Tasks created above that have not ended, threads of the host itself are not counted
+UBaseType_t uxTaskGetNumberOfTasks(void);
+
+/**
+ * Copies the state of every task, in creation order.
+ * @param status receives the tasks.
+ * @param size entries status holds.
+ * @param total_run_time receives microseconds since start, NULL if not wanted.
+ * @return tasks copied, 0 if there are more than size.
+ */
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t size, uint32_t *total_run_time);
+
+#endif /* HOST_FREERTOS_TASK_H_ */
@@ -0,0 +1,112 @@
+/*
+ * host_httpd.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_HTTPD_H_
+#define HOST_HTTPD_H_
+
+#include <stdint.h>
+
+#include "esp_http_server.h"
+
+/**
+ * Host stand-in for the httpd task.
+ *
+ * One FreeRTOS task runs the work items queued with httpd_queue_work in order, as the
+ * httpd task does, and the URI handlers of the sessions a test opens. There is no
+ * listening socket: a session is a file descriptor the test hands in, usually one end
+ * of a socketpair. httpd_ws_send_frame_async writes to it a u32 little endian length
+ * and then the payload, so a reader can split frames. Like lwIP with send_wait_timeout,
+ * a send waits up to the configured time for room in the socket and fails with
+ * ESP_FAIL after that. Frames from the client are handed in with host_httpd_ws_recv.
+ */
+
+/**
+ * Starts the httpd task without going through httpd_start.
+ * @param send_wait_ms longest wait for room in a client socket, and for request body bytes.
+ * @param close_fn session close hook, may be NULL to just close the socket.
+ * @return the server handle.
+ */
+httpd_handle_t host_httpd_start(uint32_t send_wait_ms, httpd_close_func_t close_fn);
+
+/**
+ * Runs the work items still queued and stops the httpd task.
+ * @param hd server handle.
+ */
+void host_httpd_stop(httpd_handle_t hd);
+
+/**
+ * Gets the running server, as started by httpd_start or host_httpd_start.
+ * @return the server handle, NULL if none is running.
+ */
+httpd_handle_t host_httpd_get(void);
+
+/**
+ * Waits until the work queue is empty and the httpd task is idle.
+ * @param hd server handle.
+ */
+void host_httpd_sync(httpd_handle_t hd);
+
+/**
+ * Runs a function on the httpd task and waits for it.
+ * @param hd server handle.
+ * @param fn function to run.
+ * @param arg its argument.
+ */
+void host_httpd_call(httpd_handle_t hd, httpd_work_fn_t fn, void *arg);
+
+/**
+ * Opens a session on a URI, as a client connecting and sending a GET. The handler runs
+ * on the httpd task; for a websocket URI that is the handshake.
+ * @param hd server handle.
+ * @param fd socket of the session.
+ * @param uri registered URI.
+ * @return what the handler returned, ESP_ERR_NOT_FOUND for an unknown URI,
+ * ESP_ERR_NO_MEM if max_open_sockets sessions are open.
+ */
+esp_err_t host_httpd_open(httpd_handle_t hd, int fd, const char *uri);
+
+/**
+ * Sends a plain HTTP request, as a client would on a connection of its own, and waits for
+ * the handler. The response is written to fd: status line, headers, then the body after a
+ * Content-Length or chunked. With a Content-Length request header the handler reads that
+ * many body bytes from fd with httpd_req_recv.
+ * @param hd server handle.
+ * @param fd socket the body is read from and the response is written to.
+ * @param method request method.
+ * @param uri registered URI.
+ * @param headers request headers, "Name: value\r\n" each, NULL for none.
+ * @return what the handler returned, ESP_ERR_NOT_FOUND for an unknown URI.
+ */
+esp_err_t host_httpd_http_request(httpd_handle_t hd, int fd, httpd_method_t method, const char *uri, const char *headers);
+
+/**
+ * Hands a frame from the client to the websocket handler of a session and waits for it.
+ * @param hd server handle.
+ * @param fd socket of the session.
+ * @param type frame type.
+ * @param payload frame payload.
+ * @param len payload bytes.
+ * @return what the handler returned, ESP_ERR_NOT_FOUND if fd is not a websocket session.
+ */
+esp_err_t host_httpd_ws_recv(httpd_handle_t hd, int fd, httpd_ws_type_t type, const void *payload, size_t len);
+
+/**
+ * Closes a session as when the client goes away, through the close hook, and waits for it.
+ * @param hd server handle.
+ * @param fd socket of the session.
+ */
+void host_httpd_close(httpd_handle_t hd, int fd);
+
+/**
+ * Counts the frames the server handed to sockets and the time spent in sends.
+ * @param hd server handle.
+ * @param frames receives the frames sent.
+ * @param send_us receives the time spent in httpd_ws_send_frame_async, blocked sends included.
+ */
+void host_httpd_stats(httpd_handle_t hd, uint32_t *frames, uint64_t *send_us);
+
+#endif /* HOST_HTTPD_H_ */
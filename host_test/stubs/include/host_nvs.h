@@ -0,0 +1,23 @@
+/*
+ * host_nvs.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_HOST_NVS_H_
+#define HOST_HOST_NVS_H_
+
+#include "esp_err.h"
+
+/**
+ * Host stand-in for NVS, blobs kept in RAM until nvs_flash_erase.
+ */
+
+/**
+ * Fails the next nvs_set_blob, as a full partition or a power loss would.
+ * @param err error it returns, the blob is not stored.
+ */
+void host_nvs_fail_next_set(esp_err_t err);
+
+#endif /* HOST_HOST_NVS_H_ */
@@ -0,0 +1,71 @@
+/*
+ * host_wifi.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_WIFI_H_
+#define HOST_WIFI_H_
+
+#include <stdint.h>
+
+#include "esp_wifi.h"
+
+// Access points one scan reports at most
+#define HOST_WIFI_MAX_SCAN_RECORDS	16
+
+/**
+ * Host stand-in for the WiFi driver, netif and default event loop.
+ *
+ * esp_wifi_connect and esp_wifi_disconnect are only counted. A test plays the driver:
+ * it sets the access point the station is associated with and posts the events the
+ * driver would, host_wifi_post_event runs the registered handlers on the calling thread.
+ */
+
+/**
+ * Driver calls counted since the start, and the state they left
+ */
+typedef struct host_wifi_stats
+{
+	uint32_t connects;				///> esp_wifi_connect calls
+	uint32_t disconnects;			///> esp_wifi_disconnect calls
+	uint32_t scans;					///> esp_wifi_scan_start calls
+	bool sta_dhcpc_stopped;			///> esp_netif_dhcpc_stop was the last call on the station
+} host_wifi_stats_t;
+
+/**
+ * Runs the handlers registered for an event.
+ * @param event_base WIFI_EVENT or IP_EVENT.
+ * @param event_id event of that base.
+ * @param event_data event structure, may be NULL for events without one.
+ */
+void host_wifi_post_event(esp_event_base_t event_base, int32_t event_id, void *event_data);
+
+/**
+ * Sets the access point esp_wifi_sta_get_ap_info reports.
+ * @param ap access point the station is associated with, NULL if it is not.
+ */
+void host_wifi_set_ap(const wifi_ap_record_t *ap);
+
+/**
+ * Sets the number of stations esp_wifi_ap_get_sta_list reports on the SoftAP.
+ * @param num stations joined.
+ */
+void host_wifi_set_stations(int num);
+
+/**
+ * Sets the access points the next esp_wifi_scan_get_ap_records returns. The scan only
+ * completes when the test posts WIFI_EVENT_SCAN_DONE.
+ * @param records access points found, copied.
+ * @param count number of records, up to HOST_WIFI_MAX_SCAN_RECORDS.
+ */
+void host_wifi_set_scan(const wifi_ap_record_t *records, uint16_t count);
+
+/**
+ * Reads the driver call counters.
+ * @param stats receives the counters.
+ */
+void host_wifi_get_stats(host_wifi_stats_t *stats);
+
+#endif /* HOST_WIFI_H_ */
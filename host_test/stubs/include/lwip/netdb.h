@@ -0,0 +1,15 @@
+/*
+ * netdb.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_LWIP_NETDB_H_
+#define HOST_LWIP_NETDB_H_
+
+// The host socket API is close enough to the lwIP one
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#endif /* HOST_LWIP_NETDB_H_ */
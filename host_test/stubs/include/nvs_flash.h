@@ -0,0 +1,19 @@
+/*
+ * nvs_flash.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_NVS_FLASH_H_
+#define HOST_NVS_FLASH_H_
+
+#include "esp_err.h"
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+
+// Forgets every namespace
+esp_err_t nvs_flash_erase(void);
+
+#endif /* HOST_NVS_FLASH_H_ */
@@ -0,0 +1,49 @@
+/*
+ * sdkconfig.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_SDKCONFIG_H_
+#define HOST_SDKCONFIG_H_
+
+// Defaults from main/Kconfig.projbuild, the host build has no menuconfig
+#define CONFIG_WS_LOG_FORMAT_TEXT				1
+#define CONFIG_WS_LOG_COMPRESSION				1
+#define CONFIG_WS_LOG_BATCH_SIZE				1024
+#define CONFIG_WS_LOG_FLUSH_DEADLINE_MS			20
+#define CONFIG_HTTP_SERVER_MAX_OPEN_SOCKETS		10
+#define CONFIG_WS_CLIENT_MAX_CLIENTS			8
+#define CONFIG_WS_LOG_HISTORY_KB				8
+#define CONFIG_WS_LOG_STORE						1
+#define CONFIG_WS_LOG_STORE_BATCH_SIZE			2048
+#define CONFIG_WS_LOG_STORE_FLUSH_S				10
+#define CONFIG_WS_CLIENT_QUEUE_DEPTH			8
+#define CONFIG_WS_CLIENT_OVERFLOW_DROP_OLDEST	1
+#define CONFIG_WS_RX_POOL_SLOTS					2
+#define CONFIG_WS_RX_POOL_SLOT_SIZE				256
+#define CONFIG_WS_METRICS_PERIOD_MS				5000
+#define CONFIG_WS_HTTP_SERVER_IDLE_STOP_S		0
+// Off by default on the device, on here so the profiler is built and tested
+#define CONFIG_WS_PROFILER						1
+#define CONFIG_WS_PROFILER_PERIOD_MS			1000
+#define CONFIG_WS_PROFILER_MAX_TASKS			24
+#define CONFIG_WS_WIFI_FAST_RECONNECT			1
+#define CONFIG_WS_WIFI_RECONNECT_MIN_MS			500
+#define CONFIG_WS_WIFI_RECONNECT_MAX_MS			60000
+#define CONFIG_WS_WIFI_MAX_NETWORKS				4
+#define CONFIG_WS_TASK_HTTPD_PRIORITY			21
+#define CONFIG_WS_TASK_HTTPD_CORE				1
+#define CONFIG_WS_TASK_HTTP_MONITOR_PRIORITY	3
+#define CONFIG_WS_TASK_HTTP_MONITOR_CORE		1
+#define CONFIG_WS_TASK_WS_PRINT_PRIORITY		12
+#define CONFIG_WS_TASK_WS_PRINT_CORE			0
+#define CONFIG_WS_TASK_WIFI_APP_PRIORITY		5
+#define CONFIG_WS_TASK_WIFI_APP_CORE			1
+#define CONFIG_WS_TASK_OTA_WRITER_PRIORITY		5
+#define CONFIG_WS_TASK_OTA_WRITER_CORE			0
+#define CONFIG_WS_TASK_PROFILER_PRIORITY		2
+#define CONFIG_WS_TASK_PROFILER_CORE			-1
+
+#endif /* HOST_SDKCONFIG_H_ */
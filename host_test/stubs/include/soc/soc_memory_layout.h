@@ -0,0 +1,20 @@
+/*
+ * soc_memory_layout.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_SOC_MEMORY_LAYOUT_H_
+#define HOST_SOC_MEMORY_LAYOUT_H_
+
+#include <stdbool.h>
+
+// No flash is mapped on the host, no format string can be found in an ELF string table
+static inline bool esp_ptr_in_drom(const void *p)
+{
+	(void)p;
+	return false;
+}
+
+#endif /* HOST_SOC_MEMORY_LAYOUT_H_ */
@@ -0,0 +1,58 @@
+/*
+ * host_test.h
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Just enough of a unit test framework: a failed check prints its location and the
+ * test goes on, the executable exits with 1 if any check failed so ctest reports it.
+ */
+static int host_test_failures = 0;
+
+#define TEST_CHECK(cond) \
+	do { \
+		if (!(cond)) \
+		{ \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			host_test_failures++; \
+		} \
+	} while (0)
+
+#define TEST_CHECK_EQ(expected, actual) \
+	do { \
+		long long host_test_e = (long long)(expected); \
+		long long host_test_a = (long long)(actual); \
+		if (host_test_e != host_test_a) \
+		{ \
+			fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, host_test_a, host_test_e); \
+			host_test_failures++; \
+		} \
+	} while (0)
+
+#define TEST_CHECK_MEM(expected, actual, len) \
+	do { \
+		if (memcmp((expected), (actual), (len)) != 0) \
+		{ \
+			fprintf(stderr, "%s:%d: %s differs from %s\n", __FILE__, __LINE__, #actual, #expected); \
+			host_test_failures++; \
+		} \
+	} while (0)
+
+#define TEST_RUN(fn) \
+	do { \
+		int host_test_before = host_test_failures; \
+		fn(); \
+		printf("%-40s %s\n", #fn, host_test_failures == host_test_before ? "ok" : "FAILED"); \
+	} while (0)
+
+#define TEST_RESULT()				(host_test_failures ? 1 : 0)
+
+#endif /* HOST_TEST_H_ */
@@ -0,0 +1,422 @@
+/*
+ * test_app_nvs.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_crc.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include "app_nvs.h"
+#include "host_nvs.h"
+#include "wifi_app.h"
+
+#include "host_test.h"
+
+// Configuration wifi_app.c allocates in wifi_app_start, the tests bring their own
+extern wifi_config_t *wifi_config;
+
+static wifi_config_t config;
+
+// Room for the largest record in flash
+static uint8_t blob[1024];
+
+/**
+ * Starts from an empty NVS, as on a new board.
+ */
+static void erase(void)
+{
+	nvs_flash_erase();
+	app_nvs_flash_setup();
+}
+
+/**
+ * Sets the credentials wifi_app would connect with.
+ */
+static void set_creds(const char *ssid, const char *password)
+{
+	memset(&config, 0x00, sizeof(config));
+	strcpy((char *)config.sta.ssid, ssid);
+	strcpy((char *)config.sta.password, password);
+}
+
+/**
+ * Loads the credentials as a reboot would, RAM copy read again from NVS.
+ * @return what app_nvs_load_sta_creds returned.
+ */
+static bool reboot_and_load(void)
+{
+	app_nvs_flash_setup();
+	memset(&config, 0x00, sizeof(config));
+	return app_nvs_load_sta_creds();
+}
+
+/**
+ * Checks whether a key exists in the credentials name space.
+ */
+static bool has_key(const char *key)
+{
+	nvs_handle_t handle;
+	size_t len = sizeof(blob);
+
+	if (nvs_open("stacreds", NVS_READONLY, &handle) != ESP_OK)
+	{
+		return false;
+	}
+	esp_err_t err = nvs_get_blob(handle, key, blob, &len);
+	nvs_close(handle);
+	return err == ESP_OK;
+}
+
+/**
+ * Reads the record as it is in flash into blob.
+ * @return its length, 0 if there is none.
+ */
+static size_t read_record(void)
+{
+	nvs_handle_t handle;
+	size_t len = sizeof(blob);
+
+	if (nvs_open("stacreds", NVS_READONLY, &handle) != ESP_OK)
+	{
+		return 0;
+	}
+	esp_err_t err = nvs_get_blob(handle, "config", blob, &len);
+	nvs_close(handle);
+	return err == ESP_OK ? len : 0;
+}
+
+/**
+ * Writes a record to flash as it is, behind app_nvs.
+ */
+static void write_record(const void *record, size_t len)
+{
+	nvs_handle_t handle;
+
+	TEST_CHECK_EQ(ESP_OK, nvs_open("stacreds", NVS_READWRITE, &handle));
+	nvs_set_blob(handle, "config", record, len);
+	nvs_commit(handle);
+	nvs_close(handle);
+}
+
+/**
+ * Gets the SSID of a saved network.
+ * @return the SSID, "" if there is no network at index.
+ */
+static const char *network_ssid(size_t index)
+{
+	static app_nvs_network_t network;
+
+	memset(&network, 0x00, sizeof(network));
+	app_nvs_get_network(index, &network);
+	return (const char *)network.ssid;
+}
+
+static void test_save_load(void)
+{
+	erase();
+	TEST_CHECK(!reboot_and_load());
+
+	set_creds("home", "secret");
+	TEST_CHECK_EQ(ESP_OK, app_nvs_save_sta_creds(NULL, -50));
+	TEST_CHECK(reboot_and_load());
+	TEST_CHECK_EQ(0, strcmp("home", (char *)config.sta.ssid));
+	TEST_CHECK_EQ(0, strcmp("secret", (char *)config.sta.password));
+	TEST_CHECK(has_key("config"));
+}
+
+static void test_unchanged_save_skipped(void)
+{
+	app_nvs_stats_t before;
+	app_nvs_stats_t after;
+
+	erase();
+	set_creds("home", "secret");
+	app_nvs_save_sta_creds(NULL, -50);
+
+	// Reconnecting to the same network writes nothing
+	app_nvs_get_stats(&before);
+	TEST_CHECK_EQ(ESP_OK, app_nvs_save_sta_creds(NULL, -50));
+	app_nvs_get_stats(&after);
+	TEST_CHECK_EQ(before.writes, after.writes);
+	TEST_CHECK_EQ(before.skipped_writes + 1, after.skipped_writes);
+
+	// Nor does a load, it is served from RAM
+	TEST_CHECK(app_nvs_load_sta_creds());
+	app_nvs_get_stats(&after);
+	TEST_CHECK_EQ(before.reads, after.reads);
+
+	set_creds("home", "changed");
+	TEST_CHECK_EQ(ESP_OK, app_nvs_save_sta_creds(NULL, -50));
+	app_nvs_get_stats(&after);
+	TEST_CHECK_EQ(before.writes + 1, after.writes);
+}
+
+static void test_clear(void)
+{
+	app_nvs_stats_t before;
+	app_nvs_stats_t after;
+
+	erase();
+	set_creds("home", "secret");
+	app_nvs_save_sta_creds(NULL, -50);
+
+	TEST_CHECK_EQ(ESP_OK, app_nvs_clear_sta_creds());
+	TEST_CHECK(!reboot_and_load());
+	TEST_CHECK(!has_key("config"));
+
+	// Nothing stored, nothing to erase
+	app_nvs_get_stats(&before);
+	TEST_CHECK_EQ(ESP_OK, app_nvs_clear_sta_creds());
+	app_nvs_get_stats(&after);
+	TEST_CHECK_EQ(before.writes, after.writes);
+	TEST_CHECK_EQ(before.skipped_writes + 1, after.skipped_writes);
+}
+
+static void test_legacy_migration(void)
+{
+	nvs_handle_t handle;
+	uint8_t ssid[MAX_SSID_LENGTH] = "old";
+	uint8_t password[MAX_PASSWORD_LENGTH] = "layout";
+
+	// Two blobs, as the firmware before the single record saved them
+	erase();
+	TEST_CHECK_EQ(ESP_OK, nvs_open("stacreds", NVS_READWRITE, &handle));
+	nvs_set_blob(handle, "ssid", ssid, sizeof(ssid));
+	nvs_set_blob(handle, "password", password, sizeof(password));
+	nvs_commit(handle);
+	nvs_close(handle);
+
+	TEST_CHECK(reboot_and_load());
+	TEST_CHECK_EQ(0, strcmp("old", (char *)config.sta.ssid));
+	TEST_CHECK_EQ(0, strcmp("layout", (char *)config.sta.password));
+	TEST_CHECK(has_key("config"));
+	TEST_CHECK(!has_key("ssid"));
+	TEST_CHECK(!has_key("password"));
+
+	// Migrated once, the next boot reads the record only
+	app_nvs_stats_t before;
+	app_nvs_stats_t after;
+	app_nvs_get_stats(&before);
+	TEST_CHECK(reboot_and_load());
+	app_nvs_get_stats(&after);
+	TEST_CHECK_EQ(before.reads + 1, after.reads);
+	TEST_CHECK_EQ(before.writes, after.writes);
+}
+
+static void test_legacy_migration_failed(void)
+{
+	nvs_handle_t handle;
+	uint8_t ssid[MAX_SSID_LENGTH] = "old";
+	uint8_t password[MAX_PASSWORD_LENGTH] = "layout";
+
+	erase();
+	TEST_CHECK_EQ(ESP_OK, nvs_open("stacreds", NVS_READWRITE, &handle));
+	nvs_set_blob(handle, "ssid", ssid, sizeof(ssid));
+	nvs_set_blob(handle, "password", password, sizeof(password));
+	nvs_commit(handle);
+	nvs_close(handle);
+
+	// The record cannot be written, the old credentials are kept for the next boot
+	host_nvs_fail_next_set(ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+	TEST_CHECK(!reboot_and_load());
+	TEST_CHECK(!has_key("config"));
+	TEST_CHECK(has_key("ssid"));
+	TEST_CHECK(has_key("password"));
+
+	TEST_CHECK(reboot_and_load());
+	TEST_CHECK_EQ(0, strcmp("layout", (char *)config.sta.password));
+	TEST_CHECK(has_key("config"));
+	TEST_CHECK(!has_key("ssid"));
+}
+
+static void test_link(void)
+{
+	app_nvs_link_t link = { .bssid = { 1, 2, 3, 4, 5, 6 }, .channel = 11, .flags = APP_NVS_LINK_VALID | APP_NVS_LINK_IP,
+			.ip = 0x0A01A8C0, .netmask = 0x00FFFFFF, .gw = 0x0101A8C0, .dns = 0x08080808 };
+	app_nvs_link_t loaded;
+	app_nvs_stats_t before;
+	app_nvs_stats_t after;
+
+	erase();
+	TEST_CHECK(!app_nvs_load_sta_link(&loaded));
+
+	set_creds("home", "secret");
+	TEST_CHECK_EQ(ESP_OK, app_nvs_save_sta_creds(&link, -50));
+	TEST_CHECK(reboot_and_load());
+	TEST_CHECK(app_nvs_load_sta_link(&loaded));
+	TEST_CHECK_MEM(&link, &loaded, sizeof(link));
+
+	// The same access point and lease again writes nothing, a new lease does
+	app_nvs_get_stats(&before);
+	app_nvs_save_sta_creds(&link, -50);
+	link.ip++;
+	app_nvs_save_sta_creds(&link, -50);
+	app_nvs_get_stats(&after);
+	TEST_CHECK_EQ(before.skipped_writes + 1, after.skipped_writes);
+	TEST_CHECK_EQ(before.writes + 1, after.writes);
+
+	// Saved without a link, none is loaded
+	app_nvs_save_sta_creds(NULL, -50);
+	TEST_CHECK(!app_nvs_load_sta_link(&loaded));
+}
+
+/**
+ * Single network record of version 1, as the firmware before the link wrote it
+ */
+typedef struct test_config_v1
+{
+	uint16_t version;
+	uint16_t size;
+	uint8_t ssid[MAX_SSID_LENGTH];
+	uint8_t password[MAX_PASSWORD_LENGTH];
+	uint32_t crc;
+} test_config_v1_t;
+
+/**
+ * Single network record of version 2, with the link
+ */
+typedef struct test_config_v2
+{
+	uint16_t version;
+	uint16_t size;
+	uint8_t ssid[MAX_SSID_LENGTH];
+	uint8_t password[MAX_PASSWORD_LENGTH];
+	app_nvs_link_t link;
+	uint32_t crc;
+} test_config_v2_t;
+
+static void test_v1_migration(void)
+{
+	test_config_v1_t v1 = { .version = 1, .size = sizeof(test_config_v1_t), .ssid = "first", .password = "version" };
+	app_nvs_link_t link;
+
+	v1.crc = esp_crc32_le(0, (const uint8_t *)&v1, offsetof(test_config_v1_t, crc));
+	erase();
+	write_record(&v1, sizeof(v1));
+
+	TEST_CHECK(reboot_and_load());
+	TEST_CHECK_EQ(0, strcmp("first", (char *)config.sta.ssid));
+	TEST_CHECK_EQ(0, strcmp("version", (char *)config.sta.password));
+	TEST_CHECK(!app_nvs_load_sta_link(&link));
+
+	// Stored as the current version, the version comes first
+	uint16_t version;
+	TEST_CHECK(read_record() > sizeof(v1));
+	memcpy(&version, blob, sizeof(version));
+	TEST_CHECK_EQ(APP_NVS_CONFIG_VERSION, version);
+
+	// A damaged version 1 record is dropped
+	v1.crc ^= 1;
+	write_record(&v1, sizeof(v1));
+	TEST_CHECK(!reboot_and_load());
+}
+
+static void test_v2_migration(void)
+{
+	test_config_v2_t v2 = { .version = 2, .size = sizeof(test_config_v2_t), .ssid = "second", .password = "version",
+			.link = { .bssid = { 6, 5, 4, 3, 2, 1 }, .channel = 1, .flags = APP_NVS_LINK_VALID } };
+	app_nvs_link_t link;
+
+	v2.crc = esp_crc32_le(0, (const uint8_t *)&v2, offsetof(test_config_v2_t, crc));
+	erase();
+	write_record(&v2, sizeof(v2));
+
+	TEST_CHECK(reboot_and_load());
+	TEST_CHECK_EQ(0, strcmp("second", (char *)config.sta.ssid));
+	TEST_CHECK_EQ(1, app_nvs_get_network_count());
+	TEST_CHECK(app_nvs_load_sta_link(&link));
+	TEST_CHECK_MEM(&v2.link, &link, sizeof(link));
+}
+
+static void test_networks(void)
+{
+	app_nvs_stats_t before;
+	app_nvs_stats_t after;
+
+	erase();
+	set_creds("first", "1");
+	app_nvs_save_sta_creds(NULL, -50);
+	set_creds("second", "2");
+	app_nvs_save_sta_creds(NULL, -50);
+	set_creds("third", "3");
+	app_nvs_save_sta_creds(NULL, -50);
+
+	// Most recently connected first, that one is loaded
+	TEST_CHECK(reboot_and_load());
+	TEST_CHECK_EQ(3, app_nvs_get_network_count());
+	TEST_CHECK_EQ(0, strcmp("third", (char *)config.sta.ssid));
+	TEST_CHECK_EQ(0, strcmp("second", network_ssid(1)));
+	TEST_CHECK_EQ(0, strcmp("first", network_ssid(2)));
+
+	// Going back to an older network moves it up, keeping its password
+	set_creds("first", "1");
+	app_nvs_save_sta_creds(NULL, -50);
+	TEST_CHECK_EQ(3, app_nvs_get_network_count());
+	TEST_CHECK_EQ(0, strcmp("first", network_ssid(0)));
+	TEST_CHECK_EQ(0, strcmp("third", network_ssid(1)));
+
+	// A full list drops the least recently connected one
+	set_creds("fourth", "4");
+	app_nvs_save_sta_creds(NULL, -50);
+	set_creds("fifth", "5");
+	app_nvs_save_sta_creds(NULL, -50);
+	TEST_CHECK_EQ(APP_NVS_MAX_NETWORKS, app_nvs_get_network_count());
+	TEST_CHECK_EQ(0, strcmp("fifth", network_ssid(0)));
+	TEST_CHECK_EQ(0, strcmp("third", network_ssid(APP_NVS_MAX_NETWORKS - 1)));
+
+	// RSSI noise writes nothing, a real move does
+	app_nvs_get_stats(&before);
+	app_nvs_save_sta_creds(NULL, -50 + APP_NVS_RSSI_STEP - 1);
+	app_nvs_save_sta_creds(NULL, -50 + APP_NVS_RSSI_STEP);
+	app_nvs_get_stats(&after);
+	TEST_CHECK_EQ(before.skipped_writes + 1, after.skipped_writes);
+	TEST_CHECK_EQ(before.writes + 1, after.writes);
+
+	// Forgetting the current network keeps the others
+	TEST_CHECK_EQ(ESP_OK, app_nvs_clear_sta_creds());
+	TEST_CHECK(reboot_and_load());
+	TEST_CHECK_EQ(APP_NVS_MAX_NETWORKS - 1, app_nvs_get_network_count());
+	TEST_CHECK_EQ(0, strcmp("fourth", (char *)config.sta.ssid));
+}
+
+static void test_damaged_record_ignored(void)
+{
+	erase();
+	set_creds("home", "secret");
+	app_nvs_save_sta_creds(NULL, -50);
+
+	size_t len = read_record();
+	TEST_CHECK(len > 0);
+	blob[len / 2] ^= 1;
+	write_record(blob, len);
+	TEST_CHECK(!reboot_and_load());
+
+	// A record of another size is foreign
+	blob[len / 2] ^= 1;
+	write_record(blob, len - 4);
+	TEST_CHECK(!reboot_and_load());
+}
+
+int main(void)
+{
+	wifi_config = &config;
+
+	TEST_RUN(test_save_load);
+	TEST_RUN(test_unchanged_save_skipped);
+	TEST_RUN(test_clear);
+	TEST_RUN(test_legacy_migration);
+	TEST_RUN(test_legacy_migration_failed);
+	TEST_RUN(test_link);
+	TEST_RUN(test_v1_migration);
+	TEST_RUN(test_v2_migration);
+	TEST_RUN(test_networks);
+	TEST_RUN(test_damaged_record_ignored);
+	return TEST_RESULT();
+}
@@ -0,0 +1,121 @@
+/*
+ * test_event_bus.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "event_bus.h"
+
+#include "host_test.h"
+
+static event_bus_t bus;
+
+static void test_priority_order(void)
+{
+	event_bus_event_t event;
+
+	TEST_CHECK(event_bus_init(&bus, "test", 4, 2));
+
+	// Normal events keep their order, high ones overtake them and keep theirs
+	TEST_CHECK(event_bus_post(&bus, 1, EVENT_BUS_PRIORITY_NORMAL, NULL, 0));
+	TEST_CHECK(event_bus_post(&bus, 2, EVENT_BUS_PRIORITY_NORMAL, NULL, 0));
+	TEST_CHECK(event_bus_post(&bus, 3, EVENT_BUS_PRIORITY_HIGH, NULL, 0));
+	TEST_CHECK(event_bus_post(&bus, 4, EVENT_BUS_PRIORITY_HIGH, NULL, 0));
+
+	const uint16_t expected[] = { 3, 4, 1, 2 };
+	for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i)
+	{
+		TEST_CHECK(event_bus_receive(&bus, &event, 0));
+		TEST_CHECK_EQ(expected[i], event.id);
+	}
+	TEST_CHECK(!event_bus_receive(&bus, &event, 0));
+	TEST_CHECK_EQ(4, bus.received);
+	TEST_CHECK_EQ(4, bus.high_water);
+}
+
+static void test_overflow(void)
+{
+	event_bus_event_t event;
+
+	// A full priority drops and counts, the other one still takes events
+	TEST_CHECK(event_bus_post(&bus, 1, EVENT_BUS_PRIORITY_HIGH, NULL, 0));
+	TEST_CHECK(event_bus_post(&bus, 2, EVENT_BUS_PRIORITY_HIGH, NULL, 0));
+	TEST_CHECK(!event_bus_post(&bus, 3, EVENT_BUS_PRIORITY_HIGH, NULL, 0));
+	TEST_CHECK_EQ(1, atomic_load(&bus.overflows[EVENT_BUS_PRIORITY_HIGH]));
+	TEST_CHECK(event_bus_post(&bus, 4, EVENT_BUS_PRIORITY_NORMAL, NULL, 0));
+	TEST_CHECK_EQ(0, atomic_load(&bus.overflows[EVENT_BUS_PRIORITY_NORMAL]));
+
+	// Payloads too large and unknown priorities are refused the same way
+	uint8_t large[EVENT_BUS_PAYLOAD_SIZE + 1] = { 0 };
+	TEST_CHECK(!event_bus_post(&bus, 5, EVENT_BUS_PRIORITY_NORMAL, large, sizeof(large)));
+	TEST_CHECK(!event_bus_post(&bus, 6, EVENT_BUS_PRIORITY_COUNT, NULL, 0));
+	TEST_CHECK_EQ(2, atomic_load(&bus.overflows[EVENT_BUS_PRIORITY_NORMAL]));
+
+	while (event_bus_receive(&bus, &event, 0))
+	{
+	}
+	TEST_CHECK_EQ(4 + 3, bus.received);
+
+	// A bus never initialized drops everything
+	event_bus_t none = { 0 };
+	TEST_CHECK(!event_bus_post(&none, 1, EVENT_BUS_PRIORITY_NORMAL, NULL, 0));
+	TEST_CHECK(!event_bus_receive(&none, &event, 0));
+}
+
+static void test_payload(void)
+{
+	event_bus_event_t event;
+	uint8_t reason = 201;
+	int64_t out = -1;
+	uint8_t short_out[4];
+
+	TEST_CHECK(event_bus_post(&bus, 7, EVENT_BUS_PRIORITY_NORMAL, &reason, sizeof(reason)));
+	TEST_CHECK(event_bus_receive(&bus, &event, 0));
+	TEST_CHECK_EQ(sizeof(reason), event.len);
+
+	// What the poster did not send reads as zeros, a short buffer takes what fits
+	event_bus_payload(&event, &out, sizeof(out));
+	TEST_CHECK_EQ(201, out);
+	event_bus_payload(&event, short_out, 1);
+	TEST_CHECK_EQ(201, short_out[0]);
+}
+
+/**
+ * Posts one event after a delay, as an event handler would.
+ */
+static void late_poster(void *arg)
+{
+	(void)arg;
+	vTaskDelay(pdMS_TO_TICKS(20));
+	event_bus_post(&bus, 8, EVENT_BUS_PRIORITY_HIGH, NULL, 0);
+	vTaskDelete(NULL);
+}
+
+static void test_receive_waits(void)
+{
+	event_bus_event_t event;
+	BaseType_t woken;
+
+	xTaskCreatePinnedToCore(late_poster, "poster", 2048, NULL, 5, NULL, tskNO_AFFINITY);
+	TEST_CHECK(event_bus_receive(&bus, &event, pdMS_TO_TICKS(1000)));
+	TEST_CHECK_EQ(8, event.id);
+
+	TEST_CHECK(event_bus_post_from_isr(&bus, 9, EVENT_BUS_PRIORITY_NORMAL, NULL, 0, &woken));
+	TEST_CHECK(event_bus_receive(&bus, &event, 0));
+	TEST_CHECK_EQ(9, event.id);
+}
+
+int main(void)
+{
+	TEST_RUN(test_priority_order);
+	TEST_RUN(test_overflow);
+	TEST_RUN(test_payload);
+	TEST_RUN(test_receive_waits);
+	return TEST_RESULT();
+}
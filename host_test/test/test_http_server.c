@@ -0,0 +1,352 @@
+/*
+ * test_http_server.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+
+#include "host_httpd.h"
+#include "http_server.h"
+
+#include "host_test.h"
+
+#define TEST_RESPONSE_MAX			16384
+
+/**
+ * Response of a request, taken apart
+ */
+typedef struct test_response
+{
+	esp_err_t result;				///> What the handler returned
+	int status;
+	char head[1024];				///> Status line and headers
+	char body[TEST_RESPONSE_MAX];	///> Chunks put back together
+	size_t body_len;
+} test_response_t;
+
+static test_response_t response;
+
+/**
+ * Sends a request with a body to the running server and reads back its response.
+ * @param method request method.
+ * @param uri requested URI.
+ * @param headers request headers, NULL for none.
+ * @param content request body, fits in the socket buffer. The client sends nothing after it.
+ * @param content_len body bytes, 0 for none.
+ * @param out receives the response.
+ */
+static void test_send(httpd_method_t method, const char *uri, const char *headers, const void *content,
+		size_t content_len, test_response_t *out)
+{
+	static char raw[TEST_RESPONSE_MAX + 1024];
+	size_t raw_len = 0;
+	int fds[2];
+
+	memset(out, 0x00, sizeof(*out));
+	TEST_CHECK_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+	TEST_CHECK_EQ((ssize_t)content_len, write(fds[1], content, content_len));
+	shutdown(fds[1], SHUT_WR);
+	out->result = host_httpd_http_request(host_httpd_get(), fds[0], method, uri, headers);
+	close(fds[0]);
+
+	for (ssize_t n; (n = read(fds[1], raw + raw_len, sizeof(raw) - 1 - raw_len)) > 0; )
+	{
+		raw_len += n;
+	}
+	close(fds[1]);
+	raw[raw_len] = '\0';
+
+	char *body = strstr(raw, "\r\n\r\n");
+	if (body == NULL)
+	{
+		return;
+	}
+	body += 4;
+	size_t head_len = body - raw;
+	memcpy(out->head, raw, head_len < sizeof(out->head) ? head_len : sizeof(out->head) - 1);
+	out->status = atoi(raw + strlen("HTTP/1.1 "));
+
+	if (strstr(out->head, "Transfer-Encoding: chunked") == NULL)
+	{
+		out->body_len = raw + raw_len - body;
+		memcpy(out->body, body, out->body_len);
+		return;
+	}
+
+	for (char *end; ; body = end + 2)
+	{
+		size_t len = strtoul(body, &end, 16);
+		end = strstr(end, "\r\n") + 2;
+		if (len == 0)
+		{
+			break;
+		}
+		memcpy(out->body + out->body_len, end, len);
+		out->body_len += len;
+		end += len;
+	}
+	out->body[out->body_len] = '\0';
+}
+
+/**
+ * Sends a GET to the running server and reads back its response.
+ * @param uri requested URI.
+ * @param headers request headers, NULL for none.
+ * @param out receives the response.
+ */
+static void test_request(const char *uri, const char *headers, test_response_t *out)
+{
+	test_send(HTTP_GET, uri, headers, NULL, 0, out);
+}
+
+/**
+ * Gets a response header as a number.
+ * @return the value, -1 if the header is missing.
+ */
+static long test_header(const test_response_t *res, const char *name)
+{
+	char field[64];
+
+	snprintf(field, sizeof(field), "\r\n%s: ", name);
+	const char *value = strstr(res->head, field);
+	return value ? strtol(value + strlen(field), NULL, 10) : -1;
+}
+
+/**
+ * Logs lines, numbered on from the previous call, and waits until ws_print handed them
+ * to the store.
+ */
+static void test_log_lines(int count)
+{
+	static int logged = 0;
+	char last[32];
+
+	for (int i = 0; i < count; ++i)
+	{
+		esp_log_write(ESP_LOG_INFO, "test", "stored line %d\n", logged++);
+	}
+
+	snprintf(last, sizeof(last), "stored line %d\n", logged - 1);
+	for (int wait = 0; wait < 200; ++wait)
+	{
+		test_request("/logs", NULL, &response);
+		if (strstr(response.body, last))
+		{
+			return;
+		}
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+	TEST_CHECK(!"lines never reached the store");
+}
+
+static void test_logs_all(void)
+{
+	test_log_lines(5);
+
+	TEST_CHECK_EQ(ESP_OK, response.result);
+	TEST_CHECK_EQ(200, response.status);
+	TEST_CHECK_EQ(0, test_header(&response, "X-Log-Start"));
+	TEST_CHECK_EQ((long)response.body_len, test_header(&response, "X-Log-End"));
+	TEST_CHECK(strstr(response.head, "Content-Type: text/plain") != NULL);
+	TEST_CHECK(strstr(response.body, "stored line 0\n") != NULL);
+}
+
+static void test_logs_range(void)
+{
+	test_request("/logs", NULL, &response);
+	long end = test_header(&response, "X-Log-End");
+	char expected[TEST_RESPONSE_MAX];
+	memcpy(expected, response.body, response.body_len);
+	TEST_CHECK(end > 10);
+
+	test_request("/logs", "Range: bytes=0-9\r\n", &response);
+	TEST_CHECK_EQ(206, response.status);
+	TEST_CHECK_EQ(10, response.body_len);
+	TEST_CHECK_MEM(expected, response.body, 10);
+	TEST_CHECK(strstr(response.head, "Content-Range: bytes 0-9/") != NULL);
+
+	// Suffix ranges count back from the end
+	test_request("/logs", "Range: bytes=-4\r\n", &response);
+	TEST_CHECK_EQ(206, response.status);
+	TEST_CHECK_EQ(4, response.body_len);
+	TEST_CHECK_MEM(expected + end - 4, response.body, 4);
+
+	// Nothing past the end yet
+	char range[48];
+	snprintf(range, sizeof(range), "Range: bytes=%ld-\r\n", end);
+	test_request("/logs", range, &response);
+	TEST_CHECK_EQ(416, response.status);
+	TEST_CHECK_EQ(0, response.body_len);
+
+	// A client polling from its last end gets only what is new
+	test_log_lines(1);
+	test_request("/logs", range, &response);
+	TEST_CHECK_EQ(206, response.status);
+	TEST_CHECK_EQ(0, strcmp("stored line 5\n", response.body));
+	TEST_CHECK_EQ(end + (long)response.body_len, test_header(&response, "X-Log-End"));
+
+	test_request("/logs", "Range: lines=0-9\r\n", &response);
+	TEST_CHECK_EQ(400, response.status);
+	test_request("/logs", "Range: bytes=9-0\r\n", &response);
+	TEST_CHECK_EQ(400, response.status);
+}
+
+static void test_metrics(void)
+{
+	test_log_lines(1);
+
+	test_request("/metrics", NULL, &response);
+	TEST_CHECK_EQ(ESP_OK, response.result);
+	TEST_CHECK_EQ(200, response.status);
+	TEST_CHECK(strstr(response.head, "Content-Type: text/plain; version=0.0.4") != NULL);
+	TEST_CHECK_EQ((long)response.body_len, test_header(&response, "Content-Length"));
+	TEST_CHECK(strstr(response.body, "# TYPE ws_log_lines_total counter\n") != NULL);
+	TEST_CHECK(strstr(response.body, "\nws_clients 0\n") != NULL);
+	TEST_CHECK(strstr(response.body, "ws_send_latency_seconds_bucket{le=\"+Inf\"}") != NULL);
+
+	// Every line taken off the ring so far, none dropped
+	const char *lines = strstr(response.body, "\nws_log_lines_total ");
+	TEST_CHECK(lines && strtol(lines + strlen("\nws_log_lines_total "), NULL, 10) >= 1);
+	TEST_CHECK(strstr(response.body, "\nws_log_lines_dropped_total 0\n") != NULL);
+}
+
+/**
+ * Gets a /metrics sample as a number.
+ * @return the value, -1 if the sample is missing.
+ */
+static long test_metric(const char *sample)
+{
+	char line[96];
+
+	test_request("/metrics", NULL, &response);
+	snprintf(line, sizeof(line), "\n%s ", sample);
+	const char *value = strstr(response.body, line);
+	return value ? strtol(value + strlen(line), NULL, 10) : -1;
+}
+
+static void test_lifecycle(void)
+{
+	httpd_handle_t server = host_httpd_get();
+
+	TEST_CHECK_EQ(1, test_metric("http_server_starts_total"));
+	TEST_CHECK_EQ(1, test_metric("http_server_users{interface=\"ap\"}"));
+
+	// The station interface shares the running server
+	http_server_acquire(HTTP_SERVER_USER_STA);
+	for (int wait = 0; wait < 100 && test_metric("http_server_users{interface=\"sta\"}") != 1; ++wait)
+	{
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+	TEST_CHECK_EQ(1, test_metric("http_server_users{interface=\"sta\"}"));
+
+	// Without an idle delay the server outlives its last user, nothing restarts on the next join
+	http_server_release(HTTP_SERVER_USER_AP);
+	http_server_release(HTTP_SERVER_USER_STA);
+	http_server_release(HTTP_SERVER_USER_STA);
+	http_server_acquire(HTTP_SERVER_USER_AP);
+	for (int wait = 0; wait < 100 && test_metric("http_server_users{interface=\"sta\"}") != 0; ++wait)
+	{
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+	TEST_CHECK_EQ(0, test_metric("http_server_users{interface=\"sta\"}"));
+	TEST_CHECK_EQ(1, test_metric("http_server_users{interface=\"ap\"}"));
+	TEST_CHECK_EQ(1, test_metric("http_server_starts_total"));
+	TEST_CHECK_EQ(0, test_metric("http_server_stops_total"));
+	TEST_CHECK(server == host_httpd_get());
+}
+
+static void test_ota_refused(void)
+{
+	static const uint8_t image[64] = { 0x00, 0x01, 0x02 };
+
+	// Chunked uploads carry no size to check against the partition
+	test_send(HTTP_POST, "/ota", NULL, NULL, 0, &response);
+	TEST_CHECK_EQ(411, response.status);
+
+	// Something else than an app image is refused after its first buffer
+	test_send(HTTP_POST, "/ota", "Content-Length: 64\r\n", image, sizeof(image), &response);
+	TEST_CHECK_EQ(500, response.status);
+	TEST_CHECK(strstr(response.body, "ESP_ERR_OTA_VALIDATE_FAILED") != NULL);
+	TEST_CHECK_EQ(64, test_metric("ota_received_bytes"));
+
+	// A client going away before the end gets no answer, its session is closed
+	test_send(HTTP_POST, "/ota", "Content-Length: 4096\r\n", image, sizeof(image), &response);
+	TEST_CHECK_EQ(ESP_FAIL, response.result);
+	TEST_CHECK_EQ(0, response.status);
+}
+
+static void test_dashboard(void)
+{
+	char etag[64] = "";
+	char match[96];
+
+	test_request("/", NULL, &response);
+	TEST_CHECK_EQ(ESP_OK, response.result);
+	TEST_CHECK_EQ(200, response.status);
+	TEST_CHECK(strstr(response.head, "Content-Type: text/html\r\n") != NULL);
+	TEST_CHECK(strstr(response.head, "Content-Encoding: gzip\r\n") != NULL);
+	TEST_CHECK(strstr(response.head, "Cache-Control: no-cache\r\n") != NULL);
+	TEST_CHECK(response.body_len > 2 && (uint8_t)response.body[0] == 0x1F && (uint8_t)response.body[1] == 0x8B);
+
+	const char *value = strstr(response.head, "\r\nETag: ");
+	TEST_CHECK(value != NULL);
+	if (value)
+	{
+		sscanf(value + strlen("\r\nETag: "), "%63[^\r]", etag);
+	}
+
+	// The browser copy is current, nothing but the headers goes out
+	snprintf(match, sizeof(match), "If-None-Match: W/\"0\", %s\r\n", etag);
+	test_request("/", match, &response);
+	TEST_CHECK_EQ(304, response.status);
+	TEST_CHECK_EQ(0, response.body_len);
+	TEST_CHECK(strstr(response.head, etag) != NULL);
+
+	test_request("/", "If-None-Match: \"0000000000000000\"\r\n", &response);
+	TEST_CHECK_EQ(200, response.status);
+	TEST_CHECK_EQ(1, test_metric("www_not_modified_total"));
+	TEST_CHECK_EQ(3, test_metric("www_requests_total"));
+
+	// The assets the page references by version are cached for good
+	test_request("/app.js", NULL, &response);
+	TEST_CHECK_EQ(200, response.status);
+	TEST_CHECK(strstr(response.head, "immutable") != NULL);
+}
+
+static void test_unknown_uri(void)
+{
+	test_request("/nothing", NULL, &response);
+	TEST_CHECK_EQ(ESP_ERR_NOT_FOUND, response.result);
+}
+
+int main(void)
+{
+	// Same order as app_main, a station joining the SoftAP starts the server
+	log_for_websocket_setup();
+	http_server_init();
+	http_server_acquire(HTTP_SERVER_USER_AP);
+	for (int wait = 0; wait < 100 && host_httpd_get() == NULL; ++wait)
+	{
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+
+	TEST_RUN(test_logs_all);
+	TEST_RUN(test_logs_range);
+	TEST_RUN(test_metrics);
+	TEST_RUN(test_lifecycle);
+	TEST_RUN(test_ota_refused);
+	TEST_RUN(test_dashboard);
+	TEST_RUN(test_unknown_uri);
+	return TEST_RESULT();
+}
@@ -0,0 +1,108 @@
+/*
+ * test_log_bin.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "log_bin.h"
+
+#include "host_test.h"
+
+static size_t encode(uint8_t *out, size_t max, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	size_t len = log_bin_encode(out, max, 1234, format, args);
+	va_end(args);
+	return len;
+}
+
+static size_t encode_text(uint8_t *out, size_t max, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	size_t len = log_bin_encode_text(out, max, 1234, format, args);
+	va_end(args);
+	return len;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void test_header(void)
+{
+	static const char format[] = "no arguments";
+	uint8_t out[32];
+
+	size_t len = encode(out, sizeof(out), format);
+	TEST_CHECK_EQ(LOG_BIN_HEADER_SIZE, len);
+	TEST_CHECK_EQ(len - 2, out[0] | (out[1] << 8));
+	TEST_CHECK_EQ((uint32_t)(uintptr_t)format, get_u32(&out[2]));
+	TEST_CHECK_EQ(1234, get_u32(&out[6]));
+}
+
+static void test_arguments(void)
+{
+	uint8_t out[64];
+
+	size_t len = encode(out, sizeof(out), "%d %5.*s %llu %%", -2, 2, "abc", 0x1122334455667788ULL);
+	const uint8_t *p = &out[LOG_BIN_HEADER_SIZE];
+
+	// int, the '*' precision, the string with its NUL, the 64-bit value
+	TEST_CHECK_EQ(LOG_BIN_HEADER_SIZE + 4 + 4 + 4 + 8, len);
+	TEST_CHECK_EQ(0xFFFFFFFE, get_u32(&p[0]));
+	TEST_CHECK_EQ(2, get_u32(&p[4]));
+	TEST_CHECK_MEM("abc", &p[8], 4);
+	TEST_CHECK_EQ(0x55667788, get_u32(&p[12]));
+	TEST_CHECK_EQ(0x11223344, get_u32(&p[16]));
+}
+
+static void test_long_string(void)
+{
+	char str[LOG_BIN_MAX_STRING_LEN * 2];
+	uint8_t out[256];
+
+	memset(str, 'x', sizeof(str) - 1);
+	str[sizeof(str) - 1] = '\0';
+
+	size_t len = encode(out, sizeof(out), "%s", str);
+	TEST_CHECK_EQ(LOG_BIN_HEADER_SIZE + LOG_BIN_MAX_STRING_LEN + 1, len);
+	TEST_CHECK_EQ('\0', out[len - 1]);
+}
+
+static void test_refused(void)
+{
+	uint8_t out[16];
+	int n;
+
+	// Does not fit, and %n has no binary form
+	TEST_CHECK_EQ(0, encode(out, sizeof(out), "%d %d", 1, 2));
+	TEST_CHECK_EQ(0, encode(out, sizeof(out), "%n", &n));
+	TEST_CHECK_EQ(0, encode(out, LOG_BIN_HEADER_SIZE - 1, "x"));
+}
+
+static void test_text(void)
+{
+	uint8_t out[LOG_BIN_HEADER_SIZE + 8];
+
+	size_t len = encode_text(out, sizeof(out), "%s=%d", "value", 12345);
+	TEST_CHECK_EQ(sizeof(out) - 1, len);
+	TEST_CHECK_EQ(LOG_BIN_FMT_TEXT, get_u32(&out[2]));
+	TEST_CHECK_MEM("value=1", &out[LOG_BIN_HEADER_SIZE], 7);
+}
+
+int main(void)
+{
+	TEST_RUN(test_header);
+	TEST_RUN(test_arguments);
+	TEST_RUN(test_long_string);
+	TEST_RUN(test_refused);
+	TEST_RUN(test_text);
+	return TEST_RESULT();
+}
@@ -0,0 +1,103 @@
+/*
+ * test_log_history.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdint.h>
+
+#include "log_history.h"
+
+#include "host_test.h"
+
+static void test_append_read(void)
+{
+	uint8_t buff[64];
+	uint8_t out[64];
+	log_history_t history;
+	uint32_t cursor = 0;
+
+	TEST_CHECK(log_history_init(&history, buff, sizeof(buff)));
+	log_history_append(&history, "first", 5);
+	log_history_append(&history, "second", 6);
+
+	TEST_CHECK_EQ(11, log_history_read(&history, &cursor, out, sizeof(out)));
+	TEST_CHECK_MEM("firstsecond", out, 11);
+	TEST_CHECK_EQ(history.end, cursor);
+
+	// Nothing new
+	TEST_CHECK_EQ(0, log_history_read(&history, &cursor, out, sizeof(out)));
+}
+
+static void test_eviction(void)
+{
+	uint8_t buff[32];
+	uint8_t out[32];
+	log_history_t history;
+	uint32_t cursor = 0;
+
+	log_history_init(&history, buff, sizeof(buff));
+	for (char c = 'a'; c <= 'j'; ++c)
+	{
+		char record[8];
+		memset(record, c, sizeof(record));
+		log_history_append(&history, record, sizeof(record));
+	}
+
+	// 10 bytes per record, three fit, the cursor at 0 was overwritten and moves to the oldest
+	TEST_CHECK_EQ(7, history.evicted);
+	TEST_CHECK_EQ(24, log_history_read(&history, &cursor, out, sizeof(out)));
+	TEST_CHECK_EQ('h', out[0]);
+	TEST_CHECK_EQ('j', out[23]);
+}
+
+static void test_partial_read(void)
+{
+	uint8_t buff[64];
+	uint8_t out[8];
+	log_history_t history;
+	uint32_t cursor = 0;
+
+	log_history_init(&history, buff, sizeof(buff));
+	log_history_append(&history, "12345", 5);
+	log_history_append(&history, "67890", 5);
+	log_history_append(&history, "too long for out", 16);
+	log_history_append(&history, "end", 3);
+
+	// Whole records only, the one larger than out is stepped over
+	TEST_CHECK_EQ(5, log_history_read(&history, &cursor, out, sizeof(out)));
+	TEST_CHECK_EQ(5, log_history_read(&history, &cursor, out, sizeof(out)));
+	TEST_CHECK_EQ(0, log_history_read(&history, &cursor, out, sizeof(out)));
+	TEST_CHECK_EQ(3, log_history_read(&history, &cursor, out, sizeof(out)));
+	TEST_CHECK_MEM("end", out, 3);
+}
+
+static void test_position_wrap(void)
+{
+	uint8_t buff[40];
+	uint8_t out[16];
+	log_history_t history;
+
+	// Positions close to 2^32, as after a long uptime
+	log_history_init(&history, buff, sizeof(buff));
+	history.start = history.end = UINT32_MAX - 20;
+	uint32_t cursor = history.end;
+
+	for (int i = 0; i < 6; ++i)
+	{
+		log_history_append(&history, "abcdef", 6);
+	}
+	TEST_CHECK(history.end < history.start);
+	TEST_CHECK_EQ(6, log_history_read(&history, &cursor, out, 6));
+	TEST_CHECK_MEM("abcdef", out, 6);
+}
+
+int main(void)
+{
+	TEST_RUN(test_append_read);
+	TEST_RUN(test_eviction);
+	TEST_RUN(test_partial_read);
+	TEST_RUN(test_position_wrap);
+	return TEST_RESULT();
+}
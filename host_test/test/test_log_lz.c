@@ -0,0 +1,137 @@
+/*
+ * test_log_lz.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "log_lz.h"
+
+#include "host_test.h"
+
+static log_lz_t lz;
+static uint8_t window[LOG_LZ_DICT_MAX_LEN + 4096];
+static uint8_t frame[LOG_LZ_BOUND(4096)];
+static uint8_t decoded[LOG_LZ_DICT_MAX_LEN + 4096];
+
+/**
+ * Decompresses a frame the way tools/ws_log_lz.py does.
+ * @param in frame.
+ * @param len frame length.
+ * @param data receives the payload.
+ * @return payload length, or -1 if the frame is malformed.
+ */
+static int decompress(const uint8_t *in, size_t len, const uint8_t **data)
+{
+	size_t dict = log_lz_window_init(decoded);
+	size_t out = dict;
+	size_t pos = LOG_LZ_HEADER_SIZE;
+
+	if (len < LOG_LZ_HEADER_SIZE || in[0] != LOG_LZ_MAGIC || in[1] != LOG_LZ_DICT_VERSION)
+	{
+		return -1;
+	}
+	size_t end = dict + (in[2] | (in[3] << 8));
+
+	while (out < end)
+	{
+		if (pos >= len)
+		{
+			return -1;
+		}
+		uint8_t flags = in[pos++];
+
+		for (int item = 0; item < 8 && out < end; ++item)
+		{
+			if (flags & (1 << item))
+			{
+				if (pos + 2 > len)
+				{
+					return -1;
+				}
+				size_t offset = (in[pos] | ((in[pos + 1] & 0x0F) << 8)) + 1;
+				size_t match = (in[pos + 1] >> 4) + 3;
+				pos += 2;
+				if (offset > out || out + match > end)
+				{
+					return -1;
+				}
+				for (size_t i = 0; i < match; ++i, ++out)
+				{
+					decoded[out] = decoded[out - offset];
+				}
+			}
+			else
+			{
+				if (pos >= len)
+				{
+					return -1;
+				}
+				decoded[out++] = in[pos++];
+			}
+		}
+	}
+
+	*data = &decoded[dict];
+	return (int)(end - dict);
+}
+
+static void test_round_trip_logs(void)
+{
+	size_t start = log_lz_window_init(window);
+	size_t len = 0;
+
+	for (int i = 0; len < 3000; ++i)
+	{
+		len += snprintf((char *)&window[start + len], sizeof(window) - start - len,
+				"\033[0;32mI (%d) [WIFI_APP]: WIFI_EVENT_STA_CONNECTED %d\033[0m\n", 1000 + i * 7, i);
+	}
+
+	size_t out = log_lz_compress(&lz, window, len, frame, sizeof(frame));
+	const uint8_t *data;
+
+	TEST_CHECK(out > 0);
+	TEST_CHECK(out < len / 3);
+	TEST_CHECK_EQ(len, decompress(frame, out, &data));
+	TEST_CHECK_MEM(&window[start], data, len);
+}
+
+static void test_round_trip_random(void)
+{
+	size_t start = log_lz_window_init(window);
+	size_t len = 4096;
+
+	srand(1);
+	for (size_t i = 0; i < len; ++i)
+	{
+		window[start + i] = rand();
+	}
+
+	size_t out = log_lz_compress(&lz, window, len, frame, sizeof(frame));
+	const uint8_t *data;
+
+	TEST_CHECK(out > 0);
+	TEST_CHECK(out <= LOG_LZ_BOUND(len));
+	TEST_CHECK_EQ(len, decompress(frame, out, &data));
+	TEST_CHECK_MEM(&window[start], data, len);
+}
+
+static void test_small_output(void)
+{
+	size_t start = log_lz_window_init(window);
+
+	memset(&window[start], 'a', 100);
+	TEST_CHECK_EQ(0, log_lz_compress(&lz, window, 100, frame, LOG_LZ_HEADER_SIZE - 1));
+	TEST_CHECK_EQ(0, log_lz_compress(&lz, window, 100, frame, LOG_LZ_HEADER_SIZE + 2));
+}
+
+int main(void)
+{
+	TEST_RUN(test_round_trip_logs);
+	TEST_RUN(test_round_trip_random);
+	TEST_RUN(test_small_output);
+	return TEST_RESULT();
+}
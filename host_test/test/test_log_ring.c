@@ -0,0 +1,278 @@
+/*
+ * test_log_ring.c
+ *
+ *  Created on: Jun 03, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "log_ring.h"
+
+#include "host_test.h"
+
+// Records each stress producer writes
+#define STRESS_RECORDS			200000
+#define STRESS_PRODUCERS		4
+
+static uint8_t buff[1024] __attribute__((aligned(4)));
+
+static void put(log_ring_t *ring, const char *text, size_t max_len)
+{
+	char *payload = log_ring_reserve(ring, max_len);
+
+	TEST_CHECK(payload != NULL);
+	if (payload)
+	{
+		memcpy(payload, text, strlen(text));
+		log_ring_commit(ring, payload, strlen(text));
+	}
+}
+
+static void expect(log_ring_t *ring, const char *text)
+{
+	size_t len = 0;
+	const char *payload = log_ring_peek(ring, &len);
+
+	TEST_CHECK(payload != NULL);
+	if (payload)
+	{
+		TEST_CHECK_EQ(strlen(text), len);
+		TEST_CHECK_MEM(text, payload, len);
+		log_ring_release(ring);
+	}
+}
+
+static void test_init(void)
+{
+	log_ring_t ring;
+
+	TEST_CHECK(!log_ring_init(&ring, buff, 1000));
+	TEST_CHECK(!log_ring_init(&ring, buff + 1, 512));
+	TEST_CHECK(!log_ring_init(&ring, NULL, 512));
+	TEST_CHECK(log_ring_init(&ring, buff, sizeof(buff)));
+	TEST_CHECK(log_ring_reserve(&ring, LOG_RING_MAX_RECORD_LEN + 1) == NULL);
+}
+
+static void test_fifo(void)
+{
+	log_ring_t ring;
+	size_t len;
+
+	log_ring_init(&ring, buff, sizeof(buff));
+	TEST_CHECK(log_ring_peek(&ring, &len) == NULL);
+
+	put(&ring, "one", 255);
+	put(&ring, "two", 255);
+	expect(&ring, "one");
+	expect(&ring, "two");
+	TEST_CHECK(log_ring_peek(&ring, &len) == NULL);
+	TEST_CHECK_EQ(0, log_ring_used(&ring));
+	TEST_CHECK_EQ(2, ring.consumed);
+}
+
+static void test_give_back_newest(void)
+{
+	log_ring_t ring;
+
+	log_ring_init(&ring, buff, sizeof(buff));
+
+	// Only header and payload, rounded up to 4 bytes, stay in use
+	put(&ring, "0123456789", 255);
+	TEST_CHECK_EQ(16, log_ring_used(&ring));
+	put(&ring, "x", 255);
+	TEST_CHECK_EQ(24, log_ring_used(&ring));
+
+	expect(&ring, "0123456789");
+	expect(&ring, "x");
+	TEST_CHECK_EQ(0, log_ring_used(&ring));
+}
+
+static void test_give_back_behind(void)
+{
+	log_ring_t ring;
+
+	log_ring_init(&ring, buff, sizeof(buff));
+
+	// The first record is committed after the second one was reserved, it leaves a skip record
+	char *first = log_ring_reserve(&ring, 255);
+	char *second = log_ring_reserve(&ring, 255);
+	memcpy(first, "first", 5);
+	log_ring_commit(&ring, first, 5);
+	TEST_CHECK_EQ(2 * 260, log_ring_used(&ring));
+
+	memcpy(second, "second", 6);
+	log_ring_commit(&ring, second, 6);
+	TEST_CHECK_EQ(260 + 12, log_ring_used(&ring));
+
+	expect(&ring, "first");
+	expect(&ring, "second");
+	TEST_CHECK_EQ(0, log_ring_used(&ring));
+
+	// The skipped bytes were zeroed, a new record over them starts out busy
+	for (size_t i = 0; i < sizeof(buff); ++i)
+	{
+		TEST_CHECK_EQ(0, buff[i]);
+		if (buff[i])
+		{
+			break;
+		}
+	}
+}
+
+static void test_discard(void)
+{
+	log_ring_t ring;
+
+	log_ring_init(&ring, buff, sizeof(buff));
+
+	char *payload = log_ring_reserve(&ring, 255);
+	log_ring_discard(&ring, payload);
+	TEST_CHECK_EQ(0, log_ring_used(&ring));
+
+	// Not the newest one, the consumer steps over it
+	char *first = log_ring_reserve(&ring, 255);
+	put(&ring, "kept", 255);
+	log_ring_discard(&ring, first);
+	expect(&ring, "kept");
+	TEST_CHECK_EQ(0, log_ring_used(&ring));
+}
+
+static void test_full_and_wrap(void)
+{
+	log_ring_t ring;
+	char text[64];
+	uint32_t written = 0;
+	uint32_t read = 0;
+
+	log_ring_init(&ring, buff, sizeof(buff));
+
+	// Records of every length go round the ring many times, padding at the end as needed
+	for (int round = 0; round < 2000; ++round)
+	{
+		while (1)
+		{
+			size_t len = 1 + written % 50;
+			char *payload = log_ring_reserve(&ring, 60);
+			if (payload == NULL)
+			{
+				break;
+			}
+			snprintf(text, sizeof(text), "%u:%0*d", written, (int)len, 0);
+			memcpy(payload, text, strlen(text));
+			log_ring_commit(&ring, payload, strlen(text));
+			written++;
+		}
+
+		for (int n = 0; n < 3 + round % 5; ++n)
+		{
+			size_t len = 1 + read % 50;
+			snprintf(text, sizeof(text), "%u:%0*d", read, (int)len, 0);
+			expect(&ring, text);
+			read++;
+		}
+	}
+
+	TEST_CHECK(ring.dropped > 0);
+	TEST_CHECK(ring.high_water <= sizeof(buff));
+	while (read < written)
+	{
+		size_t len = 1 + read % 50;
+		snprintf(text, sizeof(text), "%u:%0*d", read, (int)len, 0);
+		expect(&ring, text);
+		read++;
+	}
+	TEST_CHECK_EQ(0, log_ring_used(&ring));
+}
+
+static log_ring_t stress_ring;
+static uint8_t stress_buff[4096] __attribute__((aligned(4)));
+
+static void *stress_producer(void *arg)
+{
+	uint32_t id = (uint32_t)(uintptr_t)arg;
+
+	for (uint32_t seq = 0; seq < STRESS_RECORDS; ++seq)
+	{
+		// Reserve the worst case, use a length that depends on the record
+		uint32_t *payload = log_ring_reserve(&stress_ring, 64);
+		if (payload)
+		{
+			size_t words = 2 + (seq + id) % 14;
+			payload[0] = id;
+			payload[1] = seq;
+			for (size_t i = 2; i < words; ++i)
+			{
+				payload[i] = id ^ seq ^ i;
+			}
+			log_ring_commit(&stress_ring, payload, words * sizeof(uint32_t));
+		}
+	}
+	return NULL;
+}
+
+static void test_concurrent_producers(void)
+{
+	pthread_t threads[STRESS_PRODUCERS];
+	int64_t next[STRESS_PRODUCERS] = { 0 };
+	uint32_t received = 0;
+	uint32_t bad = 0;
+
+	log_ring_init(&stress_ring, stress_buff, sizeof(stress_buff));
+	for (uintptr_t i = 0; i < STRESS_PRODUCERS; ++i)
+	{
+		pthread_create(&threads[i], NULL, stress_producer, (void *)i);
+	}
+
+	// Every record arrives whole and in order per producer, the missing ones were counted as dropped
+	while (received + stress_ring.dropped < STRESS_PRODUCERS * STRESS_RECORDS)
+	{
+		size_t len;
+		const uint32_t *payload = log_ring_peek(&stress_ring, &len);
+		if (payload == NULL)
+		{
+			continue;
+		}
+
+		uint32_t id = payload[0];
+		uint32_t seq = payload[1];
+		if (id >= STRESS_PRODUCERS || seq < next[id] || len != (2 + (seq + id) % 14) * sizeof(uint32_t))
+		{
+			bad++;
+		}
+		else
+		{
+			for (size_t i = 2; i < len / sizeof(uint32_t); ++i)
+			{
+				bad += payload[i] != (id ^ seq ^ i);
+			}
+			next[id] = seq + 1;
+		}
+		received++;
+		log_ring_release(&stress_ring);
+	}
+
+	for (int i = 0; i < STRESS_PRODUCERS; ++i)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	size_t len;
+	TEST_CHECK_EQ(0, bad);
+	TEST_CHECK(log_ring_peek(&stress_ring, &len) == NULL);
+	TEST_CHECK_EQ(0, log_ring_used(&stress_ring));
+	TEST_CHECK_EQ(STRESS_PRODUCERS * STRESS_RECORDS, received + stress_ring.dropped);
+}
+
+int main(void)
+{
+	TEST_RUN(test_init);
+	TEST_RUN(test_fifo);
+	TEST_RUN(test_give_back_newest);
+	TEST_RUN(test_give_back_behind);
+	TEST_RUN(test_discard);
+	TEST_RUN(test_full_and_wrap);
+	TEST_RUN(test_concurrent_producers);
+	return TEST_RESULT();
+}
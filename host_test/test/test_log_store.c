@@ -0,0 +1,342 @@
+/*
+ * test_log_store.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "log_store.h"
+
+#include "host_test.h"
+
+#define TEST_SECTORS				4
+#define TEST_BATCH					512
+
+/**
+ * Flash stand-in backed by a temporary file. Writes behave like NOR flash, they can only
+ * clear bits, and a write budget cuts a write short the way a reset would.
+ */
+typedef struct test_flash
+{
+	FILE *file;
+	uint32_t set_bits;				///> Writes that tried to turn a 0 back into a 1
+	int32_t budget;					///> Bytes left before writes fail, -1 for no limit
+} test_flash_t;
+
+static esp_err_t test_flash_read(void *ctx, uint32_t addr, void *dst, size_t len)
+{
+	test_flash_t *flash = ctx;
+
+	if (fseek(flash->file, addr, SEEK_SET) != 0 || fread(dst, 1, len, flash->file) != len)
+	{
+		return ESP_FAIL;
+	}
+	return ESP_OK;
+}
+
+static esp_err_t test_flash_write(void *ctx, uint32_t addr, const void *src, size_t len)
+{
+	test_flash_t *flash = ctx;
+	const uint8_t *bytes = src;
+	uint8_t old[LOG_STORE_SECTOR_SIZE];
+	esp_err_t err = ESP_OK;
+
+	if (flash->budget >= 0 && len > (size_t)flash->budget)
+	{
+		len = flash->budget;
+		err = ESP_FAIL;
+	}
+	if (flash->budget >= 0)
+	{
+		flash->budget -= len;
+	}
+
+	if (test_flash_read(ctx, addr, old, len) != ESP_OK)
+	{
+		return ESP_FAIL;
+	}
+	for (size_t i = 0; i < len; ++i)
+	{
+		if (bytes[i] & ~old[i])
+		{
+			flash->set_bits++;
+		}
+		old[i] &= bytes[i];
+	}
+
+	if (fseek(flash->file, addr, SEEK_SET) != 0 || fwrite(old, 1, len, flash->file) != len)
+	{
+		return ESP_FAIL;
+	}
+	return err;
+}
+
+static esp_err_t test_flash_erase(void *ctx, uint32_t addr, size_t len)
+{
+	test_flash_t *flash = ctx;
+	uint8_t erased[LOG_STORE_SECTOR_SIZE];
+
+	memset(erased, 0xFF, sizeof(erased));
+	for (size_t done = 0; done < len; done += sizeof(erased))
+	{
+		if (fseek(flash->file, addr + done, SEEK_SET) != 0 || fwrite(erased, 1, sizeof(erased), flash->file) != sizeof(erased))
+		{
+			return ESP_FAIL;
+		}
+	}
+	return ESP_OK;
+}
+
+/**
+ * Creates an erased flash file.
+ * @param flash stand-in to open.
+ * @param access receives the log_store access to it.
+ */
+static void test_flash_open(test_flash_t *flash, log_store_flash_t *access)
+{
+	memset(flash, 0x00, sizeof(test_flash_t));
+	flash->file = tmpfile();
+	flash->budget = -1;
+
+	access->read = test_flash_read;
+	access->write = test_flash_write;
+	access->erase = test_flash_erase;
+	access->ctx = flash;
+	access->size = TEST_SECTORS * LOG_STORE_SECTOR_SIZE;
+
+	test_flash_erase(flash, 0, access->size);
+}
+
+static void test_flash_close(test_flash_t *flash)
+{
+	TEST_CHECK_EQ(0, flash->set_bits);
+	fclose(flash->file);
+}
+
+/**
+ * Byte of the test stream at an offset, a prime period so segments do not line up with it.
+ */
+static uint8_t pattern(uint32_t offset)
+{
+	return (uint8_t)(offset % 251);
+}
+
+static void append_pattern(log_store_t *store, size_t len)
+{
+	uint8_t data[300];
+
+	while (len)
+	{
+		size_t n = (len < sizeof(data)) ? len : sizeof(data);
+		uint32_t end = log_store_end(store);
+		for (size_t i = 0; i < n; ++i)
+		{
+			data[i] = pattern(end + i);
+		}
+		TEST_CHECK_EQ(ESP_OK, log_store_append(store, data, n));
+		len -= n;
+	}
+}
+
+static void expect_pattern(const log_store_t *store, uint32_t from, uint32_t to)
+{
+	uint8_t out[700];
+
+	while (from < to)
+	{
+		size_t n = log_store_read(store, from, out, sizeof(out));
+		TEST_CHECK(n > 0);
+		if (n == 0)
+		{
+			return;
+		}
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (out[i] != pattern(from + i))
+			{
+				TEST_CHECK_EQ(pattern(from + i), out[i]);
+				return;
+			}
+		}
+		from += n;
+	}
+	TEST_CHECK_EQ(to, from);
+}
+
+static void test_format_and_read(void)
+{
+	test_flash_t flash;
+	log_store_flash_t access;
+	log_store_t store;
+	uint8_t batch[TEST_BATCH];
+	char out[16];
+
+	test_flash_open(&flash, &access);
+	TEST_CHECK_EQ(ESP_OK, log_store_mount(&store, &access, batch, sizeof(batch)));
+	TEST_CHECK_EQ(0, log_store_start(&store));
+	TEST_CHECK_EQ(0, log_store_end(&store));
+
+	// Read back from the RAM batch, then from flash
+	TEST_CHECK_EQ(ESP_OK, log_store_append(&store, "hello", 5));
+	TEST_CHECK_EQ(0, store.chunks_written);
+	TEST_CHECK_EQ(5, log_store_read(&store, 0, out, sizeof(out)));
+	TEST_CHECK_MEM("hello", out, 5);
+
+	TEST_CHECK_EQ(ESP_OK, log_store_flush(&store));
+	TEST_CHECK_EQ(1, store.chunks_written);
+	TEST_CHECK_EQ(3, log_store_read(&store, 2, out, sizeof(out)));
+	TEST_CHECK_MEM("llo", out, 3);
+	TEST_CHECK_EQ(0, log_store_read(&store, 5, out, sizeof(out)));
+
+	test_flash_close(&flash);
+}
+
+static void test_batching(void)
+{
+	test_flash_t flash;
+	log_store_flash_t access;
+	log_store_t store;
+	uint8_t batch[TEST_BATCH];
+
+	test_flash_open(&flash, &access);
+	log_store_mount(&store, &access, batch, sizeof(batch));
+
+	// Only full batches reach the flash
+	append_pattern(&store, 3 * TEST_BATCH + 100);
+	TEST_CHECK_EQ(3, store.chunks_written);
+	TEST_CHECK_EQ(100, store.batch_len);
+	expect_pattern(&store, 0, log_store_end(&store));
+
+	test_flash_close(&flash);
+}
+
+static void test_remount(void)
+{
+	test_flash_t flash;
+	log_store_flash_t access;
+	log_store_t store;
+	uint8_t batch[TEST_BATCH];
+
+	test_flash_open(&flash, &access);
+	log_store_mount(&store, &access, batch, sizeof(batch));
+	append_pattern(&store, 5000);
+	log_store_flush(&store);
+
+	// A reboot finds everything and appends after it
+	TEST_CHECK_EQ(ESP_OK, log_store_mount(&store, &access, batch, sizeof(batch)));
+	TEST_CHECK_EQ(0, log_store_start(&store));
+	TEST_CHECK_EQ(5000, log_store_end(&store));
+	TEST_CHECK_EQ(0, store.corrupt_chunks);
+
+	append_pattern(&store, 1000);
+	log_store_flush(&store);
+	log_store_mount(&store, &access, batch, sizeof(batch));
+	TEST_CHECK_EQ(6000, log_store_end(&store));
+	expect_pattern(&store, 0, 6000);
+
+	// Lines still in the batch at a reset are lost, nothing else
+	append_pattern(&store, 10);
+	log_store_mount(&store, &access, batch, sizeof(batch));
+	TEST_CHECK_EQ(6000, log_store_end(&store));
+
+	test_flash_close(&flash);
+}
+
+static void test_wrap(void)
+{
+	test_flash_t flash;
+	log_store_flash_t access;
+	log_store_t store;
+	uint8_t batch[TEST_BATCH];
+
+	test_flash_open(&flash, &access);
+	log_store_mount(&store, &access, batch, sizeof(batch));
+
+	// Ten times the partition, every sector is erased again and again in ring order
+	append_pattern(&store, 10 * TEST_SECTORS * LOG_STORE_SECTOR_SIZE);
+	log_store_flush(&store);
+
+	uint32_t start = log_store_start(&store);
+	uint32_t end = log_store_end(&store);
+	TEST_CHECK(start > 0);
+	TEST_CHECK(end - start > (TEST_SECTORS - 1) * (LOG_STORE_SECTOR_SIZE - 64));
+	TEST_CHECK(end - start <= TEST_SECTORS * LOG_STORE_SECTOR_SIZE);
+	TEST_CHECK(store.erases > 10 * TEST_SECTORS);
+	expect_pattern(&store, start, end);
+
+	// The oldest byte gone is not returned
+	uint8_t out[4];
+	TEST_CHECK_EQ(0, log_store_read(&store, start - 1, out, 1));
+
+	log_store_mount(&store, &access, batch, sizeof(batch));
+	TEST_CHECK_EQ(start, log_store_start(&store));
+	TEST_CHECK_EQ(end, log_store_end(&store));
+	expect_pattern(&store, start, end);
+
+	test_flash_close(&flash);
+}
+
+static void test_torn_chunk(void)
+{
+	test_flash_t flash;
+	log_store_flash_t access;
+	log_store_t store;
+	uint8_t batch[TEST_BATCH];
+
+	test_flash_open(&flash, &access);
+	log_store_mount(&store, &access, batch, sizeof(batch));
+	append_pattern(&store, 1000);
+	log_store_flush(&store);
+
+	// The reset hits in the middle of the next chunk data
+	append_pattern(&store, 300);
+	flash.budget = 8 + 100;
+	TEST_CHECK_EQ(ESP_FAIL, log_store_flush(&store));
+	flash.budget = -1;
+
+	TEST_CHECK_EQ(ESP_OK, log_store_mount(&store, &access, batch, sizeof(batch)));
+	TEST_CHECK_EQ(1000, log_store_end(&store));
+	TEST_CHECK_EQ(1, store.corrupt_chunks);
+	expect_pattern(&store, 0, 1000);
+
+	// Appends continue in a fresh segment, the torn bits are never written over
+	append_pattern(&store, 700);
+	log_store_flush(&store);
+	TEST_CHECK_EQ(1, store.head);
+	log_store_mount(&store, &access, batch, sizeof(batch));
+	TEST_CHECK_EQ(1700, log_store_end(&store));
+	expect_pattern(&store, 0, 1700);
+
+	test_flash_close(&flash);
+}
+
+static void test_bad_sizes(void)
+{
+	test_flash_t flash;
+	log_store_flash_t access;
+	log_store_t store;
+	uint8_t batch[LOG_STORE_SECTOR_SIZE];
+
+	test_flash_open(&flash, &access);
+	TEST_CHECK_EQ(ESP_ERR_INVALID_SIZE, log_store_mount(&store, &access, batch, 0));
+	TEST_CHECK_EQ(ESP_ERR_INVALID_SIZE, log_store_mount(&store, &access, batch, sizeof(batch)));
+
+	access.size = LOG_STORE_SECTOR_SIZE;
+	TEST_CHECK_EQ(ESP_ERR_INVALID_SIZE, log_store_mount(&store, &access, batch, TEST_BATCH));
+
+	test_flash_close(&flash);
+}
+
+int main(void)
+{
+	TEST_RUN(test_format_and_read);
+	TEST_RUN(test_batching);
+	TEST_RUN(test_remount);
+	TEST_RUN(test_wrap);
+	TEST_RUN(test_torn_chunk);
+	TEST_RUN(test_bad_sizes);
+	return TEST_RESULT();
+}
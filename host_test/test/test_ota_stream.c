@@ -0,0 +1,224 @@
+/*
+ * test_ota_stream.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+
+#include "ota_stream.h"
+
+#include "host_test.h"
+
+#define TEST_IMAGE_MAX			(4 * OTA_STREAM_BUFFER_SIZE)
+
+/**
+ * Sink keeping the image in RAM, failing on request
+ */
+typedef struct test_sink
+{
+	uint8_t image[TEST_IMAGE_MAX];
+	size_t size;
+	size_t written;
+	uint32_t writes;
+	uint32_t fail_write;			///> Write that fails, 0 for none
+	bool finished;
+	bool aborted;
+} test_sink_t;
+
+static test_sink_t ram;
+static ota_sink_t sink;
+static ota_stream_t stream;
+static uint8_t image[TEST_IMAGE_MAX];
+
+static esp_err_t test_sink_begin(void *ctx, size_t size)
+{
+	test_sink_t *state = ctx;
+
+	state->size = size;
+	return size <= sizeof(state->image) ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+static esp_err_t test_sink_write(void *ctx, const void *data, size_t len)
+{
+	test_sink_t *state = ctx;
+
+	if (++state->writes == state->fail_write)
+	{
+		return ESP_ERR_INVALID_CRC;
+	}
+	memcpy(state->image + state->written, data, len);
+	state->written += len;
+	return ESP_OK;
+}
+
+static esp_err_t test_sink_finish(void *ctx)
+{
+	((test_sink_t *)ctx)->finished = true;
+	return ESP_OK;
+}
+
+static void test_sink_abort(void *ctx)
+{
+	((test_sink_t *)ctx)->aborted = true;
+}
+
+/**
+ * Sets up the RAM sink for a new upload.
+ * @param fail_write write that fails, 0 for none.
+ */
+static void test_sink_reset(uint32_t fail_write)
+{
+	memset(&ram, 0x00, sizeof(ram));
+	ram.fail_write = fail_write;
+	sink = (ota_sink_t){ test_sink_begin, test_sink_write, test_sink_finish, test_sink_abort, &ram };
+}
+
+/**
+ * Receives an image into the stream in steps, as httpd_req_recv hands it in.
+ * @param len image bytes to send.
+ * @param step most bytes per receive.
+ * @return ESP_OK, or the error that stopped the upload.
+ */
+static esp_err_t test_upload(size_t len, size_t step)
+{
+	size_t sent = 0;
+
+	while (sent < len)
+	{
+		size_t room;
+		uint8_t *buf = ota_stream_buffer(&stream, &room);
+		if (buf == NULL)
+		{
+			return atomic_load(&stream.err);
+		}
+
+		size_t chunk = len - sent < step ? len - sent : step;
+		chunk = chunk < room ? chunk : room;
+		memcpy(buf, image + sent, chunk);
+		sent += chunk;
+
+		esp_err_t err = ota_stream_commit(&stream, chunk);
+		if (err != ESP_OK)
+		{
+			return err;
+		}
+	}
+	return ESP_OK;
+}
+
+static void test_whole_buffers(void)
+{
+	test_sink_reset(0);
+	TEST_CHECK_EQ(ESP_OK, ota_stream_begin(&stream, &sink, 2 * OTA_STREAM_BUFFER_SIZE));
+	TEST_CHECK_EQ(ESP_OK, test_upload(2 * OTA_STREAM_BUFFER_SIZE, 1460));
+	TEST_CHECK_EQ(ESP_OK, ota_stream_finish(&stream));
+
+	// One write per buffer, nothing left over for the finish
+	TEST_CHECK_EQ(2, ram.writes);
+	TEST_CHECK_EQ(2 * OTA_STREAM_BUFFER_SIZE, stream.stats.written);
+	TEST_CHECK_EQ(2 * OTA_STREAM_BUFFER_SIZE, stream.stats.received);
+	TEST_CHECK_MEM(image, ram.image, 2 * OTA_STREAM_BUFFER_SIZE);
+	TEST_CHECK(ram.finished && !ram.aborted);
+}
+
+static void test_partial_buffer(void)
+{
+	size_t len = 3 * OTA_STREAM_BUFFER_SIZE + 123;
+
+	test_sink_reset(0);
+	TEST_CHECK_EQ(ESP_OK, ota_stream_begin(&stream, &sink, len));
+	TEST_CHECK_EQ(ESP_OK, test_upload(len, 1000));
+	TEST_CHECK_EQ(ESP_OK, ota_stream_finish(&stream));
+
+	// The last buffer goes out short when the upload finishes
+	TEST_CHECK_EQ(4, ram.writes);
+	TEST_CHECK_EQ(len, ram.written);
+	TEST_CHECK_MEM(image, ram.image, len);
+	TEST_CHECK(ram.finished);
+}
+
+static void test_sink_error(void)
+{
+	test_sink_reset(2);
+	TEST_CHECK_EQ(ESP_OK, ota_stream_begin(&stream, &sink, TEST_IMAGE_MAX));
+
+	// The receiver learns of the failure at a later commit or buffer, never blocks on it
+	TEST_CHECK_EQ(ESP_ERR_INVALID_CRC, test_upload(TEST_IMAGE_MAX, OTA_STREAM_BUFFER_SIZE));
+	TEST_CHECK_EQ(ESP_ERR_INVALID_CRC, ota_stream_finish(&stream));
+	TEST_CHECK(!ram.finished && ram.aborted);
+	TEST_CHECK_EQ(OTA_STREAM_BUFFER_SIZE, stream.stats.written);
+}
+
+static void test_truncated(void)
+{
+	// Fewer bytes than announced fail the finish, a broken off upload aborts
+	test_sink_reset(0);
+	TEST_CHECK_EQ(ESP_OK, ota_stream_begin(&stream, &sink, 2 * OTA_STREAM_BUFFER_SIZE));
+	TEST_CHECK_EQ(ESP_OK, test_upload(OTA_STREAM_BUFFER_SIZE + 10, 1460));
+	TEST_CHECK_EQ(ESP_ERR_INVALID_SIZE, ota_stream_finish(&stream));
+	TEST_CHECK(!ram.finished && ram.aborted);
+
+	test_sink_reset(0);
+	TEST_CHECK_EQ(ESP_OK, ota_stream_begin(&stream, &sink, 2 * OTA_STREAM_BUFFER_SIZE));
+	TEST_CHECK_EQ(ESP_OK, test_upload(10, 10));
+	TEST_CHECK_EQ(ESP_FAIL, ota_stream_abort(&stream));
+	TEST_CHECK(ram.aborted);
+
+	// The sink refusing the size fails the begin
+	test_sink_reset(0);
+	TEST_CHECK_EQ(ESP_ERR_INVALID_SIZE, ota_stream_begin(&stream, &sink, TEST_IMAGE_MAX + 1));
+}
+
+static void test_partition_sink(void)
+{
+	ota_sink_partition_t state;
+	uint8_t flashed[TEST_IMAGE_MAX];
+	size_t len = 2 * OTA_STREAM_BUFFER_SIZE + 700;
+
+	ota_sink_partition(&sink, &state);
+	TEST_CHECK_EQ(ESP_OK, ota_stream_begin(&stream, &sink, len));
+	TEST_CHECK_EQ(ESP_OK, test_upload(len, 1460));
+	TEST_CHECK_EQ(ESP_OK, ota_stream_finish(&stream));
+
+	// The image lands in the partition not running, which boots next
+	const esp_partition_t *next = esp_ota_get_next_update_partition(NULL);
+	TEST_CHECK(state.partition == next);
+	TEST_CHECK(esp_ota_get_boot_partition() == next);
+	TEST_CHECK_EQ(ESP_OK, esp_partition_read(next, 0, flashed, len));
+	TEST_CHECK_MEM(image, flashed, len);
+
+	// Something else than an app image is refused by its first write
+	image[0] = 0x00;
+	ota_sink_partition(&sink, &state);
+	TEST_CHECK_EQ(ESP_OK, ota_stream_begin(&stream, &sink, len));
+	TEST_CHECK_EQ(ESP_ERR_OTA_VALIDATE_FAILED, test_upload(len, OTA_STREAM_BUFFER_SIZE));
+	TEST_CHECK_EQ(ESP_ERR_OTA_VALIDATE_FAILED, ota_stream_finish(&stream));
+	image[0] = ESP_IMAGE_HEADER_MAGIC;
+
+	// Larger than the partition
+	ota_sink_partition(&sink, &state);
+	TEST_CHECK_EQ(ESP_ERR_INVALID_SIZE, ota_stream_begin(&stream, &sink, next->size + 1));
+}
+
+int main(void)
+{
+	for (size_t i = 0; i < sizeof(image); ++i)
+	{
+		image[i] = (uint8_t)(i * 7 + (i >> 8));
+	}
+	image[0] = ESP_IMAGE_HEADER_MAGIC;
+
+	TEST_RUN(test_whole_buffers);
+	TEST_RUN(test_partial_buffer);
+	TEST_RUN(test_sink_error);
+	TEST_RUN(test_truncated);
+	TEST_RUN(test_partition_sink);
+	return TEST_RESULT();
+}
@@ -0,0 +1,348 @@
+/*
+ * test_ota_ws.c
+ *
+ *  Created on: Jun 03, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdint.h>
+
+#include "esp_crc.h"
+
+#include "ota_ws.h"
+
+#include "host_test.h"
+
+#define TEST_IMAGE_SIZE				20000
+#define TEST_CHUNK					1000
+
+/**
+ * Stand-in for the OTA partition: keeps the image in RAM and counts the calls
+ */
+typedef struct test_sink
+{
+	uint8_t image[TEST_IMAGE_SIZE];
+	size_t size;
+	size_t written;
+	uint32_t begins;
+	uint32_t finishes;
+	uint32_t aborts;
+	int32_t fail_after;				///> Bytes accepted before writes fail, -1 never
+} test_sink_t;
+
+static test_sink_t sink_state;
+static uint8_t image[TEST_IMAGE_SIZE];
+
+static esp_err_t test_sink_begin(void *ctx, size_t size)
+{
+	test_sink_t *sink = ctx;
+
+	sink->size = size;
+	sink->written = 0;
+	sink->begins++;
+	return ESP_OK;
+}
+
+static esp_err_t test_sink_write(void *ctx, const void *data, size_t len)
+{
+	test_sink_t *sink = ctx;
+
+	if (sink->fail_after >= 0 && sink->written + len > (size_t)sink->fail_after)
+	{
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (sink->written + len > sink->size)
+	{
+		return ESP_ERR_INVALID_SIZE;
+	}
+	memcpy(&sink->image[sink->written], data, len);
+	sink->written += len;
+	return ESP_OK;
+}
+
+static esp_err_t test_sink_finish(void *ctx)
+{
+	test_sink_t *sink = ctx;
+
+	sink->finishes++;
+	return ESP_OK;
+}
+
+static void test_sink_abort(void *ctx)
+{
+	test_sink_t *sink = ctx;
+
+	sink->aborts++;
+}
+
+static const ota_sink_t sink = {
+	.begin = test_sink_begin,
+	.write = test_sink_write,
+	.finish = test_sink_finish,
+	.abort = test_sink_abort,
+	.ctx = &sink_state,
+};
+
+static void setup(ota_ws_t *ota)
+{
+	memset(ota, 0x00, sizeof(ota_ws_t));
+	memset(&sink_state, 0x00, sizeof(sink_state));
+	sink_state.fail_after = -1;
+
+	for (size_t i = 0; i < sizeof(image); ++i)
+	{
+		image[i] = (uint8_t)(i * 2654435761U >> 24);
+	}
+}
+
+static void put_u32(uint8_t *out, uint32_t value)
+{
+	out[0] = value;
+	out[1] = value >> 8;
+	out[2] = value >> 16;
+	out[3] = value >> 24;
+}
+
+/**
+ * Builds the frame of a chunk as a sender would.
+ * @param frame receives the frame, room for a header and TEST_CHUNK bytes.
+ * @param seq chunk number, its offset is seq * TEST_CHUNK.
+ * @return frame length.
+ */
+static size_t make_frame(uint8_t *frame, uint32_t seq)
+{
+	uint32_t offset = seq * TEST_CHUNK;
+	size_t len = (TEST_IMAGE_SIZE - offset < TEST_CHUNK) ? TEST_IMAGE_SIZE - offset : TEST_CHUNK;
+
+	put_u32(frame, OTA_WS_MAGIC);
+	put_u32(frame + 4, seq);
+	put_u32(frame + 8, offset);
+	put_u32(frame + 12, esp_crc32_le(0, image, offset + len));
+	memcpy(frame + sizeof(ota_ws_header_t), &image[offset], len);
+	return sizeof(ota_ws_header_t) + len;
+}
+
+static ota_ws_result_e send_chunk(ota_ws_t *ota, uint32_t seq)
+{
+	uint8_t frame[sizeof(ota_ws_header_t) + TEST_CHUNK];
+	size_t len = make_frame(frame, seq);
+
+	return ota_ws_feed(ota, frame, len, 0, len);
+}
+
+static void test_whole_upload(void)
+{
+	ota_ws_t ota;
+	bool resumed = true;
+
+	setup(&ota);
+	TEST_CHECK_EQ(ESP_OK, ota_ws_begin(&ota, &sink, TEST_IMAGE_SIZE, esp_crc32_le(0, image, TEST_IMAGE_SIZE), &resumed));
+	TEST_CHECK(!resumed);
+	TEST_CHECK_EQ(1, sink_state.begins);
+
+	// Acked every OTA_WS_ACK_EVERY chunks and on the last one
+	for (uint32_t seq = 0; seq < TEST_IMAGE_SIZE / TEST_CHUNK; ++seq)
+	{
+		ota_ws_result_e expected = ((seq + 1) % OTA_WS_ACK_EVERY == 0 || seq + 1 == TEST_IMAGE_SIZE / TEST_CHUNK) ?
+				OTA_WS_ACK : OTA_WS_ACCEPTED;
+		TEST_CHECK_EQ(expected, send_chunk(&ota, seq));
+	}
+
+	TEST_CHECK_EQ(ESP_OK, ota_ws_end(&ota));
+	TEST_CHECK_EQ(1, sink_state.finishes);
+	TEST_CHECK_EQ(0, sink_state.aborts);
+	TEST_CHECK_EQ(TEST_IMAGE_SIZE, sink_state.written);
+	TEST_CHECK_MEM(image, sink_state.image, TEST_IMAGE_SIZE);
+	TEST_CHECK_EQ(TEST_IMAGE_SIZE / TEST_CHUNK, ota.stats.chunks);
+}
+
+static void test_frame_in_pieces(void)
+{
+	ota_ws_t ota;
+	bool resumed;
+	uint8_t frame[sizeof(ota_ws_header_t) + TEST_CHUNK];
+
+	setup(&ota);
+	ota_ws_begin(&ota, &sink, TEST_IMAGE_SIZE, esp_crc32_le(0, image, TEST_IMAGE_SIZE), &resumed);
+
+	// The first piece holds the header and some bytes, the rest comes in odd sizes
+	for (uint32_t seq = 0; seq < TEST_IMAGE_SIZE / TEST_CHUNK; ++seq)
+	{
+		size_t len = make_frame(frame, seq);
+		size_t pos = 0;
+		size_t piece = sizeof(ota_ws_header_t) + 7;
+		ota_ws_result_e result = OTA_WS_MORE;
+
+		while (pos < len)
+		{
+			size_t n = (len - pos < piece) ? len - pos : piece;
+			result = ota_ws_feed(&ota, &frame[pos], n, pos, len);
+			if (pos + n < len)
+			{
+				TEST_CHECK_EQ(OTA_WS_MORE, result);
+			}
+			pos += n;
+			piece = 333;
+		}
+		TEST_CHECK(result == OTA_WS_ACCEPTED || result == OTA_WS_ACK);
+	}
+
+	TEST_CHECK_EQ(ESP_OK, ota_ws_end(&ota));
+	TEST_CHECK_MEM(image, sink_state.image, TEST_IMAGE_SIZE);
+}
+
+static void test_resume(void)
+{
+	ota_ws_t ota;
+	bool resumed;
+	uint8_t frame[sizeof(ota_ws_header_t) + TEST_CHUNK];
+	char position[48];
+	uint32_t image_crc = esp_crc32_le(0, image, TEST_IMAGE_SIZE);
+
+	setup(&ota);
+	ota_ws_begin(&ota, &sink, TEST_IMAGE_SIZE, image_crc, &resumed);
+	for (uint32_t seq = 0; seq < 5; ++seq)
+	{
+		send_chunk(&ota, seq);
+	}
+
+	// The connection drops halfway through chunk 5
+	size_t len = make_frame(frame, 5);
+	TEST_CHECK_EQ(OTA_WS_MORE, ota_ws_feed(&ota, frame, 16 + 400, 0, len));
+	TEST_CHECK_EQ(5 * TEST_CHUNK + 400, ota.offset);
+
+	// The same image resumes, the position tells the sender where to go on from
+	TEST_CHECK_EQ(ESP_OK, ota_ws_begin(&ota, &sink, TEST_IMAGE_SIZE, image_crc, &resumed));
+	TEST_CHECK(resumed);
+	TEST_CHECK_EQ(1, sink_state.begins);
+	TEST_CHECK_EQ(1, ota.stats.resumes);
+	ota_ws_position(&ota, position, sizeof(position));
+	char expected[48];
+	snprintf(expected, sizeof(expected), "seq=5 offset=5400 crc=%08x", esp_crc32_le(0, image, 5400));
+	TEST_CHECK(strcmp(expected, position) == 0);
+
+	// A chunk taken before the drop is a duplicate, chunk 5 sent whole only adds its missing part
+	TEST_CHECK_EQ(OTA_WS_DUPLICATE, send_chunk(&ota, 3));
+	TEST_CHECK_EQ(1, ota.stats.duplicates);
+	for (uint32_t seq = 5; seq < TEST_IMAGE_SIZE / TEST_CHUNK; ++seq)
+	{
+		ota_ws_result_e result = send_chunk(&ota, seq);
+		TEST_CHECK(result == OTA_WS_ACCEPTED || result == OTA_WS_ACK);
+	}
+
+	TEST_CHECK_EQ(ESP_OK, ota_ws_end(&ota));
+	TEST_CHECK_EQ(TEST_IMAGE_SIZE, sink_state.written);
+	TEST_CHECK_MEM(image, sink_state.image, TEST_IMAGE_SIZE);
+}
+
+static void test_out_of_order(void)
+{
+	ota_ws_t ota;
+	bool resumed;
+	char position[48];
+
+	setup(&ota);
+
+	// No upload yet
+	TEST_CHECK_EQ(OTA_WS_REJECTED, send_chunk(&ota, 0));
+
+	ota_ws_begin(&ota, &sink, TEST_IMAGE_SIZE, esp_crc32_le(0, image, TEST_IMAGE_SIZE), &resumed);
+	TEST_CHECK_EQ(OTA_WS_ACCEPTED, send_chunk(&ota, 0));
+	TEST_CHECK_EQ(OTA_WS_REJECTED, send_chunk(&ota, 2));
+	TEST_CHECK_EQ(2, ota.stats.rejects);
+	ota_ws_position(&ota, position, sizeof(position));
+	TEST_CHECK(strncmp("seq=1 offset=1000 ", position, 18) == 0);
+
+	// Too short for a header, or not a chunk frame at all
+	uint8_t frame[sizeof(ota_ws_header_t) + TEST_CHUNK];
+	size_t len = make_frame(frame, 1);
+	TEST_CHECK_EQ(OTA_WS_REJECTED, ota_ws_feed(&ota, frame, 8, 0, 8));
+	frame[0] ^= 0xFF;
+	TEST_CHECK_EQ(OTA_WS_REJECTED, ota_ws_feed(&ota, frame, len, 0, len));
+
+	// Missing bytes keep the upload going
+	TEST_CHECK_EQ(ESP_ERR_INVALID_SIZE, ota_ws_end(&ota));
+	TEST_CHECK(ota.active);
+	ota_ws_abort(&ota);
+	TEST_CHECK_EQ(1, sink_state.aborts);
+}
+
+static void test_bad_crc(void)
+{
+	ota_ws_t ota;
+	bool resumed;
+	uint8_t frame[sizeof(ota_ws_header_t) + TEST_CHUNK];
+
+	setup(&ota);
+	ota_ws_begin(&ota, &sink, TEST_IMAGE_SIZE, esp_crc32_le(0, image, TEST_IMAGE_SIZE), &resumed);
+	send_chunk(&ota, 0);
+
+	size_t len = make_frame(frame, 1);
+	frame[sizeof(ota_ws_header_t) + 10] ^= 0x01;
+	TEST_CHECK_EQ(OTA_WS_FAILED, ota_ws_feed(&ota, frame, len, 0, len));
+	TEST_CHECK(!ota.active);
+	TEST_CHECK_EQ(ESP_ERR_INVALID_CRC, ota.err);
+	TEST_CHECK_EQ(1, sink_state.aborts);
+	TEST_CHECK_EQ(0, sink_state.finishes);
+	TEST_CHECK_EQ(ESP_ERR_INVALID_CRC, ota_ws_end(&ota));
+}
+
+static void test_sink_failure(void)
+{
+	ota_ws_t ota;
+	bool resumed;
+	ota_ws_result_e result = OTA_WS_ACCEPTED;
+
+	setup(&ota);
+	sink_state.fail_after = OTA_STREAM_BUFFER_SIZE;
+	ota_ws_begin(&ota, &sink, TEST_IMAGE_SIZE, esp_crc32_le(0, image, TEST_IMAGE_SIZE), &resumed);
+
+	// The writer fails on the second buffer, the next chunks see it
+	for (uint32_t seq = 0; seq < TEST_IMAGE_SIZE / TEST_CHUNK && result != OTA_WS_FAILED; ++seq)
+	{
+		result = send_chunk(&ota, seq);
+	}
+
+	TEST_CHECK_EQ(ESP_ERR_INVALID_STATE, ota_ws_end(&ota));
+	TEST_CHECK(!ota.active);
+	TEST_CHECK_EQ(1, sink_state.aborts);
+	TEST_CHECK_EQ(0, sink_state.finishes);
+}
+
+static void test_new_image(void)
+{
+	ota_ws_t ota;
+	bool resumed;
+
+	setup(&ota);
+	ota_ws_begin(&ota, &sink, TEST_IMAGE_SIZE, esp_crc32_le(0, image, TEST_IMAGE_SIZE), &resumed);
+	send_chunk(&ota, 0);
+
+	// Another image drops the partial one and starts over
+	TEST_CHECK_EQ(ESP_OK, ota_ws_begin(&ota, &sink, TEST_IMAGE_SIZE, 0x12345678, &resumed));
+	TEST_CHECK(!resumed);
+	TEST_CHECK_EQ(1, sink_state.aborts);
+	TEST_CHECK_EQ(2, sink_state.begins);
+	TEST_CHECK_EQ(0, ota.offset);
+
+	// Every byte arrives but the image is not the one announced
+	for (uint32_t seq = 0; seq < TEST_IMAGE_SIZE / TEST_CHUNK; ++seq)
+	{
+		send_chunk(&ota, seq);
+	}
+	TEST_CHECK_EQ(ESP_ERR_INVALID_CRC, ota_ws_end(&ota));
+	TEST_CHECK_EQ(2, sink_state.aborts);
+	TEST_CHECK_EQ(0, sink_state.finishes);
+}
+
+int main(void)
+{
+	TEST_RUN(test_whole_upload);
+	TEST_RUN(test_frame_in_pieces);
+	TEST_RUN(test_resume);
+	TEST_RUN(test_out_of_order);
+	TEST_RUN(test_bad_crc);
+	TEST_RUN(test_sink_failure);
+	TEST_RUN(test_new_image);
+	return TEST_RESULT();
+}
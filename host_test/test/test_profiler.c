@@ -0,0 +1,157 @@
+/*
+ * test_profiler.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "profiler.h"
+
+#include "host_test.h"
+
+static profiler_t profiler;
+static uint8_t frame[PROFILER_FRAME_MAX_LEN];
+static atomic_bool quit;
+
+static uint16_t get16(const uint8_t *in)
+{
+	return in[0] | (in[1] << 8);
+}
+
+/**
+ * Spins until the test ends.
+ */
+static void busy_task(void *arg)
+{
+	(void)arg;
+	while (!atomic_load(&quit))
+	{
+	}
+	vTaskDelete(NULL);
+}
+
+/**
+ * Sleeps until the test ends.
+ */
+static void idle_task(void *arg)
+{
+	(void)arg;
+	while (!atomic_load(&quit))
+	{
+		vTaskDelay(pdMS_TO_TICKS(5));
+	}
+	vTaskDelete(NULL);
+}
+
+/**
+ * Finds a task of a frame with names by its name.
+ * @return the task record, NULL if it is not there.
+ */
+static const uint8_t *find_task(const uint8_t *out, size_t len, const char *name)
+{
+	uint8_t count = out[6];
+	const char *names = (const char *)out + PROFILER_HEADER_SIZE + count * PROFILER_TASK_SIZE;
+
+	for (uint8_t i = 0; i < count && names < (const char *)out + len; ++i)
+	{
+		if (strcmp(names, name) == 0)
+		{
+			return out + PROFILER_HEADER_SIZE + i * PROFILER_TASK_SIZE;
+		}
+		names += strlen(names) + 1;
+	}
+	return NULL;
+}
+
+static void test_sample(void)
+{
+	xTaskCreatePinnedToCore(busy_task, "busy", 2048, NULL, 4, NULL, 0);
+	xTaskCreatePinnedToCore(idle_task, "idle", 3072, NULL, 3, NULL, tskNO_AFFINITY);
+
+	// The first sample is only a baseline
+	profiler_reset(&profiler);
+	TEST_CHECK_EQ(0, profiler_sample(&profiler, frame, sizeof(frame)));
+	vTaskDelay(pdMS_TO_TICKS(100));
+
+	size_t len = profiler_sample(&profiler, frame, sizeof(frame));
+	TEST_CHECK(len > PROFILER_HEADER_SIZE);
+	TEST_CHECK_MEM(PROFILER_MAGIC, frame, 4);
+	TEST_CHECK_EQ(PROFILER_VERSION, frame[4]);
+	TEST_CHECK_EQ(PROFILER_FLAG_NAMES, frame[5]);
+	TEST_CHECK_EQ(uxTaskGetNumberOfTasks(), frame[6]);
+	TEST_CHECK_EQ(portNUM_PROCESSORS, frame[7]);
+	TEST_CHECK_EQ(0, get16(&frame[22]));
+
+	const uint8_t *busy = find_task(frame, len, "busy");
+	const uint8_t *idle = find_task(frame, len, "idle");
+	TEST_CHECK(busy != NULL && idle != NULL);
+	if (busy && idle)
+	{
+		// The spinning task used most of a core, the sleeping one next to nothing
+		TEST_CHECK(get16(&busy[2]) > get16(&idle[2]));
+		TEST_CHECK(get16(&busy[2]) <= 1000);
+		TEST_CHECK_EQ(2048, get16(&busy[4]));
+		TEST_CHECK_EQ(0, busy[6]);
+		TEST_CHECK_EQ(4, busy[7]);
+		TEST_CHECK_EQ(0xFF, idle[6]);
+		TEST_CHECK_EQ(3, idle[7]);
+	}
+}
+
+static void test_names_only_on_change(void)
+{
+	uint8_t count = frame[6];
+
+	// Same tasks, the names were sent already
+	vTaskDelay(pdMS_TO_TICKS(10));
+	TEST_CHECK_EQ(PROFILER_HEADER_SIZE + count * PROFILER_TASK_SIZE, profiler_sample(&profiler, frame, sizeof(frame)));
+	TEST_CHECK_EQ(0, frame[5]);
+
+	// A new task brings them back
+	xTaskCreatePinnedToCore(idle_task, "late", 2048, NULL, 1, NULL, tskNO_AFFINITY);
+	vTaskDelay(pdMS_TO_TICKS(10));
+	size_t len = profiler_sample(&profiler, frame, sizeof(frame));
+	TEST_CHECK_EQ(PROFILER_FLAG_NAMES, frame[5]);
+	TEST_CHECK_EQ(count + 1, frame[6]);
+	TEST_CHECK(find_task(frame, len, "late") != NULL);
+
+	// And so does a new baseline
+	profiler_reset(&profiler);
+	TEST_CHECK_EQ(0, profiler_sample(&profiler, frame, sizeof(frame)));
+	vTaskDelay(pdMS_TO_TICKS(10));
+	profiler_sample(&profiler, frame, sizeof(frame));
+	TEST_CHECK_EQ(PROFILER_FLAG_NAMES, frame[5]);
+}
+
+static void test_limits(void)
+{
+	// A frame that does not fit is not written, the sample still becomes the baseline
+	vTaskDelay(pdMS_TO_TICKS(10));
+	TEST_CHECK_EQ(0, profiler_sample(&profiler, frame, PROFILER_HEADER_SIZE));
+	vTaskDelay(pdMS_TO_TICKS(10));
+	TEST_CHECK(profiler_sample(&profiler, frame, sizeof(frame)) > 0);
+
+	// More tasks than PROFILER_MAX_TASKS skip the samples
+	for (UBaseType_t i = uxTaskGetNumberOfTasks(); i <= PROFILER_MAX_TASKS; ++i)
+	{
+		xTaskCreatePinnedToCore(idle_task, "extra", 2048, NULL, 1, NULL, tskNO_AFFINITY);
+	}
+	vTaskDelay(pdMS_TO_TICKS(10));
+	TEST_CHECK_EQ(0, profiler_sample(&profiler, frame, sizeof(frame)));
+	TEST_CHECK(profiler.max_sample_us >= profiler.sample_us);
+}
+
+int main(void)
+{
+	TEST_RUN(test_sample);
+	TEST_RUN(test_names_only_on_change);
+	TEST_RUN(test_limits);
+
+	atomic_store(&quit, true);
+	return TEST_RESULT();
+}
@@ -0,0 +1,124 @@
+/*
+ * test_task_topology.c
+ *
+ *  Created on: Jun 03, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "task_topology.h"
+
+#include "host_test.h"
+
+static atomic_bool quit;
+
+/**
+ * Sleeps until the test ends.
+ */
+static void idle_task(void *arg)
+{
+	(void)arg;
+	while (!atomic_load(&quit))
+	{
+		vTaskDelay(pdMS_TO_TICKS(5));
+	}
+	vTaskDelete(NULL);
+}
+
+/**
+ * Finds a preset by its name.
+ * @return the preset number, task_topology_preset_count if there is none.
+ */
+static uint32_t find_preset(const char *name)
+{
+	uint32_t preset = 0;
+
+	while (preset < task_topology_preset_count() && strcmp(task_topology_preset_name(preset), name) != 0)
+	{
+		preset++;
+	}
+	return preset;
+}
+
+static void test_config(void)
+{
+	// Preset 0 is menuconfig, the default before any select
+	TEST_CHECK_EQ(0, task_topology_active());
+	TEST_CHECK_EQ(0, strcmp("config", task_topology_preset_name(0)));
+
+	task_spec_t httpd = task_topology_get(TASK_TOPOLOGY_HTTPD);
+	TEST_CHECK_EQ(0, strcmp("httpd", httpd.name));
+	TEST_CHECK_EQ(CONFIG_WS_TASK_HTTPD_PRIORITY, httpd.priority);
+	TEST_CHECK_EQ(CONFIG_WS_TASK_HTTPD_CORE, httpd.core_id);
+
+	// Kconfig -1 leaves a task unpinned
+	TEST_CHECK_EQ(tskNO_AFFINITY, task_topology_get(TASK_TOPOLOGY_PROFILER).core_id);
+
+	// The load sits just below the log task
+	TEST_CHECK_EQ(CONFIG_WS_TASK_WS_PRINT_PRIORITY - 1, task_topology_get(TASK_TOPOLOGY_BENCH).priority);
+}
+
+static void test_presets(void)
+{
+	uint32_t one_core = find_preset("one_core");
+	uint32_t log_first = find_preset("log_first");
+
+	TEST_CHECK(one_core < task_topology_preset_count());
+	TEST_CHECK(log_first < task_topology_preset_count());
+
+	// One core for everything, priorities as in menuconfig
+	task_topology_select(one_core);
+	TEST_CHECK_EQ(one_core, task_topology_active());
+	for (int id = 0; id < TASK_TOPOLOGY_COUNT; ++id)
+	{
+		TEST_CHECK_EQ(1, task_topology_get(id).core_id);
+	}
+	TEST_CHECK_EQ(CONFIG_WS_TASK_WIFI_APP_PRIORITY, task_topology_get(TASK_TOPOLOGY_WIFI_APP).priority);
+
+	task_topology_select(log_first);
+	TEST_CHECK(task_topology_get(TASK_TOPOLOGY_WS_PRINT).priority > task_topology_get(TASK_TOPOLOGY_HTTPD).priority);
+
+	// An unknown preset falls back to menuconfig
+	task_topology_select(task_topology_preset_count());
+	TEST_CHECK_EQ(0, task_topology_active());
+	TEST_CHECK_EQ(0, strcmp("?", task_topology_preset_name(task_topology_preset_count())));
+}
+
+static void test_create(void)
+{
+	TaskStatus_t status[16];
+	TaskHandle_t handle = NULL;
+
+	TEST_CHECK_EQ(pdPASS, task_topology_create(TASK_TOPOLOGY_WS_PRINT, idle_task, NULL, &handle));
+
+	// The task runs with the name, priority and core of the table
+	UBaseType_t count = uxTaskGetSystemState(status, sizeof(status) / sizeof(status[0]), NULL);
+	bool found = false;
+	for (UBaseType_t i = 0; i < count; ++i)
+	{
+		if (status[i].xHandle == handle)
+		{
+			found = true;
+			TEST_CHECK_EQ(0, strcmp("websocket", status[i].pcTaskName));
+			TEST_CHECK_EQ(CONFIG_WS_TASK_WS_PRINT_PRIORITY, status[i].uxCurrentPriority);
+			TEST_CHECK_EQ(CONFIG_WS_TASK_WS_PRINT_CORE, status[i].xCoreID);
+		}
+	}
+	TEST_CHECK(found);
+}
+
+int main(void)
+{
+	TEST_RUN(test_config);
+	TEST_RUN(test_presets);
+	TEST_RUN(test_create);
+
+	atomic_store(&quit, true);
+	return TEST_RESULT();
+}
@@ -0,0 +1,318 @@
+/*
+ * test_wifi_app.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+#include "nvs_flash.h"
+
+#include "app_nvs.h"
+#include "host_wifi.h"
+#include "http_server.h"
+#include "wifi_app.h"
+
+#include "host_test.h"
+
+static const wifi_ap_record_t ap = { .bssid = { 1, 2, 3, 4, 5, 6 }, .ssid = "home", .primary = 6, .rssi = -50 };
+
+static wifi_app_stats_t stats;
+
+/**
+ * Plays the driver losing the link.
+ * @param reason wifi_err_reason_t the event carries.
+ */
+static void drop_link(uint8_t reason)
+{
+	wifi_event_sta_disconnected_t event = { .reason = reason };
+
+	host_wifi_set_ap(NULL);
+	host_wifi_post_event(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &event);
+}
+
+/**
+ * Plays the driver associating and DHCP handing out an address.
+ */
+static void got_ip(void)
+{
+	host_wifi_set_ap(&ap);
+	host_wifi_post_event(IP_EVENT, IP_EVENT_STA_GOT_IP, NULL);
+}
+
+/**
+ * Gets the SSID of a saved network.
+ * @return the SSID, "" if there is no network at index.
+ */
+static const char *network_name(size_t index)
+{
+	static app_nvs_network_t network;
+
+	memset(&network, 0x00, sizeof(network));
+	app_nvs_get_network(index, &network);
+	return (const char *)network.ssid;
+}
+
+/**
+ * Waits until wifi_app took the latest disconnect and scheduled its reconnect.
+ * @return false if it did not within a second.
+ */
+static bool wait_scheduled(uint8_t reason)
+{
+	for (int wait = 0; wait < 100; ++wait)
+	{
+		wifi_app_get_stats(&stats);
+		if (stats.last_reason == reason && stats.backoff_ms != 0)
+		{
+			return true;
+		}
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+	return false;
+}
+
+/**
+ * Waits until wifi_app took the latest IP and cancelled the backoff.
+ * @return false if it did not within a second.
+ */
+static bool wait_recovered(uint32_t recoveries)
+{
+	for (int wait = 0; wait < 100; ++wait)
+	{
+		wifi_app_get_stats(&stats);
+		if (stats.recoveries == recoveries && stats.backoff_ms == 0)
+		{
+			return true;
+		}
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+	return false;
+}
+
+/**
+ * Waits until the driver counter reaches a value.
+ * @return false if it did not within a second.
+ */
+static bool wait_driver(const uint32_t *counter, uint32_t value, host_wifi_stats_t *driver)
+{
+	for (int wait = 0; wait < 100; ++wait)
+	{
+		host_wifi_get_stats(driver);
+		if (*counter >= value)
+		{
+			return true;
+		}
+		vTaskDelay(pdMS_TO_TICKS(10));
+	}
+	return false;
+}
+
+/**
+ * Saves a network as wifi_app does after a connection.
+ */
+static void save_network(const char *ssid)
+{
+	wifi_config_t *config = wifi_app_get_wifi_config();
+
+	memset(config, 0x00, sizeof(wifi_config_t));
+	strcpy((char *)config->sta.ssid, ssid);
+	strcpy((char *)config->sta.password, "secret");
+	app_nvs_save_sta_creds(NULL, -50);
+}
+
+static void test_no_saved_creds(void)
+{
+	host_wifi_stats_t driver;
+
+	// Nothing saved, the station waits for the HTTP server
+	vTaskDelay(pdMS_TO_TICKS(50));
+	host_wifi_get_stats(&driver);
+	TEST_CHECK_EQ(0, driver.connects);
+}
+
+static void test_reconnect_and_recover(void)
+{
+	host_wifi_stats_t before;
+	host_wifi_stats_t after;
+
+	host_wifi_get_stats(&before);
+	drop_link(WIFI_REASON_BEACON_TIMEOUT);
+	TEST_CHECK(wait_scheduled(WIFI_REASON_BEACON_TIMEOUT));
+	TEST_CHECK(stats.backoff_ms >= WIFI_RECONNECT_MIN_MS / 2 && stats.backoff_ms <= WIFI_RECONNECT_MIN_MS);
+
+	// Nothing before the delay, the timer connects once it ran out
+	host_wifi_get_stats(&after);
+	TEST_CHECK_EQ(before.connects, after.connects);
+	for (int wait = 0; wait < 100 && after.connects == before.connects; ++wait)
+	{
+		vTaskDelay(pdMS_TO_TICKS(10));
+		host_wifi_get_stats(&after);
+	}
+	TEST_CHECK_EQ(before.connects + 1, after.connects);
+	wifi_app_get_stats(&stats);
+	TEST_CHECK_EQ(1, stats.reconnects);
+
+	got_ip();
+	TEST_CHECK(wait_recovered(1));
+	TEST_CHECK(stats.last_recovery_us >= WIFI_RECONNECT_MIN_MS / 2 * 1000);
+	TEST_CHECK_EQ(stats.last_recovery_us, stats.max_recovery_us);
+}
+
+static void test_backoff_by_reason(void)
+{
+	// First delays: 4x for a missing access point, 32x doubled once for rejected credentials
+	drop_link(WIFI_REASON_NO_AP_FOUND);
+	TEST_CHECK(wait_scheduled(WIFI_REASON_NO_AP_FOUND));
+	TEST_CHECK(stats.backoff_ms >= 2 * WIFI_RECONNECT_MIN_MS && stats.backoff_ms <= 4 * WIFI_RECONNECT_MIN_MS);
+
+	drop_link(WIFI_REASON_AUTH_FAIL);
+	TEST_CHECK(wait_scheduled(WIFI_REASON_AUTH_FAIL));
+	TEST_CHECK(stats.backoff_ms >= 32 * WIFI_RECONNECT_MIN_MS && stats.backoff_ms <= 64 * WIFI_RECONNECT_MIN_MS);
+
+	// Every attempt doubles, up to the cap
+	for (int i = 0; i < 8; ++i)
+	{
+		drop_link(i % 2 ? WIFI_REASON_AUTH_FAIL : WIFI_REASON_HANDSHAKE_TIMEOUT);
+		TEST_CHECK(wait_scheduled(i % 2 ? WIFI_REASON_AUTH_FAIL : WIFI_REASON_HANDSHAKE_TIMEOUT));
+	}
+	TEST_CHECK(stats.backoff_ms >= WIFI_RECONNECT_MAX_MS / 2 && stats.backoff_ms <= WIFI_RECONNECT_MAX_MS);
+
+	got_ip();
+	TEST_CHECK(wait_recovered(2));
+}
+
+static void test_ranked_scan(void)
+{
+	const wifi_ap_record_t records[] =
+	{
+		{ .bssid = { 0xA }, .ssid = "home", .primary = 6, .rssi = -50 },
+		{ .bssid = { 0xB }, .ssid = "office", .primary = 1, .rssi = -40 },
+		{ .bssid = { 0xC }, .ssid = "home", .primary = 11, .rssi = -70 },
+		{ .bssid = { 0xD }, .ssid = "neighbour", .primary = 3, .rssi = -30 },
+	};
+	host_wifi_stats_t driver;
+	wifi_config_t sta;
+
+	// Office first, home is the most recent
+	nvs_flash_erase();
+	app_nvs_flash_setup();
+	save_network("office");
+	save_network("home");
+
+	// With saved networks the backoff reconnect scans instead of connecting blindly
+	host_wifi_get_stats(&driver);
+	uint32_t scans = driver.scans;
+	uint32_t connects = driver.connects;
+	drop_link(WIFI_REASON_BEACON_TIMEOUT);
+	TEST_CHECK(wait_driver(&driver.scans, scans + 1, &driver));
+	TEST_CHECK_EQ(connects, driver.connects);
+
+	// Home gets 5 dB for being more recent, office is still 5 dB stronger and wins
+	host_wifi_set_scan(records, sizeof(records) / sizeof(records[0]));
+	host_wifi_post_event(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, NULL);
+	TEST_CHECK(wait_driver(&driver.connects, connects + 1, &driver));
+	esp_wifi_get_config(WIFI_IF_STA, &sta);
+	TEST_CHECK_EQ(0, strcmp("office", (char *)sta.sta.ssid));
+	TEST_CHECK(sta.sta.bssid_set);
+	TEST_CHECK_EQ(0xB, sta.sta.bssid[0]);
+	TEST_CHECK_EQ(1, sta.sta.channel);
+
+	// A failure moves to the next candidate without scanning again, on its strongest access point
+	drop_link(WIFI_REASON_AUTH_FAIL);
+	TEST_CHECK(wait_driver(&driver.connects, connects + 2, &driver));
+	esp_wifi_get_config(WIFI_IF_STA, &sta);
+	TEST_CHECK_EQ(0, strcmp("home", (char *)sta.sta.ssid));
+	TEST_CHECK_EQ(0xA, sta.sta.bssid[0]);
+	TEST_CHECK_EQ(6, sta.sta.channel);
+	TEST_CHECK_EQ(scans + 1, driver.scans);
+	wifi_app_get_stats(&stats);
+	TEST_CHECK_EQ(1, stats.failovers);
+
+	// Every candidate failed, back to the backoff
+	drop_link(WIFI_REASON_NO_AP_FOUND);
+	TEST_CHECK(wait_scheduled(WIFI_REASON_NO_AP_FOUND));
+
+	got_ip();
+	TEST_CHECK(wait_recovered(4));
+	TEST_CHECK_EQ(0, strcmp("home", network_name(0)));
+}
+
+static void test_soft_ap_busy(void)
+{
+	// Stations on the SoftAP keep the scans apart
+	host_wifi_set_stations(1);
+	drop_link(WIFI_REASON_BEACON_TIMEOUT);
+	TEST_CHECK(wait_scheduled(WIFI_REASON_BEACON_TIMEOUT));
+	TEST_CHECK_EQ(WIFI_RECONNECT_AP_BUSY_MS, stats.backoff_ms);
+	host_wifi_set_stations(0);
+
+	got_ip();
+	TEST_CHECK(wait_recovered(3));
+}
+
+static void test_http_connect(void)
+{
+	host_wifi_stats_t driver;
+
+	// Already connected, no attempt starts and the next disconnect is not taken for its failure
+	host_wifi_get_stats(&driver);
+	uint32_t connects = driver.connects;
+	TEST_CHECK_EQ(pdTRUE, wifi_app_request_connect("cafe", "secret"));
+	vTaskDelay(pdMS_TO_TICKS(50));
+	host_wifi_get_stats(&driver);
+	TEST_CHECK_EQ(connects, driver.connects);
+
+	drop_link(WIFI_REASON_BEACON_TIMEOUT);
+	TEST_CHECK(wait_scheduled(WIFI_REASON_BEACON_TIMEOUT));
+
+	// A failed attempt from the HTTP server goes back to the saved networks through the backoff
+	TEST_CHECK_EQ(pdTRUE, wifi_app_request_connect("cafe", "secret"));
+	TEST_CHECK(wait_driver(&driver.connects, connects + 1, &driver));
+	drop_link(WIFI_REASON_AUTH_FAIL);
+	TEST_CHECK(wait_scheduled(WIFI_REASON_AUTH_FAIL));
+
+	got_ip();
+	TEST_CHECK(wait_recovered(5));
+}
+
+static void test_user_disconnect(void)
+{
+	host_wifi_stats_t driver;
+
+	// Connected from the HTTP server rather than saved credentials, the request still drops the link
+	host_wifi_get_stats(&driver);
+	uint32_t disconnects = driver.disconnects;
+	TEST_CHECK_EQ(pdTRUE, wifi_app_send_message(WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT));
+	TEST_CHECK(wait_driver(&driver.disconnects, disconnects + 1, &driver));
+
+	// The disconnect it causes schedules no reconnect
+	drop_link(WIFI_REASON_ASSOC_LEAVE);
+	vTaskDelay(pdMS_TO_TICKS(50));
+	wifi_app_get_stats(&stats);
+	TEST_CHECK_EQ(0, stats.backoff_ms);
+	TEST_CHECK(stats.last_reason != WIFI_REASON_ASSOC_LEAVE);
+}
+
+int main(void)
+{
+	// Same order as app_main, on an empty NVS
+	nvs_flash_erase();
+	app_nvs_flash_setup();
+	wifi_app_start(esp_timer_get_time());
+
+	TEST_RUN(test_no_saved_creds);
+	TEST_RUN(test_reconnect_and_recover);
+	TEST_RUN(test_backoff_by_reason);
+	TEST_RUN(test_soft_ap_busy);
+	TEST_RUN(test_ranked_scan);
+	TEST_RUN(test_http_connect);
+	TEST_RUN(test_user_disconnect);
+	return TEST_RESULT();
+}
@@ -0,0 +1,458 @@
+/*
+ * test_ws_client.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "host_httpd.h"
+#include "ws_client.h"
+
+#include "host_test.h"
+
+static httpd_handle_t server;
+
+// Sessions closed through httpd_sess_trigger_close, as the close hook in http_server.c sees them
+static int closed_fd = -1;
+
+static void on_close(httpd_handle_t hd, int fd)
+{
+	(void)hd;
+	closed_fd = fd;
+	ws_client_remove(fd);
+}
+
+/**
+ * Client socket pair, server is the end ws_client writes to
+ */
+typedef struct test_client
+{
+	int server;
+	int client;
+} test_client_t;
+
+static test_client_t client_open(bool replay)
+{
+	int fds[2];
+	socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+	test_client_t client = { .server = fds[0], .client = fds[1] };
+	TEST_CHECK_EQ(ESP_OK, ws_client_add(client.server, replay));
+	return client;
+}
+
+static void client_close(test_client_t *client)
+{
+	ws_client_remove(client->server);
+	close(client->server);
+	close(client->client);
+}
+
+/**
+ * Reads one frame written by host_httpd.
+ * @param client client to read.
+ * @param out receives the payload, NUL terminated.
+ * @param size size of out.
+ * @return payload length, -1 if no frame came within 1 s.
+ */
+static int client_read(test_client_t *client, char *out, size_t size)
+{
+	uint8_t header[4];
+	size_t got = 0;
+	size_t len = sizeof(header);
+	uint8_t *dst = header;
+
+	for (int part = 0; part < 2; ++part)
+	{
+		while (got < len)
+		{
+			struct pollfd ready = { .fd = client->client, .events = POLLIN };
+			if (poll(&ready, 1, 1000) <= 0)
+			{
+				return -1;
+			}
+			ssize_t n = read(client->client, dst + got, len - got);
+			if (n <= 0)
+			{
+				return -1;
+			}
+			got += n;
+		}
+
+		if (part == 0)
+		{
+			len = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+			if (len >= size)
+			{
+				return -1;
+			}
+			dst = (uint8_t *)out;
+			got = 0;
+		}
+	}
+
+	out[len] = '\0';
+	return (int)len;
+}
+
+static void broadcast_text(const char *text)
+{
+	ws_msg_t *msg = ws_msg_create(text, strlen(text), HTTPD_WS_TYPE_TEXT);
+	ws_client_broadcast(msg);
+	ws_msg_unref(msg);
+}
+
+static SemaphoreHandle_t httpd_release;
+
+// Keeps the httpd thread busy, as a long handler would, so frames pile up in the queues
+static void httpd_hold(void *arg)
+{
+	(void)arg;
+	xSemaphoreTake(httpd_release, portMAX_DELAY);
+}
+
+static void test_broadcast(void)
+{
+	test_client_t a = client_open(false);
+	test_client_t b = client_open(false);
+	char out[64];
+
+	broadcast_text("hello");
+	TEST_CHECK_EQ(5, client_read(&a, out, sizeof(out)));
+	TEST_CHECK(strcmp(out, "hello") == 0);
+	TEST_CHECK_EQ(5, client_read(&b, out, sizeof(out)));
+
+	host_httpd_sync(server);
+	ws_client_stats_t stats[WS_CLIENT_MAX_CLIENTS];
+	TEST_CHECK_EQ(2, ws_client_get_stats(stats, WS_CLIENT_MAX_CLIENTS));
+	TEST_CHECK_EQ(1, stats[0].sent_frames);
+	TEST_CHECK_EQ(5, stats[0].sent_bytes);
+	TEST_CHECK_EQ(0, stats[0].queued_frames);
+
+	client_close(&a);
+	client_close(&b);
+}
+
+/**
+ * Broadcasts more frames than a queue holds while the httpd thread is held.
+ * @param client client to check.
+ * @param first receives the number in the first frame that came through.
+ * @return frames received.
+ */
+static int overflow(test_client_t *client, int *first)
+{
+	char out[16];
+	int received = 0;
+
+	httpd_queue_work(server, httpd_hold, NULL);
+	for (int i = 0; i < WS_CLIENT_QUEUE_DEPTH + 3; ++i)
+	{
+		snprintf(out, sizeof(out), "%d", i);
+		broadcast_text(out);
+	}
+	xSemaphoreGive(httpd_release);
+
+	*first = -1;
+	while (client_read(client, out, sizeof(out)) > 0)
+	{
+		if (*first < 0)
+		{
+			*first = atoi(out);
+		}
+		received++;
+		if (received == WS_CLIENT_QUEUE_DEPTH)
+		{
+			break;
+		}
+	}
+	host_httpd_sync(server);
+	return received;
+}
+
+static void test_drop_oldest(void)
+{
+	test_client_t client = client_open(false);
+	int first;
+
+	ws_client_set_overflow_policy(WS_CLIENT_OVERFLOW_DROP_OLDEST);
+	TEST_CHECK_EQ(WS_CLIENT_QUEUE_DEPTH, overflow(&client, &first));
+	TEST_CHECK_EQ(3, first);
+
+	ws_client_stats_t stats;
+	ws_client_get_stats(&stats, 1);
+	TEST_CHECK_EQ(3, stats.dropped_frames);
+	TEST_CHECK_EQ(WS_CLIENT_QUEUE_DEPTH, stats.high_water);
+
+	client_close(&client);
+}
+
+static void test_drop_newest(void)
+{
+	test_client_t client = client_open(false);
+	int first;
+
+	ws_client_set_overflow_policy(WS_CLIENT_OVERFLOW_DROP_NEWEST);
+	TEST_CHECK_EQ(WS_CLIENT_QUEUE_DEPTH, overflow(&client, &first));
+	TEST_CHECK_EQ(0, first);
+
+	client_close(&client);
+	ws_client_set_overflow_policy(WS_CLIENT_OVERFLOW_DROP_OLDEST);
+}
+
+static void test_disconnect(void)
+{
+	test_client_t client = client_open(false);
+	int first;
+
+	closed_fd = -1;
+	ws_client_set_overflow_policy(WS_CLIENT_OVERFLOW_DISCONNECT);
+	overflow(&client, &first);
+	TEST_CHECK_EQ(client.server, closed_fd);
+
+	ws_client_stats_t stats;
+	TEST_CHECK_EQ(0, ws_client_get_stats(&stats, 1));
+
+	client_close(&client);
+	ws_client_set_overflow_policy(WS_CLIENT_OVERFLOW_DROP_OLDEST);
+}
+
+/**
+ * Shrinks the buffer of the end ws_client writes to, so a client that does not read fills it quickly.
+ * @param client client to shrink.
+ */
+static void client_shrink(test_client_t *client)
+{
+	int size = 4096;
+	setsockopt(client->server, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+}
+
+static void test_stalled_client(void)
+{
+	test_client_t stalled = client_open(false);
+	test_client_t reader = client_open(false);
+	char text[256];
+	char out[256];
+	uint32_t frames;
+	uint64_t send_us;
+
+	ws_client_set_overflow_policy(WS_CLIENT_OVERFLOW_DROP_OLDEST);
+	client_shrink(&stalled);
+	host_httpd_stats(server, &frames, &send_us);
+	uint64_t send_us_before = send_us;
+
+	// One client never reads, the other one gets every frame anyway
+	memset(text, 'x', sizeof(text) - 1);
+	text[sizeof(text) - 1] = '\0';
+	for (int i = 0; i < 200; ++i)
+	{
+		char number[8];
+		snprintf(number, sizeof(number), "%05d", i);
+		memcpy(text, number, 5);
+		broadcast_text(text);
+		TEST_CHECK_EQ(sizeof(text) - 1, client_read(&reader, out, sizeof(out)));
+		TEST_CHECK_MEM(text, out, 5);
+	}
+	host_httpd_sync(server);
+
+	// No send waited for room, the httpd thread was never blocked
+	host_httpd_stats(server, &frames, &send_us);
+	TEST_CHECK(send_us - send_us_before < 200000);
+
+	ws_client_stats_t stats[2];
+	TEST_CHECK_EQ(2, ws_client_get_stats(stats, 2));
+	TEST_CHECK(stats[0].stalls > 0);
+	TEST_CHECK(stats[0].dropped_frames > 0);
+	TEST_CHECK_EQ(0, stats[0].send_failures);
+	TEST_CHECK_EQ(WS_CLIENT_QUEUE_DEPTH, stats[0].queued_frames);
+	TEST_CHECK_EQ(200, stats[1].sent_frames);
+
+	// Once it reads again the retry timer catches it up, up to the newest frame
+	int last = -1;
+	while (client_read(&stalled, out, sizeof(out)) > 0)
+	{
+		last = atoi(out);
+		if (last == 199)
+		{
+			break;
+		}
+	}
+	TEST_CHECK_EQ(199, last);
+
+	client_close(&stalled);
+	client_close(&reader);
+}
+
+static void test_send_timeout(void)
+{
+	test_client_t client = client_open(false);
+	static char big[64 * 1024];
+
+	closed_fd = -1;
+	client_shrink(&client);
+
+	// Writable but the frame does not fit, the send waits out send_wait_ms and the client is dropped
+	memset(big, 'x', sizeof(big));
+	ws_msg_t *msg = ws_msg_create(big, sizeof(big), HTTPD_WS_TYPE_TEXT);
+	ws_client_broadcast(msg);
+	ws_msg_unref(msg);
+	host_httpd_sync(server);
+	host_httpd_sync(server);
+
+	TEST_CHECK_EQ(client.server, closed_fd);
+	ws_client_stats_t stats;
+	TEST_CHECK_EQ(0, ws_client_get_stats(&stats, 1));
+
+	client_close(&client);
+}
+
+static void test_groups_and_topics(void)
+{
+	test_client_t a = client_open(false);
+	test_client_t b = client_open(false);
+	ws_filter_t groups[WS_CLIENT_MAX_CLIENTS];
+	ws_filter_t warn;
+	char args[] = "level=W";
+	char out[64];
+
+	// Same subscription, same group
+	TEST_CHECK_EQ(1, __builtin_popcount(ws_client_get_groups(groups)));
+
+	ws_filter_parse(&warn, args);
+	ws_client_set_filter(b.server, &warn);
+	uint32_t active = ws_client_get_groups(groups);
+	TEST_CHECK_EQ(2, __builtin_popcount(active));
+
+	ws_client_stats_t stats[2];
+	ws_client_get_stats(stats, 2);
+	TEST_CHECK(stats[0].group != stats[1].group);
+	TEST_CHECK_EQ(ESP_LOG_WARN, groups[stats[1].group].level);
+
+	ws_msg_t *msg = ws_msg_create("warn", 4, HTTPD_WS_TYPE_TEXT);
+	ws_client_broadcast_group(msg, stats[1].group);
+	ws_msg_unref(msg);
+	TEST_CHECK_EQ(4, client_read(&b, out, sizeof(out)));
+
+	TEST_CHECK_EQ(0, ws_client_get_topics());
+	ws_client_set_topic(a.server, WS_CLIENT_TOPIC_METRICS, true);
+	TEST_CHECK_EQ(WS_CLIENT_TOPIC_METRICS, ws_client_get_topics());
+	msg = ws_msg_create("metrics", 7, HTTPD_WS_TYPE_TEXT);
+	ws_client_broadcast_topic(msg, WS_CLIENT_TOPIC_METRICS);
+	ws_msg_unref(msg);
+	TEST_CHECK_EQ(7, client_read(&a, out, sizeof(out)));
+
+	// Topics combine, each one is dropped on its own
+	ws_client_set_topic(a.server, WS_CLIENT_TOPIC_PROFILER, true);
+	TEST_CHECK_EQ(WS_CLIENT_TOPIC_METRICS | WS_CLIENT_TOPIC_PROFILER, ws_client_get_topics());
+	ws_client_set_topic(a.server, WS_CLIENT_TOPIC_METRICS, false);
+	TEST_CHECK_EQ(WS_CLIENT_TOPIC_PROFILER, ws_client_get_topics());
+	ws_client_set_topic(a.server, WS_CLIENT_TOPIC_PROFILER, false);
+	TEST_CHECK_EQ(0, ws_client_get_topics());
+
+	// Neither got the other one's frame
+	host_httpd_sync(server);
+	ws_client_get_stats(stats, 2);
+	TEST_CHECK_EQ(1, stats[0].sent_frames);
+	TEST_CHECK_EQ(1, stats[1].sent_frames);
+
+	client_close(&a);
+	client_close(&b);
+}
+
+static void test_replay(void)
+{
+	test_client_t client = client_open(true);
+	ws_client_replay_t replays[WS_CLIENT_MAX_CLIENTS];
+	char out[64];
+
+	TEST_CHECK_EQ(1, ws_client_get_replays(replays, WS_CLIENT_MAX_CLIENTS));
+	TEST_CHECK(!replays[0].started);
+
+	// Broadcasts skip a replaying client, direct sends reach it
+	broadcast_text("live");
+	ws_msg_t *msg = ws_msg_create("old", 3, HTTPD_WS_TYPE_TEXT);
+	TEST_CHECK_EQ(ESP_OK, ws_client_send(client.server, msg));
+	ws_msg_unref(msg);
+	TEST_CHECK_EQ(3, client_read(&client, out, sizeof(out)));
+
+	ws_client_set_replay(client.server, 42, true);
+	TEST_CHECK_EQ(0, ws_client_get_replays(replays, WS_CLIENT_MAX_CLIENTS));
+	broadcast_text("live");
+	TEST_CHECK_EQ(4, client_read(&client, out, sizeof(out)));
+
+	client_close(&client);
+}
+
+static void test_table_full(void)
+{
+	test_client_t clients[WS_CLIENT_MAX_CLIENTS];
+
+	for (int i = 0; i < WS_CLIENT_MAX_CLIENTS; ++i)
+	{
+		clients[i] = client_open(false);
+	}
+	TEST_CHECK_EQ(ESP_ERR_NO_MEM, ws_client_add(1000, false));
+	TEST_CHECK_EQ(ESP_OK, ws_client_add(clients[0].server, false));
+
+	for (int i = 0; i < WS_CLIENT_MAX_CLIENTS; ++i)
+	{
+		client_close(&clients[i]);
+	}
+}
+
+static void test_stop_while_stalled(void)
+{
+	test_client_t stalled = client_open(false);
+	char text[256];
+
+	// A client that stopped reading leaves the retry timer armed
+	client_shrink(&stalled);
+	memset(text, 'x', sizeof(text) - 1);
+	text[sizeof(text) - 1] = '\0';
+	for (int i = 0; i < 100; ++i)
+	{
+		broadcast_text(text);
+	}
+	host_httpd_sync(server);
+	ws_client_stats_t stats;
+	TEST_CHECK_EQ(1, ws_client_get_stats(&stats, 1));
+	TEST_CHECK(stats.stalls > 0);
+
+	// Stopped as http_server_stop does it, nothing queues work on the freed server afterwards
+	ws_client_init(NULL);
+	host_httpd_stop(server);
+	broadcast_text(text);
+	vTaskDelay(pdMS_TO_TICKS(3 * WS_CLIENT_STALL_RETRY_MS));
+	TEST_CHECK_EQ(0, ws_client_get_stats(&stats, 1));
+
+	close(stalled.server);
+	close(stalled.client);
+}
+
+int main(void)
+{
+	httpd_release = xSemaphoreCreateBinary();
+	server = host_httpd_start(1000, on_close);
+	ws_client_init(server);
+
+	TEST_RUN(test_broadcast);
+	TEST_RUN(test_drop_oldest);
+	TEST_RUN(test_drop_newest);
+	TEST_RUN(test_disconnect);
+	TEST_RUN(test_stalled_client);
+	TEST_RUN(test_send_timeout);
+	TEST_RUN(test_groups_and_topics);
+	TEST_RUN(test_replay);
+	TEST_RUN(test_table_full);
+	TEST_RUN(test_stop_while_stalled);
+	return TEST_RESULT();
+}
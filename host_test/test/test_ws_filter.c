@@ -0,0 +1,90 @@
+/*
+ * test_ws_filter.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdarg.h>
+
+#include "ws_filter.h"
+
+#include "host_test.h"
+
+static void classify(uint8_t *level, uint32_t *tag_hash, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	ws_filter_classify(format, args, level, tag_hash);
+	va_end(args);
+}
+
+static void test_parse(void)
+{
+	char args[] = "level=W tags=[WIFI_APP],-[http_server] compress=lz";
+	ws_filter_t filter;
+
+	TEST_CHECK_EQ(ESP_OK, ws_filter_parse(&filter, args));
+	TEST_CHECK_EQ(ESP_LOG_WARN, filter.level);
+	TEST_CHECK_EQ(1, filter.include_count);
+	TEST_CHECK_EQ(1, filter.exclude_count);
+	TEST_CHECK_EQ(ws_filter_tag_hash("[WIFI_APP]"), filter.include[0]);
+	TEST_CHECK_EQ(ws_filter_tag_hash("[http_server]"), filter.exclude[0]);
+	TEST_CHECK_EQ(WS_FILTER_COMPRESS_LZ, filter.compress);
+}
+
+static void test_parse_errors(void)
+{
+	char level[] = "level=X";
+	char key[] = "colour=red";
+	char tags[] = "tags=a,b,c,d,e,f,g,h,i";
+	ws_filter_t filter;
+
+	TEST_CHECK_EQ(ESP_ERR_INVALID_ARG, ws_filter_parse(&filter, level));
+	TEST_CHECK_EQ(ESP_ERR_INVALID_ARG, ws_filter_parse(&filter, key));
+	TEST_CHECK_EQ(ESP_ERR_INVALID_SIZE, ws_filter_parse(&filter, tags));
+}
+
+static void test_match(void)
+{
+	char args[] = "level=I tags=-noisy";
+	ws_filter_t filter;
+
+	ws_filter_parse(&filter, args);
+	TEST_CHECK(ws_filter_match(&filter, ESP_LOG_ERROR, ws_filter_tag_hash("app")));
+	TEST_CHECK(ws_filter_match(&filter, ESP_LOG_INFO, 0));
+	TEST_CHECK(!ws_filter_match(&filter, ESP_LOG_DEBUG, ws_filter_tag_hash("app")));
+	TEST_CHECK(!ws_filter_match(&filter, ESP_LOG_ERROR, ws_filter_tag_hash("noisy")));
+
+	char mute[] = "level=N";
+	ws_filter_parse(&filter, mute);
+	TEST_CHECK(!ws_filter_match(&filter, ESP_LOG_ERROR, 0));
+}
+
+static void test_classify(void)
+{
+	uint8_t level;
+	uint32_t tag_hash;
+
+	classify(&level, &tag_hash, "\033[0;33mW (%u) %s: disk %d%%\033[0m\n", 10U, "[disk]", 95);
+	TEST_CHECK_EQ(ESP_LOG_WARN, level);
+	TEST_CHECK_EQ(ws_filter_tag_hash("[disk]"), tag_hash);
+
+	classify(&level, &tag_hash, "I (%u) %s: up\n", 10U, "boot");
+	TEST_CHECK_EQ(ESP_LOG_INFO, level);
+	TEST_CHECK_EQ(ws_filter_tag_hash("boot"), tag_hash);
+
+	// printf straight to the console, no level or tag
+	classify(&level, &tag_hash, "plain %d\n", 1);
+	TEST_CHECK_EQ(ESP_LOG_NONE, level);
+	TEST_CHECK_EQ(0, tag_hash);
+}
+
+int main(void)
+{
+	TEST_RUN(test_parse);
+	TEST_RUN(test_parse_errors);
+	TEST_RUN(test_match);
+	TEST_RUN(test_classify);
+	return TEST_RESULT();
+}
@@ -0,0 +1,147 @@
+/*
+ * test_ws_rpc.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <poll.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "esp_timer.h"
+
+#include "host_httpd.h"
+#include "ws_rpc.h"
+
+#include "host_test.h"
+
+static httpd_handle_t server;
+static int server_fd;
+static int client_fd;
+
+static esp_err_t echo(httpd_req_t *req, char *args, char *reply, size_t reply_len)
+{
+	(void)req;
+	char *first = ws_rpc_next_token(&args);
+	snprintf(reply, reply_len, "%s|%s", first ? first : "", args);
+	return ESP_OK;
+}
+
+static esp_err_t fail(httpd_req_t *req, char *args, char *reply, size_t reply_len)
+{
+	(void)req;
+	(void)args;
+	(void)reply;
+	(void)reply_len;
+	return ESP_ERR_INVALID_STATE;
+}
+
+static const ws_rpc_route_t routes[] =
+{
+	{ "echo", echo },
+	{ "fail", fail },
+};
+
+// The text frame handler of http_server.c, minus the receive pool
+static esp_err_t handler(httpd_req_t *req)
+{
+	if (req->method == HTTP_GET)
+	{
+		return ESP_OK;
+	}
+
+	char msg[128];
+	httpd_ws_frame_t frame = { .payload = (uint8_t *)msg };
+	httpd_ws_recv_frame(req, &frame, 0);
+	httpd_ws_recv_frame(req, &frame, sizeof(msg) - 1);
+	msg[frame.len] = '\0';
+	return ws_rpc_dispatch(routes, sizeof(routes) / sizeof(routes[0]), req, msg, esp_timer_get_time());
+}
+
+/**
+ * Sends a command and reads the reply frame.
+ * @param msg command.
+ * @param out receives the reply, NUL terminated.
+ * @param size size of out.
+ * @return reply length, -1 if none came.
+ */
+static int call(const char *msg, char *out, size_t size)
+{
+	uint8_t header[4];
+
+	if (host_httpd_ws_recv(server, server_fd, HTTPD_WS_TYPE_TEXT, msg, strlen(msg)) != ESP_OK)
+	{
+		return -1;
+	}
+
+	struct pollfd ready = { .fd = client_fd, .events = POLLIN };
+	if (poll(&ready, 1, 1000) <= 0 || read(client_fd, header, sizeof(header)) != sizeof(header))
+	{
+		return -1;
+	}
+	uint32_t len = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+	if (len >= size || read(client_fd, out, len) != (ssize_t)len)
+	{
+		return -1;
+	}
+	out[len] = '\0';
+	return (int)len;
+}
+
+static void test_next_token(void)
+{
+	char text[] = "  one two   three ";
+	char *cursor = text;
+
+	TEST_CHECK(strcmp(ws_rpc_next_token(&cursor), "one") == 0);
+	TEST_CHECK(strcmp(ws_rpc_next_token(&cursor), "two") == 0);
+	TEST_CHECK(strcmp(ws_rpc_next_token(&cursor), "three") == 0);
+	TEST_CHECK(ws_rpc_next_token(&cursor) == NULL);
+}
+
+static void test_dispatch(void)
+{
+	char out[256];
+
+	TEST_CHECK(call("7 echo a b c", out, sizeof(out)) > 0);
+	TEST_CHECK(strcmp(out, "7 ok a|b c") == 0);
+
+	// Without an id the reply carries 0
+	TEST_CHECK(call("echo x", out, sizeof(out)) > 0);
+	TEST_CHECK(strcmp(out, "0 ok x|") == 0);
+
+	TEST_CHECK(call("8 fail", out, sizeof(out)) > 0);
+	TEST_CHECK(strcmp(out, "8 err ESP_ERR_INVALID_STATE") == 0);
+
+	TEST_CHECK(call("9 reboot", out, sizeof(out)) > 0);
+	TEST_CHECK(strcmp(out, "9 err unknown command reboot") == 0);
+
+	ws_rpc_stats_t stats;
+	ws_rpc_get_stats(&stats);
+	TEST_CHECK_EQ(4, stats.requests);
+	TEST_CHECK_EQ(2, stats.errors);
+	TEST_CHECK(stats.max_us >= stats.last_us);
+}
+
+int main(void)
+{
+	httpd_uri_t uri = { .uri = "/ws", .method = HTTP_GET, .handler = handler, .is_websocket = true };
+	int fds[2];
+
+	socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	server_fd = fds[0];
+	client_fd = fds[1];
+	server = host_httpd_start(1000, NULL);
+	httpd_register_uri_handler(server, &uri);
+	host_httpd_open(server, server_fd, "/ws");
+
+	TEST_RUN(test_next_token);
+	TEST_RUN(test_dispatch);
+
+	host_httpd_stop(server);
+	close(server_fd);
+	close(client_fd);
+	return TEST_RESULT();
+}
@@ -0,0 +1,145 @@
+/*
+ * test_ws_rx_pool.c
+ *
+ *  Created on: Jun 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "host_httpd.h"
+#include "ws_rx_pool.h"
+
+#include "host_test.h"
+
+static httpd_handle_t server;
+
+// What the handler below saw of the last frame
+static char received[WS_RX_POOL_SLOT_SIZE];
+static size_t streamed;
+static size_t chunks;
+static bool in_order;
+
+static esp_err_t on_chunk(httpd_req_t *req, const httpd_ws_frame_t *frame, const uint8_t *chunk, size_t len, size_t offset)
+{
+	(void)req;
+	(void)frame;
+
+	for (size_t i = 0; i < len; ++i)
+	{
+		in_order = in_order && chunk[i] == (uint8_t)(offset + i);
+	}
+	streamed += len;
+	chunks++;
+	return ESP_OK;
+}
+
+// Same pattern as ws_handler
+static esp_err_t handler(httpd_req_t *req)
+{
+	if (req->method == HTTP_GET)
+	{
+		return ESP_OK;
+	}
+
+	httpd_ws_frame_t frame = { 0 };
+	esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+	uint8_t *buf = err == ESP_OK ? ws_rx_pool_take() : NULL;
+	if (buf == NULL)
+	{
+		return ESP_ERR_NO_MEM;
+	}
+
+	if (frame.len >= WS_RX_POOL_SLOT_SIZE)
+	{
+		err = ws_rx_pool_stream(req, &frame, buf, on_chunk);
+	}
+	else
+	{
+		err = ws_rx_pool_recv(req, &frame, buf);
+		memcpy(received, buf, frame.len + 1);
+	}
+	ws_rx_pool_give(buf);
+	return err;
+}
+
+static void test_take_give(void)
+{
+	uint8_t *bufs[WS_RX_POOL_SLOTS];
+	ws_rx_pool_stats_t stats;
+
+	for (int i = 0; i < WS_RX_POOL_SLOTS; ++i)
+	{
+		bufs[i] = ws_rx_pool_take();
+		TEST_CHECK(bufs[i] != NULL);
+	}
+	TEST_CHECK(ws_rx_pool_take() == NULL);
+
+	ws_rx_pool_get_stats(&stats);
+	TEST_CHECK_EQ(WS_RX_POOL_SLOTS, stats.in_use);
+	TEST_CHECK_EQ(WS_RX_POOL_SLOTS, stats.high_water);
+	TEST_CHECK_EQ(1, stats.exhausted);
+
+	for (int i = 0; i < WS_RX_POOL_SLOTS; ++i)
+	{
+		ws_rx_pool_give(bufs[i]);
+	}
+	ws_rx_pool_give(NULL);
+	ws_rx_pool_get_stats(&stats);
+	TEST_CHECK_EQ(0, stats.in_use);
+}
+
+static void test_buffered(void)
+{
+	ws_rx_pool_stats_t stats;
+
+	TEST_CHECK_EQ(ESP_OK, host_httpd_ws_recv(server, 10, HTTPD_WS_TYPE_TEXT, "status", 6));
+	TEST_CHECK(strcmp(received, "status") == 0);
+
+	ws_rx_pool_get_stats(&stats);
+	TEST_CHECK_EQ(1, stats.buffered_frames);
+	TEST_CHECK_EQ(0, stats.in_use);
+}
+
+static void test_streamed(void)
+{
+	// Not a multiple of the chunk size, the last chunk is short
+	static uint8_t payload[3 * WS_RX_POOL_SLOT_SIZE + 5];
+	ws_rx_pool_stats_t stats;
+
+	for (size_t i = 0; i < sizeof(payload); ++i)
+	{
+		payload[i] = (uint8_t)i;
+	}
+	streamed = 0;
+	chunks = 0;
+	in_order = true;
+
+	TEST_CHECK_EQ(ESP_OK, host_httpd_ws_recv(server, 10, HTTPD_WS_TYPE_BINARY, payload, sizeof(payload)));
+	TEST_CHECK_EQ(sizeof(payload), streamed);
+	TEST_CHECK_EQ((sizeof(payload) + (WS_RX_POOL_SLOT_SIZE & ~3U) - 1) / (WS_RX_POOL_SLOT_SIZE & ~3U), chunks);
+	TEST_CHECK(in_order);
+
+	ws_rx_pool_get_stats(&stats);
+	TEST_CHECK_EQ(1, stats.streamed_frames);
+	TEST_CHECK_EQ(sizeof(payload), stats.streamed_bytes);
+	TEST_CHECK_EQ(0, stats.in_use);
+}
+
+int main(void)
+{
+	httpd_uri_t uri = { .uri = "/ws", .method = HTTP_GET, .handler = handler, .is_websocket = true };
+
+	server = host_httpd_start(1000, NULL);
+	httpd_register_uri_handler(server, &uri);
+	TEST_CHECK_EQ(ESP_OK, host_httpd_open(server, 10, "/ws"));
+
+	TEST_RUN(test_take_give);
+	TEST_RUN(test_buffered);
+	TEST_RUN(test_streamed);
+
+	host_httpd_stop(server);
+	return TEST_RESULT();
+}
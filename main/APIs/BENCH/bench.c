@@ -0,0 +1,340 @@
+/*
+ * bench.c
+ *
+ *  Created on: May 28, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/task.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_websocket_client.h"
+#include "sys/param.h"
+
+#include "bench.h"
+#include "http_server.h"
+#include "task_topology.h"
+
+#ifdef CONFIG_WS_BENCHMARK
+
+#define BENCH_MAGIC					0x484E4542	// "BENH"
+#define BENCH_CONNECTED_BIT			BIT0
+
+static const char TAG[] = "[bench]";
+
+/**
+ * Progress of the benchmark, kept in RTC memory across the restarts between topologies
+ */
+typedef struct bench_state
+{
+	uint32_t magic;
+	uint32_t next;					///> Topology measured at this boot, the preset count once all were
+	bench_result_t results[BENCH_MAX_PRESETS];
+} bench_state_t;
+
+static RTC_NOINIT_ATTR bench_state_t bench_state;
+
+// Loopback client counters, written by the websocket client task
+static EventGroupHandle_t bench_events = NULL;
+static atomic_bool bench_measuring = false;
+static atomic_uint bench_ws_bytes = 0;
+static atomic_uint bench_ws_lines = 0;
+static atomic_uint bench_ws_gap_max_us = 0;
+static int64_t bench_ws_last_us = 0;
+
+static esp_timer_handle_t bench_restart_timer = NULL;
+
+static uint32_t bench_preset_count(void)
+{
+	return MIN(task_topology_preset_count(), BENCH_MAX_PRESETS);
+}
+
+static void bench_reset(void)
+{
+	memset(&bench_state, 0, sizeof(bench_state));
+	bench_state.magic = BENCH_MAGIC;
+}
+
+/**
+ * Loopback client events. Nothing is logged here, a log line would come back as another frame.
+ */
+static void bench_ws_event(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+	esp_websocket_event_data_t *data = (esp_websocket_event_data_t *)event_data;
+
+	switch (event_id)
+	{
+		case WEBSOCKET_EVENT_CONNECTED:
+			xEventGroupSetBits(bench_events, BENCH_CONNECTED_BIT);
+			break;
+
+		case WEBSOCKET_EVENT_DISCONNECTED:
+			xEventGroupClearBits(bench_events, BENCH_CONNECTED_BIT);
+			break;
+
+		case WEBSOCKET_EVENT_DATA:
+		{
+			// Continuation, text and binary frames, the client answers the pings itself
+			if (data->op_code > 0x2)
+			{
+				break;
+			}
+
+			uint32_t lines = 0;
+			for (int i = 0; i < data->data_len; ++i)
+			{
+				lines += (data->data_ptr[i] == '\n');
+			}
+			atomic_fetch_add(&bench_ws_lines, lines);
+
+			if (!atomic_load(&bench_measuring))
+			{
+				bench_ws_last_us = 0;
+				break;
+			}
+			atomic_fetch_add(&bench_ws_bytes, data->data_len);
+
+			// Gaps are taken between the starts of two frames
+			if (data->payload_offset == 0)
+			{
+				int64_t now = esp_timer_get_time();
+				if (bench_ws_last_us != 0 && now - bench_ws_last_us > atomic_load(&bench_ws_gap_max_us))
+				{
+					atomic_store(&bench_ws_gap_max_us, (unsigned)(now - bench_ws_last_us));
+				}
+				bench_ws_last_us = now;
+			}
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
+/**
+ * Writes BENCH_LINES_PER_S log lines a second for BENCH_SECONDS, a batch every tick,
+ * and measures how late the load task wakes up.
+ * @param result receives the load figures.
+ */
+static void bench_load(bench_result_t *result)
+{
+	static const char pad[BENCH_LINE_PAD + 1] = "................................................";
+	const uint32_t per_tick = MAX(1, BENCH_LINES_PER_S / configTICK_RATE_HZ);
+	const uint32_t ticks = BENCH_SECONDS * configTICK_RATE_HZ;
+	const int64_t tick_us = 1000000 / configTICK_RATE_HZ;
+	uint64_t late_sum = 0;
+	uint64_t late_sum_sq = 0;
+	uint32_t late_max = 0;
+	ws_log_stats_t before;
+	ws_log_stats_t after;
+
+	ws_log_get_stats(&before);
+	atomic_store(&bench_ws_bytes, 0);
+	atomic_store(&bench_ws_lines, 0);
+	atomic_store(&bench_ws_gap_max_us, 0);
+	atomic_store(&bench_measuring, true);
+
+	// Starts on a tick edge, every wake-up after it is due tick_us later than the one before
+	TickType_t wake = xTaskGetTickCount();
+	vTaskDelayUntil(&wake, 1);
+	int64_t start = esp_timer_get_time();
+
+	for (uint32_t t = 1; t <= ticks; ++t)
+	{
+		vTaskDelayUntil(&wake, 1);
+
+		int64_t late = esp_timer_get_time() - start - t * tick_us;
+		uint32_t late_us = late > 0 ? (uint32_t)late : 0;
+		late_sum += late_us;
+		late_sum_sq += (uint64_t)late_us * late_us;
+		late_max = MAX(late_max, late_us);
+
+		for (uint32_t i = 0; i < per_tick; ++i)
+		{
+			ESP_LOGI(TAG, "%08u %s", result->lines++, pad);
+		}
+	}
+
+	int64_t elapsed_us = esp_timer_get_time() - start;
+	atomic_store(&bench_measuring, false);
+	uint32_t ws_bytes = atomic_load(&bench_ws_bytes);
+
+	// Lines still in the ring or in flight are counted, not timed
+	vTaskDelay(pdMS_TO_TICKS(BENCH_DRAIN_MS));
+	ws_log_get_stats(&after);
+
+	double mean = (double)late_sum / ticks;
+	double variance = (double)late_sum_sq / ticks - mean * mean;
+
+	result->lines_per_s = (uint64_t)result->lines * 1000000 / MAX(elapsed_us, 1);
+	result->dropped = after.dropped - before.dropped;
+	result->ws_lines = atomic_load(&bench_ws_lines);
+	result->ws_bytes_per_s = (uint64_t)ws_bytes * 1000000 / MAX(elapsed_us, 1);
+	result->ws_gap_max_us = atomic_load(&bench_ws_gap_max_us);
+	result->jitter_mean_us = (uint32_t)mean;
+	result->jitter_sd_us = (uint32_t)sqrt(variance > 0 ? variance : 0);
+	result->jitter_max_us = late_max;
+}
+
+/**
+ * Logs the results of every topology measured so far.
+ */
+static void bench_log_results(void)
+{
+	char line[160];
+
+	for (uint32_t i = 0; i < bench_preset_count(); ++i)
+	{
+		if (bench_format(i, line, sizeof(line)) == ESP_OK)
+		{
+			ESP_LOGI(TAG, "%s", line);
+		}
+	}
+}
+
+/**
+ * Benchmark task, measures the topology of this boot through a loopback websocket client
+ * and restarts into the next one.
+ * @param pvParameters parameter which can be passed to the task.
+ */
+static void bench_task(void *pvParameters)
+{
+	uint32_t preset = bench_state.next;
+	bench_result_t *result = &bench_state.results[preset];
+	esp_websocket_client_config_t config = {
+		.uri = BENCH_URI,
+		.task_prio = task_topology_get(TASK_TOPOLOGY_BENCH).priority,
+	};
+
+	memset(result, 0, sizeof(*result));
+	ESP_LOGI(TAG, "topology %u of %u: %s", preset + 1, bench_preset_count(), task_topology_preset_name(preset));
+
+	bench_events = xEventGroupCreate();
+	http_server_acquire(HTTP_SERVER_USER_BENCH);
+
+	esp_websocket_client_handle_t client = esp_websocket_client_init(&config);
+	esp_websocket_register_events(client, WEBSOCKET_EVENT_ANY, bench_ws_event, NULL);
+	esp_websocket_client_start(client);
+
+	EventBits_t bits = xEventGroupWaitBits(bench_events, BENCH_CONNECTED_BIT, pdFALSE, pdTRUE, pdMS_TO_TICKS(BENCH_CONNECT_MS));
+	if ((bits & BENCH_CONNECTED_BIT) == 0)
+	{
+		ESP_LOGE(TAG, "no loopback connection to %s", BENCH_URI);
+		result->err = ESP_ERR_TIMEOUT;
+	}
+	else
+	{
+		// Plain text frames, so the client can count the lines
+		const char subscribe[] = "1 subscribe level=I compress=none";
+		esp_websocket_client_send_text(client, subscribe, sizeof(subscribe) - 1, portMAX_DELAY);
+		vTaskDelay(pdMS_TO_TICKS(BENCH_WARMUP_MS));
+
+		ws_log_console_mute(true);
+		bench_load(result);
+		ws_log_console_mute(false);
+		result->err = ESP_OK;
+	}
+
+	esp_websocket_client_stop(client);
+	esp_websocket_client_destroy(client);
+	http_server_release(HTTP_SERVER_USER_BENCH);
+	vEventGroupDelete(bench_events);
+
+	char line[160];
+	bench_format(preset, line, sizeof(line));
+	ESP_LOGI(TAG, "%s", line);
+
+	bench_state.next = preset + 1;
+	if (bench_state.next < bench_preset_count())
+	{
+		ESP_LOGI(TAG, "restarting into %s", task_topology_preset_name(bench_state.next));
+		esp_restart();
+	}
+
+	ESP_LOGI(TAG, "all topologies measured, restarting into %s", task_topology_preset_name(0));
+	bench_log_results();
+	esp_restart();
+}
+
+void bench_boot(void)
+{
+	// RTC memory holds garbage after a power cycle, a new firmware starts a new run
+	if (esp_reset_reason() == ESP_RST_POWERON || bench_state.magic != BENCH_MAGIC ||
+		bench_state.next > bench_preset_count())
+	{
+		bench_reset();
+	}
+
+	task_topology_select(bench_state.next < bench_preset_count() ? bench_state.next : 0);
+}
+
+void bench_start(void)
+{
+	if (bench_state.next >= bench_preset_count())
+	{
+		bench_log_results();
+		return;
+	}
+
+	task_topology_create(TASK_TOPOLOGY_BENCH, bench_task, NULL, NULL);
+}
+
+esp_err_t bench_format(uint32_t preset, char *out, size_t size)
+{
+	if (preset >= bench_preset_count())
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (preset >= bench_state.next)
+	{
+		return ESP_ERR_NOT_FINISHED;
+	}
+
+	const bench_result_t *result = &bench_state.results[preset];
+	if (result->err != ESP_OK)
+	{
+		snprintf(out, size, "%s err=%s", task_topology_preset_name(preset), esp_err_to_name(result->err));
+		return ESP_OK;
+	}
+
+	snprintf(out, size, "%s lines/s=%u dropped=%u ws_lines=%u/%u ws_B/s=%u gap_ms=%u.%03u jitter_us=%u/%u/%u",
+			 task_topology_preset_name(preset), result->lines_per_s, result->dropped,
+			 result->ws_lines, result->lines, result->ws_bytes_per_s,
+			 result->ws_gap_max_us / 1000, result->ws_gap_max_us % 1000,
+			 result->jitter_mean_us, result->jitter_sd_us, result->jitter_max_us);
+	return ESP_OK;
+}
+
+static void bench_restart_cb(void *arg)
+{
+	esp_restart();
+}
+
+void bench_rerun(void)
+{
+	bench_reset();
+
+	// Leaves time for the reply to reach the client
+	if (bench_restart_timer == NULL)
+	{
+		const esp_timer_create_args_t args = {
+			.callback = bench_restart_cb,
+			.name = "bench_restart",
+		};
+		esp_timer_create(&args, &bench_restart_timer);
+	}
+	esp_timer_start_once(bench_restart_timer, 500 * 1000);
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * bench.h
+ *
+ *  Created on: May 28, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_BENCH_H_
+#define MAIN_BENCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Load, see Websocket Log Streaming / Task topology in menuconfig
+#define BENCH_SECONDS				CONFIG_WS_BENCHMARK_SECONDS
+#define BENCH_LINES_PER_S			CONFIG_WS_BENCHMARK_LINES_PER_S
+#define BENCH_LINE_PAD				48		// Filler characters per line, about 80 bytes with the esp_log prefix
+
+// Loopback websocket client
+#define BENCH_URI					"ws://127.0.0.1/ws"
+#define BENCH_CONNECT_MS			15000	// Longest wait for the server and the handshake
+#define BENCH_WARMUP_MS				1000	// Settling time before the measurement, the log history replays meanwhile
+#define BENCH_DRAIN_MS				1000	// Time left for queued lines to arrive after the load stops
+
+// Largest number of topologies kept, see task_topology_preset_count
+#define BENCH_MAX_PRESETS			8
+
+/**
+ * Measurement of one topology
+ */
+typedef struct bench_result
+{
+	uint32_t lines;					///> Lines written by the load task
+	uint32_t lines_per_s;			///> Lines written per second, below the configured rate when the load could not keep up
+	uint32_t dropped;				///> Lines lost because the log ring was full
+	uint32_t ws_lines;				///> Lines the loopback client received, the drain time included
+	uint32_t ws_bytes_per_s;		///> Websocket payload bytes the client received per second of load
+	uint32_t ws_gap_max_us;			///> Longest time between two frames at the client during the load
+	uint32_t jitter_mean_us;		///> Mean wake-up lateness of the load task
+	uint32_t jitter_sd_us;			///> Standard deviation of the lateness
+	uint32_t jitter_max_us;			///> Worst lateness
+	esp_err_t err;					///> ESP_OK if the run completed
+} bench_result_t;
+
+/**
+ * Selects the task topology of this boot: the next one to measure while the benchmark
+ * runs, the one from menuconfig once it is done. Call it first in app_main, before any
+ * task of the topology table is created.
+ */
+void bench_boot(void);
+
+/**
+ * Starts the run of this boot, if one is pending. The run measures its topology,
+ * stores the result across the restart and restarts into the next topology.
+ * After the last one the results are logged and the device runs normally.
+ */
+void bench_start(void);
+
+/**
+ * Writes the result of a topology as one line of text.
+ * @param preset topology number.
+ * @param out text buffer.
+ * @param size size of out.
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if there is no such topology, ESP_ERR_NOT_FINISHED if it was not measured yet.
+ */
+esp_err_t bench_format(uint32_t preset, char *out, size_t size);
+
+/**
+ * Forgets the results and restarts the device into the first topology half a second later.
+ */
+void bench_rerun(void);
+
+#endif /* MAIN_BENCH_H_ */
@@ -0,0 +1,128 @@
+/*
+ * event_bus.c
+ *
+ *  Created on: May 20, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <string.h>
+
+#include "event_bus.h"
+
+bool event_bus_init(event_bus_t *bus, const char *name, size_t normal_depth, size_t high_depth)
+{
+	memset(bus, 0x00, sizeof(event_bus_t));
+	bus->name = name;
+	for (int i = 0; i < EVENT_BUS_PRIORITY_COUNT; ++i)
+	{
+		atomic_init(&bus->posted[i], 0);
+		atomic_init(&bus->overflows[i], 0);
+	}
+
+	bus->queues[EVENT_BUS_PRIORITY_NORMAL] = xQueueCreate(normal_depth, sizeof(event_bus_event_t));
+	bus->queues[EVENT_BUS_PRIORITY_HIGH] = xQueueCreate(high_depth, sizeof(event_bus_event_t));
+	bus->pending = xSemaphoreCreateCounting(normal_depth + high_depth, 0);
+
+	return bus->queues[EVENT_BUS_PRIORITY_NORMAL] && bus->queues[EVENT_BUS_PRIORITY_HIGH] && bus->pending;
+}
+
+/**
+ * Builds an event.
+ * @param event event to fill.
+ * @param id event id.
+ * @param priority event_bus_priority_e.
+ * @param payload bytes copied into the event.
+ * @param len payload length.
+ * @return false if the event can not be posted.
+ */
+static bool event_bus_prepare(event_bus_event_t *event, uint16_t id, event_bus_priority_e priority, const void *payload, size_t len)
+{
+	if (len > EVENT_BUS_PAYLOAD_SIZE || priority >= EVENT_BUS_PRIORITY_COUNT)
+	{
+		return false;
+	}
+
+	event->id = id;
+	event->priority = priority;
+	event->len = len;
+	if (len)
+	{
+		memcpy(event->payload, payload, len);
+	}
+	return true;
+}
+
+/**
+ * Counts a post.
+ * @param bus bus posted to.
+ * @param priority priority of the event.
+ * @param queued true if the event made it into its queue.
+ * @return queued.
+ */
+static bool event_bus_count(event_bus_t *bus, event_bus_priority_e priority, bool queued)
+{
+	priority = priority < EVENT_BUS_PRIORITY_COUNT ? priority : EVENT_BUS_PRIORITY_NORMAL;
+	atomic_fetch_add_explicit(queued ? &bus->posted[priority] : &bus->overflows[priority], 1, memory_order_relaxed);
+	return queued;
+}
+
+bool event_bus_post(event_bus_t *bus, uint16_t id, event_bus_priority_e priority, const void *payload, size_t len)
+{
+	event_bus_event_t event;
+
+	bool queued = bus->pending && event_bus_prepare(&event, id, priority, payload, len) &&
+			xQueueSend(bus->queues[priority], &event, 0) == pdTRUE;
+	if (queued)
+	{
+		// Never fails, the count is as large as both queues together
+		xSemaphoreGive(bus->pending);
+	}
+	return event_bus_count(bus, priority, queued);
+}
+
+bool event_bus_post_from_isr(event_bus_t *bus, uint16_t id, event_bus_priority_e priority, const void *payload, size_t len, BaseType_t *woken)
+{
+	event_bus_event_t event;
+
+	bool queued = bus->pending && event_bus_prepare(&event, id, priority, payload, len) &&
+			xQueueSendFromISR(bus->queues[priority], &event, woken) == pdTRUE;
+	if (queued)
+	{
+		xSemaphoreGiveFromISR(bus->pending, woken);
+	}
+	return event_bus_count(bus, priority, queued);
+}
+
+bool event_bus_receive(event_bus_t *bus, event_bus_event_t *event, TickType_t wait)
+{
+	if (bus->pending == NULL || xSemaphoreTake(bus->pending, wait) != pdTRUE)
+	{
+		return false;
+	}
+
+	// Every count given matches one queued event, high priority first
+	UBaseType_t waiting = 0;
+	for (int i = EVENT_BUS_PRIORITY_COUNT - 1; i >= 0; --i)
+	{
+		waiting += uxQueueMessagesWaiting(bus->queues[i]);
+	}
+	for (int i = EVENT_BUS_PRIORITY_COUNT - 1; i >= 0; --i)
+	{
+		if (xQueueReceive(bus->queues[i], event, 0) == pdTRUE)
+		{
+			if (waiting > bus->high_water)
+			{
+				bus->high_water = waiting;
+			}
+			bus->received++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void event_bus_payload(const event_bus_event_t *event, void *out, size_t len)
+{
+	memset(out, 0x00, len);
+	memcpy(out, event->payload, len < event->len ? len : event->len);
+}
@@ -0,0 +1,112 @@
+/*
+ * event_bus.h
+ *
+ *  Created on: May 20, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_EVENT_BUS_H_
+#define MAIN_EVENT_BUS_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+// Largest payload carried inside an event
+#define EVENT_BUS_PAYLOAD_SIZE		12
+
+/**
+ * Event priorities, each one has its own queue
+ */
+typedef enum event_bus_priority
+{
+	EVENT_BUS_PRIORITY_NORMAL = 0,
+	EVENT_BUS_PRIORITY_HIGH,		///> Received before any normal event, never crowded out by them
+	EVENT_BUS_PRIORITY_COUNT,
+} event_bus_priority_e;
+
+/**
+ * Event with its payload inline, copied into the queue so nothing is allocated per event
+ */
+typedef struct event_bus_event
+{
+	uint16_t id;					///> Owner defined, e.g. wifi_app_message_e
+	uint8_t priority;				///> event_bus_priority_e
+	uint8_t len;					///> Payload bytes used
+	uint8_t payload[EVENT_BUS_PAYLOAD_SIZE];
+} event_bus_event_t;
+
+/**
+ * Event queues owned by one consumer task, posted to from tasks, event handlers and ISRs.
+ *
+ * Posting never blocks: if the queue of the event's priority is full the event is dropped
+ * and counted, so a burst of events can not stall the esp_event loop or a timer. Events of
+ * the same priority are received in order, high priority ones before normal ones.
+ */
+typedef struct event_bus
+{
+	const char *name;
+	QueueHandle_t queues[EVENT_BUS_PRIORITY_COUNT];
+	SemaphoreHandle_t pending;		///> Counts the events in all queues, the consumer waits on it
+	_Atomic uint32_t posted[EVENT_BUS_PRIORITY_COUNT];
+	_Atomic uint32_t overflows[EVENT_BUS_PRIORITY_COUNT];		///> Events dropped because their queue was full
+	uint32_t received;				///> Counted by the consumer
+	uint32_t high_water;			///> Largest number of events the consumer found queued
+} event_bus_t;
+
+/**
+ * Creates the queues of a bus.
+ * @param bus bus to initialize.
+ * @param name name used in metrics.
+ * @param normal_depth normal priority events the bus holds.
+ * @param high_depth high priority events the bus holds.
+ * @return true if the bus was created.
+ */
+bool event_bus_init(event_bus_t *bus, const char *name, size_t normal_depth, size_t high_depth);
+
+/**
+ * Posts an event without blocking, from a task or an esp_event handler.
+ * @param bus bus to post to, an uninitialized bus drops the event.
+ * @param id event id.
+ * @param priority event_bus_priority_e.
+ * @param payload bytes copied into the event, may be NULL if len is 0.
+ * @param len payload length, at most EVENT_BUS_PAYLOAD_SIZE.
+ * @return true if the event was queued.
+ */
+bool event_bus_post(event_bus_t *bus, uint16_t id, event_bus_priority_e priority, const void *payload, size_t len);
+
+/**
+ * Posts an event from an ISR.
+ * @param bus bus to post to.
+ * @param id event id.
+ * @param priority event_bus_priority_e.
+ * @param payload bytes copied into the event.
+ * @param len payload length, at most EVENT_BUS_PAYLOAD_SIZE.
+ * @param woken set to pdTRUE if a higher priority task was woken, see portYIELD_FROM_ISR.
+ * @return true if the event was queued.
+ */
+bool event_bus_post_from_isr(event_bus_t *bus, uint16_t id, event_bus_priority_e priority, const void *payload, size_t len, BaseType_t *woken);
+
+/**
+ * Waits for the next event, high priority ones first. Only the owner task may call it.
+ * @param bus bus to receive from.
+ * @param event receives the event.
+ * @param wait ticks to wait, portMAX_DELAY to wait forever.
+ * @return true if an event was received.
+ */
+bool event_bus_receive(event_bus_t *bus, event_bus_event_t *event, TickType_t wait);
+
+/**
+ * Copies the payload of an event, zero filling what the poster did not send.
+ * @param event event received.
+ * @param out buffer receiving the payload.
+ * @param len size of out, at most EVENT_BUS_PAYLOAD_SIZE.
+ */
+void event_bus_payload(const event_bus_event_t *event, void *out, size_t len);
+
+#endif /* MAIN_EVENT_BUS_H_ */
@@ -7,21 +7,51 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "sys/param.h"
 
 
+#include "soc/soc_memory_layout.h"
+
+#include "app_nvs.h"
+#include "event_bus.h"
 #include "http_server.h"
+#include "log_bin.h"
+#include "log_history.h"
+#include "log_lz.h"
+#include "log_ring.h"
+#include "log_store.h"
+#include "metrics.h"
+#include "ota_stream.h"
+#include "ota_ws.h"
+#include "task_topology.h"
 #include "wifi_app.h"
+#include "ws_client.h"
+#include "ws_filter.h"
+#include "ws_rpc.h"
+#include "ws_rx_pool.h"
+#include "www.h"
+#ifdef CONFIG_WS_PROFILER
+#include "profiler.h"
+#endif
+#ifdef CONFIG_WS_BENCHMARK
+#include "bench.h"
+#endif
 
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 static const char TAG[] = "[http_server]";
 
@@ -33,9 +63,6 @@ static const char TAG[] = "[http_server]";
 	#define HTTP_DEBUG(...)
 #endif
 
-// Max number clients for websocket communication.
-static const size_t max_clients = 4;
-
 // Wifi connect status
 static int g_wifi_connect_status = NONE;
 
@@ -46,14 +73,81 @@ static int g_fw_update_status = OTA_UPDATE_PENDING;
 static bool g_is_local_time_set = false;
 
 
+// Log records waiting to be sent to the websocket clients
+static log_ring_t ws_log_ring;
+static uint8_t ws_log_ring_buff[WS_LOG_RING_SIZE] __attribute__((aligned(4)));
+
+// Websocket log task handle, notified every time a record is committed
+static TaskHandle_t task_ws_print = NULL;
+
+// Log lines kept off the serial console, see ws_log_console_mute
+static volatile bool ws_log_console_muted = false;
+
+#ifdef CONFIG_WS_LOG_COMPRESSION
+// Compressor state and window, the preset dictionary followed by the lines of one frame
+static log_lz_t ws_log_lz;
+static uint8_t ws_log_lz_window[LOG_LZ_DICT_MAX_LEN + WS_LOG_BATCH_SIZE];
+static size_t ws_log_lz_dict_len = 0;
+
+// Compression counters, written by the websocket log task only
+static uint32_t ws_log_lz_in_bytes = 0;
+static uint32_t ws_log_lz_out_bytes = 0;
+static uint32_t ws_log_lz_us = 0;
+#endif
+
+#ifdef CONFIG_WS_LOG_STORE
+// Log lines kept in the "logstore" partition, downloaded from GET /logs
+static log_store_t ws_log_store;
+static log_store_flash_t ws_log_store_flash;
+static uint8_t ws_log_store_batch[WS_LOG_STORE_BATCH_SIZE];
+
+// Taken by ws_print to append and by the /logs handler to read, NULL if the store did not mount
+static SemaphoreHandle_t ws_log_store_mutex = NULL;
+#endif
+
 // HTTP server task handle
 static httpd_handle_t http_server_handle = NULL;
 
 // HTTP server monitor task handle
 static TaskHandle_t task_http_server_monitor = NULL;
 
-// Queue handle used to manipulate the main queue of events
-static QueueHandle_t http_server_monitor_queue_handle;
+// Events for the HTTP server monitor, created once by http_server_init
+static event_bus_t http_server_monitor_bus;
+
+/**
+ * Payload of HTTP_MSG_SERVER_ACQUIRE and HTTP_MSG_SERVER_RELEASE
+ */
+typedef struct http_server_user_event
+{
+	uint32_t time_us;				///> Low bits of esp_timer_get_time, differences stay valid across the wrap
+	uint8_t user;					///> http_server_user_e
+} http_server_user_event_t;
+
+// References held on the server per interface and lifecycle counters, written by the monitor task only
+static uint32_t http_server_users[HTTP_SERVER_USER_COUNT];
+static uint32_t http_server_starts = 0;
+static uint32_t http_server_stops = 0;
+static uint32_t http_server_start_us = 0;
+
+// Stops the server HTTP_SERVER_IDLE_STOP_MS after the last release, NULL if it never stops
+static esp_timer_handle_t http_server_idle_timer = NULL;
+
+/**
+ * Time to first frame probe. A station joining the SoftAP arms it, the next websocket
+ * handshake is taken as that station's client and its first frame ends the measurement.
+ */
+typedef enum http_server_probe_state
+{
+	HTTP_SERVER_PROBE_IDLE = 0,
+	HTTP_SERVER_PROBE_JOINED,		///> Waiting for a websocket handshake
+	HTTP_SERVER_PROBE_OPENED,		///> Waiting for the first frame sent to http_server_probe_fd
+} http_server_probe_state_e;
+
+static _Atomic int http_server_probe_state = HTTP_SERVER_PROBE_IDLE;
+static uint32_t http_server_probe_join_us = 0;		///> Written by the monitor task before the probe is armed
+static int http_server_probe_fd = -1;				///> Read and written on the httpd task only
+static uint32_t http_server_join_to_open_us = 0;
+static uint32_t http_server_join_to_frame_us = 0;
 
 /**
  * ESP32 timer configuration passed to esp_timer_create.
@@ -66,62 +160,58 @@ const esp_timer_create_args_t fw_update_reset_args = {
 };
 esp_timer_handle_t fw_update_reset;
 
-/*
- * Structure holding server handle
- * and internal socket fd in order
- * to use out of request send
- */
-struct async_resp_arg {
-    httpd_handle_t hd;
-    int fd;
+// Periodic push of the metrics to the clients subscribed to WS_CLIENT_TOPIC_METRICS
+static esp_timer_handle_t http_server_metrics_timer = NULL;
 
-	char *data;
-};
-	
+// An HTTP_MSG_METRICS_PUSH is waiting on the monitor bus, a busy monitor gets one, not a backlog
+static atomic_bool http_server_metrics_pending;
 
-void http_ws_server_send_messages(char * data)
+// Firmware upload, used by the httpd task only. The counters of the last upload stay for /metrics
+static ota_stream_t http_server_ota_stream;
+static ota_sink_t http_server_ota_sink;
+static ota_sink_partition_t http_server_ota_partition;
+static uint32_t http_server_ota_rate = 0;		///> KB/s of the last upload
+static const ota_stream_stats_t *http_server_ota_stats = &http_server_ota_stream.stats;	///> Counters of the latest upload, POST or websocket
+
+// Firmware upload over /ws binary frames, kept across reconnects of its sender until it ends or idles out
+static ota_ws_t http_server_ota_ws;
+static esp_timer_handle_t http_server_ota_ws_timer = NULL;
+static int64_t http_server_ota_ws_last_us = 0;			///> When the sender was last heard from
+static int64_t http_server_ota_ws_reported = 0;		///> When the last progress frame was sent
+
+// Dashboard counters, written by the httpd task only
+static uint32_t http_server_www_requests = 0;
+static uint32_t http_server_www_not_modified = 0;
+static uint32_t http_server_www_bytes = 0;
+
+void http_ws_server_send_msg(ws_msg_t *msg)
 {
+	// Each client gets its own queue, a stalled one cannot hold back the others
+	ws_client_broadcast(msg);
+}
 
-	if (!http_server_handle) { // httpd might not have been created by now
-		return;
-	}
+void http_ws_server_send_messages(const char *data, size_t len)
+{
+	ws_msg_t *msg = ws_msg_create(data, len, HTTPD_WS_TYPE_TEXT);
 
-	size_t clients = max_clients;
-    int    client_fds[max_clients];
-	if (httpd_get_client_list(http_server_handle, &clients, client_fds) == ESP_OK) 
+	if (msg)
 	{
-		    for (size_t i=0; i < clients; ++i) 
-			{
-                int sock = client_fds[i];
-                if (httpd_ws_get_fd_info(http_server_handle, sock) == HTTPD_WS_CLIENT_WEBSOCKET) {
-                 
-                    struct async_resp_arg *resp_arg = malloc(sizeof(struct async_resp_arg));
-                    resp_arg->hd = http_server_handle;
-                    resp_arg->fd = sock;
-					resp_arg->data = data;
-
-
-					httpd_handle_t hd = resp_arg->hd;
-					int fd = resp_arg->fd;
-					const char * data = resp_arg->data;;
-					httpd_ws_frame_t ws_pkt;
-					memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-					ws_pkt.payload = (uint8_t*)data;
-					ws_pkt.len = strlen(data);
-					ws_pkt.type = HTTPD_WS_TYPE_TEXT;
-
-					httpd_ws_send_frame_async(hd, fd, &ws_pkt);
-					free(resp_arg);
-
-                }
-            }
-	} 
-	else 
-	{
-        ESP_LOGE(TAG, "httpd_get_client_list failed!");
-        return;
-    }
+		http_ws_server_send_msg(msg);
+		ws_msg_unref(msg);
+	}
+}
 
+/**
+ * Session close hook, forgets the websocket client before its socket is closed.
+ * Together with the handshake in ws_handler this keeps the ws_client table in step
+ * with the open sessions, so broadcasts never have to walk the httpd session list.
+ * @param hd server handle.
+ * @param sockfd socket being closed.
+ */
+static void http_server_close_fn(httpd_handle_t hd, int sockfd)
+{
+	ws_client_remove(sockfd);
+	close(sockfd);
 }
 
 
@@ -150,19 +240,153 @@ void http_server_set_connect_status(http_server_wifi_connect_status_e wifi_conne
 	g_wifi_connect_status = wifi_connect_status;
 }
 
+static httpd_handle_t http_server_configure(void);
+static void http_server_metrics_push(void);
+
+/**
+ * Starts the HTTP server if it is not running. Monitor task only.
+ */
+static void http_server_start(void)
+{
+	if (http_server_handle == NULL)
+	{
+		int64_t start = esp_timer_get_time();
+		if (http_server_configure())
+		{
+			http_server_starts++;
+			http_server_start_us = esp_timer_get_time() - start;
+			HTTP_DEBUG("http_server_start: started in %u us", http_server_start_us);
+		}
+	}
+}
+
+/**
+ * Stops the HTTP server, closing every session. Monitor task only.
+ */
+static void http_server_stop(void)
+{
+	if (http_server_handle)
+	{
+		httpd_handle_t hd = http_server_handle;
+
+		// Senders and the retry timer let go of the handle before httpd_stop frees it
+		esp_timer_stop(http_server_ota_ws_timer);
+		ws_client_init(NULL);
+		http_server_handle = NULL;
+		HTTP_DEBUG("http_server_stop: stopping HTTP server");
+		httpd_stop(hd);
+
+		// No sender can come back to it, the httpd task that owned it is gone
+		ota_ws_abort(&http_server_ota_ws);
+		http_server_stops++;
+	}
+}
+
+/**
+ * Adds the references of every interface.
+ * @return references held on the server.
+ */
+static uint32_t http_server_users_total(void)
+{
+	uint32_t total = 0;
+
+	for (int i = 0; i < HTTP_SERVER_USER_COUNT; ++i)
+	{
+		total += http_server_users[i];
+	}
+	return total;
+}
+
+/**
+ * HTTP_MSG_SERVER_ACQUIRE, takes a reference and makes sure the server runs.
+ * A station joining the SoftAP also arms the time to first frame probe.
+ * @param event interface and time of the request.
+ */
+static void http_server_lifecycle_acquire(const http_server_user_event_t *event)
+{
+	if (event->user >= HTTP_SERVER_USER_COUNT)
+	{
+		return;
+	}
+
+	http_server_users[event->user]++;
+	if (event->user == HTTP_SERVER_USER_AP)
+	{
+		http_server_probe_join_us = event->time_us;
+		atomic_store(&http_server_probe_state, HTTP_SERVER_PROBE_JOINED);
+	}
+
+	if (http_server_idle_timer)
+	{
+		esp_timer_stop(http_server_idle_timer);
+	}
+	http_server_start();
+}
+
+/**
+ * HTTP_MSG_SERVER_RELEASE, drops a reference. The server and its tasks stay up,
+ * the idle timer only stops it if nobody acquires it again in time.
+ * @param event interface and time of the request.
+ */
+static void http_server_lifecycle_release(const http_server_user_event_t *event)
+{
+	if (event->user >= HTTP_SERVER_USER_COUNT || http_server_users[event->user] == 0)
+	{
+		return;
+	}
+
+	http_server_users[event->user]--;
+	if (http_server_users_total() == 0 && http_server_idle_timer)
+	{
+		esp_timer_stop(http_server_idle_timer);
+		esp_timer_start_once(http_server_idle_timer, HTTP_SERVER_IDLE_STOP_MS * 1000ULL);
+	}
+}
+
+/**
+ * HTTP_MSG_SERVER_IDLE, stops the server if still nobody uses it.
+ */
+static void http_server_lifecycle_idle(void)
+{
+	wifi_sta_list_t wifi_sta_list;
+
+	// A join lost to a full event bus must not stop the server under a station still on the SoftAP
+	if (esp_wifi_ap_get_sta_list(&wifi_sta_list) == ESP_OK && wifi_sta_list.num > http_server_users[HTTP_SERVER_USER_AP])
+	{
+		http_server_users[HTTP_SERVER_USER_AP] = wifi_sta_list.num;
+	}
+
+	if (http_server_users_total() == 0)
+	{
+		http_server_stop();
+	}
+}
+
+#if HTTP_SERVER_IDLE_STOP_MS > 0
+/**
+ * esp_timer callback of the idle timer, the monitor task does the stopping.
+ * @param arg unused.
+ */
+static void http_server_idle_callback(void *arg)
+{
+	http_server_monitor_send_message(HTTP_MSG_SERVER_IDLE);
+}
+#endif
+
 /**
  * HTTP server monitor task used to track events of the HTTP server
  * @param pvParameters parameter which can be passed to the task.
  */
 static void http_server_monitor(void *parameter)
 {
-	http_server_queue_message_t msg;
+	event_bus_event_t msg;
+	http_server_user_event_t user_event;
 
 	for (;;)
 	{
-		if (xQueueReceive(http_server_monitor_queue_handle, &msg, portMAX_DELAY))
+		if (event_bus_receive(&http_server_monitor_bus, &msg, portMAX_DELAY))
 		{
-			switch (msg.msgID)
+			switch (msg.id)
 			{
 				case HTTP_MSG_WIFI_CONNECT_INIT:
 					HTTP_DEBUG("HTTP_MSG_WIFI_CONNECT_INIT");
@@ -211,6 +435,32 @@ static void http_server_monitor(void *parameter)
 
 					break;
 
+				case HTTP_MSG_SERVER_ACQUIRE:
+					event_bus_payload(&msg, &user_event, sizeof(user_event));
+					HTTP_DEBUG("HTTP_MSG_SERVER_ACQUIRE: user %u", user_event.user);
+					http_server_lifecycle_acquire(&user_event);
+
+					break;
+
+				case HTTP_MSG_SERVER_RELEASE:
+					event_bus_payload(&msg, &user_event, sizeof(user_event));
+					HTTP_DEBUG("HTTP_MSG_SERVER_RELEASE: user %u", user_event.user);
+					http_server_lifecycle_release(&user_event);
+
+					break;
+
+				case HTTP_MSG_SERVER_IDLE:
+					HTTP_DEBUG("HTTP_MSG_SERVER_IDLE");
+					http_server_lifecycle_idle();
+
+					break;
+
+				case HTTP_MSG_METRICS_PUSH:
+					atomic_store(&http_server_metrics_pending, false);
+					http_server_metrics_push();
+
+					break;
+
 				default:
 					break;
 			}
@@ -219,195 +469,1829 @@ static void http_server_monitor(void *parameter)
 }
 
 
-/*
- * This handler echos back the received ws data
- * and triggers an async send if certain message received
+/**
+ * "subscribe [level=<E|W|I|D|V>] [tags=<tag>,-<tag>,...]", changes the log lines sent to the client.
  */
-static esp_err_t ws_handler(httpd_req_t *req)
+static esp_err_t http_server_rpc_subscribe(httpd_req_t *req, char *args, char *reply, size_t reply_len)
 {
-    if (req->method == HTTP_GET) {
-        ESP_LOGI(TAG, "Handshake done, the new connection was opened");
-        return ESP_OK;
-    }
-    httpd_ws_frame_t ws_pkt;
-    uint8_t *buf = NULL;
-    memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-    ws_pkt.type = HTTPD_WS_TYPE_TEXT;
-    /* Set max_len = 0 to get the frame len */
-    esp_err_t ret = httpd_ws_recv_frame(req, &ws_pkt, 0);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "httpd_ws_recv_frame failed to get frame len with %d", ret);
-        return ret;
-    }
-    ESP_LOGI(TAG, "frame len is %d", ws_pkt.len);
-    if (ws_pkt.len) {
-        /* ws_pkt.len + 1 is for NULL termination as we are expecting a string */
-        buf = calloc(1, ws_pkt.len + 1);
-        if (buf == NULL) {
-            ESP_LOGE(TAG, "Failed to calloc memory for buf");
-            return ESP_ERR_NO_MEM;
-        }
-        ws_pkt.payload = buf;
-        /* Set max_len = ws_pkt.len to get the frame payload */
-        ret = httpd_ws_recv_frame(req, &ws_pkt, ws_pkt.len);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "httpd_ws_recv_frame failed with %d", ret);
-            free(buf);
-            return ret;
-        }
-        ESP_LOGI(TAG, "Got packet with message: %s", ws_pkt.payload);
-    }
-    return ret;
+	ws_filter_t filter;
+	int fd = httpd_req_to_sockfd(req);
+
+	esp_err_t err = ws_filter_parse(&filter, args);
+	if (err == ESP_OK)
+	{
+		ws_client_add(fd, false);
+		err = ws_client_set_filter(fd, &filter);
+	}
+
+	if (err == ESP_OK)
+	{
+		snprintf(reply, reply_len, "level=%u include=%u exclude=%u",
+				filter.level, filter.include_count, filter.exclude_count);
+	}
+	return err;
 }
 
 /**
- * Sets up the default httpd server configuration.
- * @return http server instance handle if successful, NULL otherwise.
+ * "connect <ssid> [password]", joins an access point as station. The SSID ends at the first
+ * space, the password is the rest of the line, spaces included.
  */
-static httpd_handle_t http_server_configure(void)
+static esp_err_t http_server_rpc_connect(httpd_req_t *req, char *args, char *reply, size_t reply_len)
 {
-	// Generate the default configuration
-	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+	char *ssid = ws_rpc_next_token(&args);
+	char *password = *args != '\0' ? args : NULL;
 
-	// Create HTTP server monitor task
-	xTaskCreatePinnedToCore(&http_server_monitor, "http_server_monitor", HTTP_SERVER_MONITOR_STACK_SIZE, NULL, HTTP_SERVER_MONITOR_PRIORITY, &task_http_server_monitor,HTTP_SERVER_MONITOR_CORE_ID);
+	if (ssid == NULL || strlen(ssid) > MAX_SSID_LENGTH || (password && strlen(password) > MAX_PASSWORD_LENGTH))
+	{
+		snprintf(reply, reply_len, "usage: connect <ssid> [password]");
+		return ESP_ERR_INVALID_ARG;
+	}
 
-	// Create the message queue
-	http_server_monitor_queue_handle = xQueueCreate(3, sizeof(http_server_queue_message_t));
+	if (wifi_app_request_connect(ssid, password) != pdTRUE)
+	{
+		snprintf(reply, reply_len, "busy");
+		return ESP_ERR_NO_MEM;
+	}
+	snprintf(reply, reply_len, "connecting to %s", ssid);
+	return ESP_OK;
+}
 
-	// The core that the HTTP server will run on
-	config.core_id = HTTP_SERVER_TASK_CORE_ID;
+/**
+ * "networks", lists the saved networks, most recently connected first.
+ */
+static esp_err_t http_server_rpc_networks(httpd_req_t *req, char *args, char *reply, size_t reply_len)
+{
+	app_nvs_network_t network;
+	size_t written = snprintf(reply, reply_len, "count=%u", (unsigned)app_nvs_get_network_count());
 
-	// Adjust the default priority to 1 less than the wifi application task
-	config.task_priority = HTTP_SERVER_TASK_PRIORITY;
+	for (size_t i = 0; written < reply_len && app_nvs_get_network(i, &network); i++)
+	{
+		written += snprintf(&reply[written], reply_len - written, " %.32s:last=%u,rssi=%d,ch=%u",
+				(char *)network.ssid, network.last_success, network.rssi, network.link.channel);
+	}
+	return ESP_OK;
+}
 
-	// Bump up the stack size (default is 4096)
-	config.stack_size = HTTP_SERVER_TASK_STACK_SIZE;
+/**
+ * "disconnect", drops the station connection, stops reconnecting and forgets the network.
+ */
+static esp_err_t http_server_rpc_disconnect(httpd_req_t *req, char *args, char *reply, size_t reply_len)
+{
+	if (wifi_app_send_message(WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT) != pdTRUE)
+	{
+		snprintf(reply, reply_len, "busy");
+		return ESP_ERR_NO_MEM;
+	}
+	snprintf(reply, reply_len, "disconnecting");
+	return ESP_OK;
+}
 
-	// Increase uri handlers
-	config.max_uri_handlers = 25;
+/**
+ * "status", reports the station connection, firmware update and time state.
+ */
+static esp_err_t http_server_rpc_status(httpd_req_t *req, char *args, char *reply, size_t reply_len)
+{
+	esp_netif_ip_info_t ip_info = {0};
 
-	// Increase the timeout limits
-	config.recv_wait_timeout = 10;
-	config.send_wait_timeout = 10;
+	if (esp_netif_sta)
+	{
+		esp_netif_get_ip_info(esp_netif_sta, &ip_info);
+	}
 
-	config.max_open_sockets = max_clients;
+	snprintf(reply, reply_len, "wifi=%d ssid=%.32s ip=" IPSTR " ota=%d time=%d heap=%u uptime=%lld",
+			g_wifi_connect_status, (char *)wifi_app_get_wifi_config()->sta.ssid, IP2STR(&ip_info.ip),
+			g_fw_update_status, g_is_local_time_set, esp_get_free_heap_size(), (long long)(esp_timer_get_time() / 1000000));
+	return ESP_OK;
+}
 
-	HTTP_DEBUG("http_server_configure: Starting server on port: '%d' with task priority: '%d'",
-			config.server_port,
-			config.task_priority);
+/**
+ * "loglevel <tag|*> <N|E|W|I|D|V>", sets the esp_log level of a tag.
+ */
+static esp_err_t http_server_rpc_loglevel(httpd_req_t *req, char *args, char *reply, size_t reply_len)
+{
+	char *tag = ws_rpc_next_token(&args);
+	char *letter = ws_rpc_next_token(&args);
+	uint8_t level = letter ? ws_filter_level_from_letter(letter[0]) : ESP_LOG_NONE;
 
-	// Start the httpd server
-	if (httpd_start(&http_server_handle, &config) == ESP_OK)
+	if (tag == NULL || letter == NULL || letter[1] != '\0' || (level == ESP_LOG_NONE && letter[0] != 'N'))
 	{
-		HTTP_DEBUG("http_server_configure: Registering URI handlers");
-
-		httpd_uri_t ws = {
-        .uri        = "/ws",
-        .method     = HTTP_GET,
-        .handler    = ws_handler,
-        .user_ctx   = NULL,
-        .is_websocket = true,
-		.handle_ws_control_frames = true
-		};
-		httpd_register_uri_handler(http_server_handle, &ws);
-	
-		return http_server_handle;
+		snprintf(reply, reply_len, "usage: loglevel <tag|*> <N|E|W|I|D|V>");
+		return ESP_ERR_INVALID_ARG;
 	}
 
-	return NULL;
+	esp_log_level_set(tag, level);
+	snprintf(reply, reply_len, "%s=%c", tag, letter[0]);
+	return ESP_OK;
 }
 
-void http_server_start(void)
+/**
+ * "stats", reports the websocket clients, receive pool and command latency counters.
+ */
+static esp_err_t http_server_rpc_stats(httpd_req_t *req, char *args, char *reply, size_t reply_len)
 {
-	if (http_server_handle == NULL)
+	ws_client_stats_t clients[WS_CLIENT_MAX_CLIENTS];
+	ws_rx_pool_stats_t pool;
+	ws_rpc_stats_t rpc;
+	uint32_t sent = 0, dropped = 0, queued = 0;
+
+	size_t count = ws_client_get_stats(clients, WS_CLIENT_MAX_CLIENTS);
+	for (size_t i = 0; i < count; ++i)
+	{
+		sent += clients[i].sent_frames;
+		dropped += clients[i].dropped_frames;
+		queued += clients[i].queued_frames;
+	}
+	ws_rx_pool_get_stats(&pool);
+	ws_rpc_get_stats(&rpc);
+
+	int written = snprintf(reply, reply_len, "clients=%u sent=%u dropped=%u queued=%u ring_dropped=%u "
+			"rx_pool=%u/%u rx_high=%u rx_streamed=%u rpc=%u rpc_err=%u rpc_last_us=%u rpc_max_us=%u rpc_avg_us=%u",
+			(unsigned)count, sent, dropped, queued, atomic_load_explicit(&ws_log_ring.dropped, memory_order_relaxed),
+			pool.in_use, pool.slots, pool.high_water, pool.streamed_frames,
+			rpc.requests, rpc.errors, rpc.last_us, rpc.max_us, rpc.requests ? (uint32_t)(rpc.total_us / rpc.requests) : 0);
+
+#ifdef CONFIG_WS_LOG_COMPRESSION
+	// Ratio in hundredths, CPU cost in microseconds per KB of uncompressed log lines
+	if (written > 0 && (size_t)written < reply_len)
 	{
-		http_server_handle = http_server_configure();
+		snprintf(&reply[written], reply_len - written, " lz_in=%u lz_out=%u lz_ratio=%u lz_us_per_kb=%u",
+				ws_log_lz_in_bytes, ws_log_lz_out_bytes,
+				ws_log_lz_out_bytes ? (uint32_t)(100ULL * ws_log_lz_in_bytes / ws_log_lz_out_bytes) : 0,
+				ws_log_lz_in_bytes ? (uint32_t)(1024ULL * ws_log_lz_us / ws_log_lz_in_bytes) : 0);
 	}
+#else
+	(void)written;
+#endif
+	return ESP_OK;
 }
 
-
-void http_server_stop(void)
+/**
+ * "metrics <on|off>", starts or stops the periodic metrics frames, see WS_METRICS_PERIOD_MS.
+ */
+static esp_err_t http_server_rpc_metrics(httpd_req_t *req, char *args, char *reply, size_t reply_len)
 {
+	char *state = ws_rpc_next_token(&args);
+	int fd = httpd_req_to_sockfd(req);
 
-	wifi_sta_list_t wifi_sta_list; 
-	esp_wifi_ap_get_sta_list(&wifi_sta_list);
-
-	if(wifi_sta_list.num == false) // Only stop server if it's connected one client.
+	if (state == NULL || (strcmp(state, "on") != 0 && strcmp(state, "off") != 0))
 	{
-		if (http_server_handle)
-		{
-			httpd_stop(http_server_handle);
-			HTTP_DEBUG("http_server_stop: stopping HTTP server");
-			http_server_handle = NULL;
-		}
-		if (task_http_server_monitor)
-		{
-			vTaskDelete(task_http_server_monitor);
-			HTTP_DEBUG("http_server_stop: stopping HTTP server monitor");
-			task_http_server_monitor = NULL;
-		}
+		snprintf(reply, reply_len, "usage: metrics <on|off>");
+		return ESP_ERR_INVALID_ARG;
 	}
-	
-}
 
-BaseType_t http_server_monitor_send_message(http_server_message_e msgID)
-{
-	
-	http_server_queue_message_t msg;
-	msg.msgID = msgID;
-	return xQueueSend(http_server_monitor_queue_handle, &msg, portMAX_DELAY);
-	
+	ws_client_add(fd, false);
+	esp_err_t err = ws_client_set_topic(fd, WS_CLIENT_TOPIC_METRICS, strcmp(state, "on") == 0);
+	if (err == ESP_OK)
+	{
+		snprintf(reply, reply_len, "metrics=%s period_ms=%u", state, WS_METRICS_PERIOD_MS);
+	}
+	return err;
 }
 
-void http_server_fw_update_reset_callback(void *arg)
+#ifdef CONFIG_WS_PROFILER
+/**
+ * "profile <on|off>", starts or stops the binary task samples, see profiler.h.
+ */
+static esp_err_t http_server_rpc_profile(httpd_req_t *req, char *args, char *reply, size_t reply_len)
 {
-	HTTP_DEBUG("http_server_fw_update_reset_callback: Timer timed-out, restarting the device");
-	esp_restart();
-}
-
-
-// ------------------------------------------ * Websocket functions * --------------------------------
+	char *state = ws_rpc_next_token(&args);
+	int fd = httpd_req_to_sockfd(req);
 
-static QueueHandle_t ws_queue = NULL;
+	if (state == NULL || (strcmp(state, "on") != 0 && strcmp(state, "off") != 0))
+	{
+		snprintf(reply, reply_len, "usage: profile <on|off>");
+		return ESP_ERR_INVALID_ARG;
+	}
 
+	ws_client_add(fd, false);
+	esp_err_t err = ws_client_set_topic(fd, WS_CLIENT_TOPIC_PROFILER, strcmp(state, "on") == 0);
+	if (err == ESP_OK)
+	{
+		snprintf(reply, reply_len, "profile=%s period_ms=%u max_tasks=%u", state, PROFILER_PERIOD_MS, PROFILER_MAX_TASKS);
+	}
+	return err;
+}
+#endif
 
-void ws_print(void *pvParameters)
+#ifdef CONFIG_WS_BENCHMARK
+/**
+ * "bench [<topology>|run]", shows the topology in use, the result of a measured topology,
+ * or forgets the results and measures every topology again, see bench.h.
+ */
+static esp_err_t http_server_rpc_bench(httpd_req_t *req, char *args, char *reply, size_t reply_len)
 {
-	char buffer[255];
-	
-	for(;;)
+	char *arg = ws_rpc_next_token(&args);
+	uint32_t active = task_topology_active();
+	uint32_t count = task_topology_preset_count();
+
+	if (arg == NULL)
 	{
-		if(xQueueReceive(ws_queue, &(buffer), (portTickType)portMAX_DELAY))
+		uint32_t measured = 0;
+		char line[8];
+		for (uint32_t i = 0; i < count; ++i)
 		{
-			http_ws_server_send_messages(buffer);
+			measured += (bench_format(i, line, sizeof(line)) == ESP_OK);
 		}
+		snprintf(reply, reply_len, "topology=%s measured=%u/%u", task_topology_preset_name(active), measured, count);
+		return ESP_OK;
 	}
-	
-}
 
+	if (strcmp(arg, "run") == 0)
+	{
+		bench_rerun();
+		snprintf(reply, reply_len, "restarting into %s", task_topology_preset_name(0));
+		return ESP_OK;
+	}
+
+	char *end = NULL;
+	uint32_t preset = strtoul(arg, &end, 10);
+	if (end == arg || *end != '\0')
+	{
+		snprintf(reply, reply_len, "usage: bench [<0-%u>|run]", count - 1);
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	esp_err_t err = bench_format(preset, reply, reply_len);
+	if (err == ESP_ERR_NOT_FINISHED)
+	{
+		snprintf(reply, reply_len, "%s not measured yet", task_topology_preset_name(preset));
+	}
+	else if (err != ESP_OK)
+	{
+		snprintf(reply, reply_len, "no topology %u", preset);
+	}
+	return err;
+}
+#endif
+
+/**
+ * Writes one labeled sample per websocket client for a counter of ws_client_stats_t.
+ * @param writer output.
+ * @param name metric name.
+ * @param type "counter" or "gauge".
+ * @param help description of the metric.
+ * @param clients client counters.
+ * @param count number of entries in clients.
+ * @param field offsetof the uint32_t counter in ws_client_stats_t.
+ */
+static void http_server_metrics_clients(metrics_writer_t *writer, const char *name, const char *type, const char *help,
+		const ws_client_stats_t *clients, size_t count, size_t field)
+{
+	char labels[16];
+
+	metrics_write_family(writer, name, type, help);
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t value;
+		memcpy(&value, (const uint8_t *)&clients[i] + field, sizeof(value));
+		snprintf(labels, sizeof(labels), "fd=\"%d\"", clients[i].fd);
+		metrics_write_sample(writer, name, labels, value);
+	}
+}
+
+/**
+ * Writes the counters of the event buses, labeled by bus and priority.
+ * @param writer output.
+ */
+static void http_server_metrics_buses(metrics_writer_t *writer)
+{
+	static const char *priorities[EVENT_BUS_PRIORITY_COUNT] = { "normal", "high" };
+	const event_bus_t *buses[] = { wifi_app_get_event_bus(), &http_server_monitor_bus };
+	char labels[48];
+
+	metrics_write_family(writer, "event_bus_posted_total", "counter", "Events queued on the bus.");
+	for (size_t i = 0; i < sizeof(buses) / sizeof(buses[0]); ++i)
+	{
+		for (int p = 0; p < EVENT_BUS_PRIORITY_COUNT; ++p)
+		{
+			snprintf(labels, sizeof(labels), "bus=\"%s\",priority=\"%s\"", buses[i]->name ? buses[i]->name : "", priorities[p]);
+			metrics_write_sample(writer, "event_bus_posted_total", labels, atomic_load_explicit(&buses[i]->posted[p], memory_order_relaxed));
+		}
+	}
+
+	metrics_write_family(writer, "event_bus_overflows_total", "counter", "Events dropped because their queue was full.");
+	for (size_t i = 0; i < sizeof(buses) / sizeof(buses[0]); ++i)
+	{
+		for (int p = 0; p < EVENT_BUS_PRIORITY_COUNT; ++p)
+		{
+			snprintf(labels, sizeof(labels), "bus=\"%s\",priority=\"%s\"", buses[i]->name ? buses[i]->name : "", priorities[p]);
+			metrics_write_sample(writer, "event_bus_overflows_total", labels, atomic_load_explicit(&buses[i]->overflows[p], memory_order_relaxed));
+		}
+	}
+
+	metrics_write_family(writer, "event_bus_high_water_events", "gauge", "Most events the consumer found queued.");
+	for (size_t i = 0; i < sizeof(buses) / sizeof(buses[0]); ++i)
+	{
+		snprintf(labels, sizeof(labels), "bus=\"%s\"", buses[i]->name ? buses[i]->name : "");
+		metrics_write_sample(writer, "event_bus_high_water_events", labels, buses[i]->high_water);
+	}
+}
+
+/**
+ * Writes the log pipeline, client, command and heap metrics in the Prometheus text format.
+ * Every counter is read without stopping its writer, so a scrape costs the loggers nothing.
+ * @param writer output.
+ */
+static void http_server_metrics_render(metrics_writer_t *writer)
+{
+	ws_client_stats_t clients[WS_CLIENT_MAX_CLIENTS];
+	ws_rx_pool_stats_t pool;
+	ws_rpc_stats_t rpc;
+	app_nvs_stats_t nvs;
+	wifi_app_stats_t wifi;
+
+	size_t count = ws_client_get_stats(clients, WS_CLIENT_MAX_CLIENTS);
+	ws_rx_pool_get_stats(&pool);
+	ws_rpc_get_stats(&rpc);
+	app_nvs_get_stats(&nvs);
+	wifi_app_get_stats(&wifi);
+
+	metrics_write_value(writer, "ws_log_lines_total", "counter", "Log lines taken off the ring by the websocket log task.",
+			ws_log_ring.consumed);
+	metrics_write_value(writer, "ws_log_lines_dropped_total", "counter", "Log lines lost because the ring was full.",
+			atomic_load_explicit(&ws_log_ring.dropped, memory_order_relaxed));
+	metrics_write_value(writer, "ws_log_ring_used_bytes", "gauge", "Bytes of log lines waiting in the ring.",
+			log_ring_used(&ws_log_ring));
+	metrics_write_value(writer, "ws_log_ring_high_water_bytes", "gauge", "Most bytes ever waiting in the ring.",
+			ws_log_ring.high_water);
+	metrics_write_value(writer, "ws_log_ring_size_bytes", "gauge", "Size of the log ring.", WS_LOG_RING_SIZE);
+
+	metrics_write_value(writer, "ws_clients", "gauge", "Websocket clients connected.", count);
+	http_server_metrics_clients(writer, "ws_client_sent_bytes_total", "counter", "Bytes handed to the client socket.",
+			clients, count, offsetof(ws_client_stats_t, sent_bytes));
+	http_server_metrics_clients(writer, "ws_client_sent_frames_total", "counter", "Frames handed to the client socket.",
+			clients, count, offsetof(ws_client_stats_t, sent_frames));
+	http_server_metrics_clients(writer, "ws_client_send_failures_total", "counter", "Frames the client socket refused.",
+			clients, count, offsetof(ws_client_stats_t, send_failures));
+	http_server_metrics_clients(writer, "ws_client_dropped_frames_total", "counter", "Frames lost to the slow client policy.",
+			clients, count, offsetof(ws_client_stats_t, dropped_frames));
+	http_server_metrics_clients(writer, "ws_client_stalls_total", "counter", "Drains put off because the client socket was full.",
+			clients, count, offsetof(ws_client_stats_t, stalls));
+	http_server_metrics_clients(writer, "ws_client_queued_frames", "gauge", "Frames waiting in the client queue.",
+			clients, count, offsetof(ws_client_stats_t, queued_frames));
+	http_server_metrics_clients(writer, "ws_client_queue_high_water_frames", "gauge", "Most frames ever waiting in the client queue.",
+			clients, count, offsetof(ws_client_stats_t, high_water));
+	metrics_write_histogram(writer, "ws_send_latency_seconds", "Time from queueing a frame on a client to handing it to the socket.",
+			ws_client_get_latency());
+
+	metrics_write_value(writer, "ws_rx_pool_high_water", "gauge", "Most receive buffers ever in use.", pool.high_water);
+	metrics_write_value(writer, "ws_rpc_requests_total", "counter", "Websocket commands answered.", rpc.requests);
+	metrics_write_value(writer, "ws_rpc_errors_total", "counter", "Websocket commands answered with err.", rpc.errors);
+
+#ifdef CONFIG_WS_LOG_COMPRESSION
+	metrics_write_value(writer, "ws_log_lz_in_bytes_total", "counter", "Log bytes fed to the compressor.", ws_log_lz_in_bytes);
+	metrics_write_value(writer, "ws_log_lz_out_bytes_total", "counter", "Compressed log bytes produced.", ws_log_lz_out_bytes);
+#endif
+#ifdef CONFIG_WS_LOG_STORE
+	metrics_write_value(writer, "log_store_chunks_total", "counter", "Chunks written to the log partition.", ws_log_store.chunks_written);
+	metrics_write_value(writer, "log_store_erases_total", "counter", "Sectors erased in the log partition.", ws_log_store.erases);
+#endif
+
+	http_server_metrics_buses(writer);
+
+	metrics_write_value(writer, "http_server_starts_total", "counter", "HTTP server starts.", http_server_starts);
+	metrics_write_value(writer, "http_server_stops_total", "counter", "HTTP server stops after the idle delay.", http_server_stops);
+	metrics_write_value(writer, "http_server_start_us", "gauge", "Time taken by the latest server start.", http_server_start_us);
+	metrics_write_family(writer, "http_server_users", "gauge", "References held on the server.");
+	metrics_write_sample(writer, "http_server_users", "interface=\"ap\"", http_server_users[HTTP_SERVER_USER_AP]);
+	metrics_write_sample(writer, "http_server_users", "interface=\"sta\"", http_server_users[HTTP_SERVER_USER_STA]);
+	metrics_write_sample(writer, "http_server_users", "interface=\"bench\"", http_server_users[HTTP_SERVER_USER_BENCH]);
+	metrics_write_value(writer, "ws_join_to_open_ms", "gauge", "Time from the latest SoftAP station join to the next websocket handshake.",
+			http_server_join_to_open_us / 1000);
+	metrics_write_value(writer, "ws_join_to_first_frame_ms", "gauge", "Time from the latest SoftAP station join to the first frame of that client.",
+			http_server_join_to_frame_us / 1000);
+
+	metrics_write_value(writer, "nvs_reads_total", "counter", "Configuration blob reads.", nvs.reads);
+	metrics_write_value(writer, "nvs_writes_total", "counter", "Configuration blob writes and erases, one commit each.", nvs.writes);
+	metrics_write_value(writer, "nvs_skipped_writes_total", "counter", "Configuration saves skipped because nothing changed.", nvs.skipped_writes);
+	metrics_write_value(writer, "nvs_boot_load_us", "gauge", "Time taken to read the configuration at boot.", nvs.boot_load_us);
+
+	metrics_write_value(writer, "wifi_got_ip_ms", "gauge", "Time from app_main to the first station IP, 0 until then.", wifi.got_ip_us < 0 ? 0 : wifi.got_ip_us / 1000);
+	metrics_write_value(writer, "wifi_connect_ms", "gauge", "Time from the latest connect to its IP.", wifi.connect_us / 1000);
+	metrics_write_value(writer, "wifi_fast_connects_total", "counter", "Connects started on the saved access point.", wifi.fast_attempts);
+	metrics_write_value(writer, "wifi_fast_fallbacks_total", "counter", "Saved access point connects that fell back to a full scan.", wifi.fast_fallbacks);
+	metrics_write_value(writer, "wifi_reconnects_total", "counter", "Reconnects started by the backoff timer.", wifi.reconnects);
+	metrics_write_value(writer, "wifi_recoveries_total", "counter", "Station outages that ended with an IP.", wifi.recoveries);
+	metrics_write_value(writer, "wifi_last_recovery_ms", "gauge", "Time from the first disconnect of the latest outage to its IP.", wifi.last_recovery_us / 1000);
+	metrics_write_value(writer, "wifi_max_recovery_ms", "gauge", "Longest outage since boot.", wifi.max_recovery_us / 1000);
+	metrics_write_value(writer, "wifi_backoff_ms", "gauge", "Delay before the pending reconnect, 0 if none.", wifi.backoff_ms);
+	metrics_write_value(writer, "wifi_scans_total", "counter", "Scans started to pick a saved network.", wifi.scans);
+	metrics_write_value(writer, "wifi_select_us", "gauge", "Time taken to rank the latest scan.", wifi.select_us);
+	metrics_write_value(writer, "wifi_failovers_total", "counter", "Connects moved to the next saved network of a scan.", wifi.failovers);
+	metrics_write_value(writer, "wifi_last_disconnect_reason", "gauge", "Reason code of the latest station disconnect.", wifi.last_reason);
+
+	metrics_write_value(writer, "ota_received_bytes", "gauge", "Image bytes received by the latest upload.", http_server_ota_stats->received);
+	metrics_write_value(writer, "ota_rate_kbytes", "gauge", "Speed of the latest finished upload in KB/s.", http_server_ota_rate);
+	metrics_write_value(writer, "ota_write_ms", "gauge", "Time the latest upload spent writing flash.", http_server_ota_stats->write_us / 1000);
+	metrics_write_value(writer, "ota_stall_ms", "gauge", "Time the latest upload waited for flash writes.", http_server_ota_stats->stall_us / 1000);
+	metrics_write_value(writer, "ota_ws_chunks_total", "counter", "Websocket upload chunks accepted.", http_server_ota_ws.stats.chunks);
+	metrics_write_value(writer, "ota_ws_duplicates_total", "counter", "Websocket upload chunks received again after a resume.", http_server_ota_ws.stats.duplicates);
+	metrics_write_value(writer, "ota_ws_rejects_total", "counter", "Websocket upload chunks answered with a nak.", http_server_ota_ws.stats.rejects);
+	metrics_write_value(writer, "ota_ws_resumes_total", "counter", "Websocket uploads resumed after a dropped connection.", http_server_ota_ws.stats.resumes);
+
+	metrics_write_value(writer, "www_requests_total", "counter", "Dashboard files requested.", http_server_www_requests);
+	metrics_write_value(writer, "www_not_modified_total", "counter", "Dashboard requests answered 304 from the browser cache.", http_server_www_not_modified);
+	metrics_write_value(writer, "www_sent_bytes_total", "counter", "Gzipped dashboard bytes sent.", http_server_www_bytes);
+
+#ifdef CONFIG_WS_PROFILER
+	metrics_write_value(writer, "profiler_sample_us", "gauge", "Cost of the latest task profiler sample.", profiler_get()->sample_us);
+	metrics_write_value(writer, "profiler_sample_max_us", "gauge", "Worst task profiler sample cost.", profiler_get()->max_sample_us);
+#endif
+
+	metrics_write_value(writer, "heap_free_bytes", "gauge", "Free heap.", esp_get_free_heap_size());
+	metrics_write_value(writer, "heap_min_free_bytes", "gauge", "Lowest free heap since boot.", esp_get_minimum_free_heap_size());
+	metrics_write_value(writer, "uptime_seconds", "counter", "Time since boot.", esp_timer_get_time() / 1000000);
+}
+
+/**
+ * HTTP_MSG_METRICS_PUSH, sends the metrics to the clients that asked for them.
+ * Runs on the monitor task, rendering needs more stack than the esp_timer task has.
+ */
+static void http_server_metrics_push(void)
+{
+	static bool warned = false;
+	metrics_writer_t writer;
+
+	if (!(ws_client_get_topics() & WS_CLIENT_TOPIC_METRICS))
+	{
+		return;
+	}
+
+	ws_msg_t *msg = ws_msg_alloc(HTTP_SERVER_METRICS_MAX_LEN, HTTPD_WS_TYPE_TEXT);
+	if (msg == NULL)
+	{
+		return;
+	}
+
+	metrics_writer_init(&writer, (char *)msg->payload, HTTP_SERVER_METRICS_MAX_LEN);
+	http_server_metrics_render(&writer);
+
+	// Once per boot, the push repeats every period and its warning would reach the same clients
+	if (writer.truncated && !warned)
+	{
+		ESP_LOGW(TAG, "pushed metrics truncated at %u bytes", (unsigned)writer.len);
+		warned = true;
+	}
+
+	// Not shared yet, the frame can still be trimmed to the text length
+	msg->frame.len = writer.len;
+	ws_client_broadcast_topic(msg, WS_CLIENT_TOPIC_METRICS);
+	ws_msg_unref(msg);
+}
+
+/**
+ * esp_timer callback of the metrics timer, the monitor task renders and sends them.
+ * @param arg unused.
+ */
+static void http_server_metrics_callback(void *arg)
+{
+	if (!atomic_exchange(&http_server_metrics_pending, true) && http_server_monitor_send_message(HTTP_MSG_METRICS_PUSH) != pdTRUE)
+	{
+		atomic_store(&http_server_metrics_pending, false);
+	}
+}
+
+/**
+ * GET /metrics, serves the metrics in the Prometheus text format.
+ * @param req HTTP request.
+ * @return ESP_OK, or the send error.
+ */
+static esp_err_t http_server_metrics_handler(httpd_req_t *req)
+{
+	metrics_writer_t writer;
+
+	char *text = malloc(HTTP_SERVER_METRICS_MAX_LEN);
+	if (text == NULL)
+	{
+		return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "out of memory");
+	}
+
+	metrics_writer_init(&writer, text, HTTP_SERVER_METRICS_MAX_LEN);
+	http_server_metrics_render(&writer);
+	if (writer.truncated)
+	{
+		ESP_LOGW(TAG, "metrics truncated at %u bytes", (unsigned)writer.len);
+	}
+
+	httpd_resp_set_type(req, "text/plain; version=0.0.4");
+	esp_err_t err = httpd_resp_send(req, text, writer.len);
+	free(text);
+	return err;
+}
+
+/**
+ * GET of a dashboard file, see www_asset_t. The gzipped bytes go out as they are in flash,
+ * every browser sends Accept-Encoding: gzip. A request carrying the current ETag in
+ * If-None-Match is answered with a bodiless 304.
+ * @param req HTTP request, its user_ctx is the asset.
+ * @return ESP_OK, or the send error.
+ */
+static esp_err_t http_server_www_handler(httpd_req_t *req)
+{
+	const www_asset_t *asset = req->user_ctx;
+	char if_none_match[WWW_IF_NONE_MATCH_MAX_LEN];
+
+	http_server_www_requests++;
+	httpd_resp_set_hdr(req, "ETag", asset->etag);
+	httpd_resp_set_hdr(req, "Cache-Control", asset->cache_control);
+	httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+	if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+			www_not_modified(asset, if_none_match))
+	{
+		http_server_www_not_modified++;
+		httpd_resp_set_status(req, "304 Not Modified");
+		return httpd_resp_send(req, NULL, 0);
+	}
+
+	http_server_www_bytes += asset->len;
+	httpd_resp_set_type(req, asset->type);
+	httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+	return httpd_resp_send(req, (const char *)asset->data, asset->len);
+}
+
+/**
+ * Upload speed so far.
+ * @param stats upload counters.
+ * @return KB/s received since the upload started.
+ */
+static uint32_t http_server_ota_rate_now(const ota_stream_stats_t *stats)
+{
+	int64_t elapsed = esp_timer_get_time() - stats->start_us;
+
+	return elapsed > 0 ? (uint64_t)stats->received * 1000000 / elapsed / 1024 : 0;
+}
+
+/**
+ * Sends the upload progress to every websocket client as
+ * "ota state=<start|resumed|receiving|done|failed> received=<bytes> total=<bytes> rate=<KB/s> stall=<ms>".
+ * @param stats upload counters.
+ * @param state upload state.
+ */
+static void http_server_ota_progress(const ota_stream_stats_t *stats, const char *state)
+{
+	char text[112];
+
+	int len = snprintf(text, sizeof(text), "ota state=%s received=%u total=%u rate=%u stall=%u",
+			state, stats->received, stats->total, http_server_ota_rate_now(stats), stats->stall_us / 1000);
+	http_ws_server_send_messages(text, MIN(len, (int)sizeof(text) - 1));
+
+	// The upload keeps the httpd task busy, its work items can not send the frames meanwhile
+	ws_client_pump();
+}
+
+/**
+ * POST /ota, streams the raw image in the request body into the next OTA partition,
+ * e.g. curl --data-binary @build/websocket.bin http://192.168.5.1/ota
+ * Receiving and flash writes overlap, see ota_stream_t. On success the device restarts
+ * into the new image a few seconds after answering.
+ * @param req HTTP request.
+ * @return ESP_OK once answered, ESP_FAIL to close a session whose upload broke off.
+ */
+static esp_err_t http_server_ota_handler(httpd_req_t *req)
+{
+	ota_stream_t *stream = &http_server_ota_stream;
+	size_t remaining = req->content_len;
+	int timeouts = 0;
+
+	if (remaining == 0)
+	{
+		return httpd_resp_send_err(req, HTTPD_411_LENGTH_REQUIRED, "image size required");
+	}
+	if (http_server_ota_ws.active)
+	{
+		// Both uploads write the same partition
+		httpd_resp_set_status(req, "409 Conflict");
+		return httpd_resp_sendstr(req, "websocket upload in progress");
+	}
+
+	ota_sink_partition(&http_server_ota_sink, &http_server_ota_partition);
+	http_server_ota_stats = &stream->stats;
+	esp_err_t err = ota_stream_begin(stream, &http_server_ota_sink, remaining);
+	if (err != ESP_OK)
+	{
+		ESP_LOGE(TAG, "ota: %u byte image refused: %s", (unsigned)remaining, esp_err_to_name(err));
+		return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(err));
+	}
+	HTTP_DEBUG("ota: receiving %u bytes into %s", (unsigned)remaining, http_server_ota_partition.partition->label);
+	http_server_ota_progress(&stream->stats, "start");
+
+	int64_t reported = esp_timer_get_time();
+	while (remaining > 0)
+	{
+		size_t room;
+		uint8_t *buf = ota_stream_buffer(stream, &room);
+		if (buf == NULL)
+		{
+			break;
+		}
+
+		int received = httpd_req_recv(req, (char *)buf, MIN(room, remaining));
+		if (received == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts <= HTTP_SERVER_OTA_RECV_RETRIES)
+		{
+			continue;
+		}
+		if (received <= 0)
+		{
+			break;
+		}
+		timeouts = 0;
+		remaining -= received;
+
+		if (ota_stream_commit(stream, received) != ESP_OK)
+		{
+			break;
+		}
+
+		if (esp_timer_get_time() - reported >= HTTP_SERVER_OTA_PROGRESS_MS * 1000LL)
+		{
+			reported = esp_timer_get_time();
+			http_server_ota_progress(&stream->stats, "receiving");
+		}
+	}
+
+	err = remaining == 0 ? ota_stream_finish(stream) : ota_stream_abort(stream);
+
+	http_server_ota_rate = http_server_ota_rate_now(&stream->stats);
+	HTTP_DEBUG("ota: %u of %u bytes at %u KB/s, %u ms writing flash, %u ms waiting for it: %s",
+			stream->stats.received, stream->stats.total, http_server_ota_rate,
+			stream->stats.write_us / 1000, stream->stats.stall_us / 1000, esp_err_to_name(err));
+
+	if (err == ESP_OK)
+	{
+		http_server_ota_progress(&stream->stats, "done");
+		http_server_monitor_send_message(HTTP_MSG_OTA_UPDATE_SUCCESSFUL);
+		return httpd_resp_sendstr(req, "ok");
+	}
+
+	http_server_ota_progress(&stream->stats, "failed");
+	http_server_monitor_send_message(HTTP_MSG_OTA_UPDATE_FAILED);
+	if (remaining > 0 && err == ESP_FAIL)
+	{
+		// The client went away or stalled, there is nobody to answer
+		return ESP_FAIL;
+	}
+	return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(err));
+}
+
+/**
+ * Sends a text frame back on the websocket a request came from, ahead of any queued frame.
+ * @param req websocket request.
+ * @param text frame text.
+ * @param len snprintf result for text.
+ * @param size size of the text buffer.
+ * @return the httpd_ws_send_frame result.
+ */
+static esp_err_t http_server_ota_ws_send(httpd_req_t *req, const char *text, int len, size_t size)
+{
+	httpd_ws_frame_t ws_pkt;
+
+	memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
+	ws_pkt.payload = (uint8_t *)text;
+	ws_pkt.len = MIN(len, (int)size - 1);
+	ws_pkt.type = HTTPD_WS_TYPE_TEXT;
+	return httpd_ws_send_frame(req, &ws_pkt);
+}
+
+/**
+ * Reports the end of a websocket upload to the log, the clients and the monitor task.
+ * @param err how it ended.
+ */
+static void http_server_ota_ws_done(esp_err_t err)
+{
+	const ota_stream_stats_t *stats = &http_server_ota_ws.stream.stats;
+
+	esp_timer_stop(http_server_ota_ws_timer);
+	http_server_ota_rate = http_server_ota_rate_now(stats);
+	HTTP_DEBUG("ota ws: %u of %u bytes at %u KB/s, %u ms writing flash, %u ms waiting for it: %s",
+			stats->received, stats->total, http_server_ota_rate,
+			stats->write_us / 1000, stats->stall_us / 1000, esp_err_to_name(err));
+
+	http_server_ota_progress(stats, err == ESP_OK ? "done" : "failed");
+	http_server_monitor_send_message(err == ESP_OK ? HTTP_MSG_OTA_UPDATE_SUCCESSFUL : HTTP_MSG_OTA_UPDATE_FAILED);
+}
+
+/**
+ * Pushes back the idle abort of the websocket upload, called on every sign of its sender.
+ */
+static void http_server_ota_ws_touch(void)
+{
+	http_server_ota_ws_last_us = esp_timer_get_time();
+	if (http_server_ota_ws_timer)
+	{
+		esp_timer_stop(http_server_ota_ws_timer);
+		esp_timer_start_once(http_server_ota_ws_timer, HTTP_SERVER_OTA_WS_IDLE_MS * 1000ULL);
+	}
+}
+
+/**
+ * httpd work item, drops the websocket upload once its sender stayed away too long.
+ * @param arg unused.
+ */
+static void http_server_ota_ws_expire(void *arg)
+{
+	// A chunk may have come in between the timer and this work item
+	if (http_server_ota_ws.active &&
+			esp_timer_get_time() - http_server_ota_ws_last_us >= HTTP_SERVER_OTA_WS_IDLE_MS * 1000LL)
+	{
+		ESP_LOGW(TAG, "ota ws: sender gone for %u s, upload dropped", HTTP_SERVER_OTA_WS_IDLE_MS / 1000);
+		ota_ws_abort(&http_server_ota_ws);
+		http_server_ota_ws_done(http_server_ota_ws.err);
+	}
+}
+
+/**
+ * esp_timer callback, hands the idle abort to the httpd task that owns the upload.
+ * @param arg unused.
+ */
+static void http_server_ota_ws_idle_callback(void *arg)
+{
+	httpd_handle_t hd = http_server_handle;
+
+	if (hd)
+	{
+		httpd_queue_work(hd, http_server_ota_ws_expire, NULL);
+	}
+}
+
+/**
+ * Takes a piece of a binary frame for the websocket upload. Once the frame is complete the
+ * sender gets "ota ack <position>" every OTA_WS_ACK_EVERY chunks, "ota nak <position>" for a
+ * chunk out of place and "ota failed err=<name>" when the upload was dropped, see ota_ws_position.
+ * @param req websocket request the frame arrived on.
+ * @param data piece of the payload.
+ * @param len number of bytes in data.
+ * @param offset position of data within the payload.
+ * @param frame_len length of the whole payload.
+ * @return ESP_OK to keep the session open, or the send error.
+ */
+static esp_err_t http_server_ota_ws_frame(httpd_req_t *req, const uint8_t *data, size_t len, size_t offset, size_t frame_len)
+{
+	ota_ws_t *ota = &http_server_ota_ws;
+	char text[80];
+	int n;
+
+	ota_ws_result_e result = ota_ws_feed(ota, data, len, offset, frame_len);
+	if (result == OTA_WS_MORE)
+	{
+		return ESP_OK;
+	}
+
+	if (result == OTA_WS_FAILED)
+	{
+		ESP_LOGE(TAG, "ota ws: upload dropped: %s", esp_err_to_name(ota->err));
+		http_server_ota_ws_done(ota->err);
+		n = snprintf(text, sizeof(text), "ota failed err=%s", esp_err_to_name(ota->err));
+		return http_server_ota_ws_send(req, text, n, sizeof(text));
+	}
+
+	if (ota->active)
+	{
+		http_server_ota_ws_touch();
+		if (http_server_ota_ws_last_us - http_server_ota_ws_reported >= HTTP_SERVER_OTA_PROGRESS_MS * 1000LL)
+		{
+			http_server_ota_ws_reported = http_server_ota_ws_last_us;
+			http_server_ota_progress(&ota->stream.stats, "receiving");
+		}
+	}
+
+	if (result == OTA_WS_ACCEPTED)
+	{
+		return ESP_OK;
+	}
+
+	n = snprintf(text, sizeof(text), "ota %s ", result == OTA_WS_REJECTED ? "nak" : "ack");
+	n += ota_ws_position(ota, text + n, sizeof(text) - n);
+	return http_server_ota_ws_send(req, text, n, sizeof(text));
+}
+
+/**
+ * "ota [begin <size> <crc32-hex>|end|abort]", firmware upload over /ws binary frames, see ota_ws_t.
+ * Every form answers the position to send from next, after begin it is past the start
+ * when the same image resumes. end restarts the device into the image a few seconds later.
+ */
+static esp_err_t http_server_rpc_ota(httpd_req_t *req, char *args, char *reply, size_t reply_len)
+{
+	ota_ws_t *ota = &http_server_ota_ws;
+	char *action = ws_rpc_next_token(&args);
+	bool resumed = false;
+
+	if (action && strcmp(action, "begin") == 0)
+	{
+		char *size = ws_rpc_next_token(&args);
+		char *crc = ws_rpc_next_token(&args);
+		if (size == NULL || crc == NULL)
+		{
+			snprintf(reply, reply_len, "usage: ota begin <size> <crc32-hex>");
+			return ESP_ERR_INVALID_ARG;
+		}
+		uint32_t image_size = strtoul(size, NULL, 10);
+		uint32_t image_crc = strtoul(crc, NULL, 16);
+
+		if (ota->active && (ota->size != image_size || ota->image_crc != image_crc))
+		{
+			// Dropped while the sink still holds its partition, before it is set up for the new image
+			ota_ws_abort(ota);
+			http_server_ota_ws_done(ota->err);
+		}
+		if (!ota->active)
+		{
+			ota_sink_partition(&http_server_ota_sink, &http_server_ota_partition);
+			http_server_ota_stats = &ota->stream.stats;
+		}
+
+		esp_err_t err = ota_ws_begin(ota, &http_server_ota_sink, image_size, image_crc, &resumed);
+		if (err != ESP_OK)
+		{
+			ESP_LOGE(TAG, "ota ws: %u byte image refused: %s", image_size, esp_err_to_name(err));
+			return err;
+		}
+		HTTP_DEBUG("ota ws: %s %u bytes at %u", resumed ? "resuming" : "receiving", image_size, ota->offset);
+		http_server_ota_ws_touch();
+		http_server_ota_ws_reported = http_server_ota_ws_last_us;
+		http_server_ota_progress(&ota->stream.stats, resumed ? "resumed" : "start");
+	}
+	else if (action && strcmp(action, "end") == 0)
+	{
+		bool active = ota->active;
+		esp_err_t err = ota_ws_end(ota);
+
+		// Missing bytes leave the upload going, the position tells the sender what to send again
+		if (active && err != ESP_ERR_INVALID_SIZE)
+		{
+			http_server_ota_ws_done(err);
+		}
+		if (err != ESP_OK)
+		{
+			int n = snprintf(reply, reply_len, "%s ", esp_err_to_name(err));
+			ota_ws_position(ota, reply + n, reply_len - n);
+			return err;
+		}
+	}
+	else if (action && strcmp(action, "abort") == 0)
+	{
+		if (ota->active)
+		{
+			ota_ws_abort(ota);
+			http_server_ota_ws_done(ota->err);
+		}
+	}
+	else if (action)
+	{
+		snprintf(reply, reply_len, "usage: ota [begin <size> <crc32-hex>|end|abort]");
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	int n = ota_ws_position(ota, reply, reply_len);
+	snprintf(reply + n, reply_len - n, " size=%u window=%u active=%d resumed=%d",
+			ota->size, OTA_WS_WINDOW, ota->active, resumed);
+	return ESP_OK;
+}
+
+// Commands accepted on /ws, see ws_rpc_dispatch for the message format
+static const ws_rpc_route_t http_server_rpc_routes[] =
+{
+	{ "subscribe",	http_server_rpc_subscribe },
+	{ "connect",	http_server_rpc_connect },
+	{ "disconnect",	http_server_rpc_disconnect },
+	{ "networks",	http_server_rpc_networks },
+	{ "status",		http_server_rpc_status },
+	{ "loglevel",	http_server_rpc_loglevel },
+	{ "stats",		http_server_rpc_stats },
+	{ "metrics",	http_server_rpc_metrics },
+	{ "ota",		http_server_rpc_ota },
+#ifdef CONFIG_WS_PROFILER
+	{ "profile",	http_server_rpc_profile },
+#endif
+#ifdef CONFIG_WS_BENCHMARK
+	{ "bench",		http_server_rpc_bench },
+#endif
+};
+
+/**
+ * Chunk callback for frames too long for a receive buffer. Binary frames carry firmware
+ * upload chunks, no command is that long so the payload of a text frame is read off the
+ * socket and dropped.
+ * @param req websocket request the frame arrived on.
+ * @param frame frame being streamed.
+ * @param chunk payload bytes.
+ * @param len number of bytes in chunk.
+ * @param offset position of chunk within the payload.
+ * @return ESP_OK to keep the session open.
+ */
+static esp_err_t http_server_ws_stream(httpd_req_t *req, const httpd_ws_frame_t *frame,
+		const uint8_t *chunk, size_t len, size_t offset)
+{
+	if (frame->type == HTTPD_WS_TYPE_BINARY)
+	{
+		return http_server_ota_ws_frame(req, chunk, len, offset, frame->len);
+	}
+
+	if (offset + len == frame->len)
+	{
+		ws_rx_pool_stats_t stats;
+		ws_rx_pool_get_stats(&stats);
+		ESP_LOGW(TAG, "dropped %u byte frame, rx pool %u/%u in use, high water %u",
+				(unsigned)frame->len, stats.in_use, stats.slots, stats.high_water);
+	}
+	return ESP_OK;
+}
+
+/**
+ * Handshake side of the time to first frame probe, runs on the httpd task.
+ * @param fd socket of the client that just opened.
+ */
+static void http_server_probe_open(int fd)
+{
+	int expected = HTTP_SERVER_PROBE_JOINED;
+	uint32_t join_us = http_server_probe_join_us;
+
+	http_server_probe_fd = fd;
+	if (atomic_compare_exchange_strong(&http_server_probe_state, &expected, HTTP_SERVER_PROBE_OPENED))
+	{
+		http_server_join_to_open_us = (uint32_t)esp_timer_get_time() - join_us;
+	}
+}
+
+/**
+ * ws_client first frame hook, ends the time to first frame probe.
+ * @param fd socket of the client.
+ * @param time_us when its first frame was sent.
+ */
+static void http_server_probe_first_frame(int fd, int64_t time_us)
+{
+	int expected = HTTP_SERVER_PROBE_OPENED;
+
+	if (fd == http_server_probe_fd &&
+			atomic_compare_exchange_strong(&http_server_probe_state, &expected, HTTP_SERVER_PROBE_IDLE))
+	{
+		http_server_join_to_frame_us = (uint32_t)time_us - http_server_probe_join_us;
+		HTTP_DEBUG("First websocket frame %u ms after the station joined", http_server_join_to_frame_us / 1000);
+	}
+}
+
+/*
+ * This handler receives the ws data into a pooled buffer, frames that
+ * do not fit in one are streamed to http_server_ws_stream
+ */
+static esp_err_t ws_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET) {
+        ESP_LOGI(TAG, "Handshake done, the new connection was opened");
+        /* Refusing the handshake closes the session when every client slot is taken */
+        esp_err_t err = ws_client_add(httpd_req_to_sockfd(req), WS_LOG_HISTORY_SIZE > 0);
+        if (err == ESP_OK) {
+            http_server_probe_open(httpd_req_to_sockfd(req));
+        }
+        if (err == ESP_OK && WS_LOG_HISTORY_SIZE > 0 && task_ws_print != NULL) {
+            /* ws_print replays the history, then the client goes live */
+            xTaskNotifyGive(task_ws_print);
+        }
+        return err;
+    }
+    int64_t arrival = esp_timer_get_time();
+    httpd_ws_frame_t ws_pkt;
+    uint8_t *buf = NULL;
+    memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
+    ws_pkt.type = HTTPD_WS_TYPE_TEXT;
+    /* Set max_len = 0 to get the frame len */
+    esp_err_t ret = httpd_ws_recv_frame(req, &ws_pkt, 0);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "httpd_ws_recv_frame failed to get frame len with %d", ret);
+        return ret;
+    }
+    if (ws_pkt.len) {
+        /* Buffers are fixed at build time, an exhausted pool closes the session instead of growing the heap */
+        buf = ws_rx_pool_take();
+        if (buf == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        if (ws_pkt.len >= WS_RX_POOL_SLOT_SIZE) {
+            ret = ws_rx_pool_stream(req, &ws_pkt, buf, http_server_ws_stream);
+            ws_rx_pool_give(buf);
+            return ret;
+        }
+        ret = ws_rx_pool_recv(req, &ws_pkt, buf);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "httpd_ws_recv_frame failed with %d", ret);
+            ws_rx_pool_give(buf);
+            return ret;
+        }
+        if (ws_pkt.type == HTTPD_WS_TYPE_TEXT) {
+            /* Not logged, the connect password would reach the clients and the stored log */
+            ret = ws_rpc_dispatch(http_server_rpc_routes, sizeof(http_server_rpc_routes) / sizeof(http_server_rpc_routes[0]),
+                    req, (char *)ws_pkt.payload, arrival);
+        } else if (ws_pkt.type == HTTPD_WS_TYPE_BINARY) {
+            ret = http_server_ota_ws_frame(req, ws_pkt.payload, ws_pkt.len, 0, ws_pkt.len);
+        }
+        ws_rx_pool_give(buf);
+    }
+    return ret;
+}
+
+#ifdef CONFIG_WS_LOG_STORE
+/**
+ * Parses a "bytes=<first>-[last]" or "bytes=-<suffix>" Range header against the stored log.
+ * Offsets count from the first byte ever logged, so a client can ask for everything past
+ * the end it saw last time. A range starting before the oldest byte kept is clamped to it.
+ * @param value header value.
+ * @param start oldest stream offset still stored.
+ * @param end stream offset after the newest byte.
+ * @param first receives the first offset to send.
+ * @param last receives the offset after the last byte to send.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a malformed range, ESP_ERR_INVALID_SIZE if nothing is left.
+ */
+static esp_err_t http_server_logs_range(const char *value, uint32_t start, uint32_t end, uint32_t *first, uint32_t *last)
+{
+	char *cursor;
+
+	if (strncmp(value, "bytes=", 6) != 0)
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+	value += 6;
+
+	if (*value == '-')
+	{
+		unsigned long suffix = strtoul(value + 1, &cursor, 10);
+		if (cursor == value + 1 || *cursor != '\0')
+		{
+			return ESP_ERR_INVALID_ARG;
+		}
+		*first = (suffix < end - start) ? end - suffix : start;
+		*last = end;
+	}
+	else
+	{
+		unsigned long from = strtoul(value, &cursor, 10);
+		if (cursor == value || *cursor != '-')
+		{
+			return ESP_ERR_INVALID_ARG;
+		}
+		value = cursor + 1;
+
+		unsigned long to = end - 1;
+		if (*value != '\0')
+		{
+			to = strtoul(value, &cursor, 10);
+			if (cursor == value || *cursor != '\0' || to < from)
+			{
+				return ESP_ERR_INVALID_ARG;
+			}
+		}
+		*first = MAX(from, start);
+		*last = MIN(to + 1, end);
+	}
+
+	return (*first < *last) ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+/**
+ * GET /logs, sends the log kept in flash. Honors a single byte Range, see http_server_logs_range,
+ * and reports the stored span in X-Log-Start and X-Log-End.
+ * @param req HTTP request.
+ * @return ESP_OK, or ESP_FAIL if the connection broke.
+ */
+static esp_err_t http_server_logs_handler(httpd_req_t *req)
+{
+	char range[48];
+	char content_range[48];
+	char log_start[12];
+	char log_end[12];
+	char chunk[WS_LOG_STORE_CHUNK_SIZE];
+
+	if (ws_log_store_mutex == NULL)
+	{
+		return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "no log partition");
+	}
+
+	xSemaphoreTake(ws_log_store_mutex, portMAX_DELAY);
+	uint32_t start = log_store_start(&ws_log_store);
+	uint32_t end = log_store_end(&ws_log_store);
+	xSemaphoreGive(ws_log_store_mutex);
+
+	// httpd keeps pointers to the header values until the response is sent
+	snprintf(log_start, sizeof(log_start), "%u", start);
+	snprintf(log_end, sizeof(log_end), "%u", end);
+	httpd_resp_set_hdr(req, "X-Log-Start", log_start);
+	httpd_resp_set_hdr(req, "X-Log-End", log_end);
+	httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+	httpd_resp_set_type(req, (WS_LOG_FRAME_TYPE == HTTPD_WS_TYPE_BINARY) ? HTTPD_TYPE_OCTET : "text/plain");
+
+	uint32_t first = start;
+	uint32_t last = end;
+
+	if (httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) == ESP_OK)
+	{
+		esp_err_t err = http_server_logs_range(range, start, end, &first, &last);
+		if (err == ESP_ERR_INVALID_SIZE)
+		{
+			// Nothing new since the offset asked for
+			snprintf(content_range, sizeof(content_range), "bytes */%u", end);
+			httpd_resp_set_hdr(req, "Content-Range", content_range);
+			httpd_resp_set_status(req, "416 Range Not Satisfiable");
+			return httpd_resp_send(req, NULL, 0);
+		}
+		if (err != ESP_OK)
+		{
+			return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "bad range");
+		}
+
+		snprintf(content_range, sizeof(content_range), "bytes %u-%u/%u", first, last - 1, end);
+		httpd_resp_set_hdr(req, "Content-Range", content_range);
+		httpd_resp_set_status(req, "206 Partial Content");
+	}
+
+	while (first < last)
+	{
+		// The lock is held per chunk only, logging carries on while the response goes out
+		xSemaphoreTake(ws_log_store_mutex, portMAX_DELAY);
+		size_t len = log_store_read(&ws_log_store, first, chunk, MIN(last - first, sizeof(chunk)));
+		xSemaphoreGive(ws_log_store_mutex);
+
+		// Short once the segment being read is recycled, the response ends early
+		if (len == 0)
+		{
+			break;
+		}
+
+		if (httpd_resp_send_chunk(req, chunk, len) != ESP_OK)
+		{
+			return ESP_FAIL;
+		}
+		first += len;
+	}
+
+	return httpd_resp_send_chunk(req, NULL, 0);
+}
+#endif
+
+/**
+ * Sets up the default httpd server configuration.
+ * @return http server instance handle if successful, NULL otherwise.
+ */
+static httpd_handle_t http_server_configure(void)
+{
+	// Generate the default configuration
+	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+
+	// Core, priority and stack (default is 4096) from the task topology
+	task_spec_t task = task_topology_get(TASK_TOPOLOGY_HTTPD);
+	config.core_id = task.core_id;
+	config.task_priority = task.priority;
+	config.stack_size = task.stack_size;
+
+	// Increase uri handlers
+	config.max_uri_handlers = 25;
+
+	// Increase the receive timeout, a send that waits longer than a second is a client that stopped reading
+	config.recv_wait_timeout = 10;
+	config.send_wait_timeout = 1;
+
+	// Room for the websocket clients plus the regular HTTP sessions
+	config.max_open_sockets = HTTP_SERVER_MAX_OPEN_SOCKETS;
+
+	// Drop the websocket client state of closed sessions
+	config.close_fn = http_server_close_fn;
+
+	HTTP_DEBUG("http_server_configure: Starting server on port: '%d' with task priority: '%d'",
+			config.server_port,
+			config.task_priority);
+
+	// Start the httpd server
+	if (httpd_start(&http_server_handle, &config) == ESP_OK)
+	{
+		ws_client_init(http_server_handle);
+
+		HTTP_DEBUG("http_server_configure: Registering URI handlers");
+
+		httpd_uri_t ws = {
+        .uri        = "/ws",
+        .method     = HTTP_GET,
+        .handler    = ws_handler,
+        .user_ctx   = NULL,
+        .is_websocket = true,
+		.handle_ws_control_frames = true
+		};
+		httpd_register_uri_handler(http_server_handle, &ws);
+
+		httpd_uri_t metrics = {
+		.uri        = "/metrics",
+		.method     = HTTP_GET,
+		.handler    = http_server_metrics_handler,
+		.user_ctx   = NULL
+		};
+		httpd_register_uri_handler(http_server_handle, &metrics);
+
+		for (size_t i = 0; i < www_asset_count; ++i)
+		{
+			httpd_uri_t www = {
+			.uri        = www_assets[i].uri,
+			.method     = HTTP_GET,
+			.handler    = http_server_www_handler,
+			.user_ctx   = (void *)&www_assets[i]
+			};
+			httpd_register_uri_handler(http_server_handle, &www);
+		}
+
+		httpd_uri_t ota = {
+		.uri        = "/ota",
+		.method     = HTTP_POST,
+		.handler    = http_server_ota_handler,
+		.user_ctx   = NULL
+		};
+		httpd_register_uri_handler(http_server_handle, &ota);
+
+#ifdef CONFIG_WS_LOG_STORE
+		httpd_uri_t logs = {
+		.uri        = "/logs",
+		.method     = HTTP_GET,
+		.handler    = http_server_logs_handler,
+		.user_ctx   = NULL
+		};
+		httpd_register_uri_handler(http_server_handle, &logs);
+#endif
+	
+		return http_server_handle;
+	}
+
+	return NULL;
+}
+
+void http_server_init(void)
+{
+	if (task_http_server_monitor)
+	{
+		return;
+	}
+
+	// Created before the monitor task, events posted before the first acquire wait for it
+	event_bus_init(&http_server_monitor_bus, "http_server", HTTP_SERVER_MONITOR_EVENT_DEPTH, HTTP_SERVER_MONITOR_EVENT_HIGH_DEPTH);
+	task_topology_create(TASK_TOPOLOGY_HTTP_MONITOR, &http_server_monitor, NULL, &task_http_server_monitor);
+
+	ws_client_set_first_frame_hook(http_server_probe_first_frame);
+
+	// Idles while no client is subscribed, so it is simply left running
+	const esp_timer_create_args_t metrics_timer_args = {
+			.callback = &http_server_metrics_callback,
+			.arg = NULL,
+			.dispatch_method = ESP_TIMER_TASK,
+			.name = "metrics_push"
+	};
+	if (esp_timer_create(&metrics_timer_args, &http_server_metrics_timer) == ESP_OK)
+	{
+		esp_timer_start_periodic(http_server_metrics_timer, WS_METRICS_PERIOD_MS * 1000ULL);
+	}
+
+	const esp_timer_create_args_t ota_ws_timer_args = {
+			.callback = &http_server_ota_ws_idle_callback,
+			.arg = NULL,
+			.dispatch_method = ESP_TIMER_TASK,
+			.name = "ota_ws_idle"
+	};
+	esp_timer_create(&ota_ws_timer_args, &http_server_ota_ws_timer);
+
+#if HTTP_SERVER_IDLE_STOP_MS > 0
+	const esp_timer_create_args_t idle_timer_args = {
+			.callback = &http_server_idle_callback,
+			.arg = NULL,
+			.dispatch_method = ESP_TIMER_TASK,
+			.name = "http_idle"
+	};
+	esp_timer_create(&idle_timer_args, &http_server_idle_timer);
+#endif
+
+#ifdef CONFIG_WS_PROFILER
+	// Sleeps while nobody is subscribed
+	profiler_start();
+#endif
+}
+
+/**
+ * Posts a lifecycle request to the monitor task.
+ * @param msgID HTTP_MSG_SERVER_ACQUIRE or HTTP_MSG_SERVER_RELEASE.
+ * @param user interface making the request.
+ */
+static void http_server_post_user(http_server_message_e msgID, http_server_user_e user)
+{
+	http_server_user_event_t event = { .time_us = (uint32_t)esp_timer_get_time(), .user = user };
+
+	if (!event_bus_post(&http_server_monitor_bus, msgID, EVENT_BUS_PRIORITY_NORMAL, &event, sizeof(event)))
+	{
+		ESP_LOGW(TAG, "http_server_post_user: monitor bus full, dropped %d for user %d", msgID, user);
+	}
+}
+
+void http_server_acquire(http_server_user_e user)
+{
+	http_server_post_user(HTTP_MSG_SERVER_ACQUIRE, user);
+}
+
+void http_server_release(http_server_user_e user)
+{
+	http_server_post_user(HTTP_MSG_SERVER_RELEASE, user);
+}
+
+BaseType_t http_server_monitor_send_message(http_server_message_e msgID)
+{
+	event_bus_priority_e priority = (msgID == HTTP_MSG_OTA_UPDATE_SUCCESSFUL || msgID == HTTP_MSG_OTA_UPDATE_FAILED) ?
+			EVENT_BUS_PRIORITY_HIGH : EVENT_BUS_PRIORITY_NORMAL;
+
+	return event_bus_post(&http_server_monitor_bus, msgID, priority, NULL, 0) ? pdTRUE : pdFALSE;
+}
+
+void http_server_fw_update_reset_callback(void *arg)
+{
+	// esp_restart runs ws_log_store_shutdown, so the lines logged up to here are kept
+	HTTP_DEBUG("http_server_fw_update_reset_callback: Timer timed-out, restarting the device");
+	esp_restart();
+}
+
+
+// ------------------------------------------ * Websocket functions * --------------------------------
+
+/**
+ * Header in front of every log line in the ring and in the pending batch,
+ * lets the fan-out apply the client subscriptions without parsing the line.
+ */
+typedef struct ws_log_meta
+{
+	uint8_t level;			///> esp_log_level_t of the line, ESP_LOG_NONE if unknown
+	uint8_t reserved;
+	uint16_t len;			///> Line bytes following the header
+	uint32_t tag_hash;		///> ws_filter_tag_hash of the tag, 0 if unknown
+} ws_log_meta_t;
+
+// Log lines, each behind its ws_log_meta_t, waiting to be sent as a single frame
+static uint8_t ws_log_batch[WS_LOG_BATCH_SIZE];
+
+// Filter group snapshot, kept off the websocket log task stack
+static ws_filter_t ws_print_groups[WS_CLIENT_MAX_CLIENTS];
+
+#if WS_LOG_HISTORY_SIZE > 0
+// Most recent log records, each one a ws_log_meta_t and its line, replayed to new clients
+static log_history_t ws_log_history;
+static uint8_t ws_log_history_buff[WS_LOG_HISTORY_SIZE];
+
+// History records being replayed, same layout as ws_log_batch
+static uint8_t ws_log_replay[WS_LOG_BATCH_SIZE];
+#endif
+
+
+/**
+ * Copies the lines of a batch that pass a filter.
+ * @param batch log lines with their headers.
+ * @param len number of bytes in batch.
+ * @param filter subscription to apply.
+ * @param out buffer receiving the lines, NULL to only count them.
+ * @return number of line bytes that pass the filter.
+ */
+static size_t ws_print_gather(const uint8_t *batch, size_t len, const ws_filter_t *filter, uint8_t *out)
+{
+	ws_log_meta_t meta;
+	size_t total = 0;
+
+	for (size_t pos = 0; pos < len; pos += sizeof(meta) + meta.len)
+	{
+		memcpy(&meta, &batch[pos], sizeof(meta));
+		if (ws_filter_match(filter, meta.level, meta.tag_hash))
+		{
+			if (out)
+			{
+				memcpy(&out[total], &batch[pos + sizeof(meta)], meta.len);
+			}
+			total += meta.len;
+		}
+	}
+
+	return total;
+}
+
+#ifdef CONFIG_WS_LOG_COMPRESSION
+/**
+ * Builds the compressed frame of a filter group.
+ * @param batch log lines with their headers.
+ * @param len number of bytes in batch.
+ * @param filter subscription of the group.
+ * @param frame_len uncompressed length of the lines passing the filter.
+ * @return the message, or NULL if out of memory.
+ */
+static ws_msg_t *ws_print_compress(const uint8_t *batch, size_t len, const ws_filter_t *filter, size_t frame_len)
+{
+	if (ws_log_lz_dict_len == 0)
+	{
+		ws_log_lz_dict_len = log_lz_window_init(ws_log_lz_window);
+	}
+
+	ws_print_gather(batch, len, filter, &ws_log_lz_window[ws_log_lz_dict_len]);
+
+	ws_msg_t *msg = ws_msg_alloc(LOG_LZ_BOUND(frame_len), HTTPD_WS_TYPE_BINARY);
+	if (msg == NULL)
+	{
+		return NULL;
+	}
+
+	int64_t start = esp_timer_get_time();
+	// Not shared yet, the frame can still be trimmed to the compressed length
+	msg->frame.len = log_lz_compress(&ws_log_lz, ws_log_lz_window, frame_len, msg->payload, LOG_LZ_BOUND(frame_len));
+	ws_log_lz_us += esp_timer_get_time() - start;
+	ws_log_lz_in_bytes += frame_len;
+	ws_log_lz_out_bytes += msg->frame.len;
+
+	return msg;
+}
+#endif
+
+/**
+ * Builds the frame of the lines of a batch that pass a filter.
+ * @param batch log lines with their headers.
+ * @param len number of bytes in batch.
+ * @param filter subscription to apply.
+ * @return the message, or NULL if no line passes or out of memory.
+ */
+static ws_msg_t *ws_print_build(const uint8_t *batch, size_t len, const ws_filter_t *filter)
+{
+	// First pass sizes the frame so it can be built in a single allocation
+	size_t frame_len = ws_print_gather(batch, len, filter, NULL);
+	if (frame_len == 0)
+	{
+		return NULL;
+	}
+
+#ifdef CONFIG_WS_LOG_COMPRESSION
+	if (filter->compress == WS_FILTER_COMPRESS_LZ)
+	{
+		return ws_print_compress(batch, len, filter, frame_len);
+	}
+#endif
+
+	ws_msg_t *msg = ws_msg_alloc(frame_len, WS_LOG_FRAME_TYPE);
+	if (msg)
+	{
+		ws_print_gather(batch, len, filter, msg->payload);
+	}
+	return msg;
+}
+
+/**
+ * Sends the pending log lines to the live websocket clients, one frame per filter group,
+ * and keeps them in the history for the clients still to come.
+ * @param batch log lines with their headers.
+ * @param len number of bytes in batch.
+ */
+static void ws_print_flush(const uint8_t *batch, size_t len)
+{
+	uint32_t active = ws_client_get_groups(ws_print_groups);
+	for (uint8_t group = 0; group < WS_CLIENT_MAX_CLIENTS; ++group)
+	{
+		if (!(active & (1UL << group)))
+		{
+			continue;
+		}
+
+		ws_msg_t *msg = ws_print_build(batch, len, &ws_print_groups[group]);
+		if (msg == NULL)
+		{
+			continue;
+		}
+
+		ws_client_broadcast_group(msg, group);
+		ws_msg_unref(msg);
+	}
+
+#if WS_LOG_HISTORY_SIZE > 0
+	ws_log_meta_t meta;
+	for (size_t pos = 0; pos < len; pos += sizeof(meta) + meta.len)
+	{
+		memcpy(&meta, &batch[pos], sizeof(meta));
+		log_history_append(&ws_log_history, &batch[pos], sizeof(meta) + meta.len);
+	}
+#endif
+
+#ifdef CONFIG_WS_LOG_STORE
+	if (ws_log_store_mutex)
+	{
+		// Only the lines go to flash, the download is the plain log
+		ws_log_meta_t line;
+		xSemaphoreTake(ws_log_store_mutex, portMAX_DELAY);
+		for (size_t pos = 0; pos < len; pos += sizeof(line) + line.len)
+		{
+			memcpy(&line, &batch[pos], sizeof(line));
+			log_store_append(&ws_log_store, &batch[pos + sizeof(line)], line.len);
+		}
+		xSemaphoreGive(ws_log_store_mutex);
+	}
+#endif
+}
+
+#ifdef CONFIG_WS_LOG_STORE
+/**
+ * Writes the lines waiting in the store batch to flash.
+ * @param wait longest time to wait for the store lock.
+ */
+static void ws_log_store_flush(TickType_t wait)
+{
+	if (ws_log_store_mutex && xSemaphoreTake(ws_log_store_mutex, wait) == pdTRUE)
+	{
+		log_store_flush(&ws_log_store);
+		xSemaphoreGive(ws_log_store_mutex);
+	}
+}
+
+/**
+ * Shutdown handler, keeps the last lines across esp_restart.
+ */
+static void ws_log_store_shutdown(void)
+{
+	// Lines still in the websocket batch are lost, the store only sees what ws_print flushed
+	ws_log_store_flush(pdMS_TO_TICKS(100));
+}
+#endif
+
+#if WS_LOG_HISTORY_SIZE > 0
+/**
+ * Queues the log history on the clients that just connected, as far as their queues allow.
+ * Broadcasts skip a client until it is done, and only ws_print adds to the history and
+ * broadcasts, so the client sees every line exactly once across the handover.
+ * @return true if a client still has history left to receive.
+ */
+static bool ws_print_replay(void)
+{
+	ws_client_replay_t replays[WS_CLIENT_MAX_CLIENTS];
+	bool pending = false;
+
+	size_t count = ws_client_get_replays(replays, WS_CLIENT_MAX_CLIENTS);
+	if (count == 0)
+	{
+		return false;
+	}
+
+	ws_client_get_groups(ws_print_groups);
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t cursor = replays[i].started ? replays[i].cursor : ws_log_history.start;
+
+		while (cursor != ws_log_history.end)
+		{
+			uint32_t next = cursor;
+			size_t len = log_history_read(&ws_log_history, &next, ws_log_replay, sizeof(ws_log_replay));
+
+			ws_msg_t *msg = ws_print_build(ws_log_replay, len, &ws_print_groups[replays[i].group]);
+			esp_err_t err = msg ? ws_client_send(replays[i].fd, msg) : ESP_OK;
+			ws_msg_unref(msg);
+
+			// Queue full, carry on once the httpd task drained it
+			if (err != ESP_OK)
+			{
+				break;
+			}
+			cursor = next;
+		}
+
+		bool done = (cursor == ws_log_history.end);
+		ws_client_set_replay(replays[i].fd, cursor, done);
+		pending |= !done;
+	}
+
+	return pending;
+}
+#endif
+
+
+void ws_print(void *pvParameters)
+{
+	const TickType_t deadline = MAX(pdMS_TO_TICKS(WS_LOG_FLUSH_DEADLINE_MS), 1);
+	TickType_t batch_start = 0;
+	size_t batch_len = 0;
+	bool replaying = false;
+#ifdef CONFIG_WS_LOG_STORE
+	const TickType_t store_period = pdMS_TO_TICKS(WS_LOG_STORE_FLUSH_MS);
+	TickType_t store_flushed = xTaskGetTickCount();
+#endif
+	const uint8_t *record;
+	size_t len;
+
+	for(;;)
+	{
+		// Sleep until a new line arrives, or until the pending frame is due
+		TickType_t wait = portMAX_DELAY;
+		if (batch_len)
+		{
+			TickType_t elapsed = xTaskGetTickCount() - batch_start;
+			wait = (elapsed < deadline) ? deadline - elapsed : 0;
+		}
+		if (replaying)
+		{
+			// A client queue was full, poll until the history is through
+			wait = MIN(wait, deadline);
+		}
+#ifdef CONFIG_WS_LOG_STORE
+		if (ws_log_store.batch_len)
+		{
+			// A partial store batch goes to flash on its own schedule, even when no line comes
+			TickType_t elapsed = xTaskGetTickCount() - store_flushed;
+			wait = MIN(wait, (elapsed < store_period) ? store_period - elapsed : 0);
+		}
+#endif
+		ulTaskNotifyTake(pdTRUE, wait);
+
+		while ((record = log_ring_peek(&ws_log_ring, &len)) != NULL)
+		{
+			if (batch_len + len > sizeof(ws_log_batch))
+			{
+				ws_print_flush(ws_log_batch, batch_len);
+				batch_len = 0;
+			}
+
+			if (batch_len == 0)
+			{
+				batch_start = xTaskGetTickCount();
+			}
+			memcpy(&ws_log_batch[batch_len], record, len);
+			batch_len += len;
+			log_ring_release(&ws_log_ring);
+		}
+
+		if (batch_len == sizeof(ws_log_batch) || (batch_len && xTaskGetTickCount() - batch_start >= deadline))
+		{
+			ws_print_flush(ws_log_batch, batch_len);
+			batch_len = 0;
+		}
+
+#ifdef CONFIG_WS_LOG_STORE
+		if (xTaskGetTickCount() - store_flushed >= store_period)
+		{
+			ws_log_store_flush(portMAX_DELAY);
+			store_flushed = xTaskGetTickCount();
+		}
+#endif
+
+#if WS_LOG_HISTORY_SIZE > 0
+		replaying = ws_print_replay();
+#endif
+	}
+	
+}
+
+
+/**
+ * Reserves a ring record for one log line and fills in its header.
+ * @param format format string of the line.
+ * @param args format arguments, not consumed.
+ * @return the record header, the line goes right after it. NULL if the ring is full.
+ */
+static ws_log_meta_t *ws_log_reserve(const char *format, va_list args)
+{
+	ws_log_meta_t *meta = log_ring_reserve(&ws_log_ring, sizeof(ws_log_meta_t) + WS_LOG_LINE_MAX_LEN);
+
+	if (meta)
+	{
+		meta->reserved = 0;
+		ws_filter_classify(format, args, &meta->level, &meta->tag_hash);
+	}
+	return meta;
+}
+
+/**
+ * Publishes a record reserved with ws_log_reserve and wakes up ws_print.
+ * @param meta record header.
+ * @param len line bytes written after the header, 0 gives the record back.
+ */
+static void ws_log_commit(ws_log_meta_t *meta, size_t len)
+{
+	if (len == 0)
+	{
+		log_ring_discard(&ws_log_ring, meta);
+		return;
+	}
+
+	meta->len = len;
+	log_ring_commit(&ws_log_ring, meta, sizeof(ws_log_meta_t) + len);
+
+	if (task_ws_print != NULL)
+	{
+		xTaskNotifyGive(task_ws_print);
+	}
+}
+
+#ifdef CONFIG_WS_LOG_FORMAT_BINARY
+/**
+ * Binary flavour of http_websocket_vprintf, queues the raw arguments instead of the rendered line.
+ * @param format format string.
+ * @param args format arguments.
+ * @return number of characters printed on the console.
+ */
+static int http_websocket_vprintf_binary(const char *format, va_list args)
+{
+	int written = 0;
+
+#ifdef CONFIG_WS_LOG_BINARY_CONSOLE
+	va_list console_args;
+	va_copy(console_args, args);
+	if (!ws_log_console_muted)
+	{
+		written = vprintf(format, console_args);
+	}
+	va_end(console_args);
+#endif
+
+	ws_log_meta_t *meta = ws_log_reserve(format, args);
+	if (meta == NULL)
+	{
+		return written;
+	}
+
+	uint8_t *record = (uint8_t *)(meta + 1);
+	uint32_t timestamp = esp_log_timestamp();
+	size_t len = 0;
+
+	// Only formats in flash can be found in the string table extracted from the ELF
+	if (esp_ptr_in_drom(format))
+	{
+		va_list bin_args;
+		va_copy(bin_args, args);
+		len = log_bin_encode(record, WS_LOG_LINE_MAX_LEN, timestamp, format, bin_args);
+		va_end(bin_args);
+	}
+
+	if (len == 0)
+	{
+		len = log_bin_encode_text(record, WS_LOG_LINE_MAX_LEN, timestamp, format, args);
+	}
+
+	ws_log_commit(meta, len);
+	return written;
+}
+#endif
 
 int http_websocket_vprintf(const char *format, va_list args)
 {
-	static char vprintf_buff[255];
-	int written = vsnprintf(vprintf_buff, sizeof(vprintf_buff), format, args);
+#ifdef CONFIG_WS_LOG_FORMAT_BINARY
+	return http_websocket_vprintf_binary(format, args);
+#else
+	// Format straight into the ring, concurrent loggers each get their own record
+	ws_log_meta_t *meta = ws_log_reserve(format, args);
+	if (meta == NULL)
+	{
+		// Ring full, the line still reaches the serial console
+		return ws_log_console_muted ? 0 : vprintf(format, args);
+	}
+
+	char *line = (char *)(meta + 1);
+	int written = vsnprintf(line, WS_LOG_LINE_MAX_LEN, format, args);
+	size_t len = 0;
 	if (written > 0)
 	{
-		
-		if(ws_queue != NULL)
+		len = MIN((size_t)written, WS_LOG_LINE_MAX_LEN - 1);
+		if (!ws_log_console_muted)
 		{
-			xQueueSend( ws_queue, ( void * ) &vprintf_buff, ( TickType_t ) 0 );
+			fwrite(line, 1, len, stdout);
 		}
-		printf(vprintf_buff);
 	}
+
+	ws_log_commit(meta, len);
 	return written;
+#endif
+}
+
+void ws_log_get_stats(ws_log_stats_t *stats)
+{
+	stats->lines = ws_log_ring.consumed;
+	stats->dropped = atomic_load_explicit(&ws_log_ring.dropped, memory_order_relaxed);
+}
+
+void ws_log_console_mute(bool mute)
+{
+	ws_log_console_muted = mute;
 }
 
 void log_for_websocket_setup(void)
 {
-	ws_queue = xQueueCreate(50, sizeof(char)*255);
+	log_ring_init(&ws_log_ring, ws_log_ring_buff, sizeof(ws_log_ring_buff));
+#if WS_LOG_HISTORY_SIZE > 0
+	log_history_init(&ws_log_history, ws_log_history_buff, sizeof(ws_log_history_buff));
+#endif
+#ifdef CONFIG_WS_LOG_STORE
+	// Mounted before the vprintf hook goes in, nothing is logged to the store meanwhile
+	esp_err_t err = log_store_partition_flash(&ws_log_store_flash, WS_LOG_STORE_PARTITION);
+	if (err == ESP_OK)
+	{
+		err = log_store_mount(&ws_log_store, &ws_log_store_flash, ws_log_store_batch, sizeof(ws_log_store_batch));
+	}
+	if (err == ESP_OK)
+	{
+		ws_log_store_mutex = xSemaphoreCreateMutex();
+		esp_register_shutdown_handler(ws_log_store_shutdown);
+		ESP_LOGI(TAG, "log store: %u..%u, %u bad chunks", log_store_start(&ws_log_store),
+				log_store_end(&ws_log_store), ws_log_store.corrupt_chunks);
+	}
+	else
+	{
+		ESP_LOGW(TAG, "log store not mounted: %s", esp_err_to_name(err));
+	}
+#endif
 
-	xTaskCreatePinnedToCore(ws_print, "websocket", 2048, NULL, 12, NULL,0);
+	task_topology_create(TASK_TOPOLOGY_WS_PRINT, ws_print, NULL, &task_ws_print);
 
 	esp_log_set_vprintf(http_websocket_vprintf); 
 }
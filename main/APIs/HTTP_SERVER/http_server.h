@@ -8,19 +8,46 @@
 #ifndef MAIN_HTTP_SERVER_H_
 #define MAIN_HTTP_SERVER_H_
 
+#include "ws_msg.h"
+
 #define OTA_UPDATE_PENDING 		0
 #define OTA_UPDATE_SUCCESSFUL	1
 #define OTA_UPDATE_FAILED		-1
 
-// HTTP Server task
-#define HTTP_SERVER_TASK_STACK_SIZE			10240
-#define HTTP_SERVER_TASK_PRIORITY			21
-#define HTTP_SERVER_TASK_CORE_ID			1
-
-// HTTP Server Monitor task
-#define HTTP_SERVER_MONITOR_STACK_SIZE		4096
-#define HTTP_SERVER_MONITOR_PRIORITY		3
-#define HTTP_SERVER_MONITOR_CORE_ID			1
+// HTTP Server task, placed by task_topology.h
+#define HTTP_SERVER_MAX_OPEN_SOCKETS		CONFIG_HTTP_SERVER_MAX_OPEN_SOCKETS
+#define HTTP_SERVER_METRICS_MAX_LEN			10240	// Longest /metrics text, also the size of a metrics frame
+#define WS_METRICS_PERIOD_MS				CONFIG_WS_METRICS_PERIOD_MS
+
+// HTTP Server Monitor task, placed by task_topology.h
+#define HTTP_SERVER_MONITOR_EVENT_DEPTH		8
+#define HTTP_SERVER_MONITOR_EVENT_HIGH_DEPTH	2		// Firmware update results
+
+// Firmware upload, POST /ota
+#define HTTP_SERVER_OTA_PROGRESS_MS			500		// Interval of the progress frames sent to the websocket clients
+#define HTTP_SERVER_OTA_RECV_RETRIES		5		// Receive timeouts in a row before an upload is dropped
+#define HTTP_SERVER_OTA_WS_IDLE_MS			60000	// Time a websocket upload waits for its sender to come back
+
+// Server lifecycle
+#define HTTP_SERVER_IDLE_STOP_MS			(CONFIG_WS_HTTP_SERVER_IDLE_STOP_S * 1000)	// Time without users before the server stops, 0 never stops it
+
+// Websocket log pipeline
+#define WS_LOG_RING_SIZE					8192	// Bytes shared by all queued log records, power of two
+#define WS_LOG_LINE_MAX_LEN					255		// Longest log line forwarded to the websocket clients
+#define WS_LOG_BATCH_SIZE					CONFIG_WS_LOG_BATCH_SIZE			// Bytes of log lines packed into one frame
+#define WS_LOG_FLUSH_DEADLINE_MS			CONFIG_WS_LOG_FLUSH_DEADLINE_MS		// Longest wait before a partial frame is sent
+#define WS_LOG_HISTORY_SIZE					(CONFIG_WS_LOG_HISTORY_KB * 1024)	// Bytes of recent lines replayed to new clients, 0 disables
+#ifdef CONFIG_WS_LOG_STORE
+#define WS_LOG_STORE_PARTITION				"logstore"		// Data partition label in partitions.csv
+#define WS_LOG_STORE_BATCH_SIZE				CONFIG_WS_LOG_STORE_BATCH_SIZE		// Bytes of log lines collected before a flash write
+#define WS_LOG_STORE_FLUSH_MS				(CONFIG_WS_LOG_STORE_FLUSH_S * 1000)	// Longest time lines wait in RAM
+#define WS_LOG_STORE_CHUNK_SIZE				1024	// Bytes read from flash per chunk of a /logs response
+#endif
+#ifdef CONFIG_WS_LOG_FORMAT_BINARY
+#define WS_LOG_FRAME_TYPE					HTTPD_WS_TYPE_BINARY	// Records from log_bin.h, see tools/ws_log_decode.py
+#else
+#define WS_LOG_FRAME_TYPE					HTTPD_WS_TYPE_TEXT
+#endif
 
 /**
  * Connection status for Wifi
@@ -46,33 +73,49 @@ typedef enum http_server_message
 	HTTP_MSG_OTA_UPDATE_SUCCESSFUL,
 	HTTP_MSG_OTA_UPDATE_FAILED,
 	HTTP_MSG_TIME_SERVICE_INITIALIZED,
+	HTTP_MSG_SERVER_ACQUIRE,
+	HTTP_MSG_SERVER_RELEASE,
+	HTTP_MSG_SERVER_IDLE,
+	HTTP_MSG_METRICS_PUSH,
 } http_server_message_e;
 
 /**
- * Structure for the message queue
+ * Interfaces that keep the HTTP server running, see http_server_acquire
  */
-typedef struct http_server_queue_message
+typedef enum http_server_user
 {
-	http_server_message_e msgID;
-} http_server_queue_message_t;
+	HTTP_SERVER_USER_AP = 0,		///> One reference per station joined to the SoftAP
+	HTTP_SERVER_USER_STA,			///> One reference while the station interface has an IP
+	HTTP_SERVER_USER_BENCH,			///> One reference while the topology benchmark runs its loopback client
+	HTTP_SERVER_USER_COUNT,
+} http_server_user_e;
 
 /**
- * Sends a message to the queue
+ * Sends a message to the HTTP server monitor without blocking
  * @param msgID message ID from the http_server_message_e enum.
- * @return pdTRUE if an item was successfully sent to the queue, otherwise pdFALSE.
- * @note Expand the parameter list based on your requirements e.g. how you've expanded the http_server_queue_message_t.
+ * @return pdTRUE if the message was queued, pdFALSE if the queue was full and it was dropped.
  */
 BaseType_t http_server_monitor_send_message(http_server_message_e msgID);
 
 /**
- * Starts the HTTP server.
+ * Creates the HTTP server monitor task and its timers. They stay resident, the server
+ * itself starts with the first http_server_acquire.
+ */
+void http_server_init(void);
+
+/**
+ * Takes a reference on the HTTP server for an interface, starting the server if it is
+ * not running. Does not block, safe to call from an esp_event handler.
+ * @param user interface that needs the server.
  */
-void http_server_start(void);
+void http_server_acquire(http_server_user_e user);
 
 /**
- * Stops the HTTP server.
+ * Drops a reference taken with http_server_acquire. The server keeps running when the
+ * last one goes, unless Websocket Log Streaming / Stop the HTTP server when idle is set.
+ * @param user interface that no longer needs the server.
  */
-void http_server_stop(void);
+void http_server_release(http_server_user_e user);
 
 /**
  * Timer callback function which calls esp_restart upon successful firmware update.
@@ -92,7 +135,40 @@ int http_websocket_vprintf(const char *format, va_list args);
 
 void log_for_websocket_setup(void);
 
-void http_ws_server_send_messages(char * data);
+/**
+ * Log ring counters
+ */
+typedef struct ws_log_stats
+{
+	uint32_t lines;					///> Lines taken off the ring by the websocket log task
+	uint32_t dropped;				///> Lines lost because the ring was full
+} ws_log_stats_t;
+
+/**
+ * Reads the log ring counters, from any task.
+ * @param stats receives the counters.
+ */
+void ws_log_get_stats(ws_log_stats_t *stats);
+
+/**
+ * Stops or resumes the copy of every log line on the serial console. At 115200 baud the
+ * console carries less than 150 lines a second, and each logging task waits for it.
+ * @param mute true to keep log lines off the console, websocket clients still get them.
+ */
+void ws_log_console_mute(bool mute);
+
+/**
+ * Queues a message for every connected websocket client.
+ * @param msg message to send, the caller keeps its own reference.
+ */
+void http_ws_server_send_msg(ws_msg_t *msg);
+
+/**
+ * Queues a text frame for every connected websocket client.
+ * @param data payload, not required to be NULL terminated.
+ * @param len payload length in bytes.
+ */
+void http_ws_server_send_messages(const char *data, size_t len);
 
 void http_server_set_connect_status(http_server_wifi_connect_status_e wifi_connect_status);
 
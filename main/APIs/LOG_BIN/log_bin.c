@@ -0,0 +1,189 @@
+/*
+ * log_bin.c
+ *
+ *  Created on: May 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "log_bin.h"
+
+/**
+ * Appends raw bytes to a record.
+ * @param p write position.
+ * @param end end of the record buffer.
+ * @param src bytes to append.
+ * @param len number of bytes.
+ * @return the new write position, or NULL if the bytes do not fit.
+ */
+static uint8_t *log_bin_put(uint8_t *p, const uint8_t *end, const void *src, size_t len)
+{
+	if (p == NULL || (size_t)(end - p) < len)
+	{
+		return NULL;
+	}
+	memcpy(p, src, len);
+	return p + len;
+}
+
+/**
+ * Writes the record header once the payload length is known.
+ * @param out record buffer.
+ * @param end write position after the payload.
+ * @param fmt format ID.
+ * @param timestamp milliseconds since boot.
+ * @return total record size.
+ */
+static size_t log_bin_finish(uint8_t *out, const uint8_t *end, uint32_t fmt, uint32_t timestamp)
+{
+	uint16_t len = (uint16_t)(end - out - sizeof(uint16_t));
+
+	memcpy(&out[0], &len, sizeof(len));
+	memcpy(&out[2], &fmt, sizeof(fmt));
+	memcpy(&out[6], &timestamp, sizeof(timestamp));
+
+	return end - out;
+}
+
+size_t log_bin_encode(uint8_t *out, size_t max, uint32_t timestamp, const char *format, va_list args)
+{
+	const uint8_t *end = out + max;
+	uint8_t *p = out + LOG_BIN_HEADER_SIZE;
+	const char *f = format;
+
+	if (max < LOG_BIN_HEADER_SIZE)
+	{
+		return 0;
+	}
+
+	while ((f = strchr(f, '%')) != NULL)
+	{
+		f++;
+		if (*f == '%')
+		{
+			f++;
+			continue;
+		}
+
+		// Flags
+		while (*f && strchr("-+ #0", *f))
+		{
+			f++;
+		}
+
+		// Width and precision, '*' takes an int from the arguments
+		for (int field = 0; field < 2; ++field)
+		{
+			if (field == 1)
+			{
+				if (*f != '.')
+				{
+					break;
+				}
+				f++;
+			}
+
+			if (*f == '*')
+			{
+				int32_t value = va_arg(args, int);
+				p = log_bin_put(p, end, &value, sizeof(value));
+				f++;
+			}
+			else
+			{
+				while (*f >= '0' && *f <= '9')
+				{
+					f++;
+				}
+			}
+		}
+
+		// Length modifiers, only the 64-bit ones change the argument size on the ESP32
+		bool wide = false;
+		bool is_long = false;
+		while (*f && strchr("hlLqjzt", *f))
+		{
+			if ((*f == 'l' && f[1] == 'l') || *f == 'q' || *f == 'j')
+			{
+				wide = true;
+			}
+			is_long |= (*f == 'l');
+			f++;
+		}
+
+		switch (*f++)
+		{
+			case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+				if (wide)
+				{
+					uint64_t value = va_arg(args, unsigned long long);
+					p = log_bin_put(p, end, &value, sizeof(value));
+				}
+				else
+				{
+					uint32_t value = is_long ? va_arg(args, unsigned long) : va_arg(args, unsigned int);
+					p = log_bin_put(p, end, &value, sizeof(value));
+				}
+				break;
+
+			case 'p':
+			{
+				uint32_t value = (uint32_t)(uintptr_t)va_arg(args, void *);
+				p = log_bin_put(p, end, &value, sizeof(value));
+				break;
+			}
+
+			case 's':
+			{
+				const char *str = va_arg(args, const char *);
+				if (str == NULL)
+				{
+					str = "(null)";
+				}
+				size_t len = strnlen(str, LOG_BIN_MAX_STRING_LEN);
+				p = log_bin_put(p, end, str, len);
+				p = log_bin_put(p, end, "", 1);
+				break;
+			}
+
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			{
+				double value = va_arg(args, double);
+				p = log_bin_put(p, end, &value, sizeof(value));
+				break;
+			}
+
+			default:
+				// %n or a conversion the decoder would not understand either
+				return 0;
+		}
+
+		if (p == NULL)
+		{
+			return 0;
+		}
+	}
+
+	return log_bin_finish(out, p, (uint32_t)(uintptr_t)format, timestamp);
+}
+
+size_t log_bin_encode_text(uint8_t *out, size_t max, uint32_t timestamp, const char *format, va_list args)
+{
+	if (max <= LOG_BIN_HEADER_SIZE)
+	{
+		return 0;
+	}
+
+	size_t room = max - LOG_BIN_HEADER_SIZE;
+	int written = vsnprintf((char *)&out[LOG_BIN_HEADER_SIZE], room, format, args);
+	if (written <= 0)
+	{
+		return 0;
+	}
+
+	size_t len = ((size_t)written < room) ? (size_t)written : room - 1;
+	return log_bin_finish(out, &out[LOG_BIN_HEADER_SIZE + len], LOG_BIN_FMT_TEXT, timestamp);
+}
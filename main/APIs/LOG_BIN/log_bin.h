@@ -0,0 +1,56 @@
+/*
+ * log_bin.h
+ *
+ *  Created on: May 02, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_LOG_BIN_H_
+#define MAIN_LOG_BIN_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Binary log record, all fields little endian:
+ *  u16 len        bytes following this field
+ *  u32 fmt        address of the format string in flash, LOG_BIN_FMT_TEXT for rendered text
+ *  u32 timestamp  milliseconds since boot
+ *  ...            raw arguments in format order, or the rendered text
+ *
+ * Arguments are copied as they come out of the va_list: 4 bytes for int sized values
+ * and pointers, 8 bytes for long long and double, strings as NUL terminated bytes.
+ * tools/ws_log_decode.py renders records with the string table extracted from the ELF.
+ */
+#define LOG_BIN_HEADER_SIZE			10
+
+// Format ID of records carrying an already rendered line
+#define LOG_BIN_FMT_TEXT			0
+
+// Longest string argument copied into a record, longer ones are truncated
+#define LOG_BIN_MAX_STRING_LEN		64
+
+/**
+ * Encodes a log call without rendering it.
+ * @param out buffer receiving the record.
+ * @param max size of out.
+ * @param timestamp milliseconds since boot.
+ * @param format format string, must stay at the same address for the life of the firmware.
+ * @param args format arguments.
+ * @return record size in bytes, or 0 if the record does not fit or the format is not supported.
+ */
+size_t log_bin_encode(uint8_t *out, size_t max, uint32_t timestamp, const char *format, va_list args);
+
+/**
+ * Encodes a log call as a rendered text record.
+ * @param out buffer receiving the record.
+ * @param max size of out.
+ * @param timestamp milliseconds since boot.
+ * @param format format string.
+ * @param args format arguments.
+ * @return record size in bytes, or 0 if nothing was written.
+ */
+size_t log_bin_encode_text(uint8_t *out, size_t max, uint32_t timestamp, const char *format, va_list args);
+
+#endif /* MAIN_LOG_BIN_H_ */
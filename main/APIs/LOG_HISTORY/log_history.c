@@ -0,0 +1,133 @@
+/*
+ * log_history.c
+ *
+ *  Created on: May 9, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <string.h>
+
+#include "log_history.h"
+
+/**
+ * Maps a position to a buffer offset. Positions wrap at 2^32, which is not a multiple of
+ * every size, so the mapping goes through the offset of the oldest record.
+ * @param history history to map into.
+ * @param pos absolute position between start and start + size.
+ * @return offset in buff.
+ */
+static inline uint32_t log_history_offset(const log_history_t *history, uint32_t pos)
+{
+	return (history->start_offset + (pos - history->start)) % history->size;
+}
+
+/**
+ * Copies bytes into the ring, wrapping at the end of the buffer.
+ * @param history history to write.
+ * @param pos absolute position to write at.
+ * @param data bytes to copy.
+ * @param len number of bytes.
+ */
+static void log_history_put(log_history_t *history, uint32_t pos, const void *data, size_t len)
+{
+	uint32_t offset = log_history_offset(history, pos);
+	size_t first = (len < history->size - offset) ? len : history->size - offset;
+
+	memcpy(&history->buff[offset], data, first);
+	memcpy(history->buff, (const uint8_t *)data + first, len - first);
+}
+
+/**
+ * Copies bytes out of the ring, wrapping at the end of the buffer.
+ * @param history history to read.
+ * @param pos absolute position to read from.
+ * @param out buffer receiving the bytes.
+ * @param len number of bytes.
+ */
+static void log_history_get(const log_history_t *history, uint32_t pos, void *out, size_t len)
+{
+	uint32_t offset = log_history_offset(history, pos);
+	size_t first = (len < history->size - offset) ? len : history->size - offset;
+
+	memcpy(out, &history->buff[offset], first);
+	memcpy((uint8_t *)out + first, history->buff, len - first);
+}
+
+bool log_history_init(log_history_t *history, void *buff, size_t size)
+{
+	if (buff == NULL || size <= LOG_HISTORY_HEADER_SIZE || size > UINT32_MAX / 2)
+	{
+		return false;
+	}
+
+	history->buff = buff;
+	history->size = size;
+	history->start = 0;
+	history->start_offset = 0;
+	history->end = 0;
+	history->evicted = 0;
+
+	return true;
+}
+
+void log_history_append(log_history_t *history, const void *data, size_t len)
+{
+	uint32_t span = LOG_HISTORY_HEADER_SIZE + len;
+
+	if (history->size == 0 || len > UINT16_MAX || span > history->size)
+	{
+		return;
+	}
+
+	while (history->end + span - history->start > history->size)
+	{
+		uint16_t old;
+		log_history_get(history, history->start, &old, sizeof(old));
+		history->start_offset = (history->start_offset + LOG_HISTORY_HEADER_SIZE + old) % history->size;
+		history->start += LOG_HISTORY_HEADER_SIZE + old;
+		history->evicted++;
+	}
+
+	uint16_t header = len;
+	log_history_put(history, history->end, &header, sizeof(header));
+	log_history_put(history, history->end + LOG_HISTORY_HEADER_SIZE, data, len);
+	history->end += span;
+}
+
+size_t log_history_read(log_history_t *history, uint32_t *cursor, uint8_t *out, size_t max)
+{
+	size_t copied = 0;
+
+	// Signed distances keep working once the positions wrap around
+	if ((int32_t)(*cursor - history->start) < 0 || (int32_t)(history->end - *cursor) < 0)
+	{
+		*cursor = history->start;
+	}
+
+	while (*cursor != history->end)
+	{
+		uint16_t len;
+		log_history_get(history, *cursor, &len, sizeof(len));
+
+		if (len > max)
+		{
+			// Can never be delivered, step over it once nothing else is pending
+			if (copied == 0)
+			{
+				*cursor += LOG_HISTORY_HEADER_SIZE + len;
+			}
+			break;
+		}
+
+		if (copied + len > max)
+		{
+			break;
+		}
+
+		log_history_get(history, *cursor + LOG_HISTORY_HEADER_SIZE, &out[copied], len);
+		copied += len;
+		*cursor += LOG_HISTORY_HEADER_SIZE + len;
+	}
+
+	return copied;
+}
@@ -0,0 +1,63 @@
+/*
+ * log_history.h
+ *
+ *  Created on: May 9, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_LOG_HISTORY_H_
+#define MAIN_LOG_HISTORY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bytes stored in front of every record
+#define LOG_HISTORY_HEADER_SIZE		sizeof(uint16_t)
+
+/**
+ * Fixed size ring of the most recent records, the oldest ones are overwritten.
+ *
+ * Positions are absolute byte counts since init, so a reader cursor stays valid across
+ * wrap-arounds and can tell when the records it was pointing at were overwritten.
+ * Not thread safe, meant to be owned by a single task.
+ */
+typedef struct log_history
+{
+	uint8_t *buff;
+	uint32_t size;
+	uint32_t start;					///> Position of the oldest record
+	uint32_t start_offset;			///> Offset of the oldest record in buff
+	uint32_t end;					///> Position right after the newest record
+	uint32_t evicted;				///> Records overwritten so far
+} log_history_t;
+
+/**
+ * Initializes a history on top of caller provided storage.
+ * @param history history to initialize.
+ * @param buff backing storage.
+ * @param size size of buff in bytes.
+ * @return true if the history was initialized.
+ */
+bool log_history_init(log_history_t *history, void *buff, size_t size);
+
+/**
+ * Appends a record, overwriting the oldest ones as needed.
+ * @param history history to append to.
+ * @param data record bytes.
+ * @param len record length, at most UINT16_MAX and smaller than the history.
+ */
+void log_history_append(log_history_t *history, const void *data, size_t len);
+
+/**
+ * Copies whole records, back to back without their headers, starting at a cursor.
+ * A cursor pointing at overwritten records first moves to the oldest record left.
+ * @param history history to read.
+ * @param cursor position to read from, moved past the records copied.
+ * @param out buffer receiving the records.
+ * @param max size of out, a record larger than max is skipped.
+ * @return number of bytes copied.
+ */
+size_t log_history_read(log_history_t *history, uint32_t *cursor, uint8_t *out, size_t max);
+
+#endif /* MAIN_LOG_HISTORY_H_ */
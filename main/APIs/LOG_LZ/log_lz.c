@@ -0,0 +1,133 @@
+/*
+ * log_lz.c
+ *
+ *  Created on: May 6, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <string.h>
+
+#include "log_lz.h"
+
+#define LOG_LZ_MIN_MATCH			3
+#define LOG_LZ_MAX_MATCH			(LOG_LZ_MIN_MATCH + 15)
+#define LOG_LZ_MAX_OFFSET			4096
+
+/**
+ * Preset dictionary, text our log lines keep repeating: color escapes, level letters,
+ * tags and event names. The most frequent pieces go last so they win the hash slots.
+ * Changing it breaks the host decompressor, bump LOG_LZ_DICT_VERSION and update tools/ws_log_lz.py.
+ */
+static const char log_lz_dict[] =
+		"wifi:esp_netif_handlers: sta ip: , mask: , gw: httpd_ws"
+		"Handshake done, the new connection was opened"
+		"frame len is Got packet with message: "
+		"WIFI_EVENT_AP_STADISCONNECTEDWIFI_EVENT_STA_CONNECTED"
+		"IP_EVENT_STA_GOT_IPWIFI_APP_MSG_STA_HTTP_MSG_WIFI_CONNECT_http_server_"
+		") [ws_client]: ) [ws_rx_pool]: ) [ws_rpc]: ) nvs: "
+		"\033[0;31mE (\033[0;33mW (\033[0;35m\033[0;36m"
+		") [http_server]: ) [WIFI_APP]: \033[0m\n\033[0;32mI (";
+
+_Static_assert(sizeof(log_lz_dict) - 1 <= LOG_LZ_DICT_MAX_LEN, "log_lz_dict does not fit LOG_LZ_DICT_MAX_LEN");
+
+static inline uint32_t log_lz_hash(const uint8_t *p)
+{
+	uint32_t v = p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16);
+	return (uint32_t)(v * 2654435761U) >> (32 - LOG_LZ_HASH_BITS);
+}
+
+size_t log_lz_window_init(uint8_t *window)
+{
+	memcpy(window, log_lz_dict, sizeof(log_lz_dict) - 1);
+	return sizeof(log_lz_dict) - 1;
+}
+
+size_t log_lz_compress(log_lz_t *lz, const uint8_t *window, size_t len, uint8_t *out, size_t max)
+{
+	const size_t start = sizeof(log_lz_dict) - 1;
+	const size_t end = start + len;
+
+	if (len > UINT16_MAX || max < LOG_LZ_HEADER_SIZE)
+	{
+		return 0;
+	}
+
+	memset(lz->head, 0x00, sizeof(lz->head));
+	for (size_t pos = 0; pos + LOG_LZ_MIN_MATCH <= start; ++pos)
+	{
+		lz->head[log_lz_hash(&window[pos])] = pos + 1;
+	}
+
+	out[0] = LOG_LZ_MAGIC;
+	out[1] = LOG_LZ_DICT_VERSION;
+	out[2] = len & 0xFF;
+	out[3] = len >> 8;
+
+	size_t o = LOG_LZ_HEADER_SIZE;
+	size_t flags = 0;
+	uint8_t item = 8;
+
+	for (size_t pos = start; pos < end;)
+	{
+		size_t match_len = 0;
+		size_t match_pos = 0;
+
+		if (pos + LOG_LZ_MIN_MATCH <= end)
+		{
+			uint32_t hash = log_lz_hash(&window[pos]);
+			size_t candidate = lz->head[hash];
+			lz->head[hash] = pos + 1;
+
+			if (candidate && pos - (candidate - 1) <= LOG_LZ_MAX_OFFSET)
+			{
+				size_t limit = end - pos < LOG_LZ_MAX_MATCH ? end - pos : LOG_LZ_MAX_MATCH;
+
+				match_pos = candidate - 1;
+				while (match_len < limit && window[match_pos + match_len] == window[pos + match_len])
+				{
+					match_len++;
+				}
+			}
+		}
+
+		if (match_len < LOG_LZ_MIN_MATCH)
+		{
+			match_len = 0;
+		}
+
+		if (o + (item == 8) + (match_len ? 2 : 1) > max)
+		{
+			return 0;
+		}
+
+		if (item == 8)
+		{
+			flags = o;
+			out[o++] = 0;
+			item = 0;
+		}
+
+		if (match_len)
+		{
+			size_t offset = pos - match_pos - 1;
+
+			out[flags] |= 1U << item;
+			out[o++] = offset & 0xFF;
+			out[o++] = (offset >> 8) | ((match_len - LOG_LZ_MIN_MATCH) << 4);
+
+			// Index the skipped positions so later lines can match inside this one
+			for (size_t i = 1; i < match_len && pos + i + LOG_LZ_MIN_MATCH <= end; ++i)
+			{
+				lz->head[log_lz_hash(&window[pos + i])] = pos + i + 1;
+			}
+			pos += match_len;
+		}
+		else
+		{
+			out[o++] = window[pos++];
+		}
+		item++;
+	}
+
+	return o;
+}
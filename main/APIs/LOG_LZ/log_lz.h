@@ -0,0 +1,66 @@
+/*
+ * log_lz.h
+ *
+ *  Created on: May 6, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_LOG_LZ_H_
+#define MAIN_LOG_LZ_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * LZSS compressed frame, every frame stands alone:
+ *  u8  magic        LOG_LZ_MAGIC
+ *  u8  dict         LOG_LZ_DICT_VERSION of the preset dictionary used
+ *  u16 len          uncompressed length, little endian
+ *  ...              groups of one flag byte followed by 8 items, flag bit n (LSB first) tells item n apart:
+ *                   0 literal byte
+ *                   1 match, 2 bytes: (offset - 1) in 12 bits, then (length - 3) in the upper 4 bits
+ *
+ * Offsets reach back up to 4096 bytes into the output, the preset dictionary sits in front
+ * of the first output byte so even the first line of a frame finds the tags and color escapes.
+ * Frames do not share history, a dropped frame never breaks the ones after it.
+ * tools/ws_log_lz.py decompresses frames with the same dictionary.
+ */
+#define LOG_LZ_HEADER_SIZE			4
+#define LOG_LZ_MAGIC				0xA5
+#define LOG_LZ_DICT_VERSION			1
+
+// Room reserved in front of the data for the preset dictionary
+#define LOG_LZ_DICT_MAX_LEN			512
+
+// Largest output of log_lz_compress for len bytes of input
+#define LOG_LZ_BOUND(len)			(LOG_LZ_HEADER_SIZE + (len) + ((len) + 7) / 8)
+
+#define LOG_LZ_HASH_BITS			10
+
+/**
+ * Compressor state, large enough to keep off small task stacks
+ */
+typedef struct log_lz
+{
+	uint16_t head[1 << LOG_LZ_HASH_BITS];		///> Latest window position + 1 of every 3-byte hash, 0 if none
+} log_lz_t;
+
+/**
+ * Copies the preset dictionary to the start of a compression window.
+ * @param window buffer of at least LOG_LZ_DICT_MAX_LEN bytes, the data to compress goes right after the dictionary.
+ * @return dictionary length, where the data starts.
+ */
+size_t log_lz_window_init(uint8_t *window);
+
+/**
+ * Compresses one frame.
+ * @param lz compressor state, reset on every call.
+ * @param window buffer prepared by log_lz_window_init with the data following the dictionary.
+ * @param len number of data bytes, at most UINT16_MAX.
+ * @param out buffer receiving the frame, LOG_LZ_BOUND(len) bytes are always enough.
+ * @param max size of out.
+ * @return frame length, 0 if out is too small.
+ */
+size_t log_lz_compress(log_lz_t *lz, const uint8_t *window, size_t len, uint8_t *out, size_t max);
+
+#endif /* MAIN_LOG_LZ_H_ */
@@ -0,0 +1,223 @@
+/*
+ * log_ring.c
+ *
+ *  Created on: Apr 18, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <string.h>
+
+#include "log_ring.h"
+
+/**
+ * Record header layout (one 32-bit word in front of every record):
+ *  [31]    committed, the consumer may read the record
+ *  [30]    skip, padding up to the end of the ring or a discarded record
+ *  [29:16] payload length
+ *  [15:0]  span, header + payload rounded up to 4 bytes
+ * A header of zero means the record is reserved but still being written.
+ */
+#define LOG_RING_HDR_COMMITTED		(1UL << 31)
+#define LOG_RING_HDR_SKIP			(1UL << 30)
+#define LOG_RING_HDR_LEN_SHIFT		16
+#define LOG_RING_HDR_LEN_MASK		0x3FFFUL
+#define LOG_RING_HDR_SPAN_MASK		0xFFFFUL
+
+#define LOG_RING_ALIGN(x)			(((x) + 3U) & ~3U)
+
+static inline _Atomic uint32_t *log_ring_header(log_ring_t *ring, uint32_t pos)
+{
+	return (_Atomic uint32_t *)&ring->buff[pos & (ring->size - 1)];
+}
+
+bool log_ring_init(log_ring_t *ring, void *buff, size_t size)
+{
+	if (buff == NULL || ((uintptr_t)buff & 3U) || size < 64 || (size & (size - 1)) || size > UINT16_MAX + 1UL)
+	{
+		return false;
+	}
+
+	memset(buff, 0x00, size);
+	ring->buff = buff;
+	ring->size = size;
+	ring->high_water = 0;
+	ring->consumed = 0;
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+	atomic_init(&ring->dropped, 0);
+
+	return true;
+}
+
+void *log_ring_reserve(log_ring_t *ring, size_t max_len)
+{
+	if (ring->size == 0 || max_len > LOG_RING_MAX_RECORD_LEN)
+	{
+		return NULL;
+	}
+
+	uint32_t span = LOG_RING_ALIGN(LOG_RING_HEADER_SIZE + max_len);
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	uint32_t pad;
+
+	do
+	{
+		// Acquire pairs with the release in log_ring_release so the zeroed bytes are visible
+		uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+		uint32_t offset = head & (ring->size - 1);
+
+		// Records never wrap, pad out the end of the ring instead
+		pad = (offset + span > ring->size) ? ring->size - offset : 0;
+
+		if (head + pad + span - tail > ring->size)
+		{
+			atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+			return NULL;
+		}
+	// Acquire pairs with the release in log_ring_give_back so the bytes given back read as zero
+	} while (!atomic_compare_exchange_weak_explicit(&ring->head, &head, head + pad + span,
+			memory_order_acquire, memory_order_relaxed));
+
+	if (pad)
+	{
+		atomic_store_explicit(log_ring_header(ring, head), LOG_RING_HDR_COMMITTED | LOG_RING_HDR_SKIP | pad,
+				memory_order_release);
+	}
+
+	// The span is kept in the header until commit, the committed bit stays clear
+	_Atomic uint32_t *header = log_ring_header(ring, head + pad);
+	atomic_store_explicit(header, span, memory_order_relaxed);
+
+	return (uint8_t *)header + LOG_RING_HEADER_SIZE;
+}
+
+/**
+ * Returns the end of a reservation that the producer did not use.
+ * If the record is still the newest reservation, head moves back so the next record
+ * starts right after it. Otherwise a skip record covers the unused bytes.
+ * @param ring ring the record was reserved from.
+ * @param header header of the record.
+ * @param reserved span reserved.
+ * @param span span kept, 0 to give back the whole record.
+ */
+static void log_ring_give_back(log_ring_t *ring, _Atomic uint32_t *header, uint32_t reserved, uint32_t span)
+{
+	uint32_t offset = (uint8_t *)header - ring->buff;
+	uint8_t *unused = (uint8_t *)header + span;
+
+	// The free part of the ring must read as zero, the producer may have written past its length
+	memset(unused, 0x00, reserved - span);
+
+	// The record can not be a whole lap behind head, it still holds the tail back
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	if (((head - reserved) & (ring->size - 1)) == offset &&
+		atomic_compare_exchange_strong_explicit(&ring->head, &head, head - reserved + span,
+				memory_order_release, memory_order_relaxed))
+	{
+		return;
+	}
+
+	atomic_store_explicit((_Atomic uint32_t *)unused, LOG_RING_HDR_COMMITTED | LOG_RING_HDR_SKIP | (reserved - span),
+			memory_order_release);
+}
+
+void log_ring_commit(log_ring_t *ring, void *payload, size_t len)
+{
+	_Atomic uint32_t *header = (_Atomic uint32_t *)((uint8_t *)payload - LOG_RING_HEADER_SIZE);
+	uint32_t reserved = atomic_load_explicit(header, memory_order_relaxed) & LOG_RING_HDR_SPAN_MASK;
+
+	if (len > reserved - LOG_RING_HEADER_SIZE)
+	{
+		len = reserved - LOG_RING_HEADER_SIZE;
+	}
+
+	// Short records only keep the bytes they use
+	uint32_t span = LOG_RING_ALIGN(LOG_RING_HEADER_SIZE + len);
+	if (span < reserved)
+	{
+		log_ring_give_back(ring, header, reserved, span);
+	}
+
+	atomic_store_explicit(header, LOG_RING_HDR_COMMITTED | ((uint32_t)len << LOG_RING_HDR_LEN_SHIFT) | span,
+			memory_order_release);
+}
+
+void log_ring_discard(log_ring_t *ring, void *payload)
+{
+	_Atomic uint32_t *header = (_Atomic uint32_t *)((uint8_t *)payload - LOG_RING_HEADER_SIZE);
+	uint32_t reserved = atomic_load_explicit(header, memory_order_relaxed) & LOG_RING_HDR_SPAN_MASK;
+
+	log_ring_give_back(ring, header, reserved, 0);
+}
+
+/**
+ * Zeroes the record at the tail and hands its bytes back to the producers.
+ * @param ring ring to release from.
+ * @param span bytes taken by the record.
+ */
+static void log_ring_advance(log_ring_t *ring, uint32_t span)
+{
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+	memset(&ring->buff[tail & (ring->size - 1)], 0x00, span);
+	atomic_store_explicit(&ring->tail, tail + span, memory_order_release);
+}
+
+const void *log_ring_peek(log_ring_t *ring, size_t *len)
+{
+	if (ring->size == 0)
+	{
+		return NULL;
+	}
+
+	for (;;)
+	{
+		uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+		uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+		if (tail == head)
+		{
+			return NULL;
+		}
+
+		if (head - tail > ring->high_water)
+		{
+			ring->high_water = head - tail;
+		}
+
+		// Acquire pairs with the release in commit so the payload is visible
+		_Atomic uint32_t *header = log_ring_header(ring, tail);
+		uint32_t hdr = atomic_load_explicit(header, memory_order_acquire);
+
+		if (!(hdr & LOG_RING_HDR_COMMITTED))
+		{
+			return NULL;
+		}
+
+		if (hdr & LOG_RING_HDR_SKIP)
+		{
+			log_ring_advance(ring, hdr & LOG_RING_HDR_SPAN_MASK);
+			continue;
+		}
+
+		*len = (hdr >> LOG_RING_HDR_LEN_SHIFT) & LOG_RING_HDR_LEN_MASK;
+		return (uint8_t *)header + LOG_RING_HEADER_SIZE;
+	}
+}
+
+void log_ring_release(log_ring_t *ring)
+{
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	uint32_t hdr = atomic_load_explicit(log_ring_header(ring, tail), memory_order_relaxed);
+
+	if (hdr & LOG_RING_HDR_COMMITTED)
+	{
+		log_ring_advance(ring, hdr & LOG_RING_HDR_SPAN_MASK);
+		ring->consumed++;
+	}
+}
+
+uint32_t log_ring_used(log_ring_t *ring)
+{
+	return atomic_load_explicit(&ring->head, memory_order_relaxed) - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
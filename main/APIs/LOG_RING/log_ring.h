@@ -0,0 +1,98 @@
+/*
+ * log_ring.h
+ *
+ *  Created on: Apr 18, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_LOG_RING_H_
+#define MAIN_LOG_RING_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest payload a single record can hold
+#define LOG_RING_MAX_RECORD_LEN		8191
+
+// Size of the header placed in front of every record
+#define LOG_RING_HEADER_SIZE		sizeof(uint32_t)
+
+/**
+ * Multi-producer, single-consumer byte ring holding length-prefixed records.
+ *
+ * Producers reserve space with a CAS on head and format straight into the ring,
+ * then publish the record by setting the committed bit in its header. A record only
+ * keeps the bytes it used, the rest of its reservation goes back on commit. The single
+ * consumer reads records in reservation order and zeroes them on release, so the
+ * free part of the ring is always zero and a freshly reserved header reads as busy.
+ * No locks are taken on either side.
+ */
+typedef struct log_ring
+{
+	uint8_t *buff;					///> Backing storage, 4-byte aligned
+	uint32_t size;					///> Size of buff, power of two
+	_Atomic uint32_t head;			///> Next byte to be reserved by a producer
+	_Atomic uint32_t tail;			///> Next byte to be read by the consumer
+	_Atomic uint32_t dropped;		///> Reservations refused because the ring was full
+	uint32_t high_water;			///> Largest number of bytes seen in use by the consumer
+	uint32_t consumed;				///> Records released by the consumer, counted off the producer path
+} log_ring_t;
+
+/**
+ * Initializes a ring on top of caller provided storage.
+ * @param ring ring to initialize.
+ * @param buff backing storage, must be 4-byte aligned.
+ * @param size size of buff in bytes, must be a power of two.
+ * @return true if the ring was initialized.
+ */
+bool log_ring_init(log_ring_t *ring, void *buff, size_t size);
+
+/**
+ * Reserves room for a record of up to max_len bytes. Safe to call from any task.
+ * @param ring ring to reserve from.
+ * @param max_len maximum payload length the caller will write.
+ * @return pointer to the payload area, or NULL if the ring is full or not initialized.
+ * @note Every successful reservation must be followed by log_ring_commit or log_ring_discard.
+ */
+void *log_ring_reserve(log_ring_t *ring, size_t max_len);
+
+/**
+ * Publishes a reserved record to the consumer.
+ * @param ring ring the record was reserved from.
+ * @param payload pointer returned by log_ring_reserve.
+ * @param len number of payload bytes actually written, at most the reserved max_len.
+ * The reserved bytes past len are given back, the caller must not touch them anymore.
+ */
+void log_ring_commit(log_ring_t *ring, void *payload, size_t len);
+
+/**
+ * Gives back a reserved record without publishing it.
+ * @param ring ring the record was reserved from.
+ * @param payload pointer returned by log_ring_reserve.
+ */
+void log_ring_discard(log_ring_t *ring, void *payload);
+
+/**
+ * Returns the oldest committed record without removing it. Consumer side only.
+ * @param ring ring to read from.
+ * @param len set to the payload length of the returned record.
+ * @return pointer to the payload, or NULL if the ring is empty or the oldest record is still being written.
+ */
+const void *log_ring_peek(log_ring_t *ring, size_t *len);
+
+/**
+ * Removes the record returned by the last log_ring_peek. Consumer side only.
+ * @param ring ring to release from.
+ */
+void log_ring_release(log_ring_t *ring);
+
+/**
+ * Gets the number of bytes currently reserved or waiting for the consumer.
+ * @param ring ring to query.
+ * @return bytes in use.
+ */
+uint32_t log_ring_used(log_ring_t *ring);
+
+#endif /* MAIN_LOG_RING_H_ */
@@ -0,0 +1,410 @@
+/*
+ * log_store.c
+ *
+ *  Created on: May 12, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <string.h>
+
+#include "esp_crc.h"
+
+#include "log_store.h"
+
+/**
+ * Flash layout, every sector is one segment:
+ *  segment header  u32 magic, u32 seq, u32 start, u32 crc32 of the first 12 bytes
+ *  chunks          u16 len, u16 ~len, u32 crc32 of the data, data padded to 4 bytes
+ * Chunks follow each other until the erased (0xFF) part of the sector.
+ */
+#define LOG_STORE_MAGIC					0x53474F4CUL	// "LOGS"
+
+typedef struct log_store_header
+{
+	uint32_t magic;
+	uint32_t seq;
+	uint32_t start;
+	uint32_t crc;
+} log_store_header_t;
+
+typedef struct log_store_chunk
+{
+	uint16_t len;
+	uint16_t len_inv;
+	uint32_t crc;
+} log_store_chunk_t;
+
+#define LOG_STORE_ALIGN(x)				(((x) + 3U) & ~3U)
+
+// Smallest room worth starting a chunk in, below that the next segment is opened
+#define LOG_STORE_MIN_CHUNK				(sizeof(log_store_chunk_t) + 16)
+
+/**
+ * Checks a segment header.
+ * @param header header read from flash.
+ * @return true if the header is intact.
+ */
+static bool log_store_header_valid(const log_store_header_t *header)
+{
+	return header->magic == LOG_STORE_MAGIC && header->seq != 0 &&
+			header->crc == esp_crc32_le(0, (const uint8_t *)header, offsetof(log_store_header_t, crc));
+}
+
+/**
+ * Reads the chunk header at a position of a segment.
+ * @param store store to read.
+ * @param segment segment index.
+ * @param pos byte position within the segment.
+ * @param chunk receives the header.
+ * @return true if a well formed chunk header is there, false at the erased end or on garbage.
+ */
+static bool log_store_chunk_at(const log_store_t *store, uint16_t segment, uint32_t pos, log_store_chunk_t *chunk)
+{
+	if (pos + sizeof(log_store_chunk_t) > LOG_STORE_SECTOR_SIZE ||
+		store->flash->read(store->flash->ctx, segment * LOG_STORE_SECTOR_SIZE + pos, chunk, sizeof(*chunk)) != ESP_OK)
+	{
+		return false;
+	}
+
+	return (uint16_t)~chunk->len == chunk->len_inv && chunk->len != 0 &&
+			pos + sizeof(log_store_chunk_t) + chunk->len <= LOG_STORE_SECTOR_SIZE;
+}
+
+/**
+ * Gets the stream offset where a segment ends, which is where the next valid one starts.
+ * A segment closed early after a bad chunk may hold garbage past that point.
+ * @param store store to query.
+ * @param segment segment index.
+ * @return the offset.
+ */
+static uint32_t log_store_segment_end(const log_store_t *store, uint16_t segment)
+{
+	for (uint16_t i = segment; i != store->head; )
+	{
+		i = (i + 1) % store->segments;
+		if (store->index[i].seq)
+		{
+			return store->index[i].start;
+		}
+	}
+	return store->flash_end;
+}
+
+/**
+ * Erases the next segment in ring order and makes it the head.
+ * @param store store to advance.
+ * @return ESP_OK on success, or the flash error.
+ */
+static esp_err_t log_store_open_segment(log_store_t *store)
+{
+	uint16_t next = (store->index[store->head].seq == 0) ? store->head : (store->head + 1) % store->segments;
+	uint32_t seq = store->index[store->head].seq + 1;
+	const log_store_flash_t *flash = store->flash;
+
+	// The sector stops counting as history before it is erased
+	store->index[next].seq = 0;
+
+	esp_err_t err = flash->erase(flash->ctx, next * LOG_STORE_SECTOR_SIZE, LOG_STORE_SECTOR_SIZE);
+	store->erases++;
+	if (err != ESP_OK)
+	{
+		return err;
+	}
+
+	log_store_header_t header = {
+		.magic = LOG_STORE_MAGIC,
+		.seq = seq,
+		.start = store->flash_end,
+	};
+	header.crc = esp_crc32_le(0, (const uint8_t *)&header, offsetof(log_store_header_t, crc));
+
+	err = flash->write(flash->ctx, next * LOG_STORE_SECTOR_SIZE, &header, sizeof(header));
+	if (err != ESP_OK)
+	{
+		return err;
+	}
+
+	store->index[next].seq = seq;
+	store->index[next].start = store->flash_end;
+	store->head = next;
+	store->head_used = sizeof(header);
+
+	return ESP_OK;
+}
+
+/**
+ * Writes bytes to flash as chunks, opening segments as they fill up.
+ * @param store store to write.
+ * @param data bytes to write.
+ * @param len number of bytes.
+ * @return ESP_OK on success, or the flash error.
+ */
+static esp_err_t log_store_write_chunks(log_store_t *store, const uint8_t *data, size_t len)
+{
+	const log_store_flash_t *flash = store->flash;
+
+	while (len)
+	{
+		if (store->head_used + LOG_STORE_MIN_CHUNK > LOG_STORE_SECTOR_SIZE)
+		{
+			esp_err_t err = log_store_open_segment(store);
+			if (err != ESP_OK)
+			{
+				return err;
+			}
+		}
+
+		size_t room = (LOG_STORE_SECTOR_SIZE - store->head_used - sizeof(log_store_chunk_t)) & ~3U;
+		size_t n = (len < room) ? len : room;
+		uint32_t addr = store->head * LOG_STORE_SECTOR_SIZE + store->head_used;
+
+		log_store_chunk_t chunk = {
+			.len = n,
+			.len_inv = ~n,
+			.crc = esp_crc32_le(0, data, n),
+		};
+
+		// Header first, a chunk cut short by a reset then fails its CRC when mounting
+		esp_err_t err = flash->write(flash->ctx, addr, &chunk, sizeof(chunk));
+		if (err == ESP_OK && (n & ~3U))
+		{
+			err = flash->write(flash->ctx, addr + sizeof(chunk), data, n & ~3U);
+		}
+		if (err == ESP_OK && (n & 3U))
+		{
+			uint8_t tail[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+			memcpy(tail, &data[n & ~3U], n & 3U);
+			err = flash->write(flash->ctx, addr + sizeof(chunk) + (n & ~3U), tail, sizeof(tail));
+		}
+
+		// The space is spent even on failure, flash bits cannot be written twice
+		store->head_used += sizeof(chunk) + LOG_STORE_ALIGN(n);
+		if (err != ESP_OK)
+		{
+			return err;
+		}
+
+		store->flash_end += n;
+		store->chunks_written++;
+		data += n;
+		len -= n;
+	}
+
+	return ESP_OK;
+}
+
+esp_err_t log_store_mount(log_store_t *store, const log_store_flash_t *flash, uint8_t *batch, size_t batch_size)
+{
+	if (flash->size < 2 * LOG_STORE_SECTOR_SIZE || batch_size == 0 ||
+		batch_size > LOG_STORE_SECTOR_SIZE - sizeof(log_store_header_t) - sizeof(log_store_chunk_t))
+	{
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	memset(store, 0x00, sizeof(log_store_t));
+	store->flash = flash;
+	store->segments = flash->size / LOG_STORE_SECTOR_SIZE;
+	if (store->segments > LOG_STORE_MAX_SEGMENTS)
+	{
+		store->segments = LOG_STORE_MAX_SEGMENTS;
+	}
+	store->batch = batch;
+	store->batch_size = batch_size;
+
+	bool found = false;
+	for (uint16_t i = 0; i < store->segments; ++i)
+	{
+		log_store_header_t header;
+		esp_err_t err = flash->read(flash->ctx, i * LOG_STORE_SECTOR_SIZE, &header, sizeof(header));
+		if (err != ESP_OK)
+		{
+			return err;
+		}
+
+		if (log_store_header_valid(&header))
+		{
+			store->index[i].seq = header.seq;
+			store->index[i].start = header.start;
+			if (!found || header.seq > store->index[store->head].seq)
+			{
+				store->head = i;
+			}
+			found = true;
+		}
+	}
+
+	if (!found)
+	{
+		return log_store_open_segment(store);
+	}
+
+	// Walk the head segment to the end of its valid chunks
+	uint32_t pos = sizeof(log_store_header_t);
+	uint32_t end = store->index[store->head].start;
+	log_store_chunk_t chunk;
+
+	while (log_store_chunk_at(store, store->head, pos, &chunk))
+	{
+		// The batch is empty while mounting, it holds one chunk at most
+		size_t checked = 0;
+		uint32_t crc = 0;
+		while (checked < chunk.len)
+		{
+			size_t n = (chunk.len - checked < batch_size) ? chunk.len - checked : batch_size;
+			esp_err_t err = flash->read(flash->ctx, store->head * LOG_STORE_SECTOR_SIZE + pos + sizeof(chunk) + checked, batch, n);
+			if (err != ESP_OK)
+			{
+				return err;
+			}
+			crc = esp_crc32_le(crc, batch, n);
+			checked += n;
+		}
+
+		if (crc != chunk.crc)
+		{
+			break;
+		}
+
+		end += chunk.len;
+		pos += sizeof(chunk) + LOG_STORE_ALIGN(chunk.len);
+	}
+
+	store->flash_end = end;
+	store->head_used = pos;
+
+	// Anything but erased flash after the last good chunk cannot be written over, move on
+	uint32_t word = 0xFFFFFFFF;
+	if (pos + sizeof(word) <= LOG_STORE_SECTOR_SIZE)
+	{
+		flash->read(flash->ctx, store->head * LOG_STORE_SECTOR_SIZE + pos, &word, sizeof(word));
+	}
+	if (word != 0xFFFFFFFF)
+	{
+		store->corrupt_chunks++;
+		store->head_used = LOG_STORE_SECTOR_SIZE;
+	}
+
+	return ESP_OK;
+}
+
+esp_err_t log_store_append(log_store_t *store, const void *data, size_t len)
+{
+	const uint8_t *bytes = data;
+
+	while (len)
+	{
+		size_t n = store->batch_size - store->batch_len;
+		n = (len < n) ? len : n;
+
+		memcpy(&store->batch[store->batch_len], bytes, n);
+		store->batch_len += n;
+		bytes += n;
+		len -= n;
+
+		if (store->batch_len == store->batch_size)
+		{
+			esp_err_t err = log_store_flush(store);
+			if (err != ESP_OK)
+			{
+				return err;
+			}
+		}
+	}
+
+	return ESP_OK;
+}
+
+esp_err_t log_store_flush(log_store_t *store)
+{
+	if (store->batch_len == 0)
+	{
+		return ESP_OK;
+	}
+
+	esp_err_t err = log_store_write_chunks(store, store->batch, store->batch_len);
+
+	// Dropped on failure too, retrying a failing flash would only block the logger
+	store->batch_len = 0;
+	return err;
+}
+
+uint32_t log_store_start(const log_store_t *store)
+{
+	// The oldest segment follows the head in ring order
+	for (uint16_t i = 1; i <= store->segments; ++i)
+	{
+		uint16_t segment = (store->head + i) % store->segments;
+		if (store->index[segment].seq)
+		{
+			return store->index[segment].start;
+		}
+	}
+	return store->flash_end;
+}
+
+uint32_t log_store_end(const log_store_t *store)
+{
+	return store->flash_end + store->batch_len;
+}
+
+size_t log_store_read(const log_store_t *store, uint32_t offset, void *out, size_t len)
+{
+	uint8_t *dst = out;
+	size_t copied = 0;
+
+	// Segments in ring order after the head run from oldest to newest
+	for (uint16_t i = 1; i <= store->segments && copied < len && offset < store->flash_end; ++i)
+	{
+		uint16_t segment = (store->head + i) % store->segments;
+		const log_store_segment_t *seg = &store->index[segment];
+
+		if (seg->seq == 0)
+		{
+			continue;
+		}
+
+		uint32_t stream = seg->start;
+		uint32_t limit = log_store_segment_end(store, segment);
+		uint32_t pos = sizeof(log_store_header_t);
+		log_store_chunk_t chunk;
+
+		if (offset >= limit)
+		{
+			continue;
+		}
+
+		while (copied < len && offset < limit && stream < limit && log_store_chunk_at(store, segment, pos, &chunk))
+		{
+			if (offset < stream + chunk.len && offset >= stream)
+			{
+				size_t skip = offset - stream;
+				size_t n = chunk.len - skip;
+				n = (len - copied < n) ? len - copied : n;
+
+				if (store->flash->read(store->flash->ctx, segment * LOG_STORE_SECTOR_SIZE + pos + sizeof(chunk) + skip,
+						&dst[copied], n) != ESP_OK)
+				{
+					return copied;
+				}
+				copied += n;
+				offset += n;
+			}
+
+			stream += chunk.len;
+			pos += sizeof(chunk) + LOG_STORE_ALIGN(chunk.len);
+		}
+	}
+
+	// Newest bytes still in RAM
+	if (copied < len && offset >= store->flash_end && offset < log_store_end(store))
+	{
+		size_t skip = offset - store->flash_end;
+		size_t n = store->batch_len - skip;
+		n = (len - copied < n) ? len - copied : n;
+
+		memcpy(&dst[copied], &store->batch[skip], n);
+		copied += n;
+	}
+
+	return copied;
+}
@@ -0,0 +1,128 @@
+/*
+ * log_store.h
+ *
+ *  Created on: May 12, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_LOG_STORE_H_
+#define MAIN_LOG_STORE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Erase unit of the flash, every segment is one sector
+#define LOG_STORE_SECTOR_SIZE			4096
+
+// Segments tracked in RAM, a larger partition only uses this many sectors
+#define LOG_STORE_MAX_SEGMENTS			128
+
+/**
+ * Flash access used by the store, so it can run on a partition or on any stand-in.
+ * Addresses are relative to the start of the storage area.
+ */
+typedef struct log_store_flash
+{
+	esp_err_t (*read)(void *ctx, uint32_t addr, void *dst, size_t len);
+	esp_err_t (*write)(void *ctx, uint32_t addr, const void *src, size_t len);
+	esp_err_t (*erase)(void *ctx, uint32_t addr, size_t len);		///> Sets whole sectors to 0xFF
+	void *ctx;
+	uint32_t size;					///> Bytes available, a multiple of LOG_STORE_SECTOR_SIZE
+} log_store_flash_t;
+
+/**
+ * Segment as found in its header
+ */
+typedef struct log_store_segment
+{
+	uint32_t seq;					///> Write order, 0 if the sector holds no valid segment
+	uint32_t start;					///> Stream offset of the first byte in the segment
+} log_store_segment_t;
+
+/**
+ * Append-only log stream kept in a ring of flash segments.
+ *
+ * The stream is addressed by offsets counted from the very first byte ever stored, so
+ * a reader can come back later and ask for everything past the last offset it saw.
+ * Appends collect in a RAM batch and reach the flash as one CRC protected chunk when
+ * the batch is full or on log_store_flush. Segments are reused in ring order, so every
+ * sector is erased once per lap. Not thread safe.
+ */
+typedef struct log_store
+{
+	const log_store_flash_t *flash;
+	uint16_t segments;				///> Sectors in use
+	uint16_t head;					///> Segment being written
+	uint32_t head_used;				///> Bytes written in the head segment, header included
+	uint32_t flash_end;				///> Stream offset right after the last byte in flash
+	uint8_t *batch;					///> Appended bytes not in flash yet
+	size_t batch_size;
+	size_t batch_len;
+	uint32_t chunks_written;
+	uint32_t erases;
+	uint32_t corrupt_chunks;		///> Chunks that failed their check when mounting
+	log_store_segment_t index[LOG_STORE_MAX_SEGMENTS];
+} log_store_t;
+
+/**
+ * Finds the segments in flash and resumes after the last valid chunk, formats an empty storage.
+ * @param store store to mount.
+ * @param flash storage access, must outlive the store.
+ * @param batch RAM buffer for appends, also used as scratch while mounting.
+ * @param batch_size size of batch, at most LOG_STORE_SECTOR_SIZE minus the headers.
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE on bad sizes, or the flash error.
+ */
+esp_err_t log_store_mount(log_store_t *store, const log_store_flash_t *flash, uint8_t *batch, size_t batch_size);
+
+/**
+ * Appends bytes to the stream, writing full batches to flash.
+ * @param store store to append to.
+ * @param data bytes to append.
+ * @param len number of bytes.
+ * @return ESP_OK on success, or the flash error.
+ */
+esp_err_t log_store_append(log_store_t *store, const void *data, size_t len);
+
+/**
+ * Writes the pending batch to flash, even if it is not full.
+ * @param store store to flush.
+ * @return ESP_OK on success, or the flash error.
+ */
+esp_err_t log_store_flush(log_store_t *store);
+
+/**
+ * Gets the stream offset of the oldest byte still stored.
+ * @param store store to query.
+ * @return the offset.
+ */
+uint32_t log_store_start(const log_store_t *store);
+
+/**
+ * Gets the stream offset right after the newest byte, pending batch included.
+ * @param store store to query.
+ * @return the offset.
+ */
+uint32_t log_store_end(const log_store_t *store);
+
+/**
+ * Copies stored bytes, from flash and from the pending batch.
+ * @param store store to read.
+ * @param offset stream offset to start at, between log_store_start and log_store_end.
+ * @param out buffer receiving the bytes.
+ * @param len number of bytes wanted.
+ * @return number of bytes copied, short at the end of the stream.
+ */
+size_t log_store_read(const log_store_t *store, uint32_t offset, void *out, size_t len);
+
+/**
+ * Fills a flash access backed by a data partition, see log_store_partition.c.
+ * @param flash access to fill, must outlive the store.
+ * @param label partition label in partitions.csv.
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if there is no such partition.
+ */
+esp_err_t log_store_partition_flash(log_store_flash_t *flash, const char *label);
+
+#endif /* MAIN_LOG_STORE_H_ */
@@ -0,0 +1,42 @@
+/*
+ * log_store_partition.c
+ *
+ *  Created on: May 12, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include "esp_partition.h"
+
+#include "log_store.h"
+
+static esp_err_t log_store_partition_read(void *ctx, uint32_t addr, void *dst, size_t len)
+{
+	return esp_partition_read((const esp_partition_t *)ctx, addr, dst, len);
+}
+
+static esp_err_t log_store_partition_write(void *ctx, uint32_t addr, const void *src, size_t len)
+{
+	return esp_partition_write((const esp_partition_t *)ctx, addr, src, len);
+}
+
+static esp_err_t log_store_partition_erase(void *ctx, uint32_t addr, size_t len)
+{
+	return esp_partition_erase_range((const esp_partition_t *)ctx, addr, len);
+}
+
+esp_err_t log_store_partition_flash(log_store_flash_t *flash, const char *label)
+{
+	const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+	if (partition == NULL)
+	{
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	flash->read = log_store_partition_read;
+	flash->write = log_store_partition_write;
+	flash->erase = log_store_partition_erase;
+	flash->ctx = (void *)partition;
+	flash->size = partition->size - (partition->size % LOG_STORE_SECTOR_SIZE);
+
+	return ESP_OK;
+}
@@ -0,0 +1,107 @@
+/*
+ * metrics.c
+ *
+ *  Created on: May 14, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "metrics.h"
+
+const uint32_t metrics_histogram_bounds_us[METRICS_HISTOGRAM_BUCKETS - 1] =
+{
+	500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000
+};
+
+void metrics_histogram_observe(metrics_histogram_t *histogram, uint32_t us)
+{
+	size_t bucket = 0;
+	while (bucket < METRICS_HISTOGRAM_BUCKETS - 1 && us > metrics_histogram_bounds_us[bucket])
+	{
+		bucket++;
+	}
+
+	atomic_fetch_add_explicit(&histogram->buckets[bucket], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&histogram->sum_ms, (us + 500) / 1000, memory_order_relaxed);
+}
+
+void metrics_writer_init(metrics_writer_t *writer, char *buff, size_t size)
+{
+	writer->buff = buff;
+	writer->size = size;
+	writer->len = 0;
+	writer->truncated = false;
+	buff[0] = '\0';
+}
+
+/**
+ * Appends one formatted line, or nothing if it does not fit.
+ * @param writer output.
+ * @param format printf format of the line.
+ */
+static void metrics_printf(metrics_writer_t *writer, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int written = vsnprintf(&writer->buff[writer->len], writer->size - writer->len, format, args);
+	va_end(args);
+
+	if (written < 0 || (size_t)written >= writer->size - writer->len)
+	{
+		// Cut the partial line off, a scraper must not see half a sample
+		writer->buff[writer->len] = '\0';
+		writer->truncated = true;
+		return;
+	}
+	writer->len += written;
+}
+
+void metrics_write_family(metrics_writer_t *writer, const char *name, const char *type, const char *help)
+{
+	metrics_printf(writer, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metrics_write_sample(metrics_writer_t *writer, const char *name, const char *labels, uint32_t value)
+{
+	if (labels)
+	{
+		metrics_printf(writer, "%s{%s} %u\n", name, labels, value);
+	}
+	else
+	{
+		metrics_printf(writer, "%s %u\n", name, value);
+	}
+}
+
+void metrics_write_value(metrics_writer_t *writer, const char *name, const char *type, const char *help, uint32_t value)
+{
+	metrics_write_family(writer, name, type, help);
+	metrics_write_sample(writer, name, NULL, value);
+}
+
+void metrics_write_histogram(metrics_writer_t *writer, const char *name, const char *help, const metrics_histogram_t *histogram)
+{
+	uint32_t cumulative = 0;
+
+	metrics_write_family(writer, name, "histogram", help);
+	for (size_t i = 0; i < METRICS_HISTOGRAM_BUCKETS; ++i)
+	{
+		cumulative += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+		if (i < METRICS_HISTOGRAM_BUCKETS - 1)
+		{
+			uint32_t bound = metrics_histogram_bounds_us[i];
+			metrics_printf(writer, "%s_bucket{le=\"%u.%06u\"} %u\n", name, bound / 1000000, bound % 1000000, cumulative);
+		}
+		else
+		{
+			metrics_printf(writer, "%s_bucket{le=\"+Inf\"} %u\n", name, cumulative);
+		}
+	}
+
+	uint32_t sum_ms = atomic_load_explicit(&histogram->sum_ms, memory_order_relaxed);
+	metrics_printf(writer, "%s_sum %u.%03u\n", name, sum_ms / 1000, sum_ms % 1000);
+	// The count is the +Inf bucket, the two always match in the output
+	metrics_printf(writer, "%s_count %u\n", name, cumulative);
+}
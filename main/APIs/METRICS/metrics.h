@@ -0,0 +1,98 @@
+/*
+ * metrics.h
+ *
+ *  Created on: May 14, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_METRICS_H_
+#define MAIN_METRICS_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Latency buckets, the last one catches everything above the largest bound
+#define METRICS_HISTOGRAM_BUCKETS		12
+
+/**
+ * Latency histogram with fixed bucket bounds, see metrics_histogram_bounds_us.
+ * Observations only do relaxed atomic adds, so any task can record without a lock.
+ * The sample count is the sum of the buckets, so it always matches the +Inf bucket.
+ */
+typedef struct metrics_histogram
+{
+	_Atomic uint32_t buckets[METRICS_HISTOGRAM_BUCKETS];	///> Samples per bucket, not cumulative
+	_Atomic uint32_t sum_ms;		///> Sum of all samples, rounded to milliseconds
+} metrics_histogram_t;
+
+/**
+ * Output buffer for the Prometheus text format
+ */
+typedef struct metrics_writer
+{
+	char *buff;
+	size_t size;
+	size_t len;						///> Bytes written, the text is always NUL terminated
+	bool truncated;					///> A line did not fit and was left out
+} metrics_writer_t;
+
+/**
+ * Upper bounds of the histogram buckets, in microseconds.
+ */
+extern const uint32_t metrics_histogram_bounds_us[METRICS_HISTOGRAM_BUCKETS - 1];
+
+/**
+ * Records one latency sample.
+ * @param histogram histogram to update.
+ * @param us sample in microseconds.
+ */
+void metrics_histogram_observe(metrics_histogram_t *histogram, uint32_t us);
+
+/**
+ * Starts writing the text format into a buffer.
+ * @param writer writer to initialize.
+ * @param buff output buffer.
+ * @param size size of buff, at least 1.
+ */
+void metrics_writer_init(metrics_writer_t *writer, char *buff, size_t size);
+
+/**
+ * Writes the HELP and TYPE lines of a metric family, once before its samples.
+ * @param writer output.
+ * @param name metric name.
+ * @param type "counter", "gauge" or "histogram".
+ * @param help description of the metric.
+ */
+void metrics_write_family(metrics_writer_t *writer, const char *name, const char *type, const char *help);
+
+/**
+ * Writes one sample of the family written last.
+ * @param writer output.
+ * @param name metric name.
+ * @param labels label set without the braces, like "fd=\"54\"", or NULL.
+ * @param value sample value.
+ */
+void metrics_write_sample(metrics_writer_t *writer, const char *name, const char *labels, uint32_t value);
+
+/**
+ * Writes a family holding a single unlabeled sample.
+ * @param writer output.
+ * @param name metric name.
+ * @param type "counter" or "gauge".
+ * @param help description of the metric.
+ * @param value sample value.
+ */
+void metrics_write_value(metrics_writer_t *writer, const char *name, const char *type, const char *help, uint32_t value);
+
+/**
+ * Writes a histogram family with its cumulative buckets, sum and count, in seconds.
+ * @param writer output.
+ * @param name metric name, the _bucket, _sum and _count suffixes are added.
+ * @param help description of the metric.
+ * @param histogram histogram to write.
+ */
+void metrics_write_histogram(metrics_writer_t *writer, const char *name, const char *help, const metrics_histogram_t *histogram);
+
+#endif /* MAIN_METRICS_H_ */
@@ -6,11 +6,16 @@
  */
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "esp_crc.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
+#include "sys/param.h"
 
 #include "app_nvs.h"
 #include "wifi_app.h"
@@ -21,196 +26,455 @@ static const char TAG[] = "nvs";
 // NVS name space used for station mode credentials
 const char app_nvs_sta_creds_namespace[] = "stacreds";
 
-void app_nvs_flash_setup(void)
+// Key of the configuration record, the keys of the older layout are migrated once
+static const char app_nvs_config_key[] = "config";
+
+/**
+ * Header of the record in flash, followed by count networks and the CRC of everything before it
+ */
+typedef struct app_nvs_config_header
 {
-	 // Initialize NVS
-	esp_err_t ret = nvs_flash_init();
-	if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
-	{
-		ESP_ERROR_CHECK(nvs_flash_erase());
-		ret = nvs_flash_init();
-	}
-	ESP_ERROR_CHECK(ret);
-}
+	uint16_t version;					///> APP_NVS_CONFIG_VERSION
+	uint8_t count;						///> Networks following the header
+	uint8_t network_size;				///> sizeof(app_nvs_network_t) when written
+	uint32_t seq;
+} app_nvs_config_header_t;
 
-esp_err_t app_nvs_save_sta_creds(void)
+// Largest record in flash
+#define APP_NVS_CONFIG_MAX_SIZE		(sizeof(app_nvs_config_header_t) + APP_NVS_MAX_NETWORKS * sizeof(app_nvs_network_t) + sizeof(uint32_t))
+
+/**
+ * Single network record written by versions 1 and 2, version 1 ends before link
+ */
+typedef struct app_nvs_config_v2
+{
+	uint16_t version;
+	uint16_t size;
+	uint8_t ssid[MAX_SSID_LENGTH];
+	uint8_t password[MAX_PASSWORD_LENGTH];
+	app_nvs_link_t link;
+	uint32_t crc;
+} app_nvs_config_v2_t;
+
+// RAM copy of the record in NVS, all zeros while NVS holds none
+static app_nvs_config_t app_nvs_config;
+
+// Record as it goes to and comes from flash, only touched by the Wifi task and at boot
+static uint8_t app_nvs_blob[MAX(APP_NVS_CONFIG_MAX_SIZE, sizeof(app_nvs_config_v2_t))];
+
+static app_nvs_stats_t app_nvs_stats;
+
+/**
+ * Writes a record to NVS, or erases it, and commits once.
+ * @param config record to write, NULL or without networks to erase it.
+ * @return ESP_OK if successful.
+ */
+static esp_err_t app_nvs_config_write(const app_nvs_config_t *config)
 {
 	nvs_handle handle;
-	esp_err_t esp_err;
-	ESP_LOGI(TAG, "app_nvs_save_sta_creds: Saving station mode credentials to flash");
-
-	wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
+	size_t len = 0;
 
-	if (wifi_sta_config)
+	if (config && config->count > 0)
 	{
-		esp_err = nvs_open(app_nvs_sta_creds_namespace, NVS_READWRITE, &handle);
-		if (esp_err != ESP_OK)
-		{
-			printf("app_nvs_save_sta_creds: Error (%s) opening NVS handle!\n", esp_err_to_name(esp_err));
-			return esp_err;
-		}
-
-		// Set SSID
-		esp_err = nvs_set_blob(handle, "ssid", wifi_sta_config->sta.ssid, MAX_SSID_LENGTH);
-		if (esp_err != ESP_OK)
-		{
-			printf("app_nvs_save_sta_creds: Error (%s) setting SSID to NVS!\n", esp_err_to_name(esp_err));
-			return esp_err;
-		}
+		app_nvs_config_header_t header = { .version = APP_NVS_CONFIG_VERSION, .count = config->count,
+				.network_size = sizeof(app_nvs_network_t), .seq = config->seq };
+
+		memcpy(app_nvs_blob, &header, sizeof(header));
+		len = sizeof(header);
+		memcpy(app_nvs_blob + len, config->networks, config->count * sizeof(app_nvs_network_t));
+		len += config->count * sizeof(app_nvs_network_t);
+		uint32_t crc = esp_crc32_le(0, app_nvs_blob, len);
+		memcpy(app_nvs_blob + len, &crc, sizeof(crc));
+		len += sizeof(crc);
+	}
 
-		// Set Password
-		esp_err = nvs_set_blob(handle, "password", wifi_sta_config->sta.password, MAX_PASSWORD_LENGTH);
-		if (esp_err != ESP_OK)
-		{
-			printf("app_nvs_save_sta_creds: Error (%s) setting Password to NVS!\n", esp_err_to_name(esp_err));
-			return esp_err;
-		}
+	esp_err_t esp_err = nvs_open(app_nvs_sta_creds_namespace, NVS_READWRITE, &handle);
+	if (esp_err != ESP_OK)
+	{
+		ESP_LOGE(TAG, "app_nvs_config_write: Error (%s) opening NVS handle!", esp_err_to_name(esp_err));
+		return esp_err;
+	}
 
-		// Commit credentials to NVS
+	// Erasing the whole name space also drops any key of the older layout left over
+	esp_err = len ? nvs_set_blob(handle, app_nvs_config_key, app_nvs_blob, len) : nvs_erase_all(handle);
+	if (esp_err == ESP_OK)
+	{
 		esp_err = nvs_commit(handle);
-		if (esp_err != ESP_OK)
-		{
-			printf("app_nvs_save_sta_creds: Error (%s) comitting credentials to NVS!\n", esp_err_to_name(esp_err));
-			return esp_err;
-		}
-		nvs_close(handle);
-		ESP_LOGI(TAG, "app_nvs_save_sta_creds: wrote wifi_sta_config: Station SSID: %s Password: %s", wifi_sta_config->sta.ssid, wifi_sta_config->sta.password);
 	}
+	nvs_close(handle);
 
-	printf("app_nvs_save_sta_creds: returned ESP_OK\n");
-	return ESP_OK;
+	app_nvs_stats.writes++;
+	if (esp_err != ESP_OK)
+	{
+		ESP_LOGE(TAG, "app_nvs_config_write: Error (%s) writing the configuration!", esp_err_to_name(esp_err));
+	}
+	return esp_err;
 }
 
-bool app_nvs_load_sta_creds(void)
+/**
+ * Reads the credentials stored by the oldest layout, one blob per field.
+ * @param handle open NVS handle.
+ * @param network network receiving the credentials.
+ * @return true if both were found.
+ */
+static bool app_nvs_config_read_legacy(nvs_handle handle, app_nvs_network_t *network)
 {
-	nvs_handle handle;
-	esp_err_t esp_err;
-
-	ESP_LOGI(TAG, "app_nvs_load_sta_creds: Loading Wifi credentials from flash");
-
-	if (nvs_open(app_nvs_sta_creds_namespace, NVS_READONLY, &handle) == ESP_OK)
-	{
-		wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
-
-		if (wifi_sta_config == NULL)
-		{
-			wifi_sta_config = (wifi_config_t*)malloc(sizeof(wifi_config_t));
-		}
-		memset(wifi_sta_config, 0x00, sizeof(wifi_config_t));
-
-		// Allocate buffer
-		size_t wifi_config_size = sizeof(wifi_config_t);
-		uint8_t *wifi_config_buff = (uint8_t*)malloc(sizeof(uint8_t) * wifi_config_size);
-		memset(wifi_config_buff, 0x00, sizeof(wifi_config_size));
+	size_t ssid_len = sizeof(network->ssid);
+	size_t password_len = sizeof(network->password);
 
-		// Load SSID
-		wifi_config_size = sizeof(wifi_sta_config->sta.ssid);
-		esp_err = nvs_get_blob(handle, "ssid", wifi_config_buff, &wifi_config_size);
-		if (esp_err != ESP_OK)
-		{
-			free(wifi_config_buff);
-			printf("app_nvs_load_sta_creds: (%s) no station SSID found in NVS\n", esp_err_to_name(esp_err));
-			return false;
-		}
-		memcpy(wifi_sta_config->sta.ssid, wifi_config_buff, wifi_config_size);
-
-		// Load Password
-		wifi_config_size = sizeof(wifi_sta_config->sta.password);
-		esp_err = nvs_get_blob(handle, "password", wifi_config_buff, &wifi_config_size);
-		if (esp_err != ESP_OK)
-		{
-			free(wifi_config_buff);
-			printf("app_nvs_load_sta_creds: (%s) retrieving password!\n", esp_err_to_name(esp_err));
-			return false;
-		}
-		memcpy(wifi_sta_config->sta.password, wifi_config_buff, wifi_config_size);
-
-		free(wifi_config_buff);
-		nvs_close(handle);
-
-		printf("app_nvs_load_sta_creds: SSID: %s Password: %s\n", wifi_sta_config->sta.ssid, wifi_sta_config->sta.password);
-		return wifi_sta_config->sta.ssid[0] != '\0';
-	}
-	else
-	{
-		return false;
-	}
+	app_nvs_stats.reads += 2;
+	return nvs_get_blob(handle, "ssid", network->ssid, &ssid_len) == ESP_OK &&
+			nvs_get_blob(handle, "password", network->password, &password_len) == ESP_OK;
 }
 
-esp_err_t app_nvs_clear_sta_creds(void)
+/**
+ * Erases the keys of the oldest layout, once the record replacing them is in flash.
+ * @return ESP_OK if successful, keys already gone included.
+ */
+static esp_err_t app_nvs_config_erase_legacy(void)
 {
 	nvs_handle handle;
-	esp_err_t esp_err;
-	ESP_LOGI(TAG, "app_nvs_clear_sta_creds: Clearing Wifi station mode credentials from flash");
 
-	esp_err = nvs_open(app_nvs_sta_creds_namespace, NVS_READWRITE, &handle);
+	esp_err_t esp_err = nvs_open(app_nvs_sta_creds_namespace, NVS_READWRITE, &handle);
 	if (esp_err != ESP_OK)
 	{
-		printf("app_nvs_clear_sta_creds: Error (%s) opening NVS handle!\n", esp_err_to_name(esp_err));
 		return esp_err;
 	}
 
-	// Erase credentials
-	esp_err = nvs_erase_all(handle);
-	if (esp_err != ESP_OK)
+	const char *keys[] = { "ssid", "password" };
+	for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]) && esp_err == ESP_OK; ++i)
 	{
-		printf("app_nvs_clear_sta_creds: Error (%s) erasing station mode credentials!\n", esp_err_to_name(esp_err));
-		return esp_err;
+		esp_err = nvs_erase_key(handle, keys[i]);
+		esp_err = esp_err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : esp_err;
 	}
-
-	// Commit clearing credentials from NVS
-	esp_err = nvs_commit(handle);
-	if (esp_err != ESP_OK)
+	if (esp_err == ESP_OK)
 	{
-		printf("app_nvs_clear_sta_creds: Error (%s) NVS commit!\n", esp_err_to_name(esp_err));
-		return esp_err;
+		esp_err = nvs_commit(handle);
 	}
 	nvs_close(handle);
 
-	printf("app_nvs_clear_sta_creds: returned ESP_OK\n");
-	return ESP_OK;
+	app_nvs_stats.writes++;
+	return esp_err;
 }
 
+/**
+ * Takes the network out of a single network record of version 1 or 2.
+ * @param len bytes read into app_nvs_blob.
+ * @param network network receiving the credentials and, from version 2, the link.
+ * @return true if app_nvs_blob holds a valid record of those versions.
+ */
+static bool app_nvs_config_upgrade(size_t len, app_nvs_network_t *network)
+{
+	app_nvs_config_v2_t old;
+	size_t expected;
+	uint32_t crc;
+
+	memset(&old, 0x00, sizeof(old));
+	memcpy(&old, app_nvs_blob, MIN(len, sizeof(old)));
+	expected = old.version == 1 ? offsetof(app_nvs_config_v2_t, link) + sizeof(crc) :
+			old.version == 2 ? sizeof(app_nvs_config_v2_t) : 0;
+	if (expected == 0 || len != expected || old.size != expected)
+	{
+		return false;
+	}
 
+	memcpy(&crc, app_nvs_blob + len - sizeof(crc), sizeof(crc));
+	if (crc != esp_crc32_le(0, app_nvs_blob, len - sizeof(crc)))
+	{
+		return false;
+	}
 
+	memcpy(network->ssid, old.ssid, sizeof(network->ssid));
+	memcpy(network->password, old.password, sizeof(network->password));
+	if (old.version == 2)
+	{
+		network->link = old.link;
+	}
+	return true;
+}
 
+/**
+ * Checks the record in app_nvs_blob and copies it to the RAM copy.
+ * @param len bytes read.
+ * @return true if the record was valid.
+ */
+static bool app_nvs_config_parse(size_t len)
+{
+	app_nvs_config_header_t header;
+	uint32_t crc;
 
+	if (len < sizeof(header) + sizeof(crc))
+	{
+		return false;
+	}
 
+	memcpy(&header, app_nvs_blob, sizeof(header));
+	if (header.version != APP_NVS_CONFIG_VERSION || header.network_size != sizeof(app_nvs_network_t) ||
+		len != sizeof(header) + header.count * sizeof(app_nvs_network_t) + sizeof(crc))
+	{
+		return false;
+	}
 
+	memcpy(&crc, app_nvs_blob + len - sizeof(crc), sizeof(crc));
+	if (crc != esp_crc32_le(0, app_nvs_blob, len - sizeof(crc)))
+	{
+		return false;
+	}
 
+	// A smaller CONFIG_WS_WIFI_MAX_NETWORKS keeps the most recent ones
+	app_nvs_config.seq = header.seq;
+	app_nvs_config.count = MIN(header.count, APP_NVS_MAX_NETWORKS);
+	memcpy(app_nvs_config.networks, app_nvs_blob + sizeof(header), app_nvs_config.count * sizeof(app_nvs_network_t));
+	return true;
+}
 
+/**
+ * Reads the record into the RAM copy, migrating the older layouts if that is what NVS holds.
+ */
+static void app_nvs_config_read(void)
+{
+	nvs_handle handle;
+	app_nvs_network_t network;
+	size_t len = sizeof(app_nvs_blob);
+	bool migrate = false;
 
+	memset(&app_nvs_config, 0x00, sizeof(app_nvs_config));
+	memset(&network, 0x00, sizeof(network));
 
+	if (nvs_open(app_nvs_sta_creds_namespace, NVS_READONLY, &handle) != ESP_OK)
+	{
+		// Name space not created yet, nothing was ever saved
+		return;
+	}
 
+	esp_err_t esp_err = nvs_get_blob(handle, app_nvs_config_key, app_nvs_blob, &len);
+	app_nvs_stats.reads++;
+	if (esp_err == ESP_ERR_NVS_NOT_FOUND)
+	{
+		migrate = app_nvs_config_read_legacy(handle, &network);
+	}
+	else if (esp_err == ESP_OK && !app_nvs_config_parse(len))
+	{
+		migrate = app_nvs_config_upgrade(len, &network);
+		if (!migrate)
+		{
+			ESP_LOGW(TAG, "app_nvs_config_read: ignoring a damaged or foreign record (%u bytes)", (unsigned)len);
+		}
+	}
+	nvs_close(handle);
 
+	if (migrate)
+	{
+		ESP_LOGI(TAG, "app_nvs_config_read: migrating the station credentials to record version %u", APP_NVS_CONFIG_VERSION);
+		app_nvs_config_t config;
+
+		memset(&config, 0x00, sizeof(config));
+		network.last_success = 1;
+		config.seq = 1;
+		config.count = 1;
+		config.networks[0] = network;
+		// The old credentials stay until the record holding them is committed, a power loss in
+		// between leaves both and the next boot reads the record
+		if (app_nvs_config_write(&config) == ESP_OK)
+		{
+			app_nvs_config = config;
+			if (app_nvs_config_erase_legacy() != ESP_OK)
+			{
+				ESP_LOGW(TAG, "app_nvs_config_read: the keys of the older layout were not erased");
+			}
+		}
+	}
+}
 
+/**
+ * Finds a saved network by SSID.
+ * @param config record to search.
+ * @param ssid SSID, MAX_SSID_LENGTH bytes.
+ * @return index of the network, -1 if it is not saved.
+ */
+static int app_nvs_config_find(const app_nvs_config_t *config, const uint8_t *ssid)
+{
+	for (int i = 0; i < config->count; i++)
+	{
+		if (memcmp(config->networks[i].ssid, ssid, MAX_SSID_LENGTH) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
 
+/**
+ * Removes a network, moving the ones after it up.
+ * @param config record to change.
+ * @param index network to remove.
+ */
+static void app_nvs_config_remove(app_nvs_config_t *config, int index)
+{
+	config->count--;
+	memmove(&config->networks[index], &config->networks[index + 1], (config->count - index) * sizeof(app_nvs_network_t));
+	memset(&config->networks[config->count], 0x00, sizeof(app_nvs_network_t));
+}
 
+void app_nvs_flash_setup(void)
+{
+	 // Initialize NVS
+	esp_err_t ret = nvs_flash_init();
+	if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+	{
+		ESP_ERROR_CHECK(nvs_flash_erase());
+		ret = nvs_flash_init();
+	}
+	ESP_ERROR_CHECK(ret);
 
+	// The only read of the boot, everything later is served from RAM
+	int64_t start = esp_timer_get_time();
+	app_nvs_config_read();
+	app_nvs_stats.boot_load_us = esp_timer_get_time() - start;
 
+	ESP_LOGI(TAG, "app_nvs_flash_setup: %u networks loaded in %u us, %u reads %u writes", app_nvs_config.count,
+			app_nvs_stats.boot_load_us, app_nvs_stats.reads, app_nvs_stats.writes);
+}
 
+esp_err_t app_nvs_save_sta_creds(const app_nvs_link_t *link, int8_t rssi)
+{
+	wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
+	app_nvs_network_t network;
 
+	if (wifi_sta_config == NULL)
+	{
+		return ESP_OK;
+	}
 
+	app_nvs_config_t config = app_nvs_config;
+	int index = app_nvs_config_find(&config, wifi_sta_config->sta.ssid);
+	if (index >= 0)
+	{
+		network = config.networks[index];
+		app_nvs_config_remove(&config, index);
+	}
+	else
+	{
+		memset(&network, 0x00, sizeof(network));
+		memcpy(network.ssid, wifi_sta_config->sta.ssid, sizeof(network.ssid));
+		network.rssi = rssi;
+		if (config.count == APP_NVS_MAX_NETWORKS)
+		{
+			// Drop the least recently connected network
+			app_nvs_config_remove(&config, config.count - 1);
+		}
+	}
 
+	memcpy(network.password, wifi_sta_config->sta.password, sizeof(network.password));
+	if (link)
+	{
+		network.link = *link;
+	}
+	else
+	{
+		memset(&network.link, 0x00, sizeof(network.link));
+	}
+	if (abs(network.rssi - rssi) >= APP_NVS_RSSI_STEP)
+	{
+		network.rssi = rssi;
+	}
+	// Only a change of network moves the counter, reconnecting to the most recent one keeps it
+	if (index != 0)
+	{
+		network.last_success = ++config.seq;
+	}
 
+	memmove(&config.networks[1], &config.networks[0], config.count * sizeof(app_nvs_network_t));
+	config.networks[0] = network;
+	config.count++;
 
+	// Reconnecting to the same access point with the same lease must not wear the flash
+	if (memcmp(&config, &app_nvs_config, sizeof(config)) == 0)
+	{
+		app_nvs_stats.skipped_writes++;
+		ESP_LOGI(TAG, "app_nvs_save_sta_creds: credentials and link unchanged, nothing written");
+		return ESP_OK;
+	}
 
+	esp_err_t esp_err = app_nvs_config_write(&config);
+	if (esp_err == ESP_OK)
+	{
+		app_nvs_config = config;
+		ESP_LOGI(TAG, "app_nvs_save_sta_creds: wrote Station SSID: %.32s, %u networks", (char *)network.ssid, config.count);
+	}
+	return esp_err;
+}
 
+bool app_nvs_load_sta_creds(void)
+{
+	wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
 
+	if (wifi_sta_config == NULL || app_nvs_config.count == 0)
+	{
+		return false;
+	}
 
+	memset(wifi_sta_config, 0x00, sizeof(wifi_config_t));
+	memcpy(wifi_sta_config->sta.ssid, app_nvs_config.networks[0].ssid, sizeof(app_nvs_config.networks[0].ssid));
+	memcpy(wifi_sta_config->sta.password, app_nvs_config.networks[0].password, sizeof(app_nvs_config.networks[0].password));
 
+	ESP_LOGI(TAG, "app_nvs_load_sta_creds: SSID: %.32s", (char *)wifi_sta_config->sta.ssid);
+	return wifi_sta_config->sta.ssid[0] != '\0';
+}
 
+bool app_nvs_load_sta_link(app_nvs_link_t *link)
+{
+	if (app_nvs_config.count == 0)
+	{
+		memset(link, 0x00, sizeof(app_nvs_link_t));
+		return false;
+	}
 
+	*link = app_nvs_config.networks[0].link;
+	return (link->flags & APP_NVS_LINK_VALID) != 0;
+}
 
+size_t app_nvs_get_network_count(void)
+{
+	return app_nvs_config.count;
+}
 
+bool app_nvs_get_network(size_t index, app_nvs_network_t *network)
+{
+	if (index >= app_nvs_config.count)
+	{
+		return false;
+	}
 
+	*network = app_nvs_config.networks[index];
+	return true;
+}
 
+esp_err_t app_nvs_clear_sta_creds(void)
+{
+	wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
 
+	ESP_LOGI(TAG, "app_nvs_clear_sta_creds: Clearing Wifi station mode credentials from flash");
 
+	app_nvs_config_t config = app_nvs_config;
+	int index = wifi_sta_config ? app_nvs_config_find(&config, wifi_sta_config->sta.ssid) : -1;
+	if (index < 0)
+	{
+		app_nvs_stats.skipped_writes++;
+		return ESP_OK;
+	}
 
+	// Forgetting the last network erases the whole record
+	app_nvs_config_remove(&config, index);
+	esp_err_t esp_err = app_nvs_config_write(&config);
+	if (esp_err == ESP_OK)
+	{
+		app_nvs_config = config;
+	}
+	return esp_err;
+}
 
-
-
-
-
-
+void app_nvs_get_stats(app_nvs_stats_t *stats)
+{
+	*stats = app_nvs_stats;
+}
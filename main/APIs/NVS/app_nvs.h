@@ -8,24 +8,129 @@
 #ifndef MAIN_APP_NVS_H_
 #define MAIN_APP_NVS_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "wifi_app.h"
+
+// Layout version of the configuration record, older single network records are migrated
+#define APP_NVS_CONFIG_VERSION		3
+
+// Networks remembered, the least recently used one is dropped to make room
+#define APP_NVS_MAX_NETWORKS		CONFIG_WS_WIFI_MAX_NETWORKS
+
+// Stored RSSI is only refreshed when it moved by this much, so signal noise does not cause writes
+#define APP_NVS_RSSI_STEP			8
+
+// app_nvs_link_t flags
+#define APP_NVS_LINK_VALID			(1U << 0)		///> bssid and channel were filled by a successful connection
+#define APP_NVS_LINK_IP				(1U << 1)		///> ip, netmask, gw and dns hold the last DHCP lease
+
+/**
+ * Last successful link to a saved network, used to skip the scan and DHCP on the next connect.
+ * Addresses are esp_ip4_addr_t values.
+ */
+typedef struct app_nvs_link
+{
+	uint8_t bssid[6];
+	uint8_t channel;
+	uint8_t flags;						///> APP_NVS_LINK_ flags
+	uint32_t ip;
+	uint32_t netmask;
+	uint32_t gw;
+	uint32_t dns;
+} app_nvs_link_t;
+
+/**
+ * A saved network, 128 bytes in RAM and in flash
+ */
+typedef struct app_nvs_network
+{
+	uint8_t ssid[MAX_SSID_LENGTH];
+	uint8_t password[MAX_PASSWORD_LENGTH];
+	app_nvs_link_t link;
+	uint32_t last_success;				///> Connection counter at the latest success, higher is more recent
+	int8_t rssi;						///> RSSI of that connection
+	uint8_t reserved[3];
+} app_nvs_network_t;
+
+/**
+ * Everything the application keeps in NVS, stored as a single blob.
+ * One record means one read at boot and at most one write per change. In flash only the
+ * used networks are stored, between a header and a CRC.
+ */
+typedef struct app_nvs_config
+{
+	uint32_t seq;						///> Connection counter, stamped into last_success
+	uint32_t count;						///> Networks in use
+	app_nvs_network_t networks[APP_NVS_MAX_NETWORKS];	///> Most recently connected first
+} app_nvs_config_t;
+
+/**
+ * NVS access counters
+ */
+typedef struct app_nvs_stats
+{
+	uint32_t reads;						///> Blob reads, one at boot
+	uint32_t writes;					///> Blob writes and erases, each followed by one commit
+	uint32_t skipped_writes;			///> Saves dropped because nothing changed
+	uint32_t boot_load_us;				///> Time taken by the boot read
+} app_nvs_stats_t;
+
+/**
+ * Initializes NVS and reads the configuration record into RAM.
+ */
 void app_nvs_flash_setup(void);
 
 /**
- * Saves station mode Wifi credentials to NVS
+ * Saves the station mode Wifi credentials as the most recent network, nothing is written if
+ * the network already was the most recent one and its link did not change.
+ * @param link link the credentials just connected over, NULL to store none.
+ * @param rssi RSSI of the connection.
  * @return ESP_OK if successful.
  */
-esp_err_t app_nvs_save_sta_creds(void);
+esp_err_t app_nvs_save_sta_creds(const app_nvs_link_t *link, int8_t rssi);
 
 /**
- * Loads the previously saved credentials from NVS.
+ * Loads the credentials of the most recent network from the RAM copy read at boot.
  * @return true if previously saved credentials were found.
  */
 bool app_nvs_load_sta_creds(void);
 
 /**
- * Clears station mode credentials from NVS
+ * Gets the link saved along with the most recent network.
+ * @param link receives the link, all zeros if there is none.
+ * @return true if the link is valid.
+ */
+bool app_nvs_load_sta_link(app_nvs_link_t *link);
+
+/**
+ * Gets the number of saved networks.
+ * @return networks saved, at most APP_NVS_MAX_NETWORKS.
+ */
+size_t app_nvs_get_network_count(void);
+
+/**
+ * Gets a saved network.
+ * @param index 0 for the most recently connected one.
+ * @param network receives the network.
+ * @return true if there is a network at index.
+ */
+bool app_nvs_get_network(size_t index, app_nvs_network_t *network);
+
+/**
+ * Forgets the network of the station mode Wifi credentials.
  * @return ESP_OK if successful.
  */
 esp_err_t app_nvs_clear_sta_creds(void);
 
+/**
+ * Reads the NVS access counters.
+ * @param stats receives the counters.
+ */
+void app_nvs_get_stats(app_nvs_stats_t *stats);
+
 #endif /* MAIN_APP_NVS_H_ */
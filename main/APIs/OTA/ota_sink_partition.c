@@ -0,0 +1,67 @@
+/*
+ * ota_sink_partition.c
+ *
+ *  Created on: May 24, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include "esp_ota_ops.h"
+
+#include "ota_stream.h"
+
+static esp_err_t ota_sink_partition_begin(void *ctx, size_t size)
+{
+	ota_sink_partition_t *state = ctx;
+
+	state->partition = esp_ota_get_next_update_partition(NULL);
+	if (state->partition == NULL)
+	{
+		return ESP_ERR_NOT_FOUND;
+	}
+	if (size > state->partition->size)
+	{
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	// Sectors are erased as the writes reach them instead of all up front, so erasing overlaps the upload too
+	return esp_ota_begin(state->partition, OTA_WITH_SEQUENTIAL_WRITES, &state->handle);
+}
+
+static esp_err_t ota_sink_partition_write(void *ctx, const void *data, size_t len)
+{
+	return esp_ota_write(((ota_sink_partition_t *)ctx)->handle, data, len);
+}
+
+static esp_err_t ota_sink_partition_finish(void *ctx)
+{
+	ota_sink_partition_t *state = ctx;
+
+	esp_err_t err = esp_ota_end(state->handle);
+	if (err == ESP_OK)
+	{
+		err = esp_ota_set_boot_partition(state->partition);
+	}
+	return err;
+}
+
+static void ota_sink_partition_abort(void *ctx)
+{
+	ota_sink_partition_t *state = ctx;
+
+	if (state->partition)
+	{
+		esp_ota_abort(state->handle);
+	}
+}
+
+void ota_sink_partition(ota_sink_t *sink, ota_sink_partition_t *state)
+{
+	state->partition = NULL;
+	state->handle = 0;
+
+	sink->begin = ota_sink_partition_begin;
+	sink->write = ota_sink_partition_write;
+	sink->finish = ota_sink_partition_finish;
+	sink->abort = ota_sink_partition_abort;
+	sink->ctx = state;
+}
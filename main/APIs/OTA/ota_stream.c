@@ -0,0 +1,246 @@
+/*
+ * ota_stream.c
+ *
+ *  Created on: May 24, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+
+#include "ota_stream.h"
+#include "task_topology.h"
+
+/**
+ * Buffer handed from the receiver to the writer task
+ */
+typedef struct ota_stream_chunk
+{
+	uint8_t *data;					///> NULL stops the writer
+	size_t len;
+} ota_stream_chunk_t;
+
+/**
+ * Records the first error of an upload, later ones are consequences of it.
+ * @param stream stream being uploaded.
+ * @param err error to record.
+ */
+static void ota_stream_fail(ota_stream_t *stream, esp_err_t err)
+{
+	int expected = ESP_OK;
+
+	atomic_compare_exchange_strong(&stream->err, &expected, err);
+}
+
+/**
+ * Writer task, hands every full buffer to the sink and gives it back to the receiver.
+ * @param arg stream being uploaded.
+ */
+static void ota_stream_writer(void *arg)
+{
+	ota_stream_t *stream = arg;
+	ota_stream_chunk_t chunk;
+
+	for (;;)
+	{
+		xQueueReceive(stream->full, &chunk, portMAX_DELAY);
+		if (chunk.data == NULL)
+		{
+			break;
+		}
+
+		if (atomic_load(&stream->err) == ESP_OK)
+		{
+			int64_t start = esp_timer_get_time();
+			esp_err_t err = stream->sink->write(stream->sink->ctx, chunk.data, chunk.len);
+			stream->stats.write_us += esp_timer_get_time() - start;
+
+			if (err == ESP_OK)
+			{
+				stream->stats.written += chunk.len;
+			}
+			else
+			{
+				ota_stream_fail(stream, err);
+			}
+		}
+
+		// Never blocks, the queue holds every buffer
+		xQueueSend(stream->free, &chunk.data, 0);
+	}
+
+	// The stream may be released as soon as this is given
+	xSemaphoreGive(stream->done);
+	vTaskDelete(NULL);
+}
+
+/**
+ * Frees what ota_stream_begin allocated.
+ * @param stream stream to release.
+ */
+static void ota_stream_release(ota_stream_t *stream)
+{
+	for (int i = 0; i < OTA_STREAM_BUFFERS; ++i)
+	{
+		free(stream->buffers[i]);
+		stream->buffers[i] = NULL;
+	}
+	if (stream->free)
+	{
+		vQueueDelete(stream->free);
+		stream->free = NULL;
+	}
+	if (stream->full)
+	{
+		vQueueDelete(stream->full);
+		stream->full = NULL;
+	}
+	if (stream->done)
+	{
+		vSemaphoreDelete(stream->done);
+		stream->done = NULL;
+	}
+	stream->fill = NULL;
+}
+
+/**
+ * Hands the buffer being filled to the writer task.
+ * @param stream stream being uploaded.
+ */
+static void ota_stream_hand_off(ota_stream_t *stream)
+{
+	ota_stream_chunk_t chunk = { .data = stream->fill, .len = stream->fill_len };
+
+	// Never blocks, the queue has a slot for every buffer and for the stop chunk
+	xQueueSend(stream->full, &chunk, 0);
+	stream->fill = NULL;
+	stream->fill_len = 0;
+}
+
+/**
+ * Stops the writer task and waits for it to exit.
+ * @param stream stream being uploaded.
+ */
+static void ota_stream_stop_writer(ota_stream_t *stream)
+{
+	ota_stream_chunk_t stop = { .data = NULL, .len = 0 };
+
+	xQueueSend(stream->full, &stop, 0);
+	xSemaphoreTake(stream->done, portMAX_DELAY);
+}
+
+esp_err_t ota_stream_begin(ota_stream_t *stream, const ota_sink_t *sink, size_t size)
+{
+	memset(stream, 0x00, sizeof(ota_stream_t));
+	atomic_init(&stream->err, ESP_OK);
+	stream->sink = sink;
+	stream->stats.total = size;
+	stream->stats.start_us = esp_timer_get_time();
+
+	for (int i = 0; i < OTA_STREAM_BUFFERS; ++i)
+	{
+		stream->buffers[i] = malloc(OTA_STREAM_BUFFER_SIZE);
+	}
+	stream->free = xQueueCreate(OTA_STREAM_BUFFERS, sizeof(uint8_t *));
+	stream->full = xQueueCreate(OTA_STREAM_BUFFERS + 1, sizeof(ota_stream_chunk_t));
+	stream->done = xSemaphoreCreateBinary();
+	if (!stream->buffers[0] || !stream->buffers[1] || !stream->free || !stream->full || !stream->done)
+	{
+		ota_stream_release(stream);
+		return ESP_ERR_NO_MEM;
+	}
+
+	esp_err_t err = sink->begin(sink->ctx, size);
+	if (err != ESP_OK)
+	{
+		ota_stream_release(stream);
+		return err;
+	}
+
+	for (int i = 0; i < OTA_STREAM_BUFFERS; ++i)
+	{
+		xQueueSend(stream->free, &stream->buffers[i], 0);
+	}
+
+	// Best on the core the httpd task does not use, see task_topology.h
+	if (task_topology_create(TASK_TOPOLOGY_OTA_WRITER, ota_stream_writer, stream, NULL) != pdPASS)
+	{
+		sink->abort(sink->ctx);
+		ota_stream_release(stream);
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+uint8_t *ota_stream_buffer(ota_stream_t *stream, size_t *room)
+{
+	if (atomic_load(&stream->err) != ESP_OK)
+	{
+		return NULL;
+	}
+
+	if (stream->fill == NULL)
+	{
+		int64_t start = esp_timer_get_time();
+		xQueueReceive(stream->free, &stream->fill, portMAX_DELAY);
+		stream->stats.stall_us += esp_timer_get_time() - start;
+		stream->fill_len = 0;
+	}
+
+	*room = OTA_STREAM_BUFFER_SIZE - stream->fill_len;
+	return stream->fill + stream->fill_len;
+}
+
+esp_err_t ota_stream_commit(ota_stream_t *stream, size_t len)
+{
+	stream->fill_len += len;
+	stream->stats.received += len;
+
+	if (stream->fill_len == OTA_STREAM_BUFFER_SIZE)
+	{
+		ota_stream_hand_off(stream);
+	}
+	return atomic_load(&stream->err);
+}
+
+esp_err_t ota_stream_finish(ota_stream_t *stream)
+{
+	if (stream->fill && stream->fill_len)
+	{
+		ota_stream_hand_off(stream);
+	}
+	ota_stream_stop_writer(stream);
+
+	esp_err_t err = atomic_load(&stream->err);
+	if (err == ESP_OK && stream->stats.written != stream->stats.total)
+	{
+		err = ESP_ERR_INVALID_SIZE;
+	}
+
+	if (err == ESP_OK)
+	{
+		err = stream->sink->finish(stream->sink->ctx);
+	}
+	else
+	{
+		stream->sink->abort(stream->sink->ctx);
+	}
+
+	ota_stream_fail(stream, err);
+	ota_stream_release(stream);
+	return err;
+}
+
+esp_err_t ota_stream_abort(ota_stream_t *stream)
+{
+	ota_stream_fail(stream, ESP_FAIL);
+	ota_stream_stop_writer(stream);
+	stream->sink->abort(stream->sink->ctx);
+	ota_stream_release(stream);
+	return atomic_load(&stream->err);
+}
@@ -0,0 +1,132 @@
+/*
+ * ota_stream.h
+ *
+ *  Created on: May 24, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_OTA_STREAM_H_
+#define MAIN_OTA_STREAM_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include "esp_err.h"
+#include "esp_ota_ops.h"
+
+// Bytes per buffer, one flash sector so each write erases and programs whole sectors
+#define OTA_STREAM_BUFFER_SIZE			4096
+
+// One buffer is received into while the other one is written
+#define OTA_STREAM_BUFFERS				2
+
+/**
+ * Destination of a firmware image, so the stream can write to an OTA partition or to any stand-in.
+ */
+typedef struct ota_sink
+{
+	esp_err_t (*begin)(void *ctx, size_t size);						///> Prepares for an image of size bytes
+	esp_err_t (*write)(void *ctx, const void *data, size_t len);	///> Appends, called on the writer task only
+	esp_err_t (*finish)(void *ctx);									///> Checks the image and selects it for the next boot
+	void (*abort)(void *ctx);										///> Drops a partial image
+	void *ctx;
+} ota_sink_t;
+
+/**
+ * State of the OTA partition sink
+ */
+typedef struct ota_sink_partition
+{
+	const esp_partition_t *partition;		///> Partition being written, NULL before begin
+	esp_ota_handle_t handle;
+} ota_sink_partition_t;
+
+/**
+ * Upload counters, for progress reports and metrics
+ */
+typedef struct ota_stream_stats
+{
+	uint32_t total;					///> Image size given to ota_stream_begin
+	uint32_t received;				///> Bytes committed by the receiver
+	uint32_t written;				///> Bytes the sink accepted, written by the writer task only
+	uint32_t write_us;				///> Time the writer spent in the sink, written by the writer task only
+	uint32_t stall_us;				///> Time the receiver waited for a free buffer, the share of the upload bound by flash
+	int64_t start_us;				///> esp_timer_get_time at ota_stream_begin
+} ota_stream_stats_t;
+
+/**
+ * Firmware image written to a sink through two alternating buffers.
+ *
+ * The receiver fills one buffer straight from its socket while a writer task hands the
+ * other one to the sink, so the radio and the flash work at the same time. The receiver
+ * only waits when both buffers are taken, that is when the flash is the slower side.
+ * The first sink error stops the upload, the buffers still cycle so the receiver never
+ * blocks on a writer that gave up.
+ */
+typedef struct ota_stream
+{
+	const ota_sink_t *sink;
+	uint8_t *buffers[OTA_STREAM_BUFFERS];
+	QueueHandle_t free;				///> Buffers the receiver may fill
+	QueueHandle_t full;				///> Chunks waiting for the writer, an empty one stops it
+	SemaphoreHandle_t done;			///> Given by the writer task when it exits
+	uint8_t *fill;					///> Buffer being received into, NULL if none is taken
+	size_t fill_len;
+	_Atomic int err;				///> First error, ESP_OK while the upload is healthy
+	ota_stream_stats_t stats;
+} ota_stream_t;
+
+/**
+ * Starts an upload: allocates the buffers, begins the sink and starts the writer task.
+ * @param stream stream to start, must stay valid until ota_stream_finish or ota_stream_abort.
+ * @param sink destination of the image, must outlive the stream.
+ * @param size image size in bytes.
+ * @return ESP_OK on success, ESP_ERR_NO_MEM, or the sink error.
+ */
+esp_err_t ota_stream_begin(ota_stream_t *stream, const ota_sink_t *sink, size_t size);
+
+/**
+ * Gets the space to receive the next bytes into, waiting for a buffer if both are taken.
+ * @param stream stream being uploaded.
+ * @param room receives the free bytes at the returned address.
+ * @return where to receive, NULL once the upload failed.
+ */
+uint8_t *ota_stream_buffer(ota_stream_t *stream, size_t *room);
+
+/**
+ * Accounts for bytes received into the space from ota_stream_buffer, handing the buffer
+ * to the writer once it is full.
+ * @param stream stream being uploaded.
+ * @param len bytes received, at most the room given.
+ * @return ESP_OK, or the error that stopped the upload.
+ */
+esp_err_t ota_stream_commit(ota_stream_t *stream, size_t len);
+
+/**
+ * Writes what is left, waits for the writer and finishes the sink.
+ * @param stream stream being uploaded, released on return.
+ * @return ESP_OK if the image was accepted, otherwise the first error of the upload.
+ */
+esp_err_t ota_stream_finish(ota_stream_t *stream);
+
+/**
+ * Stops an upload and drops the partial image.
+ * @param stream stream being uploaded, released on return.
+ * @return the error that stopped the upload, ESP_FAIL if there was none.
+ */
+esp_err_t ota_stream_abort(ota_stream_t *stream);
+
+/**
+ * Sets up a sink writing to the next OTA app partition with esp_ota_write.
+ * @param sink sink to fill.
+ * @param state partition state, must outlive the sink.
+ */
+void ota_sink_partition(ota_sink_t *sink, ota_sink_partition_t *state);
+
+#endif /* MAIN_OTA_STREAM_H_ */
@@ -0,0 +1,261 @@
+/*
+ * ota_ws.c
+ *
+ *  Created on: May 26, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_crc.h"
+
+#include "ota_ws.h"
+
+// Bytes of ota_ws_header_t on the wire
+#define OTA_WS_HEADER_LEN			16
+
+/**
+ * Reads a little endian word of a chunk header.
+ * @param data first byte of the word.
+ * @return the word.
+ */
+static uint32_t ota_ws_read_u32(const uint8_t *data)
+{
+	return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/**
+ * Drops the upload in progress.
+ * @param ota upload state.
+ * @param err why, ESP_OK to keep the error that stopped the stream.
+ */
+static void ota_ws_fail(ota_ws_t *ota, esp_err_t err)
+{
+	if (!ota->active)
+	{
+		return;
+	}
+
+	esp_err_t stream_err = ota_stream_abort(&ota->stream);
+	ota->err = (err == ESP_OK) ? stream_err : err;
+	ota->active = false;
+}
+
+/**
+ * Decides what to do with a chunk from its header.
+ * @param ota upload state, header already read.
+ * @param len image bytes in the chunk.
+ * @return OTA_WS_ACCEPTED to take its bytes, otherwise the answer to the chunk.
+ */
+static ota_ws_result_e ota_ws_judge(const ota_ws_t *ota, uint32_t len)
+{
+	const ota_ws_header_t *header = &ota->header;
+
+	if (!ota->active || header->magic != OTA_WS_MAGIC)
+	{
+		return OTA_WS_REJECTED;
+	}
+	if ((uint64_t)header->offset + len > ota->size)
+	{
+		return OTA_WS_REJECTED;
+	}
+	if (header->seq < ota->seq && header->offset + len <= ota->offset)
+	{
+		return OTA_WS_DUPLICATE;
+	}
+
+	// The chunk may start before the position when it was cut by a dropped connection, its taken part is skipped
+	if (header->seq == ota->seq && header->offset <= ota->offset && header->offset + len >= ota->offset)
+	{
+		return OTA_WS_ACCEPTED;
+	}
+	return OTA_WS_REJECTED;
+}
+
+/**
+ * Copies the image bytes of a chunk not taken yet into the stream.
+ * @param ota upload state, taking the current chunk.
+ * @param data image bytes.
+ * @param len bytes in data.
+ * @param pos image offset of the first byte of data.
+ * @return ESP_OK, or the error that stopped the stream.
+ */
+static esp_err_t ota_ws_take(ota_ws_t *ota, const uint8_t *data, size_t len, uint32_t pos)
+{
+	if (pos + len <= ota->offset)
+	{
+		return ESP_OK;
+	}
+	if (pos < ota->offset)
+	{
+		data += ota->offset - pos;
+		len -= ota->offset - pos;
+	}
+
+	while (len)
+	{
+		size_t room;
+		uint8_t *buffer = ota_stream_buffer(&ota->stream, &room);
+		if (buffer == NULL)
+		{
+			return ESP_FAIL;
+		}
+
+		size_t n = (len < room) ? len : room;
+		memcpy(buffer, data, n);
+		ota->crc = esp_crc32_le(ota->crc, data, n);
+		ota->offset += n;
+		data += n;
+		len -= n;
+
+		esp_err_t err = ota_stream_commit(&ota->stream, n);
+		if (err != ESP_OK)
+		{
+			return err;
+		}
+	}
+	return ESP_OK;
+}
+
+/**
+ * Settles a chunk once its last byte arrived.
+ * @param ota upload state.
+ * @return the answer to the chunk.
+ */
+static ota_ws_result_e ota_ws_settle(ota_ws_t *ota)
+{
+	switch (ota->verdict)
+	{
+		case OTA_WS_ACCEPTED:
+			if (ota->crc != ota->header.crc)
+			{
+				// The bytes are already on their way to flash, there is no going back to the previous chunk
+				ota_ws_fail(ota, ESP_ERR_INVALID_CRC);
+				return OTA_WS_FAILED;
+			}
+
+			ota->seq++;
+			ota->stats.chunks++;
+			if (++ota->unacked >= OTA_WS_ACK_EVERY || ota->offset == ota->size)
+			{
+				ota->unacked = 0;
+				return OTA_WS_ACK;
+			}
+			return OTA_WS_ACCEPTED;
+
+		case OTA_WS_DUPLICATE:
+			ota->stats.duplicates++;
+			ota->unacked = 0;
+			return OTA_WS_DUPLICATE;
+
+		case OTA_WS_REJECTED:
+			ota->stats.rejects++;
+			return OTA_WS_REJECTED;
+
+		default:
+			return OTA_WS_FAILED;
+	}
+}
+
+esp_err_t ota_ws_begin(ota_ws_t *ota, const ota_sink_t *sink, uint32_t size, uint32_t image_crc, bool *resumed)
+{
+	if (ota->active && ota->size == size && ota->image_crc == image_crc)
+	{
+		*resumed = true;
+		ota->unacked = 0;
+		ota->stats.resumes++;
+		return ESP_OK;
+	}
+
+	*resumed = false;
+	ota_ws_fail(ota, ESP_FAIL);
+
+	esp_err_t err = ota_stream_begin(&ota->stream, sink, size);
+	ota->err = err;
+	if (err != ESP_OK)
+	{
+		return err;
+	}
+
+	ota->active = true;
+	ota->size = size;
+	ota->image_crc = image_crc;
+	ota->offset = 0;
+	ota->crc = 0;
+	ota->seq = 0;
+	ota->unacked = 0;
+	return ESP_OK;
+}
+
+ota_ws_result_e ota_ws_feed(ota_ws_t *ota, const uint8_t *data, size_t len, size_t offset, size_t frame_len)
+{
+	if (offset == 0)
+	{
+		if (len < OTA_WS_HEADER_LEN || frame_len < OTA_WS_HEADER_LEN)
+		{
+			memset(&ota->header, 0x00, sizeof(ota->header));
+			ota->verdict = OTA_WS_REJECTED;
+		}
+		else
+		{
+			ota->header.magic = ota_ws_read_u32(data);
+			ota->header.seq = ota_ws_read_u32(data + 4);
+			ota->header.offset = ota_ws_read_u32(data + 8);
+			ota->header.crc = ota_ws_read_u32(data + 12);
+			ota->verdict = ota_ws_judge(ota, frame_len - OTA_WS_HEADER_LEN);
+		}
+	}
+
+	if (ota->verdict == OTA_WS_ACCEPTED)
+	{
+		size_t skip = (offset < OTA_WS_HEADER_LEN) ? OTA_WS_HEADER_LEN - offset : 0;
+		if (skip < len)
+		{
+			uint32_t pos = ota->header.offset + (offset + skip - OTA_WS_HEADER_LEN);
+			esp_err_t err = ota_ws_take(ota, data + skip, len - skip, pos);
+			if (err != ESP_OK)
+			{
+				ota_ws_fail(ota, err == ESP_FAIL ? ESP_OK : err);
+				ota->verdict = OTA_WS_FAILED;
+			}
+		}
+	}
+
+	if (offset + len < frame_len)
+	{
+		return OTA_WS_MORE;
+	}
+	return ota_ws_settle(ota);
+}
+
+esp_err_t ota_ws_end(ota_ws_t *ota)
+{
+	if (!ota->active)
+	{
+		return (ota->err != ESP_OK) ? ota->err : ESP_ERR_INVALID_STATE;
+	}
+	if (ota->offset != ota->size)
+	{
+		return ESP_ERR_INVALID_SIZE;
+	}
+	if (ota->crc != ota->image_crc)
+	{
+		ota_ws_fail(ota, ESP_ERR_INVALID_CRC);
+		return ota->err;
+	}
+
+	ota->err = ota_stream_finish(&ota->stream);
+	ota->active = false;
+	return ota->err;
+}
+
+void ota_ws_abort(ota_ws_t *ota)
+{
+	ota_ws_fail(ota, ESP_FAIL);
+}
+
+int ota_ws_position(const ota_ws_t *ota, char *out, size_t size)
+{
+	return snprintf(out, size, "seq=%u offset=%u crc=%08x", ota->seq, ota->offset, ota->crc);
+}
@@ -0,0 +1,137 @@
+/*
+ * ota_ws.h
+ *
+ *  Created on: May 26, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_OTA_WS_H_
+#define MAIN_OTA_WS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "ota_stream.h"
+
+// First word of every chunk frame, "OTA1" on the wire
+#define OTA_WS_MAGIC				0x3141544F
+
+// Chunks a sender may have in flight without an ack
+#define OTA_WS_WINDOW				8
+
+// Chunks accepted between two acks, so an ack always arrives before the window closes
+#define OTA_WS_ACK_EVERY			(OTA_WS_WINDOW / 2)
+
+/**
+ * Header in front of the image bytes of a chunk frame, little endian.
+ * The image bytes run from the header to the end of the frame.
+ */
+typedef struct ota_ws_header
+{
+	uint32_t magic;					///> OTA_WS_MAGIC
+	uint32_t seq;					///> Chunk number, counted from 0
+	uint32_t offset;				///> Image offset of the first byte of the chunk
+	uint32_t crc;					///> CRC-32 of the image from offset 0 through the last byte of this chunk
+} ota_ws_header_t;
+
+/**
+ * What to tell the sender about a chunk frame
+ */
+typedef enum ota_ws_result
+{
+	OTA_WS_MORE = 0,				///> Frame not complete yet, nothing to send
+	OTA_WS_ACCEPTED,				///> Chunk taken, no ack due yet
+	OTA_WS_ACK,						///> Chunk taken, acknowledge everything up to it
+	OTA_WS_DUPLICATE,				///> Chunk already taken before a resume, ignored, ack so the sender catches up
+	OTA_WS_REJECTED,				///> Out of place chunk or no upload, nak with the expected position
+	OTA_WS_FAILED,					///> The upload was dropped, see ota_ws_t.err
+} ota_ws_result_e;
+
+/**
+ * Counters of the websocket uploads since boot
+ */
+typedef struct ota_ws_stats
+{
+	uint32_t chunks;				///> Chunks accepted
+	uint32_t duplicates;			///> Chunks received again after a resume
+	uint32_t rejects;				///> Chunks answered with a nak
+	uint32_t resumes;				///> Uploads continued where a dropped connection left them
+} ota_ws_stats_t;
+
+/**
+ * Firmware upload carried by binary websocket frames.
+ *
+ * Every chunk names its sequence number, its image offset and the CRC-32 of the image
+ * up to its end, so the device can check order and content without a round trip per
+ * chunk. The device acks every OTA_WS_ACK_EVERY chunks, a sender keeps up to
+ * OTA_WS_WINDOW chunks in flight. The upload outlives the connection: beginning the same
+ * image again resumes from the last byte taken, which may be in the middle of a chunk.
+ * Image bytes go through ota_stream_t, so the flash side is any ota_sink_t. Not thread safe.
+ */
+typedef struct ota_ws
+{
+	ota_stream_t stream;
+	bool active;					///> An upload is in progress
+	uint32_t size;					///> Image size
+	uint32_t image_crc;				///> CRC-32 of the whole image, identifies it when resuming
+	uint32_t offset;				///> Image bytes taken
+	uint32_t crc;					///> CRC-32 of the bytes taken
+	uint32_t seq;					///> Sequence number expected next
+	uint32_t unacked;				///> Chunks taken since the last ack
+	esp_err_t err;					///> Why the latest upload was dropped, ESP_OK if it was not
+	ota_ws_header_t header;			///> Header of the frame being received
+	ota_ws_result_e verdict;		///> Answer to the frame being received, decided by its header
+	ota_ws_stats_t stats;
+} ota_ws_t;
+
+/**
+ * Starts an upload, or resumes the one in progress if it is for the same image.
+ * A different image drops the upload in progress.
+ * @param ota upload state.
+ * @param sink destination of the image, must outlive the upload.
+ * @param size image size in bytes.
+ * @param image_crc CRC-32 of the whole image.
+ * @param resumed set to true if the upload continues where it stopped.
+ * @return ESP_OK on success, or the ota_stream_begin error.
+ */
+esp_err_t ota_ws_begin(ota_ws_t *ota, const ota_sink_t *sink, uint32_t size, uint32_t image_crc, bool *resumed);
+
+/**
+ * Takes a piece of a binary frame. Frames may arrive whole or in pieces, in order.
+ * @param ota upload state.
+ * @param data piece of the frame payload.
+ * @param len bytes in data, the first piece must hold the whole header.
+ * @param offset position of data within the frame payload.
+ * @param frame_len length of the whole frame payload.
+ * @return OTA_WS_MORE until the last piece, then what to tell the sender.
+ */
+ota_ws_result_e ota_ws_feed(ota_ws_t *ota, const uint8_t *data, size_t len, size_t offset, size_t frame_len);
+
+/**
+ * Finishes the upload once every byte was taken and the image CRC matches.
+ * @param ota upload state.
+ * @return ESP_OK if the image was accepted, ESP_ERR_INVALID_SIZE if bytes are missing and the
+ * upload goes on, otherwise the error that dropped the upload.
+ */
+esp_err_t ota_ws_end(ota_ws_t *ota);
+
+/**
+ * Drops the upload in progress, if any.
+ * @param ota upload state.
+ */
+void ota_ws_abort(ota_ws_t *ota);
+
+/**
+ * Writes the position of the upload as "seq=<next> offset=<bytes> crc=<hex>", the sender
+ * continues from there after a nak or a resume.
+ * @param ota upload state.
+ * @param out text buffer.
+ * @param size size of out.
+ * @return length written, as snprintf.
+ */
+int ota_ws_position(const ota_ws_t *ota, char *out, size_t size);
+
+#endif /* MAIN_OTA_WS_H_ */
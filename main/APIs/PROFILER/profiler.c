@@ -0,0 +1,219 @@
+/*
+ * profiler.c
+ *
+ *  Created on: May 16, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "sys/param.h"
+
+#include "task_topology.h"
+#include "ws_client.h"
+
+#ifdef CONFIG_WS_PROFILER
+// Sized by options that only exist while the profiler is enabled
+#include "profiler.h"
+
+static const char TAG[] = "[profiler]";
+
+// Sampler of the profiler task, kept off its stack
+static profiler_t profiler;
+
+static TaskHandle_t task_profiler = NULL;
+
+static inline void profiler_put16(uint8_t *out, uint16_t value)
+{
+	out[0] = value;
+	out[1] = value >> 8;
+}
+
+static inline void profiler_put32(uint8_t *out, uint32_t value)
+{
+	profiler_put16(out, value);
+	profiler_put16(out + 2, value >> 16);
+}
+
+/**
+ * Finds the run time counter a task had at the previous sample.
+ * @param profiler sampler state.
+ * @param number task number.
+ * @param run_time receives the counter.
+ * @return true if the task was there.
+ */
+static bool profiler_prev_run_time(const profiler_t *profiler, UBaseType_t number, uint32_t *run_time)
+{
+	for (size_t i = 0; i < profiler->prev_count; ++i)
+	{
+		if (profiler->prev[i].number == number)
+		{
+			*run_time = profiler->prev[i].run_time;
+			return true;
+		}
+	}
+	return false;
+}
+
+void profiler_reset(profiler_t *profiler)
+{
+	profiler->prev_count = 0;
+	profiler->prev_total = 0;
+
+	// The first frame after the baseline carries the names, a new subscriber needs them
+	profiler->frames = 0;
+}
+
+size_t profiler_sample(profiler_t *profiler, uint8_t *out, size_t max)
+{
+	uint32_t total = 0;
+	int64_t start = esp_timer_get_time();
+
+	UBaseType_t all = uxTaskGetNumberOfTasks();
+	UBaseType_t count = uxTaskGetSystemState(profiler->status, PROFILER_MAX_TASKS, &total);
+	if (count == 0)
+	{
+		// More tasks than PROFILER_MAX_TASKS, uxTaskGetSystemState copies nothing then
+		ESP_LOGW(TAG, "%u tasks, raise WS_PROFILER_MAX_TASKS", all);
+		return 0;
+	}
+
+	bool baseline = (profiler->prev_total == 0);
+	uint32_t interval = total - profiler->prev_total;
+	bool names = (profiler->frames % PROFILER_NAMES_EVERY) == 0 || count != profiler->prev_count;
+	size_t len = PROFILER_HEADER_SIZE + count * PROFILER_TASK_SIZE;
+
+	for (UBaseType_t i = 0; i < count; ++i)
+	{
+		uint32_t run_time;
+		names |= !profiler_prev_run_time(profiler, profiler->status[i].xTaskNumber, &run_time);
+	}
+	if (names)
+	{
+		for (UBaseType_t i = 0; i < count; ++i)
+		{
+			len += strnlen(profiler->status[i].pcTaskName, configMAX_TASK_NAME_LEN - 1) + 1;
+		}
+	}
+
+	if (!baseline && interval && len <= max)
+	{
+		uint8_t *task = out + PROFILER_HEADER_SIZE;
+		uint8_t *name = task + count * PROFILER_TASK_SIZE;
+
+		for (UBaseType_t i = 0; i < count; ++i, task += PROFILER_TASK_SIZE)
+		{
+			const TaskStatus_t *status = &profiler->status[i];
+			uint32_t prev = 0;
+
+			// A task born since the previous sample keeps 0, it ran for all of its counter
+			profiler_prev_run_time(profiler, status->xTaskNumber, &prev);
+			uint32_t permille = (uint64_t)(status->ulRunTimeCounter - prev) * 1000 / interval;
+
+			profiler_put16(&task[0], status->xTaskNumber);
+			profiler_put16(&task[2], MIN(permille, 1000));
+			profiler_put16(&task[4], status->usStackHighWaterMark);
+			task[6] = (status->xCoreID == tskNO_AFFINITY) ? 0xFF : status->xCoreID;
+			task[7] = status->uxCurrentPriority;
+			task[8] = status->eCurrentState;
+			task[9] = 0;
+
+			if (names)
+			{
+				size_t name_len = strnlen(status->pcTaskName, configMAX_TASK_NAME_LEN - 1);
+				memcpy(name, status->pcTaskName, name_len);
+				name[name_len] = '\0';
+				name += name_len + 1;
+			}
+		}
+	}
+	else
+	{
+		len = 0;
+	}
+
+	// The run time counters are the baseline of the next sample
+	for (UBaseType_t i = 0; i < count; ++i)
+	{
+		profiler->prev[i].number = profiler->status[i].xTaskNumber;
+		profiler->prev[i].run_time = profiler->status[i].ulRunTimeCounter;
+	}
+	profiler->prev_count = count;
+	profiler->prev_total = total ? total : 1;
+
+	profiler->sample_us = esp_timer_get_time() - start;
+	profiler->max_sample_us = MAX(profiler->max_sample_us, profiler->sample_us);
+
+	if (len)
+	{
+		memcpy(out, PROFILER_MAGIC, 4);
+		out[4] = PROFILER_VERSION;
+		out[5] = names ? PROFILER_FLAG_NAMES : 0;
+		out[6] = count;
+		out[7] = portNUM_PROCESSORS;
+		profiler_put32(&out[8], interval);
+		profiler_put32(&out[12], esp_timer_get_time() / 1000);
+		profiler_put32(&out[16], esp_get_free_heap_size());
+		profiler_put16(&out[20], MIN(profiler->sample_us, UINT16_MAX));
+		profiler_put16(&out[22], all - count);
+		profiler->frames++;
+	}
+
+	return len;
+}
+
+/**
+ * Profiler task, samples only while somebody listens so an idle profiler costs a wakeup per period.
+ * @param pvParameters unused.
+ */
+static void profiler_task(void *pvParameters)
+{
+	TickType_t last_wake = xTaskGetTickCount();
+
+	for (;;)
+	{
+		vTaskDelayUntil(&last_wake, MAX(pdMS_TO_TICKS(PROFILER_PERIOD_MS), 1));
+
+		if (!(ws_client_get_topics() & WS_CLIENT_TOPIC_PROFILER))
+		{
+			// A new subscriber gets fresh deltas, not one spanning the time nobody listened
+			profiler_reset(&profiler);
+			continue;
+		}
+
+		ws_msg_t *msg = ws_msg_alloc(PROFILER_FRAME_MAX_LEN, HTTPD_WS_TYPE_BINARY);
+		if (msg == NULL)
+		{
+			continue;
+		}
+
+		// Not shared yet, the frame can still be trimmed to the sample length
+		msg->frame.len = profiler_sample(&profiler, msg->payload, PROFILER_FRAME_MAX_LEN);
+		if (msg->frame.len == 0)
+		{
+			// First sample after a reset, or the frame did not fit, nothing to send
+			ws_msg_unref(msg);
+			continue;
+		}
+		ws_client_broadcast_topic(msg, WS_CLIENT_TOPIC_PROFILER);
+		ws_msg_unref(msg);
+	}
+}
+
+void profiler_start(void)
+{
+	if (task_profiler == NULL)
+	{
+		task_topology_create(TASK_TOPOLOGY_PROFILER, profiler_task, NULL, &task_profiler);
+	}
+}
+
+const profiler_t *profiler_get(void)
+{
+	return &profiler;
+}
+
+#endif
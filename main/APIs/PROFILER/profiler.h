@@ -0,0 +1,97 @@
+/*
+ * profiler.h
+ *
+ *  Created on: May 16, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_PROFILER_H_
+#define MAIN_PROFILER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Profiler task, placed by task_topology.h
+#define PROFILER_PERIOD_MS				CONFIG_WS_PROFILER_PERIOD_MS
+#define PROFILER_MAX_TASKS				CONFIG_WS_PROFILER_MAX_TASKS
+
+// Task names are repeated at least this often so a client that joins late learns them
+#define PROFILER_NAMES_EVERY			10
+
+/**
+ * Sample frame, all fields little endian:
+ *  header  char magic[4] "PROF", u8 version, u8 flags, u8 task count, u8 cores,
+ *          u32 interval_us, u32 uptime_ms, u32 free heap, u16 sample_us, u16 tasks left out
+ *  tasks   u16 task number, u16 CPU use in permille of one core over the interval,
+ *          u16 lowest free stack in bytes, u8 core (0xFF unpinned), u8 priority, u8 state, u8 reserved
+ *  names   if PROFILER_FLAG_NAMES, one NUL terminated name per task in the same order
+ *
+ * Task numbers are unique for the life of the firmware, tools/ws_profiler.py keeps the
+ * names it has seen by number. No log record starts with "PR", so the frames can share
+ * a connection with binary log frames.
+ */
+#define PROFILER_MAGIC					"PROF"
+#define PROFILER_VERSION				1
+#define PROFILER_HEADER_SIZE			24
+#define PROFILER_TASK_SIZE				10
+#define PROFILER_FLAG_NAMES				(1U << 0)
+
+// Largest frame, names included
+#define PROFILER_FRAME_MAX_LEN			(PROFILER_HEADER_SIZE + PROFILER_MAX_TASKS * (PROFILER_TASK_SIZE + configMAX_TASK_NAME_LEN))
+
+/**
+ * Run time counter of a task at the previous sample
+ */
+typedef struct profiler_task
+{
+	UBaseType_t number;
+	uint32_t run_time;
+} profiler_task_t;
+
+/**
+ * Sampler state, the previous sample is what the next one is diffed against
+ */
+typedef struct profiler
+{
+	TaskStatus_t status[PROFILER_MAX_TASKS];	///> Scratch for uxTaskGetSystemState
+	profiler_task_t prev[PROFILER_MAX_TASKS];
+	size_t prev_count;
+	uint32_t prev_total;			///> Total run time at the previous sample, 0 before the first one
+	uint32_t frames;
+	uint32_t sample_us;				///> Cost of the latest sample
+	uint32_t max_sample_us;			///> Worst sample cost seen
+} profiler_t;
+
+/**
+ * Forgets the previous sample, the next call to profiler_sample only sets a baseline.
+ * @param profiler sampler to reset.
+ */
+void profiler_reset(profiler_t *profiler);
+
+/**
+ * Samples the run time counters and stack high-water marks of every task and encodes
+ * the change since the previous sample. The scheduler is suspended while the task list
+ * is copied, which costs time in proportion to the number of tasks.
+ * @param profiler sampler state.
+ * @param out buffer receiving the frame.
+ * @param max size of out, PROFILER_FRAME_MAX_LEN always fits.
+ * @return frame length, 0 for the baseline sample or if out is too small.
+ */
+size_t profiler_sample(profiler_t *profiler, uint8_t *out, size_t max);
+
+/**
+ * Starts the profiler task. It samples every PROFILER_PERIOD_MS while a websocket client
+ * is subscribed to WS_CLIENT_TOPIC_PROFILER and sleeps otherwise.
+ */
+void profiler_start(void);
+
+/**
+ * Gets the sampler of the profiler task, for its cost counters.
+ * @return the sampler.
+ */
+const profiler_t *profiler_get(void);
+
+#endif /* MAIN_PROFILER_H_ */
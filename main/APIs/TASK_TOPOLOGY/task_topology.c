@@ -0,0 +1,162 @@
+/*
+ * task_topology.c
+ *
+ *  Created on: May 28, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include "task_topology.h"
+
+// Kconfig takes -1 for an unpinned task
+#define TASK_TOPOLOGY_CORE(core)		((core) < 0 ? tskNO_AFFINITY : (BaseType_t)(core))
+
+// Placement of a task from menuconfig
+#define TASK_TOPOLOGY_CONFIG(task)		{ CONFIG_WS_TASK_##task##_PRIORITY, TASK_TOPOLOGY_CORE(CONFIG_WS_TASK_##task##_CORE) }
+
+// Same priority as in menuconfig, on another core
+#define TASK_TOPOLOGY_ON(task, core)	{ CONFIG_WS_TASK_##task##_PRIORITY, (core) }
+
+// The benchmark load sits just below the log task, like any busy application task would
+#define TASK_TOPOLOGY_BENCH_PRIORITY	(CONFIG_WS_TASK_WS_PRINT_PRIORITY > 1 ? CONFIG_WS_TASK_WS_PRINT_PRIORITY - 1 : 1)
+
+/**
+ * Priority and core of a task in a topology
+ */
+typedef struct task_topology_place
+{
+	UBaseType_t priority;
+	BaseType_t core_id;
+} task_topology_place_t;
+
+/**
+ * Built-in topology
+ */
+typedef struct task_topology_preset
+{
+	const char *name;
+	task_topology_place_t tasks[TASK_TOPOLOGY_COUNT];
+} task_topology_preset_t;
+
+// Names and stacks do not change with the placement
+static const struct
+{
+	const char *name;
+	uint32_t stack_size;
+} task_topology_tasks[TASK_TOPOLOGY_COUNT] =
+{
+	[TASK_TOPOLOGY_HTTPD]			= { "httpd",				10240 },
+	[TASK_TOPOLOGY_HTTP_MONITOR]	= { "http_server_monitor",	4096 },
+	[TASK_TOPOLOGY_WS_PRINT]		= { "websocket",			3072 },
+	[TASK_TOPOLOGY_WIFI_APP]		= { "wifi_app_task",		4096 },
+	[TASK_TOPOLOGY_OTA_WRITER]		= { "ota_writer",			3072 },
+	[TASK_TOPOLOGY_PROFILER]		= { "profiler",				3072 },
+	[TASK_TOPOLOGY_BENCH]			= { "bench",				4096 },
+};
+
+static const task_topology_preset_t task_topology_presets[] =
+{
+	{
+		// As set in menuconfig
+		.name = "config",
+		.tasks = {
+			[TASK_TOPOLOGY_HTTPD]			= TASK_TOPOLOGY_CONFIG(HTTPD),
+			[TASK_TOPOLOGY_HTTP_MONITOR]	= TASK_TOPOLOGY_CONFIG(HTTP_MONITOR),
+			[TASK_TOPOLOGY_WS_PRINT]		= TASK_TOPOLOGY_CONFIG(WS_PRINT),
+			[TASK_TOPOLOGY_WIFI_APP]		= TASK_TOPOLOGY_CONFIG(WIFI_APP),
+			[TASK_TOPOLOGY_OTA_WRITER]		= TASK_TOPOLOGY_CONFIG(OTA_WRITER),
+			[TASK_TOPOLOGY_PROFILER]		= TASK_TOPOLOGY_CONFIG(PROFILER),
+			[TASK_TOPOLOGY_BENCH]			= { TASK_TOPOLOGY_BENCH_PRIORITY, tskNO_AFFINITY },
+		},
+	},
+	{
+		// Everything on the app core, the protocol core only keeps the system tasks
+		.name = "one_core",
+		.tasks = {
+			[TASK_TOPOLOGY_HTTPD]			= TASK_TOPOLOGY_ON(HTTPD, 1),
+			[TASK_TOPOLOGY_HTTP_MONITOR]	= TASK_TOPOLOGY_ON(HTTP_MONITOR, 1),
+			[TASK_TOPOLOGY_WS_PRINT]		= TASK_TOPOLOGY_ON(WS_PRINT, 1),
+			[TASK_TOPOLOGY_WIFI_APP]		= TASK_TOPOLOGY_ON(WIFI_APP, 1),
+			[TASK_TOPOLOGY_OTA_WRITER]		= TASK_TOPOLOGY_ON(OTA_WRITER, 1),
+			[TASK_TOPOLOGY_PROFILER]		= TASK_TOPOLOGY_ON(PROFILER, 1),
+			[TASK_TOPOLOGY_BENCH]			= { TASK_TOPOLOGY_BENCH_PRIORITY, 1 },
+		},
+	},
+	{
+		// The scheduler picks a core at every switch
+		.name = "unpinned",
+		.tasks = {
+			[TASK_TOPOLOGY_HTTPD]			= TASK_TOPOLOGY_ON(HTTPD, tskNO_AFFINITY),
+			[TASK_TOPOLOGY_HTTP_MONITOR]	= TASK_TOPOLOGY_ON(HTTP_MONITOR, tskNO_AFFINITY),
+			[TASK_TOPOLOGY_WS_PRINT]		= TASK_TOPOLOGY_ON(WS_PRINT, tskNO_AFFINITY),
+			[TASK_TOPOLOGY_WIFI_APP]		= TASK_TOPOLOGY_ON(WIFI_APP, tskNO_AFFINITY),
+			[TASK_TOPOLOGY_OTA_WRITER]		= TASK_TOPOLOGY_ON(OTA_WRITER, tskNO_AFFINITY),
+			[TASK_TOPOLOGY_PROFILER]		= TASK_TOPOLOGY_ON(PROFILER, tskNO_AFFINITY),
+			[TASK_TOPOLOGY_BENCH]			= { TASK_TOPOLOGY_BENCH_PRIORITY, tskNO_AFFINITY },
+		},
+	},
+	{
+		// Log task above the HTTP server, lines leave the ring before the server sends them
+		.name = "log_first",
+		.tasks = {
+			[TASK_TOPOLOGY_HTTPD]			= TASK_TOPOLOGY_CONFIG(HTTPD),
+			[TASK_TOPOLOGY_HTTP_MONITOR]	= TASK_TOPOLOGY_CONFIG(HTTP_MONITOR),
+			[TASK_TOPOLOGY_WS_PRINT]		= { CONFIG_WS_TASK_HTTPD_PRIORITY < 24 ? CONFIG_WS_TASK_HTTPD_PRIORITY + 1 : 24,
+												TASK_TOPOLOGY_CORE(CONFIG_WS_TASK_WS_PRINT_CORE) },
+			[TASK_TOPOLOGY_WIFI_APP]		= TASK_TOPOLOGY_CONFIG(WIFI_APP),
+			[TASK_TOPOLOGY_OTA_WRITER]		= TASK_TOPOLOGY_CONFIG(OTA_WRITER),
+			[TASK_TOPOLOGY_PROFILER]		= TASK_TOPOLOGY_CONFIG(PROFILER),
+			[TASK_TOPOLOGY_BENCH]			= { TASK_TOPOLOGY_BENCH_PRIORITY, tskNO_AFFINITY },
+		},
+	},
+};
+
+#define TASK_TOPOLOGY_PRESETS			(sizeof(task_topology_presets) / sizeof(task_topology_presets[0]))
+
+static uint32_t task_topology_preset = 0;
+
+void task_topology_select(uint32_t preset)
+{
+	task_topology_preset = (preset < TASK_TOPOLOGY_PRESETS) ? preset : 0;
+}
+
+uint32_t task_topology_preset_count(void)
+{
+	return TASK_TOPOLOGY_PRESETS;
+}
+
+const char *task_topology_preset_name(uint32_t preset)
+{
+	return (preset < TASK_TOPOLOGY_PRESETS) ? task_topology_presets[preset].name : "?";
+}
+
+uint32_t task_topology_active(void)
+{
+	return task_topology_preset;
+}
+
+task_spec_t task_topology_get(task_topology_id_e id)
+{
+	const task_topology_place_t *place = &task_topology_presets[task_topology_preset].tasks[id];
+	task_spec_t spec =
+	{
+		.name = task_topology_tasks[id].name,
+		.stack_size = task_topology_tasks[id].stack_size,
+		.priority = place->priority,
+		.core_id = place->core_id,
+	};
+
+#ifdef CONFIG_FREERTOS_UNICORE
+	if (spec.core_id != tskNO_AFFINITY)
+	{
+		spec.core_id = 0;
+	}
+#endif
+	return spec;
+}
+
+BaseType_t task_topology_create(task_topology_id_e id, TaskFunction_t fn, void *arg, TaskHandle_t *handle)
+{
+	task_spec_t spec = task_topology_get(id);
+
+	return xTaskCreatePinnedToCore(fn, spec.name, spec.stack_size, arg, spec.priority, handle, spec.core_id);
+}
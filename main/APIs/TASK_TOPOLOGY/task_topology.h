@@ -0,0 +1,86 @@
+/*
+ * task_topology.h
+ *
+ *  Created on: May 28, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_TASK_TOPOLOGY_H_
+#define MAIN_TASK_TOPOLOGY_H_
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * Tasks placed by the topology table
+ */
+typedef enum task_topology_id
+{
+	TASK_TOPOLOGY_HTTPD = 0,		///> esp_http_server task, created by httpd_start
+	TASK_TOPOLOGY_HTTP_MONITOR,
+	TASK_TOPOLOGY_WS_PRINT,
+	TASK_TOPOLOGY_WIFI_APP,			///> Its core is also given to the Wi-Fi driver task
+	TASK_TOPOLOGY_OTA_WRITER,
+	TASK_TOPOLOGY_PROFILER,
+	TASK_TOPOLOGY_BENCH,			///> Load of the topology benchmark
+	TASK_TOPOLOGY_COUNT,
+} task_topology_id_e;
+
+/**
+ * Everything needed to create a task
+ */
+typedef struct task_spec
+{
+	const char *name;
+	uint32_t stack_size;			///> Bytes, fixed by the code the task runs
+	UBaseType_t priority;
+	BaseType_t core_id;				///> 0, 1 or tskNO_AFFINITY
+} task_spec_t;
+
+/**
+ * Places every task by one of the built-in topologies. Preset 0 is the one from
+ * menuconfig, the others are variations of it for the benchmark. Call it before
+ * any task of the table is created.
+ * @param preset topology number, below task_topology_preset_count.
+ */
+void task_topology_select(uint32_t preset);
+
+/**
+ * Number of built-in topologies.
+ * @return presets task_topology_select accepts.
+ */
+uint32_t task_topology_preset_count(void);
+
+/**
+ * Name of a built-in topology.
+ * @param preset topology number.
+ * @return its name, "?" if there is no such preset.
+ */
+const char *task_topology_preset_name(uint32_t preset);
+
+/**
+ * Topology in use.
+ * @return preset number given to task_topology_select, 0 by default.
+ */
+uint32_t task_topology_active(void);
+
+/**
+ * Reads the placement of a task in the topology in use.
+ * @param id task.
+ * @return its name, stack, priority and core.
+ */
+task_spec_t task_topology_get(task_topology_id_e id);
+
+/**
+ * Creates a task as the topology in use places it.
+ * @param id task.
+ * @param fn task function.
+ * @param arg task argument.
+ * @param handle receives the task handle, may be NULL.
+ * @return the xTaskCreatePinnedToCore result.
+ */
+BaseType_t task_topology_create(task_topology_id_e id, TaskFunction_t fn, void *arg, TaskHandle_t *handle);
+
+#endif /* MAIN_TASK_TOPOLOGY_H_ */
@@ -0,0 +1,815 @@
+/*
+ * ws_client.c
+ *
+ *  Created on: Apr 25, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "ws_client.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+
+static const char TAG[] = "[ws_client]";
+
+/**
+ * Frame waiting in a client queue
+ */
+typedef struct ws_client_frame
+{
+	ws_msg_t *msg;
+	int64_t enqueued;				///> esp_timer_get_time when queued
+} ws_client_frame_t;
+
+/**
+ * Websocket client slot, protected by ws_clients_lock.
+ */
+typedef struct ws_client
+{
+	bool in_use;
+	bool draining;					///> A drain work item is queued or running on the httpd task, or the retry timer will queue one
+	bool stalled;					///> The socket had no room, the retry timer queues the next drain
+	bool evicting;					///> Close already requested by the disconnect policy
+	bool replaying;					///> Catching up on the log history, skipped by broadcasts
+	bool replay_started;
+	uint32_t replay_cursor;
+	uint8_t head;
+	uint8_t count;
+	ws_client_frame_t queue[WS_CLIENT_QUEUE_DEPTH];
+	ws_client_stats_t stats;
+} ws_client_t;
+
+static ws_client_t ws_clients[WS_CLIENT_MAX_CLIENTS];
+
+static SemaphoreHandle_t ws_clients_lock = NULL;
+
+// NULL once the server is stopped, read under ws_clients_lock by anything queueing work on it
+static httpd_handle_t ws_clients_server = NULL;
+
+// Queues the drains of stalled clients, see ws_client_retry
+static esp_timer_handle_t ws_clients_retry_timer = NULL;
+
+// Distinct subscriptions in use and the number of clients sharing each one
+static ws_filter_t ws_client_groups[WS_CLIENT_MAX_CLIENTS];
+static uint8_t ws_client_group_refs[WS_CLIENT_MAX_CLIENTS];
+
+// Broadcast group matching every client
+#define WS_CLIENT_GROUP_ALL			0xFF
+
+// Enqueue to send latency, observed on the httpd task without taking ws_clients_lock
+static metrics_histogram_t ws_client_latency;
+
+// Told about the first frame of each client, see ws_client_set_first_frame_hook
+static ws_client_first_frame_fn_t ws_client_first_frame_hook = NULL;
+
+#if defined(CONFIG_WS_CLIENT_OVERFLOW_DISCONNECT)
+static ws_client_overflow_policy_e ws_clients_policy = WS_CLIENT_OVERFLOW_DISCONNECT;
+#elif defined(CONFIG_WS_CLIENT_OVERFLOW_DROP_NEWEST)
+static ws_client_overflow_policy_e ws_clients_policy = WS_CLIENT_OVERFLOW_DROP_NEWEST;
+#else
+static ws_client_overflow_policy_e ws_clients_policy = WS_CLIENT_OVERFLOW_DROP_OLDEST;
+#endif
+
+/**
+ * Removes the oldest frame from a client queue. Caller holds ws_clients_lock.
+ * @param client client to pop from, must have at least one frame queued.
+ * @return the removed frame, its message reference goes to the caller.
+ */
+static ws_client_frame_t ws_client_pop(ws_client_t *client)
+{
+	ws_client_frame_t frame = client->queue[client->head];
+
+	client->head = (client->head + 1) % WS_CLIENT_QUEUE_DEPTH;
+	client->count--;
+	client->stats.queued_frames = client->count;
+	client->stats.queued_bytes -= frame.msg->frame.len;
+
+	return frame;
+}
+
+/**
+ * Finds the group with the same filter or claims a free one. Caller holds ws_clients_lock.
+ * There are as many groups as client slots, so a group is always available.
+ * @param filter subscription of the joining client.
+ * @return the group index.
+ */
+static uint8_t ws_client_group_join(const ws_filter_t *filter)
+{
+	uint8_t free_group = 0;
+
+	for (uint8_t i = WS_CLIENT_MAX_CLIENTS; i-- > 0;)
+	{
+		if (ws_client_group_refs[i] == 0)
+		{
+			free_group = i;
+		}
+		else if (memcmp(&ws_client_groups[i], filter, sizeof(ws_filter_t)) == 0)
+		{
+			ws_client_group_refs[i]++;
+			return i;
+		}
+	}
+
+	ws_client_groups[free_group] = *filter;
+	ws_client_group_refs[free_group] = 1;
+	return free_group;
+}
+
+/**
+ * Drops every queued frame and frees the slot. Caller holds ws_clients_lock.
+ * @param client client to release.
+ */
+static void ws_client_release(ws_client_t *client)
+{
+	while (client->count)
+	{
+		ws_msg_unref(ws_client_pop(client).msg);
+	}
+	ws_client_group_refs[client->stats.group]--;
+	client->in_use = false;
+	client->evicting = false;
+}
+
+/**
+ * Finds the slot of a tracked client. Caller holds ws_clients_lock.
+ * @param fd socket of the client.
+ * @return the slot, or NULL if the client is not tracked.
+ */
+static ws_client_t *ws_client_find(int fd)
+{
+	for (size_t i = 0; i < WS_CLIENT_MAX_CLIENTS; ++i)
+	{
+		if (ws_clients[i].in_use && ws_clients[i].stats.fd == fd)
+		{
+			return &ws_clients[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Tells whether a client socket has room for a frame, without waiting.
+ * lwIP reports a socket writable once TCP_SNDLOWAT bytes are free, more than a log batch frame.
+ * @param fd socket of the client.
+ * @return true if a send would not block, also if the socket is in error so the send reports it.
+ */
+static bool ws_client_writable(int fd)
+{
+	fd_set writable;
+	fd_set failed;
+	struct timeval now = { 0, 0 };
+
+	FD_ZERO(&writable);
+	FD_SET(fd, &writable);
+	FD_ZERO(&failed);
+	FD_SET(fd, &failed);
+
+	return select(fd + 1, NULL, &writable, &failed, &now) != 0;
+}
+
+/**
+ * Asks the server to close a session, unless it is stopped or stopping.
+ * Holds ws_clients_lock so http_server_stop cannot free the server meanwhile.
+ * @param fd socket of the session.
+ */
+static void ws_client_close(int fd)
+{
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	if (ws_clients_server)
+	{
+		httpd_sess_trigger_close(ws_clients_server, fd);
+	}
+	xSemaphoreGive(ws_clients_lock);
+}
+
+/**
+ * Hands a frame taken off a client queue to its socket and counts the result.
+ * Runs on the httpd task, without ws_clients_lock held. A send that times out means the
+ * client stopped reading, it is disconnected rather than left to block the task again.
+ * @param client client the frame was popped from.
+ * @param frame frame popped, its message reference is dropped here.
+ * @param fd socket of the client when the frame was popped.
+ * @param hd server the client belonged to when the frame was popped.
+ */
+static void ws_client_send_frame(ws_client_t *client, ws_client_frame_t frame, int fd, httpd_handle_t hd)
+{
+	size_t len = frame.msg->frame.len;
+	esp_err_t err = httpd_ws_send_frame_async(hd, fd, &frame.msg->frame);
+	ws_msg_unref(frame.msg);
+
+	if (err == ESP_OK)
+	{
+		metrics_histogram_observe(&ws_client_latency, esp_timer_get_time() - frame.enqueued);
+	}
+
+	bool first = false;
+	bool evict = false;
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	if (err == ESP_OK)
+	{
+		first = client->stats.sent_frames == 0;
+		client->stats.sent_frames++;
+		client->stats.sent_bytes += len;
+	}
+	else
+	{
+		client->stats.send_failures++;
+
+		// ESP_ERR_INVALID_ARG: the session is gone, the close hook will not run for it anymore
+		// ESP_FAIL: the socket stayed full for send_wait_timeout
+		if ((err == ESP_ERR_INVALID_ARG || err == ESP_FAIL) && client->in_use && client->stats.fd == fd)
+		{
+			evict = (err == ESP_FAIL);
+			ws_client_release(client);
+		}
+	}
+	xSemaphoreGive(ws_clients_lock);
+
+	if (evict)
+	{
+		ESP_LOGW(TAG, "ws_client_send_frame: fd %d stopped reading, disconnecting", fd);
+		ws_client_close(fd);
+	}
+
+	ws_client_first_frame_fn_t hook = ws_client_first_frame_hook;
+	if (first && hook)
+	{
+		hook(fd, esp_timer_get_time());
+	}
+}
+
+static void ws_client_schedule(ws_client_t *client);
+
+/**
+ * httpd work item sending the queued frames of one client.
+ * Runs on the httpd task, sends a short burst and then requeues itself so a slow
+ * client only ever delays the others by WS_CLIENT_DRAIN_BURST frames. A socket
+ * without room is not waited on, the frames stay queued where the overflow policy
+ * deals with them and the retry timer comes back for the client later.
+ * @param arg client slot.
+ */
+static void ws_client_drain(void *arg)
+{
+	ws_client_t *client = arg;
+
+	for (int burst = 0; burst < WS_CLIENT_DRAIN_BURST; ++burst)
+	{
+		xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+		if (!client->in_use || client->count == 0)
+		{
+			client->draining = false;
+			xSemaphoreGive(ws_clients_lock);
+			return;
+		}
+
+		// Still draining as far as broadcasts go, they must not queue a work item that would stall again
+		int fd = client->stats.fd;
+		if (!ws_client_writable(fd))
+		{
+			client->stalled = true;
+			client->stats.stalls++;
+			xSemaphoreGive(ws_clients_lock);
+
+			// Already armed by another stalled client is fine, the callback serves them all
+			esp_timer_start_once(ws_clients_retry_timer, WS_CLIENT_STALL_RETRY_MS * 1000);
+			return;
+		}
+		ws_client_frame_t frame = ws_client_pop(client);
+		httpd_handle_t hd = ws_clients_server;
+		xSemaphoreGive(ws_clients_lock);
+
+		ws_client_send_frame(client, frame, fd, hd);
+	}
+
+	// More frames pending, let the other clients' work items run first
+	ws_client_schedule(client);
+}
+
+/**
+ * Queues the drain work item of a client, called without ws_clients_lock.
+ * The work is queued under the lock, so the server cannot be stopped in between.
+ * @param client client whose queue went from idle to pending.
+ */
+static void ws_client_schedule(ws_client_t *client)
+{
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	if (ws_clients_server == NULL || httpd_queue_work(ws_clients_server, ws_client_drain, client) != ESP_OK)
+	{
+		client->draining = false;
+	}
+	xSemaphoreGive(ws_clients_lock);
+}
+
+/**
+ * esp_timer callback, queues the drain of every client that found its socket full.
+ * A client still full stalls again and rearms the timer.
+ * @param arg unused.
+ */
+static void ws_client_retry(void *arg)
+{
+	uint32_t due = 0;
+
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	for (size_t i = 0; i < WS_CLIENT_MAX_CLIENTS && ws_clients_server; ++i)
+	{
+		if (ws_clients[i].stalled)
+		{
+			ws_clients[i].stalled = false;
+			due |= 1UL << i;
+		}
+	}
+	xSemaphoreGive(ws_clients_lock);
+
+	for (size_t i = 0; due; ++i, due >>= 1)
+	{
+		if (due & 1UL)
+		{
+			ws_client_schedule(&ws_clients[i]);
+		}
+	}
+}
+
+void ws_client_pump(void)
+{
+	if (ws_clients_lock == NULL)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < WS_CLIENT_MAX_CLIENTS; ++i)
+	{
+		ws_client_t *client = &ws_clients[i];
+
+		// Leaves draining alone, a queued work item finds the queue shorter and carries on
+		for (int burst = 0; burst < WS_CLIENT_DRAIN_BURST; ++burst)
+		{
+			xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+			if (!client->in_use || client->count == 0 || !ws_client_writable(client->stats.fd))
+			{
+				xSemaphoreGive(ws_clients_lock);
+				break;
+			}
+			ws_client_frame_t frame = ws_client_pop(client);
+			int fd = client->stats.fd;
+			httpd_handle_t hd = ws_clients_server;
+			xSemaphoreGive(ws_clients_lock);
+
+			ws_client_send_frame(client, frame, fd, hd);
+		}
+	}
+}
+
+void ws_client_init(httpd_handle_t hd)
+{
+	if (ws_clients_lock == NULL)
+	{
+		const esp_timer_create_args_t retry = {
+			.callback = ws_client_retry,
+			.name = "ws_client_retry",
+		};
+		ESP_ERROR_CHECK(esp_timer_create(&retry, &ws_clients_retry_timer));
+		ws_clients_lock = xSemaphoreCreateMutex();
+	}
+
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	for (size_t i = 0; i < WS_CLIENT_MAX_CLIENTS; ++i)
+	{
+		if (ws_clients[i].in_use)
+		{
+			ws_client_release(&ws_clients[i]);
+		}
+		ws_clients[i].draining = false;
+		ws_clients[i].stalled = false;
+		ws_client_group_refs[i] = 0;
+	}
+	ws_clients_server = hd;
+	if (hd == NULL)
+	{
+		// A callback already waiting on the lock finds no stalled client and no server
+		esp_timer_stop(ws_clients_retry_timer);
+	}
+	xSemaphoreGive(ws_clients_lock);
+}
+
+esp_err_t ws_client_add(int fd, bool replay)
+{
+	esp_err_t err = ESP_ERR_NO_MEM;
+
+	if (ws_clients_lock == NULL)
+	{
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	if (ws_client_find(fd))
+	{
+		err = ESP_OK;
+	}
+	else
+	{
+		for (size_t i = 0; i < WS_CLIENT_MAX_CLIENTS; ++i)
+		{
+			ws_client_t *client = &ws_clients[i];
+
+			// A slot still referenced by a pending drain work item is not reused yet
+			if (!client->in_use && !client->draining)
+			{
+				ws_filter_t everything;
+				ws_filter_reset(&everything);
+
+				memset(client, 0x00, sizeof(ws_client_t));
+				client->in_use = true;
+				client->replaying = replay;
+				client->stats.fd = fd;
+				client->stats.group = ws_client_group_join(&everything);
+				err = ESP_OK;
+				break;
+			}
+		}
+	}
+	xSemaphoreGive(ws_clients_lock);
+
+	if (err == ESP_ERR_NO_MEM)
+	{
+		ESP_LOGW(TAG, "ws_client_add: no free slot for fd %d", fd);
+	}
+	return err;
+}
+
+void ws_client_remove(int fd)
+{
+	if (ws_clients_lock == NULL)
+	{
+		return;
+	}
+
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	ws_client_t *client = ws_client_find(fd);
+	if (client)
+	{
+		ws_client_release(client);
+	}
+	xSemaphoreGive(ws_clients_lock);
+}
+
+/**
+ * Appends a message to a client queue that has room. Caller holds ws_clients_lock.
+ * @param client client to push to.
+ * @param msg message to send, the client takes its own reference.
+ * @return true if the caller must schedule a drain with ws_client_schedule.
+ */
+static bool ws_client_push(ws_client_t *client, ws_msg_t *msg)
+{
+	uint8_t tail = (client->head + client->count) % WS_CLIENT_QUEUE_DEPTH;
+	client->queue[tail].msg = ws_msg_ref(msg);
+	client->queue[tail].enqueued = esp_timer_get_time();
+	client->count++;
+	client->stats.queued_frames = client->count;
+	client->stats.queued_bytes += msg->frame.len;
+	if (client->count > client->stats.high_water)
+	{
+		client->stats.high_water = client->count;
+	}
+
+	bool schedule = !client->draining;
+	client->draining = true;
+	return schedule;
+}
+
+/**
+ * Tells whether a broadcast is meant for a client. Caller holds ws_clients_lock.
+ * @param client client slot.
+ * @param group filter group, WS_CLIENT_GROUP_ALL for every client.
+ * @param topic WS_CLIENT_TOPIC_ bit the client must have, 0 for the log stream.
+ * @return true if the client takes the message.
+ */
+static bool ws_client_targeted(const ws_client_t *client, uint8_t group, uint8_t topic)
+{
+	return client->in_use && !client->replaying &&
+			(group == WS_CLIENT_GROUP_ALL || client->stats.group == group) &&
+			(topic == 0 || (client->stats.topics & topic));
+}
+
+/**
+ * Queues a message on every tracked client of a group.
+ * @param msg message to send.
+ * @param group filter group, WS_CLIENT_GROUP_ALL for every client.
+ * @param topic WS_CLIENT_TOPIC_ bit the clients must have, 0 for the log stream.
+ */
+static void ws_client_enqueue(ws_msg_t *msg, uint8_t group, uint8_t topic)
+{
+	if (ws_clients_lock == NULL || msg->frame.len == 0)
+	{
+		return;
+	}
+
+	// Pick the recipients in one pass so empty slots cost nothing below
+	uint32_t targets = 0;
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	for (size_t i = 0; i < WS_CLIENT_MAX_CLIENTS; ++i)
+	{
+		if (ws_client_targeted(&ws_clients[i], group, topic))
+		{
+			targets |= 1UL << i;
+		}
+	}
+	xSemaphoreGive(ws_clients_lock);
+
+	for (size_t i = 0; targets; ++i, targets >>= 1)
+	{
+		ws_client_t *client = &ws_clients[i];
+		ws_msg_t *dropped = NULL;
+		bool schedule = false;
+		int evict_fd = -1;
+
+		if (!(targets & 1UL))
+		{
+			continue;
+		}
+
+		xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+		// The slot may have changed hands since the snapshot
+		if (!ws_client_targeted(client, group, topic))
+		{
+			xSemaphoreGive(ws_clients_lock);
+			continue;
+		}
+
+		bool enqueue = true;
+		if (client->count == WS_CLIENT_QUEUE_DEPTH)
+		{
+			client->stats.dropped_frames++;
+
+			switch (ws_clients_policy)
+			{
+				case WS_CLIENT_OVERFLOW_DROP_OLDEST:
+					dropped = ws_client_pop(client).msg;
+					break;
+
+				case WS_CLIENT_OVERFLOW_DROP_NEWEST:
+					enqueue = false;
+					break;
+
+				case WS_CLIENT_OVERFLOW_DISCONNECT:
+					enqueue = false;
+					if (!client->evicting)
+					{
+						client->evicting = true;
+						evict_fd = client->stats.fd;
+					}
+					break;
+			}
+		}
+
+		if (enqueue)
+		{
+			schedule = ws_client_push(client, msg);
+		}
+		xSemaphoreGive(ws_clients_lock);
+
+		ws_msg_unref(dropped);
+
+		if (evict_fd >= 0)
+		{
+			ESP_LOGW(TAG, "ws_client_broadcast: fd %d fell behind, disconnecting", evict_fd);
+			ws_client_close(evict_fd);
+		}
+
+		if (schedule)
+		{
+			ws_client_schedule(client);
+		}
+	}
+}
+
+void ws_client_broadcast(ws_msg_t *msg)
+{
+	ws_client_enqueue(msg, WS_CLIENT_GROUP_ALL, 0);
+}
+
+void ws_client_broadcast_group(ws_msg_t *msg, uint8_t group)
+{
+	ws_client_enqueue(msg, group, 0);
+}
+
+void ws_client_broadcast_topic(ws_msg_t *msg, uint8_t topic)
+{
+	ws_client_enqueue(msg, WS_CLIENT_GROUP_ALL, topic);
+}
+
+esp_err_t ws_client_set_topic(int fd, uint8_t topic, bool enabled)
+{
+	esp_err_t err = ESP_ERR_NOT_FOUND;
+
+	if (ws_clients_lock == NULL)
+	{
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	ws_client_t *client = ws_client_find(fd);
+	if (client)
+	{
+		client->stats.topics = enabled ? (client->stats.topics | topic) : (client->stats.topics & ~topic);
+		err = ESP_OK;
+	}
+	xSemaphoreGive(ws_clients_lock);
+
+	return err;
+}
+
+uint8_t ws_client_get_topics(void)
+{
+	uint8_t topics = 0;
+
+	if (ws_clients_lock == NULL)
+	{
+		return 0;
+	}
+
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	for (size_t i = 0; i < WS_CLIENT_MAX_CLIENTS; ++i)
+	{
+		if (ws_clients[i].in_use)
+		{
+			topics |= ws_clients[i].stats.topics;
+		}
+	}
+	xSemaphoreGive(ws_clients_lock);
+
+	return topics;
+}
+
+esp_err_t ws_client_send(int fd, ws_msg_t *msg)
+{
+	esp_err_t err = ESP_ERR_NOT_FOUND;
+	bool schedule = false;
+
+	if (ws_clients_lock == NULL)
+	{
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	ws_client_t *client = ws_client_find(fd);
+	if (client)
+	{
+		err = ESP_ERR_NO_MEM;
+		if (client->count < WS_CLIENT_QUEUE_DEPTH)
+		{
+			schedule = ws_client_push(client, msg);
+			err = ESP_OK;
+		}
+	}
+	xSemaphoreGive(ws_clients_lock);
+
+	if (schedule)
+	{
+		ws_client_schedule(client);
+	}
+	return err;
+}
+
+size_t ws_client_get_replays(ws_client_replay_t *replays, size_t max)
+{
+	size_t count = 0;
+
+	if (ws_clients_lock == NULL)
+	{
+		return 0;
+	}
+
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	for (size_t i = 0; i < WS_CLIENT_MAX_CLIENTS && count < max; ++i)
+	{
+		ws_client_t *client = &ws_clients[i];
+
+		if (client->in_use && client->replaying)
+		{
+			replays[count].fd = client->stats.fd;
+			replays[count].group = client->stats.group;
+			replays[count].started = client->replay_started;
+			replays[count].cursor = client->replay_cursor;
+			count++;
+		}
+	}
+	xSemaphoreGive(ws_clients_lock);
+
+	return count;
+}
+
+void ws_client_set_replay(int fd, uint32_t cursor, bool done)
+{
+	if (ws_clients_lock == NULL)
+	{
+		return;
+	}
+
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	ws_client_t *client = ws_client_find(fd);
+	if (client)
+	{
+		client->replay_started = true;
+		client->replay_cursor = cursor;
+		client->replaying = !done;
+	}
+	xSemaphoreGive(ws_clients_lock);
+}
+
+esp_err_t ws_client_set_filter(int fd, const ws_filter_t *filter)
+{
+	esp_err_t err = ESP_ERR_NOT_FOUND;
+
+	if (ws_clients_lock == NULL)
+	{
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	ws_client_t *client = ws_client_find(fd);
+	if (client)
+	{
+		// Leave first so a client alone in its group can reuse it
+		ws_client_group_refs[client->stats.group]--;
+		client->stats.group = ws_client_group_join(filter);
+		err = ESP_OK;
+	}
+	xSemaphoreGive(ws_clients_lock);
+
+	return err;
+}
+
+uint32_t ws_client_get_groups(ws_filter_t *groups)
+{
+	uint32_t active = 0;
+
+	if (ws_clients_lock == NULL)
+	{
+		return 0;
+	}
+
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	for (uint8_t i = 0; i < WS_CLIENT_MAX_CLIENTS; ++i)
+	{
+		if (ws_client_group_refs[i])
+		{
+			groups[i] = ws_client_groups[i];
+			active |= 1UL << i;
+		}
+	}
+	xSemaphoreGive(ws_clients_lock);
+
+	return active;
+}
+
+void ws_client_set_overflow_policy(ws_client_overflow_policy_e policy)
+{
+	ws_clients_policy = policy;
+}
+
+size_t ws_client_get_stats(ws_client_stats_t *stats, size_t max)
+{
+	size_t count = 0;
+
+	if (ws_clients_lock == NULL)
+	{
+		return 0;
+	}
+
+	xSemaphoreTake(ws_clients_lock, portMAX_DELAY);
+	int64_t now = esp_timer_get_time();
+	for (size_t i = 0; i < WS_CLIENT_MAX_CLIENTS && count < max; ++i)
+	{
+		ws_client_t *client = &ws_clients[i];
+
+		if (client->in_use)
+		{
+			stats[count] = client->stats;
+			stats[count].lag_ms = client->count ? (now - client->queue[client->head].enqueued) / 1000 : 0;
+			count++;
+		}
+	}
+	xSemaphoreGive(ws_clients_lock);
+
+	return count;
+}
+
+const metrics_histogram_t *ws_client_get_latency(void)
+{
+	return &ws_client_latency;
+}
+
+void ws_client_set_first_frame_hook(ws_client_first_frame_fn_t fn)
+{
+	ws_client_first_frame_hook = fn;
+}
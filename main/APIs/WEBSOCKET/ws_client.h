@@ -0,0 +1,212 @@
+/*
+ * ws_client.h
+ *
+ *  Created on: Apr 25, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_WS_CLIENT_H_
+#define MAIN_WS_CLIENT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_http_server.h"
+
+#include "metrics.h"
+#include "ws_filter.h"
+#include "ws_msg.h"
+
+// Websocket clients tracked at the same time
+#define WS_CLIENT_MAX_CLIENTS			CONFIG_WS_CLIENT_MAX_CLIENTS
+
+// Frames each client can have waiting before the overflow policy kicks in
+#define WS_CLIENT_QUEUE_DEPTH			CONFIG_WS_CLIENT_QUEUE_DEPTH
+
+// Frames sent to one client before the other clients get their turn
+#define WS_CLIENT_DRAIN_BURST			4
+
+// Wait before looking again at a client whose socket had no room
+#define WS_CLIENT_STALL_RETRY_MS		20
+
+// Optional streams a client receives on top of its log lines, bit mask
+#define WS_CLIENT_TOPIC_METRICS			(1U << 0)		///> Prometheus text, see "metrics on"
+#define WS_CLIENT_TOPIC_PROFILER		(1U << 1)		///> Binary task samples, see profiler.h
+
+/**
+ * What to do when a frame is broadcast to a client whose queue is full
+ */
+typedef enum ws_client_overflow_policy
+{
+	WS_CLIENT_OVERFLOW_DROP_OLDEST = 0,
+	WS_CLIENT_OVERFLOW_DROP_NEWEST,
+	WS_CLIENT_OVERFLOW_DISCONNECT,
+} ws_client_overflow_policy_e;
+
+/**
+ * Per-client delivery counters
+ */
+typedef struct ws_client_stats
+{
+	int fd;							///> Socket of the client
+	uint8_t group;					///> Filter group, clients with the same subscription share one
+	uint8_t topics;					///> WS_CLIENT_TOPIC_ bits the client subscribed to
+	uint32_t queued_frames;			///> Frames waiting to be sent
+	uint32_t queued_bytes;			///> Bytes waiting to be sent
+	uint32_t lag_ms;				///> Age of the oldest waiting frame
+	uint32_t high_water;			///> Most frames ever waiting at once
+	uint32_t sent_frames;			///> Frames handed to the socket
+	uint32_t sent_bytes;			///> Bytes handed to the socket
+	uint32_t dropped_frames;		///> Frames lost to the overflow policy
+	uint32_t send_failures;			///> Frames the socket refused
+	uint32_t stalls;				///> Drains put off because the socket had no room
+} ws_client_stats_t;
+
+/**
+ * Called on the httpd task after the first frame of a client reached its socket.
+ * @param fd socket of the client.
+ * @param time_us esp_timer_get_time when the frame was sent.
+ */
+typedef void (*ws_client_first_frame_fn_t)(int fd, int64_t time_us);
+
+/**
+ * Log history replay progress of a client that is not live yet
+ */
+typedef struct ws_client_replay
+{
+	int fd;							///> Socket of the client
+	uint8_t group;					///> Filter group of the client
+	bool started;					///> False until the first ws_client_set_replay, cursor is not set yet
+	uint32_t cursor;				///> History position to continue from
+} ws_client_replay_t;
+
+/**
+ * Resets the client table for a new httpd instance.
+ * @param hd handle of the server the clients belong to, NULL once the server is stopped.
+ */
+void ws_client_init(httpd_handle_t hd);
+
+/**
+ * Sends a burst of queued frames to every client right away. The frames normally go out
+ * from httpd work items, which can not run while a handler keeps the httpd task busy.
+ * A long handler, such as a firmware upload, calls this now and then. httpd task only.
+ */
+void ws_client_pump(void);
+
+/**
+ * Starts tracking a websocket client with a subscription to every log line. Does nothing if it is already tracked.
+ * @param fd socket of the client.
+ * @param replay true to hold the client back from broadcasts until ws_client_set_replay marks it done.
+ * @return ESP_OK if the client is tracked, ESP_ERR_NO_MEM if the table is full.
+ */
+esp_err_t ws_client_add(int fd, bool replay);
+
+/**
+ * Stops tracking a client and drops its pending frames.
+ * @param fd socket of the client.
+ */
+void ws_client_remove(int fd);
+
+/**
+ * Queues a message on every tracked client. Frames reach a socket only once it has room,
+ * until then they wait in the client queue under the overflow policy. A client whose
+ * socket stays full through a whole send_wait_timeout is disconnected.
+ * @param msg message to send, each client takes its own reference.
+ */
+void ws_client_broadcast(ws_msg_t *msg);
+
+/**
+ * Queues a message on the clients of one filter group.
+ * @param msg message to send, each client takes its own reference.
+ * @param group filter group from ws_client_get_groups.
+ */
+void ws_client_broadcast_group(ws_msg_t *msg, uint8_t group);
+
+/**
+ * Queues a message on the clients subscribed to a topic.
+ * @param msg message to send, each client takes its own reference.
+ * @param topic one of the WS_CLIENT_TOPIC_ bits.
+ */
+void ws_client_broadcast_topic(ws_msg_t *msg, uint8_t topic);
+
+/**
+ * Subscribes a client to an optional topic or unsubscribes it.
+ * @param fd socket of the client.
+ * @param topic one of the WS_CLIENT_TOPIC_ bits.
+ * @param enabled true to subscribe.
+ * @return ESP_OK if applied, ESP_ERR_NOT_FOUND if the client is not tracked.
+ */
+esp_err_t ws_client_set_topic(int fd, uint8_t topic, bool enabled);
+
+/**
+ * Gets the topics at least one client subscribed to, so nothing is built for nobody.
+ * @return WS_CLIENT_TOPIC_ bit mask.
+ */
+uint8_t ws_client_get_topics(void);
+
+/**
+ * Queues a message on one client, replaying or not. The overflow policy does not apply.
+ * @param fd socket of the client.
+ * @param msg message to send, the client takes its own reference.
+ * @return ESP_OK if queued, ESP_ERR_NO_MEM if the client queue is full, ESP_ERR_NOT_FOUND if the client is not tracked.
+ */
+esp_err_t ws_client_send(int fd, ws_msg_t *msg);
+
+/**
+ * Lists the clients still replaying the log history.
+ * @param replays array receiving one entry per replaying client.
+ * @param max number of entries in replays.
+ * @return number of entries written.
+ */
+size_t ws_client_get_replays(ws_client_replay_t *replays, size_t max);
+
+/**
+ * Records the replay progress of a client.
+ * @param fd socket of the client.
+ * @param cursor history position to continue from.
+ * @param done true once the history is fully queued, the client then receives broadcasts.
+ */
+void ws_client_set_replay(int fd, uint32_t cursor, bool done);
+
+/**
+ * Changes the log subscription of a client. Clients with identical filters are put in the same group.
+ * @param fd socket of the client.
+ * @param filter new subscription.
+ * @return ESP_OK if applied, ESP_ERR_NOT_FOUND if the client is not tracked.
+ */
+esp_err_t ws_client_set_filter(int fd, const ws_filter_t *filter);
+
+/**
+ * Takes a snapshot of the filter groups in use.
+ * @param groups array of WS_CLIENT_MAX_CLIENTS filters, entry n receives the filter of group n.
+ * @return bit mask of the groups that have at least one client.
+ */
+uint32_t ws_client_get_groups(ws_filter_t *groups);
+
+/**
+ * Sets the policy applied to clients that fall behind.
+ * @param policy policy from the ws_client_overflow_policy_e enum.
+ */
+void ws_client_set_overflow_policy(ws_client_overflow_policy_e policy);
+
+/**
+ * Reads the delivery counters of every tracked client.
+ * @param stats array receiving one entry per client.
+ * @param max number of entries in stats.
+ * @return number of entries written.
+ */
+size_t ws_client_get_stats(ws_client_stats_t *stats, size_t max);
+
+/**
+ * Gets the time frames spend between being queued on a client and being handed to its socket.
+ * @return histogram of every client since boot.
+ */
+const metrics_histogram_t *ws_client_get_latency(void);
+
+/**
+ * Sets the callback told about the first frame sent to each client.
+ * @param fn callback, NULL to remove it.
+ */
+void ws_client_set_first_frame_hook(ws_client_first_frame_fn_t fn);
+
+#endif /* MAIN_WS_CLIENT_H_ */
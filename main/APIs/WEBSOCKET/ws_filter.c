@@ -0,0 +1,172 @@
+/*
+ * ws_filter.c
+ *
+ *  Created on: May 09, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <string.h>
+
+#include "ws_filter.h"
+
+uint8_t ws_filter_level_from_letter(char letter)
+{
+	switch (letter)
+	{
+		case 'E': return ESP_LOG_ERROR;
+		case 'W': return ESP_LOG_WARN;
+		case 'I': return ESP_LOG_INFO;
+		case 'D': return ESP_LOG_DEBUG;
+		case 'V': return ESP_LOG_VERBOSE;
+		default: return ESP_LOG_NONE;
+	}
+}
+
+void ws_filter_reset(ws_filter_t *filter)
+{
+	memset(filter, 0x00, sizeof(ws_filter_t));
+	filter->level = ESP_LOG_VERBOSE;
+}
+
+esp_err_t ws_filter_parse(ws_filter_t *filter, char *args)
+{
+	char *save = NULL;
+
+	ws_filter_reset(filter);
+
+	for (char *token = strtok_r(args, " ", &save); token; token = strtok_r(NULL, " ", &save))
+	{
+		if (strncmp(token, "level=", 6) == 0)
+		{
+			filter->level = ws_filter_level_from_letter(token[6]);
+			if (filter->level == ESP_LOG_NONE && token[6] != 'N')
+			{
+				return ESP_ERR_INVALID_ARG;
+			}
+		}
+		else if (strncmp(token, "tags=", 5) == 0)
+		{
+			char *tag_save = NULL;
+
+			for (char *tag = strtok_r(token + 5, ",", &tag_save); tag; tag = strtok_r(NULL, ",", &tag_save))
+			{
+				bool exclude = (*tag == '-');
+				if (*tag == '-' || *tag == '+')
+				{
+					tag++;
+				}
+
+				uint8_t *count = exclude ? &filter->exclude_count : &filter->include_count;
+				if (*count == WS_FILTER_MAX_TAGS)
+				{
+					return ESP_ERR_INVALID_SIZE;
+				}
+				(exclude ? filter->exclude : filter->include)[(*count)++] = ws_filter_tag_hash(tag);
+			}
+		}
+		else if (strcmp(token, "compress=none") == 0)
+		{
+			filter->compress = WS_FILTER_COMPRESS_NONE;
+		}
+		else if (strcmp(token, "compress=lz") == 0)
+		{
+#ifdef CONFIG_WS_LOG_COMPRESSION
+			filter->compress = WS_FILTER_COMPRESS_LZ;
+#else
+			return ESP_ERR_NOT_SUPPORTED;
+#endif
+		}
+		else
+		{
+			return ESP_ERR_INVALID_ARG;
+		}
+	}
+
+	return ESP_OK;
+}
+
+bool ws_filter_match(const ws_filter_t *filter, uint8_t level, uint32_t tag_hash)
+{
+	// Level N mutes the log stream, lines of unknown level included
+	if (level > filter->level || filter->level == ESP_LOG_NONE)
+	{
+		return false;
+	}
+
+	for (uint8_t i = 0; i < filter->exclude_count; ++i)
+	{
+		if (filter->exclude[i] == tag_hash)
+		{
+			return false;
+		}
+	}
+
+	if (filter->include_count == 0)
+	{
+		return true;
+	}
+
+	for (uint8_t i = 0; i < filter->include_count; ++i)
+	{
+		if (filter->include[i] == tag_hash)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t ws_filter_tag_hash(const char *tag)
+{
+	uint32_t hash = 2166136261UL;
+
+	while (*tag)
+	{
+		hash ^= (uint8_t)*tag++;
+		hash *= 16777619UL;
+	}
+
+	// 0 is reserved for lines without a tag
+	return hash ? hash : 1;
+}
+
+void ws_filter_classify(const char *format, va_list args, uint8_t *level, uint32_t *tag_hash)
+{
+	const char *p = format;
+
+	*level = ESP_LOG_NONE;
+	*tag_hash = 0;
+
+	// Skip the LOG_COLOR escape sequence, if any
+	if (p[0] == '\033' && p[1] == '[')
+	{
+		p = strchr(p, 'm');
+		if (p == NULL)
+		{
+			return;
+		}
+		p++;
+	}
+
+	// LOG_FORMAT is "<letter> (<timestamp>) %s: ..." with the timestamp and tag as first arguments
+	uint8_t letter_level = ws_filter_level_from_letter(p[0]);
+	if (letter_level == ESP_LOG_NONE || strncmp(&p[1], " (%", 3) != 0)
+	{
+		return;
+	}
+
+	const char *close = strchr(&p[4], ')');
+	if (close == NULL || strncmp(close, ") %s: ", 6) != 0)
+	{
+		return;
+	}
+
+	va_list tag_args;
+	va_copy(tag_args, args);
+	(void)va_arg(tag_args, unsigned int);
+	const char *tag = va_arg(tag_args, const char *);
+	va_end(tag_args);
+
+	*level = letter_level;
+	*tag_hash = tag ? ws_filter_tag_hash(tag) : 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * ws_filter.h
+ *
+ *  Created on: May 09, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_WS_FILTER_H_
+#define MAIN_WS_FILTER_H_
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+// Tags a client can list in each of its include and exclude lists
+#define WS_FILTER_MAX_TAGS			8
+
+// Frame encodings a client can subscribe with
+#define WS_FILTER_COMPRESS_NONE		0
+#define WS_FILTER_COMPRESS_LZ		1		// Binary frames from log_lz.h
+
+/**
+ * Log subscription of a websocket client.
+ * Tags are kept as hashes so the fan-out path only compares integers.
+ */
+typedef struct ws_filter
+{
+	uint8_t level;							///> Most verbose esp_log_level_t forwarded
+	uint8_t include_count;					///> 0 forwards every tag not excluded
+	uint8_t exclude_count;
+	uint8_t compress;						///> WS_FILTER_COMPRESS_NONE or WS_FILTER_COMPRESS_LZ
+	uint32_t include[WS_FILTER_MAX_TAGS];
+	uint32_t exclude[WS_FILTER_MAX_TAGS];
+} ws_filter_t;
+
+/**
+ * Sets a filter that forwards everything.
+ * @param filter filter to reset.
+ */
+void ws_filter_reset(ws_filter_t *filter);
+
+/**
+ * Parses a subscription, e.g. "level=W tags=[WIFI_APP],-[http_server] compress=lz".
+ * level takes E, W, I, D or V, or N for no log lines at all. Tags prefixed with '-' are excluded, the others included.
+ * compress takes none or lz.
+ * @param filter filter to fill, reset first.
+ * @param args subscription arguments, modified in place.
+ * @return ESP_OK if parsed, ESP_ERR_INVALID_ARG on an unknown key or value, ESP_ERR_INVALID_SIZE on too many tags,
+ * ESP_ERR_NOT_SUPPORTED if compression is disabled in menuconfig.
+ */
+esp_err_t ws_filter_parse(ws_filter_t *filter, char *args);
+
+/**
+ * Maps a level letter as used by LOG_FORMAT to esp_log_level_t.
+ * @param letter E, W, I, D or V.
+ * @return the level, ESP_LOG_NONE if the letter is unknown.
+ */
+uint8_t ws_filter_level_from_letter(char letter);
+
+/**
+ * Checks a log line against a filter.
+ * @param filter filter to apply.
+ * @param level esp_log_level_t of the line, ESP_LOG_NONE if unknown.
+ * @param tag_hash ws_filter_tag_hash of the line tag, 0 if unknown.
+ * @return true if the line should be forwarded.
+ */
+bool ws_filter_match(const ws_filter_t *filter, uint8_t level, uint32_t tag_hash);
+
+/**
+ * Hashes a log tag (FNV-1a).
+ * @param tag tag string.
+ * @return hash, never 0.
+ */
+uint32_t ws_filter_tag_hash(const char *tag);
+
+/**
+ * Extracts level and tag from an ESP_LOGx call as seen by the esp_log vprintf hook.
+ * @param format format string, expected to follow LOG_FORMAT from esp_log.h.
+ * @param args format arguments, not consumed.
+ * @param level set to the esp_log_level_t of the line, ESP_LOG_NONE if the format is not recognised.
+ * @param tag_hash set to the tag hash, 0 if the format is not recognised.
+ */
+void ws_filter_classify(const char *format, va_list args, uint8_t *level, uint32_t *tag_hash);
+
+#endif /* MAIN_WS_FILTER_H_ */
@@ -0,0 +1,55 @@
+/*
+ * ws_msg.c
+ *
+ *  Created on: Apr 27, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ws_msg.h"
+
+ws_msg_t *ws_msg_alloc(size_t len, httpd_ws_type_t type)
+{
+	ws_msg_t *msg = malloc(sizeof(ws_msg_t) + len);
+	if (msg == NULL)
+	{
+		return NULL;
+	}
+
+	atomic_init(&msg->refs, 1);
+
+	memset(&msg->frame, 0x00, sizeof(httpd_ws_frame_t));
+	msg->frame.final = true;
+	msg->frame.type = type;
+	msg->frame.payload = msg->payload;
+	msg->frame.len = len;
+
+	return msg;
+}
+
+ws_msg_t *ws_msg_create(const void *data, size_t len, httpd_ws_type_t type)
+{
+	ws_msg_t *msg = ws_msg_alloc(len, type);
+
+	if (msg)
+	{
+		memcpy(msg->payload, data, len);
+	}
+	return msg;
+}
+
+ws_msg_t *ws_msg_ref(ws_msg_t *msg)
+{
+	atomic_fetch_add_explicit(&msg->refs, 1, memory_order_relaxed);
+	return msg;
+}
+
+void ws_msg_unref(ws_msg_t *msg)
+{
+	if (msg && atomic_fetch_sub_explicit(&msg->refs, 1, memory_order_acq_rel) == 1)
+	{
+		free(msg);
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ * ws_msg.h
+ *
+ *  Created on: Apr 27, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_WS_MSG_H_
+#define MAIN_WS_MSG_H_
+
+#include <stdatomic.h>
+
+#include "esp_http_server.h"
+
+/**
+ * Immutable, reference counted websocket message.
+ *
+ * The frame is built once when the message is created and shared by every client
+ * send. The payload lives in the same allocation and is released together with the
+ * message when the last reference is dropped.
+ */
+typedef struct ws_msg
+{
+	_Atomic uint32_t refs;
+	httpd_ws_frame_t frame;			///> Ready to pass to httpd_ws_send_frame_async, do not modify
+	uint8_t payload[];
+} ws_msg_t;
+
+/**
+ * Allocates a message whose payload the caller fills in before sharing it, with one reference owned by the caller.
+ * @param len payload length in bytes.
+ * @param type websocket frame type.
+ * @return the new message, or NULL if out of memory.
+ */
+ws_msg_t *ws_msg_alloc(size_t len, httpd_ws_type_t type);
+
+/**
+ * Creates a message holding a copy of the payload, with one reference owned by the caller.
+ * @param data payload to copy.
+ * @param len payload length in bytes.
+ * @param type websocket frame type.
+ * @return the new message, or NULL if out of memory.
+ */
+ws_msg_t *ws_msg_create(const void *data, size_t len, httpd_ws_type_t type);
+
+/**
+ * Takes an extra reference on a message.
+ * @param msg message to reference.
+ * @return msg, for convenience.
+ */
+ws_msg_t *ws_msg_ref(ws_msg_t *msg);
+
+/**
+ * Drops a reference, freeing the message when it was the last one.
+ * @param msg message to release, NULL is ignored.
+ */
+void ws_msg_unref(ws_msg_t *msg);
+
+#endif /* MAIN_WS_MSG_H_ */
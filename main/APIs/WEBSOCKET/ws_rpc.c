@@ -0,0 +1,133 @@
+/*
+ * ws_rpc.c
+ *
+ *  Created on: May 4, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "ws_rpc.h"
+
+static const char TAG[] = "[ws_rpc]";
+
+// Only written from the httpd task, where every command runs
+static ws_rpc_stats_t ws_rpc_stats;
+
+char *ws_rpc_next_token(char **cursor)
+{
+	char *start = *cursor;
+
+	while (*start == ' ')
+	{
+		start++;
+	}
+
+	if (*start == '\0')
+	{
+		*cursor = start;
+		return NULL;
+	}
+
+	char *end = start;
+	while (*end != ' ' && *end != '\0')
+	{
+		end++;
+	}
+
+	if (*end == ' ')
+	{
+		*end++ = '\0';
+	}
+	*cursor = end;
+
+	return start;
+}
+
+/**
+ * Finds a command in a route table.
+ * @param routes route table.
+ * @param count number of routes.
+ * @param name command name.
+ * @return the route, or NULL if the command is unknown.
+ */
+static const ws_rpc_route_t *ws_rpc_find(const ws_rpc_route_t *routes, size_t count, const char *name)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (strcmp(routes[i].name, name) == 0)
+		{
+			return &routes[i];
+		}
+	}
+	return NULL;
+}
+
+esp_err_t ws_rpc_dispatch(const ws_rpc_route_t *routes, size_t count, httpd_req_t *req, char *msg, int64_t arrival)
+{
+	char text[WS_RPC_REPLY_MAX_LEN] = "";
+	char reply[WS_RPC_ID_MAX_LEN + sizeof(" err ") + WS_RPC_REPLY_MAX_LEN];
+	const char *id = "0";
+	char *cursor = msg;
+	esp_err_t err;
+
+	char *name = ws_rpc_next_token(&cursor);
+	if (name && isdigit((unsigned char)name[0]))
+	{
+		id = name;
+		name = ws_rpc_next_token(&cursor);
+	}
+
+	const ws_rpc_route_t *route = name ? ws_rpc_find(routes, count, name) : NULL;
+	if (route)
+	{
+		err = route->handler(req, cursor, text, sizeof(text));
+	}
+	else
+	{
+		err = ESP_ERR_NOT_SUPPORTED;
+		snprintf(text, sizeof(text), "unknown command %s", name ? name : "");
+	}
+
+	if (err != ESP_OK && text[0] == '\0')
+	{
+		snprintf(text, sizeof(text), "%s", esp_err_to_name(err));
+	}
+
+	httpd_ws_frame_t ws_pkt;
+	memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
+	ws_pkt.payload = (uint8_t *)reply;
+	ws_pkt.len = snprintf(reply, sizeof(reply), "%.*s %s%s%s", WS_RPC_ID_MAX_LEN, id,
+			err == ESP_OK ? "ok" : "err", text[0] ? " " : "", text);
+	ws_pkt.len = ws_pkt.len < sizeof(reply) ? ws_pkt.len : sizeof(reply) - 1;
+	ws_pkt.type = HTTPD_WS_TYPE_TEXT;
+
+	esp_err_t sent = httpd_ws_send_frame(req, &ws_pkt);
+
+	uint32_t latency = esp_timer_get_time() - arrival;
+	ws_rpc_stats.requests++;
+	ws_rpc_stats.errors += (err != ESP_OK);
+	ws_rpc_stats.last_us = latency;
+	ws_rpc_stats.total_us += latency;
+	if (latency > ws_rpc_stats.max_us)
+	{
+		ws_rpc_stats.max_us = latency;
+	}
+
+	// Only the id and command name, arguments may carry credentials
+	ESP_LOGI(TAG, "%s %s: %s in %u us", id, route ? route->name : "unknown", esp_err_to_name(err), latency);
+
+	return sent;
+}
+
+void ws_rpc_get_stats(ws_rpc_stats_t *stats)
+{
+	*stats = ws_rpc_stats;
+}
@@ -0,0 +1,78 @@
+/*
+ * ws_rpc.h
+ *
+ *  Created on: May 4, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_WS_RPC_H_
+#define MAIN_WS_RPC_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Longest reply text a command can write, the id and status are added on top
+#define WS_RPC_REPLY_MAX_LEN			256
+
+// Longest request id echoed back in the reply
+#define WS_RPC_ID_MAX_LEN				15
+
+/**
+ * Runs one command.
+ * @param req websocket request the command arrived on.
+ * @param args text following the command name, modified in place.
+ * @param reply buffer for the reply text, empty on entry.
+ * @param reply_len size of reply.
+ * @return ESP_OK to answer "ok", any other value to answer "err".
+ */
+typedef esp_err_t (*ws_rpc_handler_t)(httpd_req_t *req, char *args, char *reply, size_t reply_len);
+
+/**
+ * Entry of a route table
+ */
+typedef struct ws_rpc_route
+{
+	const char *name;
+	ws_rpc_handler_t handler;
+} ws_rpc_route_t;
+
+/**
+ * Command counters and frame-to-reply latency
+ */
+typedef struct ws_rpc_stats
+{
+	uint32_t requests;				///> Commands answered
+	uint32_t errors;				///> Commands answered with "err", unknown ones included
+	uint32_t last_us;				///> Latency of the latest command
+	uint32_t max_us;				///> Worst latency seen
+	uint64_t total_us;				///> Sum of all latencies, divide by requests for the mean
+} ws_rpc_stats_t;
+
+/**
+ * Splits the next space separated token off a string, in place.
+ * @param cursor position to scan from, moved past the token.
+ * @return the NUL terminated token, or NULL if only spaces are left.
+ */
+char *ws_rpc_next_token(char **cursor);
+
+/**
+ * Runs a "[<id>] <command> [args]" message against a route table and sends "<id> ok|err <text>" back.
+ * The id is any token starting with a digit, messages without one are answered with id 0.
+ * @param routes route table.
+ * @param count number of routes.
+ * @param req websocket request the message arrived on.
+ * @param msg NUL terminated message, modified in place.
+ * @param arrival esp_timer_get_time when the frame arrived, used for the latency counters.
+ * @return the result of sending the reply.
+ */
+esp_err_t ws_rpc_dispatch(const ws_rpc_route_t *routes, size_t count, httpd_req_t *req, char *msg, int64_t arrival);
+
+/**
+ * Reads the command counters.
+ * @param stats receives the counters.
+ */
+void ws_rpc_get_stats(ws_rpc_stats_t *stats);
+
+#endif /* MAIN_WS_RPC_H_ */
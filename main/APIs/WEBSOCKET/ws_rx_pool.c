@@ -0,0 +1,130 @@
+/*
+ * ws_rx_pool.c
+ *
+ *  Created on: May 2, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <stdatomic.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "sys/param.h"
+
+#include "ws_rx_pool.h"
+
+static const char TAG[] = "[ws_rx_pool]";
+
+// The mask key restarts at every httpd_ws_recv_frame call, chunks keep it in phase by staying a multiple of 4
+#define WS_RX_POOL_CHUNK_SIZE		(WS_RX_POOL_SLOT_SIZE & ~3U)
+
+static uint8_t ws_rx_pool_buff[WS_RX_POOL_SLOTS][WS_RX_POOL_SLOT_SIZE] __attribute__((aligned(4)));
+
+// Bit n set while buffer n is taken
+static _Atomic uint32_t ws_rx_pool_busy = 0;
+
+static _Atomic uint32_t ws_rx_pool_high_water = 0;
+static _Atomic uint32_t ws_rx_pool_exhausted = 0;
+static _Atomic uint32_t ws_rx_pool_buffered_frames = 0;
+static _Atomic uint32_t ws_rx_pool_streamed_frames = 0;
+static _Atomic uint32_t ws_rx_pool_streamed_bytes = 0;
+
+uint8_t *ws_rx_pool_take(void)
+{
+	uint32_t busy = atomic_load_explicit(&ws_rx_pool_busy, memory_order_relaxed);
+	uint32_t slot;
+
+	do
+	{
+		for (slot = 0; slot < WS_RX_POOL_SLOTS && (busy & (1UL << slot)); ++slot);
+
+		if (slot == WS_RX_POOL_SLOTS)
+		{
+			atomic_fetch_add_explicit(&ws_rx_pool_exhausted, 1, memory_order_relaxed);
+			ESP_LOGW(TAG, "ws_rx_pool_take: all %d buffers in use", WS_RX_POOL_SLOTS);
+			return NULL;
+		}
+	} while (!atomic_compare_exchange_weak_explicit(&ws_rx_pool_busy, &busy, busy | (1UL << slot),
+			memory_order_acquire, memory_order_relaxed));
+
+	uint32_t in_use = __builtin_popcount(busy) + 1;
+	uint32_t high_water = atomic_load_explicit(&ws_rx_pool_high_water, memory_order_relaxed);
+	while (in_use > high_water && !atomic_compare_exchange_weak_explicit(&ws_rx_pool_high_water, &high_water, in_use,
+			memory_order_relaxed, memory_order_relaxed));
+
+	return ws_rx_pool_buff[slot];
+}
+
+void ws_rx_pool_give(uint8_t *buf)
+{
+	if (buf == NULL)
+	{
+		return;
+	}
+
+	uint32_t slot = (buf - &ws_rx_pool_buff[0][0]) / WS_RX_POOL_SLOT_SIZE;
+	atomic_fetch_and_explicit(&ws_rx_pool_busy, ~(1UL << slot), memory_order_release);
+}
+
+esp_err_t ws_rx_pool_recv(httpd_req_t *req, httpd_ws_frame_t *frame, uint8_t *buf)
+{
+	// One byte is kept for the terminator
+	if (frame->len >= WS_RX_POOL_SLOT_SIZE)
+	{
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	frame->payload = buf;
+	esp_err_t err = httpd_ws_recv_frame(req, frame, WS_RX_POOL_SLOT_SIZE - 1);
+	if (err == ESP_OK)
+	{
+		buf[frame->len] = '\0';
+		atomic_fetch_add_explicit(&ws_rx_pool_buffered_frames, 1, memory_order_relaxed);
+	}
+
+	return err;
+}
+
+esp_err_t ws_rx_pool_stream(httpd_req_t *req, httpd_ws_frame_t *frame, uint8_t *buf, ws_rx_chunk_cb_t cb)
+{
+	const size_t total = frame->len;
+	httpd_ws_frame_t whole = *frame;
+	esp_err_t err = ESP_OK;
+
+	whole.payload = NULL;
+	atomic_fetch_add_explicit(&ws_rx_pool_streamed_frames, 1, memory_order_relaxed);
+
+	for (size_t offset = 0; offset < total && err == ESP_OK;)
+	{
+		// A non-zero len makes httpd read just that many payload bytes
+		size_t chunk = MIN(total - offset, WS_RX_POOL_CHUNK_SIZE);
+		frame->payload = buf;
+		frame->len = chunk;
+
+		err = httpd_ws_recv_frame(req, frame, chunk);
+		if (err == ESP_OK)
+		{
+			atomic_fetch_add_explicit(&ws_rx_pool_streamed_bytes, chunk, memory_order_relaxed);
+			err = cb(req, &whole, buf, chunk, offset);
+			offset += chunk;
+		}
+	}
+
+	frame->payload = NULL;
+	frame->len = total;
+
+	return err;
+}
+
+void ws_rx_pool_get_stats(ws_rx_pool_stats_t *stats)
+{
+	stats->slots = WS_RX_POOL_SLOTS;
+	stats->slot_size = WS_RX_POOL_SLOT_SIZE;
+	stats->in_use = __builtin_popcount(atomic_load_explicit(&ws_rx_pool_busy, memory_order_relaxed));
+	stats->high_water = atomic_load_explicit(&ws_rx_pool_high_water, memory_order_relaxed);
+	stats->exhausted = atomic_load_explicit(&ws_rx_pool_exhausted, memory_order_relaxed);
+	stats->buffered_frames = atomic_load_explicit(&ws_rx_pool_buffered_frames, memory_order_relaxed);
+	stats->streamed_frames = atomic_load_explicit(&ws_rx_pool_streamed_frames, memory_order_relaxed);
+	stats->streamed_bytes = atomic_load_explicit(&ws_rx_pool_streamed_bytes, memory_order_relaxed);
+}
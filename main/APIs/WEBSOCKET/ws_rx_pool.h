@@ -0,0 +1,85 @@
+/*
+ * ws_rx_pool.h
+ *
+ *  Created on: May 2, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_WS_RX_POOL_H_
+#define MAIN_WS_RX_POOL_H_
+
+#include <stdint.h>
+
+#include "esp_http_server.h"
+
+// Receive buffers available to the websocket handler
+#define WS_RX_POOL_SLOTS				CONFIG_WS_RX_POOL_SLOTS
+
+// Bytes in each receive buffer, frames this long or longer are streamed in chunks
+#define WS_RX_POOL_SLOT_SIZE			CONFIG_WS_RX_POOL_SLOT_SIZE
+
+/**
+ * Receives one chunk of a streamed frame.
+ * @param req websocket request the frame arrived on.
+ * @param frame frame being streamed, len holds the total payload length.
+ * @param chunk unmasked payload bytes.
+ * @param len number of bytes in chunk.
+ * @param offset position of chunk within the payload.
+ * @return ESP_OK to keep streaming, any other value aborts the frame and closes the session.
+ */
+typedef esp_err_t (*ws_rx_chunk_cb_t)(httpd_req_t *req, const httpd_ws_frame_t *frame,
+		const uint8_t *chunk, size_t len, size_t offset);
+
+/**
+ * Receive buffer pool usage
+ */
+typedef struct ws_rx_pool_stats
+{
+	uint32_t slots;					///> Buffers in the pool
+	uint32_t slot_size;				///> Bytes per buffer
+	uint32_t in_use;				///> Buffers currently taken
+	uint32_t high_water;			///> Most buffers ever taken at once
+	uint32_t exhausted;				///> Takes refused because every buffer was in use
+	uint32_t buffered_frames;		///> Frames received whole into a buffer
+	uint32_t streamed_frames;		///> Frames handed to a chunk callback
+	uint32_t streamed_bytes;		///> Payload bytes handed to a chunk callback
+} ws_rx_pool_stats_t;
+
+/**
+ * Takes a free receive buffer. Never allocates.
+ * @return a buffer of WS_RX_POOL_SLOT_SIZE bytes, or NULL if every buffer is in use.
+ */
+uint8_t *ws_rx_pool_take(void);
+
+/**
+ * Returns a buffer to the pool.
+ * @param buf buffer from ws_rx_pool_take, NULL is ignored.
+ */
+void ws_rx_pool_give(uint8_t *buf);
+
+/**
+ * Receives a frame shorter than WS_RX_POOL_SLOT_SIZE into a buffer and NUL terminates it.
+ * @param req websocket request the frame arrived on.
+ * @param frame frame whose length was read with httpd_ws_recv_frame, payload is set to buf.
+ * @param buf buffer from ws_rx_pool_take.
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the frame does not fit, or the httpd error.
+ */
+esp_err_t ws_rx_pool_recv(httpd_req_t *req, httpd_ws_frame_t *frame, uint8_t *buf);
+
+/**
+ * Receives a frame of any length in buffer sized chunks.
+ * @param req websocket request the frame arrived on.
+ * @param frame frame whose length was read with httpd_ws_recv_frame.
+ * @param buf buffer from ws_rx_pool_take, used for every chunk.
+ * @param cb called once per chunk, in order.
+ * @return ESP_OK once the whole payload was delivered, the first error otherwise.
+ */
+esp_err_t ws_rx_pool_stream(httpd_req_t *req, httpd_ws_frame_t *frame, uint8_t *buf, ws_rx_chunk_cb_t cb);
+
+/**
+ * Reads the pool usage counters.
+ * @param stats receives the counters.
+ */
+void ws_rx_pool_get_stats(ws_rx_pool_stats_t *stats);
+
+#endif /* MAIN_WS_RX_POOL_H_ */
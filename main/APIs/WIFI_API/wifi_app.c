@@ -8,10 +8,13 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "lwip/netdb.h"
 
@@ -27,6 +30,8 @@
 #include "app_nvs.h"
 #endif
 
+#include "task_topology.h"
+
 
 #define WIFI_DEBUG_ENABLE
 #ifndef WIFI_DEBUG_ENABLE
@@ -40,8 +45,81 @@
 // Used for returning the WiFi configuration
 wifi_config_t *wifi_config = NULL;
 
-// Used to track the number for retries when a connection attempt fails
-static int g_retry_number;
+/**
+ * Station credentials handed over by wifi_app_request_connect, applied by the WiFi task
+ */
+typedef struct wifi_app_staged_creds
+{
+	bool pending;						///> Set by a request, cleared once copied into wifi_config
+	uint8_t ssid[MAX_SSID_LENGTH];
+	uint8_t password[MAX_PASSWORD_LENGTH];
+} wifi_app_staged_creds_t;
+
+// Guarded by wifi_app_staged_lock, so wifi_config itself is only written on the WiFi task
+static wifi_app_staged_creds_t wifi_app_staged;
+static SemaphoreHandle_t wifi_app_staged_lock;
+
+// Reconnects scheduled since the link was lost, 0 while connected
+static uint32_t wifi_app_reconnect_attempt;
+
+// esp_timer time of the first disconnect of the current outage
+static int64_t wifi_app_outage_us;
+
+// One shot timer posting WIFI_APP_MSG_RECONNECT
+static esp_timer_handle_t wifi_app_reconnect_timer;
+
+/**
+ * Reconnect policy for a group of disconnect reasons
+ */
+typedef struct wifi_app_backoff_policy
+{
+	const char *name;
+	uint32_t scale;						///> Multiplies WIFI_RECONNECT_MIN_MS for the first delay
+} wifi_app_backoff_policy_t;
+
+// Link lost with a reachable network: beacon timeouts, deauths, AP reboots
+static const wifi_app_backoff_policy_t wifi_app_backoff_link = { "link lost", 1 };
+
+// The access point is not on the air, nothing to gain from scanning often
+static const wifi_app_backoff_policy_t wifi_app_backoff_no_ap = { "no AP", 4 };
+
+// Credentials rejected, most likely wrong until someone fixes them
+static const wifi_app_backoff_policy_t wifi_app_backoff_auth = { "auth", 32 };
+
+// esp_timer time at the top of app_main
+static int64_t wifi_app_start_us;
+
+// esp_timer time of the latest connect
+static int64_t wifi_app_connect_us;
+
+// True while the station configuration is pinned to the saved access point
+static bool wifi_app_fast_connect;
+
+#ifdef NVS_ENABLE
+/**
+ * Saved network seen by the latest scan
+ */
+typedef struct wifi_app_candidate
+{
+	uint8_t network;					///> Index in the saved networks
+	uint8_t bssid[6];					///> Strongest access point of the network
+	uint8_t channel;
+	int16_t score;						///> RSSI plus the recency bonus
+} wifi_app_candidate_t;
+
+// Candidates of the latest scan, best first, and the next one to try
+static wifi_app_candidate_t wifi_app_candidates[APP_NVS_MAX_NETWORKS];
+static uint8_t wifi_app_candidate_count;
+static uint8_t wifi_app_candidate_next;
+
+// Records of the latest scan, only read on the WiFi task so one buffer serves every scan
+static wifi_ap_record_t wifi_app_scan_records[WIFI_SCAN_MAX_RECORDS];
+
+// True while a scan started by wifi_app_scan_start runs
+static bool wifi_app_scanning;
+#endif
+
+static wifi_app_stats_t wifi_app_stats = { .got_ip_us = -1 };
 
 /**
  * Wifi application event group handle and status bits
@@ -52,8 +130,24 @@ const int WIFI_APP_CONNECTING_FROM_HTTP_SERVER_BIT			= BIT1;
 const int WIFI_APP_USER_REQUESTED_STA_DISCONNECT_BIT		= BIT2;
 const int WIFI_APP_STA_CONNECTED_GOT_IP_BIT					= BIT3;
 
-// Queue handle used to manipulate the main queue of events
-static QueueHandle_t wifi_app_queue_handle;
+// Events for the WiFi application task
+static event_bus_t wifi_app_bus;
+
+/**
+ * Payload of WIFI_APP_MSG_STA_DISCONNECTED
+ */
+typedef struct wifi_app_disconnected_event
+{
+	uint8_t reason;						///> wifi_err_reason_t
+} wifi_app_disconnected_event_t;
+
+/**
+ * Payload of WIFI_APP_MSG_STA_CONNECTED_GOT_IP
+ */
+typedef struct wifi_app_got_ip_event
+{
+	int64_t time_us;					///> Taken in the event handler, the queue adds its own delay
+} wifi_app_got_ip_event_t;
 
 // netif objects for the station and access point
 esp_netif_t* esp_netif_sta = NULL;
@@ -83,17 +177,22 @@ static void wifi_app_event_handler(void *arg, esp_event_base_t event_base, int32
 			case WIFI_EVENT_AP_STACONNECTED:
 				WIFI_DEBUG("WIFI_EVENT_AP_STACONNECTED");
 				#ifdef HTTP_SERVER_ENABLE
-				http_server_start();
+				http_server_acquire(HTTP_SERVER_USER_AP);
 				#endif
 				break;
 
 			case WIFI_EVENT_AP_STADISCONNECTED:
 				WIFI_DEBUG("WIFI_EVENT_AP_STADISCONNECTED");
 				#ifdef HTTP_SERVER_ENABLE
-				http_server_stop();
+				http_server_release(HTTP_SERVER_USER_AP);
 				#endif
 				break;
 
+			case WIFI_EVENT_SCAN_DONE:
+				WIFI_DEBUG("WIFI_EVENT_SCAN_DONE");
+				wifi_app_send_message(WIFI_APP_MSG_SCAN_DONE);
+				break;
+
 			case WIFI_EVENT_STA_START:
 				WIFI_DEBUG("WIFI_EVENT_STA_START");
 				break;
@@ -105,10 +204,9 @@ static void wifi_app_event_handler(void *arg, esp_event_base_t event_base, int32
 			case WIFI_EVENT_STA_DISCONNECTED:
 				WIFI_DEBUG("WIFI_EVENT_STA_DISCONNECTED");
 
-				wifi_event_sta_disconnected_t *wifi_event_sta_disconnected = (wifi_event_sta_disconnected_t*)malloc(sizeof(wifi_event_sta_disconnected_t));
-				*wifi_event_sta_disconnected = *((wifi_event_sta_disconnected_t*)event_data);
-				printf("WIFI_EVENT_STA_DISCONNECTED, reason code %d\n", wifi_event_sta_disconnected->reason);
-				wifi_app_send_message(WIFI_APP_MSG_STA_DISCONNECTED);
+				wifi_app_disconnected_event_t disconnected = { .reason = ((wifi_event_sta_disconnected_t*)event_data)->reason };
+				WIFI_DEBUG("WIFI_EVENT_STA_DISCONNECTED, reason code %d", disconnected.reason);
+				event_bus_post(&wifi_app_bus, WIFI_APP_MSG_STA_DISCONNECTED, EVENT_BUS_PRIORITY_HIGH, &disconnected, sizeof(disconnected));
 
 				break;
 		}
@@ -120,7 +218,8 @@ static void wifi_app_event_handler(void *arg, esp_event_base_t event_base, int32
 			case IP_EVENT_STA_GOT_IP:
 				WIFI_DEBUG("IP_EVENT_STA_GOT_IP");
 
-				wifi_app_send_message(WIFI_APP_MSG_STA_CONNECTED_GOT_IP);
+				wifi_app_got_ip_event_t got_ip = { .time_us = esp_timer_get_time() };
+				event_bus_post(&wifi_app_bus, WIFI_APP_MSG_STA_CONNECTED_GOT_IP, EVENT_BUS_PRIORITY_HIGH, &got_ip, sizeof(got_ip));
 
 				break;
 		}
@@ -152,7 +251,7 @@ static void wifi_app_default_wifi_init(void)
 
 	// Default WiFi config - operations must be in this order!
 	wifi_init_config_t wifi_init_config = WIFI_INIT_CONFIG_DEFAULT();
-	wifi_init_config.wifi_task_core_id = WIFI_APP_TASK_CORE_ID;
+	wifi_init_config.wifi_task_core_id = task_topology_get(TASK_TOPOLOGY_WIFI_APP).core_id;
 	ESP_ERROR_CHECK(esp_wifi_init(&wifi_init_config));
 	ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
 	esp_netif_sta = esp_netif_create_default_wifi_sta();
@@ -199,8 +298,9 @@ static void wifi_app_soft_ap_config(void)
 
 /**
  * Connects the ESP32 to an external AP using the updated station configuration
+ * @return true if an attempt started, false if the station is already connected.
  */
-void wifi_app_connect_sta(void)
+bool wifi_app_connect_sta(void)
 {
 	WIFI_DEBUG("%s", __FUNCTION__);
 
@@ -209,10 +309,13 @@ void wifi_app_connect_sta(void)
 
 	if(err == ESP_ERR_WIFI_NOT_CONNECT)
 	{
+		wifi_app_connect_us = esp_timer_get_time();
 		ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, wifi_app_get_wifi_config()));
 		ESP_ERROR_CHECK(esp_wifi_connect());
+		return true;
 	}
 
+	return false;
 }
 
 void wifi_app_disconnect_sta(void){
@@ -234,6 +337,328 @@ void wifi_app_disconnect_sta(void){
 
 	//nfc_available_event_set(SAS_NFC_CHECK_IN, "AD467906");	
 
+/**
+ * Picks the reconnect policy for a disconnect reason.
+ * @param reason wifi_err_reason_t from the disconnect event.
+ * @return the policy.
+ */
+static const wifi_app_backoff_policy_t *wifi_app_backoff_policy(uint8_t reason)
+{
+	switch (reason)
+	{
+		case WIFI_REASON_AUTH_FAIL:
+		case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
+		case WIFI_REASON_HANDSHAKE_TIMEOUT:
+		case WIFI_REASON_802_1X_AUTH_FAILED:
+			return &wifi_app_backoff_auth;
+
+		case WIFI_REASON_NO_AP_FOUND:
+			return &wifi_app_backoff_no_ap;
+
+		default:
+			return &wifi_app_backoff_link;
+	}
+}
+
+/**
+ * Posts WIFI_APP_MSG_RECONNECT, runs in the esp_timer task.
+ * @param arg unused.
+ */
+static void wifi_app_reconnect_timer_cb(void *arg)
+{
+	// Try again shortly if the queue is full
+	if (wifi_app_send_message(WIFI_APP_MSG_RECONNECT) != pdTRUE)
+	{
+		esp_timer_start_once(wifi_app_reconnect_timer, 100 * 1000);
+	}
+}
+
+/**
+ * Schedules the next reconnect after a failed attempt or a lost link.
+ * The delay doubles from the policy's first delay up to WIFI_RECONNECT_MAX_MS and is
+ * drawn between half and all of that, so devices dropped together do not retry together.
+ * @param reason wifi_err_reason_t of the disconnect.
+ */
+static void wifi_app_reconnect_schedule(uint8_t reason)
+{
+	const wifi_app_backoff_policy_t *policy = wifi_app_backoff_policy(reason);
+	wifi_sta_list_t ap_stations;
+	uint32_t delay_ms = WIFI_RECONNECT_MAX_MS;
+
+	if (wifi_app_reconnect_attempt == 0)
+	{
+		wifi_app_outage_us = esp_timer_get_time();
+	}
+
+	// Stop doubling once the cap is reached, the shift would overflow
+	uint64_t base_ms = (uint64_t)WIFI_RECONNECT_MIN_MS * policy->scale;
+	if (wifi_app_reconnect_attempt < 32 && (base_ms << wifi_app_reconnect_attempt) < WIFI_RECONNECT_MAX_MS)
+	{
+		delay_ms = base_ms << wifi_app_reconnect_attempt;
+	}
+	delay_ms = delay_ms / 2 + esp_random() % (delay_ms / 2 + 1);
+
+	if (delay_ms < WIFI_RECONNECT_AP_BUSY_MS && esp_wifi_ap_get_sta_list(&ap_stations) == ESP_OK && ap_stations.num > 0)
+	{
+		delay_ms = WIFI_RECONNECT_AP_BUSY_MS;
+	}
+
+	wifi_app_reconnect_attempt++;
+	wifi_app_stats.backoff_ms = delay_ms;
+	wifi_app_stats.last_reason = reason;
+	WIFI_DEBUG("Reconnect %u in %u ms (%s, reason %u)", wifi_app_reconnect_attempt, delay_ms, policy->name, reason);
+
+	esp_timer_stop(wifi_app_reconnect_timer);
+	esp_timer_start_once(wifi_app_reconnect_timer, (uint64_t)delay_ms * 1000);
+}
+
+/**
+ * Drops the pending reconnect and starts the next outage from the first delay.
+ */
+static void wifi_app_reconnect_cancel(void)
+{
+	esp_timer_stop(wifi_app_reconnect_timer);
+	wifi_app_reconnect_attempt = 0;
+	wifi_app_stats.backoff_ms = 0;
+}
+
+#ifdef NVS_ENABLE
+/**
+ * Pins the station configuration to the access point saved with the credentials, so the
+ * connect probes its channel instead of scanning all of them, and reuses the saved lease
+ * instead of running DHCP when CONFIG_WS_WIFI_REUSE_IP is set.
+ * @return true if the saved link was applied.
+ */
+static bool wifi_app_fast_connect_apply(void)
+{
+#ifdef CONFIG_WS_WIFI_FAST_RECONNECT
+	app_nvs_link_t link;
+	wifi_config_t *config = wifi_app_get_wifi_config();
+
+	if (!app_nvs_load_sta_link(&link))
+	{
+		return false;
+	}
+
+	memcpy(config->sta.bssid, link.bssid, sizeof(config->sta.bssid));
+	config->sta.bssid_set = true;
+	config->sta.channel = link.channel;
+
+#ifdef CONFIG_WS_WIFI_REUSE_IP
+	if (link.flags & APP_NVS_LINK_IP)
+	{
+		esp_netif_ip_info_t ip_info = { .ip.addr = link.ip, .netmask.addr = link.netmask, .gw.addr = link.gw };
+		esp_netif_dns_info_t dns_info;
+
+		memset(&dns_info, 0x00, sizeof(dns_info));
+		dns_info.ip.u_addr.ip4.addr = link.dns;
+		dns_info.ip.type = ESP_IPADDR_TYPE_V4;
+
+		// With the DHCP client stopped the netif reports the address as soon as the link is up
+		esp_netif_dhcpc_stop(esp_netif_sta);
+		esp_netif_set_ip_info(esp_netif_sta, &ip_info);
+		esp_netif_set_dns_info(esp_netif_sta, ESP_NETIF_DNS_MAIN, &dns_info);
+	}
+#endif
+
+	WIFI_DEBUG("Trying the saved access point on channel %u", link.channel);
+	wifi_app_fast_connect = true;
+	wifi_app_stats.fast_attempts++;
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * Unpins the station configuration, the next connect scans every channel and runs DHCP.
+ */
+static void wifi_app_fast_connect_reset(void)
+{
+	wifi_config_t *config = wifi_app_get_wifi_config();
+
+	config->sta.bssid_set = false;
+	memset(config->sta.bssid, 0x00, sizeof(config->sta.bssid));
+	config->sta.channel = 0;
+
+#ifdef CONFIG_WS_WIFI_REUSE_IP
+	// Fails harmlessly if the client is already running
+	esp_netif_dhcpc_start(esp_netif_sta);
+#endif
+
+	wifi_app_fast_connect = false;
+}
+
+/**
+ * Starts an all-channel scan whose results pick the saved network to connect to.
+ */
+static void wifi_app_scan_start(void)
+{
+	wifi_app_candidate_count = 0;
+	wifi_app_candidate_next = 0;
+
+	esp_err_t err = esp_wifi_scan_start(NULL, false);
+	if (err != ESP_OK)
+	{
+		WIFI_DEBUG("Scan not started (%s)", esp_err_to_name(err));
+		wifi_app_reconnect_schedule(WIFI_REASON_UNSPECIFIED);
+		return;
+	}
+
+	wifi_app_scanning = true;
+	wifi_app_stats.scans++;
+}
+
+/**
+ * Ranks the saved networks found by the scan, best first. A network scores the RSSI of its
+ * strongest access point plus WIFI_RANK_RECENT_DB for every saved network it was used after,
+ * so a network that worked lately wins over a slightly stronger one that has not.
+ */
+static void wifi_app_scan_rank(void)
+{
+	int64_t start = esp_timer_get_time();
+	uint16_t found = WIFI_SCAN_MAX_RECORDS;
+	size_t count = app_nvs_get_network_count();
+	app_nvs_network_t network;
+
+	wifi_ap_record_t *records = wifi_app_scan_records;
+	if (esp_wifi_scan_get_ap_records(&found, records) != ESP_OK)
+	{
+		found = 0;
+	}
+
+	wifi_app_candidate_count = 0;
+	wifi_app_candidate_next = 0;
+	for (size_t i = 0; i < count && app_nvs_get_network(i, &network); i++)
+	{
+		const wifi_ap_record_t *best = NULL;
+		for (uint16_t r = 0; r < found; r++)
+		{
+			if (strncmp((char *)records[r].ssid, (char *)network.ssid, sizeof(network.ssid)) == 0 &&
+				(best == NULL || records[r].rssi > best->rssi))
+			{
+				best = &records[r];
+			}
+		}
+		if (best == NULL)
+		{
+			continue;
+		}
+
+		wifi_app_candidate_t candidate = { .network = i, .channel = best->primary,
+				.score = best->rssi + (int16_t)((count - 1 - i) * WIFI_RANK_RECENT_DB) };
+		memcpy(candidate.bssid, best->bssid, sizeof(candidate.bssid));
+
+		// Insertion sort, there are at most APP_NVS_MAX_NETWORKS candidates
+		size_t pos = wifi_app_candidate_count++;
+		while (pos > 0 && wifi_app_candidates[pos - 1].score < candidate.score)
+		{
+			wifi_app_candidates[pos] = wifi_app_candidates[pos - 1];
+			pos--;
+		}
+		wifi_app_candidates[pos] = candidate;
+	}
+
+	wifi_app_stats.select_us = esp_timer_get_time() - start;
+	WIFI_DEBUG("Scan found %u access points, %u saved networks in range, ranked in %u us",
+			found, wifi_app_candidate_count, wifi_app_stats.select_us);
+}
+
+/**
+ * Connects to the next candidate of the latest scan, pinned to the access point it was seen on.
+ * @return false if every candidate was tried.
+ */
+static bool wifi_app_candidate_connect(void)
+{
+	app_nvs_network_t network;
+	wifi_config_t *config = wifi_app_get_wifi_config();
+
+	while (wifi_app_candidate_next < wifi_app_candidate_count)
+	{
+		const wifi_app_candidate_t *candidate = &wifi_app_candidates[wifi_app_candidate_next++];
+		if (!app_nvs_get_network(candidate->network, &network))
+		{
+			continue;
+		}
+
+		memset(config, 0x00, sizeof(wifi_config_t));
+		memcpy(config->sta.ssid, network.ssid, sizeof(config->sta.ssid));
+		memcpy(config->sta.password, network.password, sizeof(config->sta.password));
+		memcpy(config->sta.bssid, candidate->bssid, sizeof(config->sta.bssid));
+		config->sta.bssid_set = true;
+		config->sta.channel = candidate->channel;
+
+		WIFI_DEBUG("Connecting to %.32s on channel %u, score %d", (char *)config->sta.ssid, candidate->channel, candidate->score);
+		wifi_app_connect_sta();
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Drops the candidates of the latest scan.
+ */
+static void wifi_app_candidates_clear(void)
+{
+	wifi_app_candidate_count = 0;
+	wifi_app_candidate_next = 0;
+}
+
+/**
+ * Collects the link of the current connection, to be saved with the credentials.
+ * @param link receives the link, all zeros if the station is not connected.
+ * @param rssi receives the RSSI of the connection.
+ */
+static void wifi_app_get_link(app_nvs_link_t *link, int8_t *rssi)
+{
+	wifi_ap_record_t ap_info;
+	esp_netif_ip_info_t ip_info;
+	esp_netif_dns_info_t dns_info;
+
+	memset(link, 0x00, sizeof(app_nvs_link_t));
+	*rssi = 0;
+	if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK)
+	{
+		return;
+	}
+
+	*rssi = ap_info.rssi;
+
+	memcpy(link->bssid, ap_info.bssid, sizeof(link->bssid));
+	link->channel = ap_info.primary;
+	link->flags = APP_NVS_LINK_VALID;
+
+	if (esp_netif_get_ip_info(esp_netif_sta, &ip_info) == ESP_OK &&
+		esp_netif_get_dns_info(esp_netif_sta, ESP_NETIF_DNS_MAIN, &dns_info) == ESP_OK)
+	{
+		link->ip = ip_info.ip.addr;
+		link->netmask = ip_info.netmask.addr;
+		link->gw = ip_info.gw.addr;
+		link->dns = dns_info.ip.u_addr.ip4.addr;
+		link->flags |= APP_NVS_LINK_IP;
+	}
+}
+#endif
+
+
+/**
+ * Moves the credentials of the latest connect request into the station configuration.
+ * Runs on the WiFi task, the staging buffer is wiped once copied.
+ */
+static void wifi_app_staged_apply(void)
+{
+	wifi_config_t *config = wifi_app_get_wifi_config();
+
+	xSemaphoreTake(wifi_app_staged_lock, portMAX_DELAY);
+	if (wifi_app_staged.pending)
+	{
+		memset(config, 0x00, sizeof(wifi_config_t));
+		memcpy(config->sta.ssid, wifi_app_staged.ssid, sizeof(config->sta.ssid));
+		memcpy(config->sta.password, wifi_app_staged.password, sizeof(config->sta.password));
+	}
+	memset(&wifi_app_staged, 0x00, sizeof(wifi_app_staged));
+	xSemaphoreGive(wifi_app_staged_lock);
+}
 
 /**
  * Main task for the WiFi application
@@ -241,7 +666,9 @@ void wifi_app_disconnect_sta(void){
  */
 static void wifi_app_task(void *pvParameters)
 {
-	wifi_app_queue_message_t msg;
+	event_bus_event_t msg;
+	wifi_app_disconnected_event_t disconnected;
+	wifi_app_got_ip_event_t got_ip;
 	EventBits_t eventBits;
 
 	// Initialize the event handler
@@ -261,9 +688,9 @@ static void wifi_app_task(void *pvParameters)
 
 	for (;;)
 	{
-		if (xQueueReceive(wifi_app_queue_handle, &msg, portMAX_DELAY))
+		if (event_bus_receive(&wifi_app_bus, &msg, portMAX_DELAY))
 		{
-			switch (msg.msgID)
+			switch (msg.id)
 			{
 				#ifdef NVS_ENABLE
 				case WIFI_APP_MSG_LOAD_SAVED_CREDENTIALS:
@@ -272,7 +699,15 @@ static void wifi_app_task(void *pvParameters)
 					if (app_nvs_load_sta_creds())
 					{
 						WIFI_DEBUG("Loaded station configuration");
-						wifi_app_connect_sta();
+						if (wifi_app_fast_connect_apply())
+						{
+							wifi_app_connect_sta();
+						}
+						else
+						{
+							// No link to go straight to, one scan picks among the saved networks
+							wifi_app_scan_start();
+						}
 						xEventGroupSetBits(wifi_app_event_group, WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT);
 					}
 					else
@@ -297,11 +732,29 @@ static void wifi_app_task(void *pvParameters)
 
 					xEventGroupSetBits(wifi_app_event_group, WIFI_APP_CONNECTING_FROM_HTTP_SERVER_BIT);
 
-					// Attempt a connection
-					wifi_app_connect_sta();
+					// The requester only staged the credentials, the configuration is never written off this task
+					wifi_app_staged_apply();
 
-					// Set current number of retries to zero
-					g_retry_number = 0;
+					#ifdef NVS_ENABLE
+					// A new network never uses the saved link
+					wifi_app_fast_connect_reset();
+					#endif
+
+					// Attempt a connection, the new network starts without a backoff
+					wifi_app_reconnect_cancel();
+					#ifdef NVS_ENABLE
+					wifi_app_candidates_clear();
+					#endif
+					if (!wifi_app_connect_sta())
+					{
+						// No attempt, so no disconnect will ever report on it
+						WIFI_DEBUG("WIFI_APP_MSG_CONNECTING_FROM_HTTP_SERVER: ALREADY CONNECTED, DISCONNECT FIRST");
+						xEventGroupClearBits(wifi_app_event_group, WIFI_APP_CONNECTING_FROM_HTTP_SERVER_BIT);
+						#ifdef HTTP_SERVER_ENABLE
+						http_server_monitor_send_message(HTTP_MSG_WIFI_CONNECT_FAIL);
+						#endif
+						break;
+					}
 
 					// Next, start the web server
 					wifi_app_send_message(WIFI_APP_MSG_START_HTTP_SERVER);
@@ -311,19 +764,55 @@ static void wifi_app_task(void *pvParameters)
 				case WIFI_APP_MSG_STA_CONNECTED_GOT_IP:
 					WIFI_DEBUG("WIFI_APP_MSG_STA_CONNECTED_GOT_IP");
 
+					#ifdef HTTP_SERVER_ENABLE
+					// Clients on the station side keep the server up as well, one reference per link
+					if (!(xEventGroupGetBits(wifi_app_event_group) & WIFI_APP_STA_CONNECTED_GOT_IP_BIT))
+					{
+						http_server_acquire(HTTP_SERVER_USER_STA);
+					}
+					#endif
 					xEventGroupSetBits(wifi_app_event_group, WIFI_APP_STA_CONNECTED_GOT_IP_BIT);
 
-					eventBits = xEventGroupGetBits(wifi_app_event_group);
-					if (eventBits & WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT) ///> Save STA creds only if connecting from the http server (not loaded from NVS)
+					event_bus_payload(&msg, &got_ip, sizeof(got_ip));
+					wifi_app_stats.connect_us = got_ip.time_us - wifi_app_connect_us;
+					if (wifi_app_stats.got_ip_us < 0)
 					{
-						WIFI_DEBUG("WIFI_APP_CONNECTING_USING_SAVED_CREDS");
+						wifi_app_stats.got_ip_us = got_ip.time_us - wifi_app_start_us;
+						wifi_app_stats.got_ip_fast = wifi_app_fast_connect;
+						WIFI_DEBUG("Got IP %lld ms after app_main, %s", wifi_app_stats.got_ip_us / 1000,
+								wifi_app_fast_connect ? "on the saved link" : "after a full scan");
 					}
-					else
+					WIFI_DEBUG("Connected in %lld ms", wifi_app_stats.connect_us / 1000);
+
+					if (wifi_app_reconnect_attempt > 0)
 					{
-						#ifdef NVS_ENABLE
-						app_nvs_save_sta_creds();
-						#endif
+						wifi_app_stats.last_recovery_us = got_ip.time_us - wifi_app_outage_us;
+						if (wifi_app_stats.last_recovery_us > wifi_app_stats.max_recovery_us)
+						{
+							wifi_app_stats.max_recovery_us = wifi_app_stats.last_recovery_us;
+						}
+						wifi_app_stats.recoveries++;
+						WIFI_DEBUG("Recovered after %u reconnects in %lld ms", wifi_app_reconnect_attempt,
+								wifi_app_stats.last_recovery_us / 1000);
 					}
+					wifi_app_reconnect_cancel();
+					#ifdef NVS_ENABLE
+					wifi_app_candidates_clear();
+					#endif
+
+					eventBits = xEventGroupGetBits(wifi_app_event_group);
+					if (eventBits & WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT)
+					{
+						WIFI_DEBUG("WIFI_APP_CONNECTING_USING_SAVED_CREDS");
+					}
+
+					#ifdef NVS_ENABLE
+					// Saved creds only write when the access point or the lease changed
+					app_nvs_link_t link;
+					int8_t rssi;
+					wifi_app_get_link(&link, &rssi);
+					app_nvs_save_sta_creds(&link, rssi);
+					#endif
 
 					if (eventBits & WIFI_APP_CONNECTING_FROM_HTTP_SERVER_BIT)
 					{
@@ -339,25 +828,25 @@ static void wifi_app_task(void *pvParameters)
 				case WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT:
 					WIFI_DEBUG("WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT");
 
-					eventBits = xEventGroupGetBits(wifi_app_event_group);
+					// However the station got connected, or is still trying to
+					xEventGroupClearBits(wifi_app_event_group,
+							WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT | WIFI_APP_CONNECTING_FROM_HTTP_SERVER_BIT);
 
-					if (eventBits & WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT)
-					{
-						WIFI_DEBUG("WIFI_APP_MSG_STA_DISCONNECTED: ATTEMPT USING SAVED CREDENTIALS");
-						xEventGroupClearBits(wifi_app_event_group, WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT);
-
-						g_retry_number = MAX_CONNECTION_RETRIES;
-						wifi_app_disconnect_sta();
-						#ifdef NVS_ENABLE
-						app_nvs_clear_sta_creds();
-						#endif
-					}
+					wifi_app_reconnect_cancel();
+					#ifdef NVS_ENABLE
+					wifi_app_candidates_clear();
+					#endif
+					wifi_app_disconnect_sta();
+					#ifdef NVS_ENABLE
+					app_nvs_clear_sta_creds();
+					#endif
 
 					break;
 
 				case WIFI_APP_MSG_STA_DISCONNECTED:
 					WIFI_DEBUG("WIFI_APP_MSG_STA_DISCONNECTED");
 
+					event_bus_payload(&msg, &disconnected, sizeof(disconnected));
 					eventBits = xEventGroupGetBits(wifi_app_event_group);
 					
 					if (eventBits & WIFI_APP_CONNECTING_FROM_HTTP_SERVER_BIT)
@@ -368,7 +857,8 @@ static void wifi_app_task(void *pvParameters)
 						http_server_monitor_send_message(HTTP_MSG_WIFI_CONNECT_FAIL);
 						#endif
 					}
-					else if (eventBits & WIFI_APP_USER_REQUESTED_STA_DISCONNECT_BIT)
+
+					if (eventBits & WIFI_APP_USER_REQUESTED_STA_DISCONNECT_BIT)
 					{
 						WIFI_DEBUG("WIFI_APP_MSG_STA_DISCONNECTED: USER REQUESTED DISCONNECTION");
 						xEventGroupClearBits(wifi_app_event_group, WIFI_APP_USER_REQUESTED_STA_DISCONNECT_BIT);
@@ -379,29 +869,80 @@ static void wifi_app_task(void *pvParameters)
 					}
 					else
 					{
+						// A failed attempt from the HTTP server recovers the same way, through the saved networks
 						WIFI_DEBUG("WIFI_APP_MSG_STA_DISCONNECTED: ATTEMPT FAILED, CHECK WIFI ACCESS POINT AVAILABILITY");
-						// Adjust this case to your needs - maybe you want to keep trying to connect...
-						if (g_retry_number < MAX_CONNECTION_RETRIES)
+						#ifdef NVS_ENABLE
+						if (wifi_app_fast_connect)
+						{
+							// The saved access point is gone or moved, fall back to a full scan without using a retry
+							WIFI_DEBUG("WIFI_APP_MSG_STA_DISCONNECTED: SAVED LINK FAILED, SCANNING");
+							if (!(eventBits & WIFI_APP_STA_CONNECTED_GOT_IP_BIT))
+							{
+								wifi_app_stats.fast_fallbacks++;
+							}
+							wifi_app_fast_connect_reset();
+							wifi_app_scan_start();
+						}
+						else if (wifi_app_candidate_connect())
 						{
-							esp_wifi_connect();
-							g_retry_number ++;
+							// Next network of the same scan, no rescan needed
+							WIFI_DEBUG("WIFI_APP_MSG_STA_DISCONNECTED: FAILING OVER");
+							wifi_app_stats.failovers++;
 						}
 						else
+						#endif
 						{
-							xEventGroupClearBits(wifi_app_event_group, WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT);
-							//app_nvs_clear_sta_creds();
+							// Keep trying forever, the backoff keeps the radio free for the SoftAP meanwhile
+							wifi_app_reconnect_schedule(disconnected.reason);
 						}
-						
-						
 					}
 
 					if (eventBits & WIFI_APP_STA_CONNECTED_GOT_IP_BIT)
 					{
 						xEventGroupClearBits(wifi_app_event_group, WIFI_APP_STA_CONNECTED_GOT_IP_BIT);
+						#ifdef HTTP_SERVER_ENABLE
+						http_server_release(HTTP_SERVER_USER_STA);
+						#endif
 					}
 
 					break;
 
+				case WIFI_APP_MSG_RECONNECT:
+					WIFI_DEBUG("WIFI_APP_MSG_RECONNECT");
+
+					wifi_app_stats.backoff_ms = 0;
+					wifi_app_stats.reconnects++;
+					#ifdef NVS_ENABLE
+					if (app_nvs_get_network_count() > 0)
+					{
+						wifi_app_scan_start();
+						break;
+					}
+					#endif
+					wifi_app_connect_sta();
+
+					break;
+
+				#ifdef NVS_ENABLE
+				case WIFI_APP_MSG_SCAN_DONE:
+					WIFI_DEBUG("WIFI_APP_MSG_SCAN_DONE");
+
+					// Scans started by someone else are theirs to read
+					if (!wifi_app_scanning)
+					{
+						break;
+					}
+					wifi_app_scanning = false;
+
+					wifi_app_scan_rank();
+					if (!wifi_app_candidate_connect())
+					{
+						wifi_app_reconnect_schedule(WIFI_REASON_NO_AP_FOUND);
+					}
+
+					break;
+				#endif
+
 				default:
 					break;
 
@@ -412,9 +953,30 @@ static void wifi_app_task(void *pvParameters)
 
 BaseType_t wifi_app_send_message(wifi_app_message_e msgID)
 {
-	wifi_app_queue_message_t msg;
-	msg.msgID = msgID;
-	return xQueueSend(wifi_app_queue_handle, &msg, portMAX_DELAY);
+	return event_bus_post(&wifi_app_bus, msgID, EVENT_BUS_PRIORITY_NORMAL, NULL, 0) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t wifi_app_request_connect(const char *ssid, const char *password)
+{
+	size_t ssid_len = strlen(ssid);
+	size_t password_len = password ? strlen(password) : 0;
+
+	if (ssid_len > MAX_SSID_LENGTH || password_len > MAX_PASSWORD_LENGTH)
+	{
+		return pdFALSE;
+	}
+
+	xSemaphoreTake(wifi_app_staged_lock, portMAX_DELAY);
+	memset(&wifi_app_staged, 0x00, sizeof(wifi_app_staged));
+	memcpy(wifi_app_staged.ssid, ssid, ssid_len);
+	if (password)
+	{
+		memcpy(wifi_app_staged.password, password, password_len);
+	}
+	wifi_app_staged.pending = true;
+	xSemaphoreGive(wifi_app_staged_lock);
+
+	return wifi_app_send_message(WIFI_APP_MSG_CONNECTING_FROM_HTTP_SERVER);
 }
 
 wifi_config_t* wifi_app_get_wifi_config(void)
@@ -422,27 +984,48 @@ wifi_config_t* wifi_app_get_wifi_config(void)
 	return wifi_config;
 }
 
+void wifi_app_get_stats(wifi_app_stats_t *stats)
+{
+	*stats = wifi_app_stats;
+}
+
+const event_bus_t *wifi_app_get_event_bus(void)
+{
+	return &wifi_app_bus;
+}
+
 
 
-void wifi_app_start(void)
+void wifi_app_start(int64_t start_us)
 {
 	WIFI_DEBUG("STARTING WIFI APPLICATION");
 
+	wifi_app_start_us = start_us;
+
 	// Disable default WiFi logging messages
 	esp_log_level_set("wifi", ESP_LOG_NONE);
 
 	// Allocate memory for the wifi configuration
 	wifi_config = (wifi_config_t*)malloc(sizeof(wifi_config_t));
 	memset(wifi_config, 0x00, sizeof(wifi_config_t));
+	wifi_app_staged_lock = xSemaphoreCreateMutex();
 
-	// Create message queue
-	wifi_app_queue_handle = xQueueCreate(3, sizeof(wifi_app_queue_message_t));
+	// Create the event bus
+	ESP_ERROR_CHECK(event_bus_init(&wifi_app_bus, "wifi_app", WIFI_APP_EVENT_DEPTH, WIFI_APP_EVENT_HIGH_DEPTH) ? ESP_OK : ESP_ERR_NO_MEM);
 
 	// Create Wifi application event group
 	wifi_app_event_group = xEventGroupCreate();
 
+	// Create the reconnect timer
+	const esp_timer_create_args_t reconnect_timer_args =
+	{
+		.callback = &wifi_app_reconnect_timer_cb,
+		.name = "wifi_reconnect",
+	};
+	ESP_ERROR_CHECK(esp_timer_create(&reconnect_timer_args, &wifi_app_reconnect_timer));
+
 	// Start the WiFi application task
-	xTaskCreatePinnedToCore(&wifi_app_task, "wifi_app_task", WIFI_APP_TASK_STACK_SIZE, NULL, WIFI_APP_TASK_PRIORITY, NULL, WIFI_APP_TASK_CORE_ID);
+	task_topology_create(TASK_TOPOLOGY_WIFI_APP, &wifi_app_task, NULL, NULL);
 }
 
 
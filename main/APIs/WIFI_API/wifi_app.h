@@ -8,12 +8,16 @@
 #ifndef MAIN_WIFI_APP_H_
 #define MAIN_WIFI_APP_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "esp_netif.h"
 
-// WiFi application task
-#define WIFI_APP_TASK_STACK_SIZE			4096
-#define WIFI_APP_TASK_PRIORITY				5
-#define WIFI_APP_TASK_CORE_ID				1
+#include "event_bus.h"
+
+// WiFi application task, placed by task_topology.h
+#define WIFI_APP_EVENT_DEPTH				8		// Normal priority events queued for the task
+#define WIFI_APP_EVENT_HIGH_DEPTH			4		// Link events, kept apart so requests can not crowd them out
 
 // WiFi application settings
 #define WIFI_AP_SSID				"WEBSOCKET"			// AP name
@@ -29,7 +33,15 @@
 #define WIFI_STA_POWER_SAVE			WIFI_PS_NONE		// Power save not used
 #define MAX_SSID_LENGTH				32					// IEEE standard maximum
 #define MAX_PASSWORD_LENGTH			64					// IEEE standard maximum
-#define MAX_CONNECTION_RETRIES		5					// Retry number on disconnect
+
+// Station reconnect backoff
+#define WIFI_RECONNECT_MIN_MS		CONFIG_WS_WIFI_RECONNECT_MIN_MS		// First delay after a lost link
+#define WIFI_RECONNECT_MAX_MS		CONFIG_WS_WIFI_RECONNECT_MAX_MS		// Cap, retries go on forever at this interval
+#define WIFI_RECONNECT_AP_BUSY_MS	5000				// Lowest delay while the SoftAP has stations, scans stall their traffic
+
+// Saved network selection
+#define WIFI_SCAN_MAX_RECORDS		20					// Access points ranked per scan, the rest are ignored
+#define WIFI_RANK_RECENT_DB			5					// Score bonus per saved network a network was used after
 
 // netif object for the Station and Access Point
 extern esp_netif_t* esp_netif_sta;
@@ -47,37 +59,73 @@ typedef enum wifi_app_message
 	WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT,
 	WIFI_APP_MSG_LOAD_SAVED_CREDENTIALS,
 	WIFI_APP_MSG_STA_DISCONNECTED,
+	WIFI_APP_MSG_RECONNECT,
+	WIFI_APP_MSG_SCAN_DONE,
 } wifi_app_message_e;
 
 /**
- * Structure for the message queue
- * @note Expand this based on application requirements e.g. add another type and parameter as required
+ * Connection timing and fast reconnect counters
  */
-typedef struct wifi_app_queue_message
+typedef struct wifi_app_stats
 {
-	wifi_app_message_e msgID;
-} wifi_app_queue_message_t;
+	int64_t got_ip_us;					///> Time from app_main to the first IP, -1 until then
+	bool got_ip_fast;					///> The first IP came through the saved link
+	int64_t connect_us;					///> Time from the latest connect to its IP
+	uint32_t fast_attempts;				///> Connects started on the saved link
+	uint32_t fast_fallbacks;			///> Of those, the ones that failed and went back to a full scan
+	uint32_t reconnects;				///> Reconnects started by the backoff timer
+	uint32_t recoveries;				///> Outages that ended with an IP
+	int64_t last_recovery_us;			///> Time from the first disconnect of the latest outage to its IP
+	int64_t max_recovery_us;
+	uint32_t backoff_ms;				///> Delay before the pending reconnect, 0 if none
+	uint8_t last_reason;				///> wifi_err_reason_t of the latest disconnect
+	uint32_t scans;						///> Scans started to pick a saved network
+	uint32_t select_us;					///> Time taken to rank the latest scan
+	uint32_t failovers;					///> Connects moved to the next candidate of a scan
+} wifi_app_stats_t;
 
 /**
- * Sends a message to the queue
+ * Sends a message to the WiFi application task without blocking
  * @param msgID message ID from the wifi_app_message_e enum.
- * @return pdTRUE if an item was successfully sent to the queue, otherwise pdFALSE.
- * @note Expand the parameter list based on your requirements e.g. how you've expanded the wifi_app_queue_message_t.
+ * @return pdTRUE if the message was queued, pdFALSE if the queue was full and it was dropped.
  */
 BaseType_t wifi_app_send_message(wifi_app_message_e msgID);
 
+/**
+ * Asks the WiFi application task to join an access point as station.
+ * The credentials are copied here and written into the station configuration on the
+ * WiFi task, so a caller on another task never races its reconnects.
+ * @param ssid network name, at most MAX_SSID_LENGTH characters.
+ * @param password network password, NULL for an open network, at most MAX_PASSWORD_LENGTH characters.
+ * @return pdTRUE if the request was queued, pdFALSE if the credentials are too long or the queue was full.
+ */
+BaseType_t wifi_app_request_connect(const char *ssid, const char *password);
+
 /**
  * Starts the WiFi RTOS task
+ * @param start_us esp_timer time taken at the top of app_main, connection times are counted from it.
  */
-void wifi_app_start(void);
+void wifi_app_start(int64_t start_us);
 
 /**
  * Gets the wifi configuration
  */
 wifi_config_t* wifi_app_get_wifi_config(void);
 
+/**
+ * Reads the connection timing and fast reconnect counters.
+ * @param stats receives the counters.
+ */
+void wifi_app_get_stats(wifi_app_stats_t *stats);
+
+/**
+ * Gets the event bus of the WiFi application task, for its counters.
+ * @return the bus.
+ */
+const event_bus_t *wifi_app_get_event_bus(void);
+
 
-void wifi_app_connect_sta(void);
+bool wifi_app_connect_sta(void);
 
 void wifi_app_disconnect_sta(void);
 
@@ -0,0 +1,21 @@
+/*
+ * www.c
+ *
+ *  Created on: May 27, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#include <string.h>
+
+#include "www.h"
+
+bool www_not_modified(const www_asset_t *asset, const char *if_none_match)
+{
+	if (strcmp(if_none_match, "*") == 0)
+	{
+		return true;
+	}
+
+	// The ETags are quoted, so a match can not start or end in the middle of another one
+	return strstr(if_none_match, asset->etag) != NULL;
+}
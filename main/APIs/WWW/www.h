@@ -0,0 +1,44 @@
+/*
+ * www.h
+ *
+ *  Created on: May 27, 2022
+ *      Author: Juan Sebastian Giraldo Duque
+ */
+
+#ifndef MAIN_WWW_H_
+#define MAIN_WWW_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest If-None-Match header looked at, a strong ETag of the table is 18 characters
+#define WWW_IF_NONE_MATCH_MAX_LEN		64
+
+/**
+ * Dashboard file, gzipped at build time by tools/www_pack.py from main/www.
+ * The bytes are sent as they are with Content-Encoding: gzip.
+ */
+typedef struct www_asset
+{
+	const char *uri;				///> Path it is served at, index.html is served at /
+	const char *type;				///> Content-Type
+	const char *etag;				///> Strong ETag of the gzipped bytes, quotes included
+	const char *cache_control;		///> no-cache for pages, immutable for the assets they reference by version
+	const uint8_t *data;			///> Gzipped bytes, in flash
+	size_t len;
+} www_asset_t;
+
+// Generated table, see build/esp-idf/main/www_assets.c
+extern const www_asset_t www_assets[];
+extern const size_t www_asset_count;
+
+/**
+ * Checks a conditional request against an asset.
+ * @param asset asset requested.
+ * @param if_none_match value of the If-None-Match header, a list of ETags or *.
+ * @return true if the client copy is current and a 304 answers the request.
+ */
+bool www_not_modified(const www_asset_t *asset, const char *if_none_match);
+
+#endif /* MAIN_WWW_H_ */
@@ -13,6 +13,7 @@
 #include "esp_system.h"
 #include "nvs_flash.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -24,16 +25,29 @@
 #include "http_server.h"
 #include "wifi_app.h"
 #include "app_nvs.h"
+#include "bench.h"
 
 static const char *TAG = "MAIN";
 
 void app_main(void)
 {
+    int64_t start_us = esp_timer_get_time();
+
+#ifdef CONFIG_WS_BENCHMARK
+    // Places the tasks before any of them is created
+    bench_boot();
+#endif
+
     ESP_LOGI(TAG, "[APP] Startup..");
     ESP_LOGI(TAG, "[APP] Free memory: %d bytes", esp_get_free_heap_size());
     ESP_LOGI(TAG, "[APP] IDF version: %s", esp_get_idf_version());
 
     log_for_websocket_setup();
+    http_server_init();
     app_nvs_flash_setup(); 
-    wifi_app_start();
+    wifi_app_start(start_us);
+
+#ifdef CONFIG_WS_BENCHMARK
+    bench_start();
+#endif
 }
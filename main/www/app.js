@@ -0,0 +1,194 @@
+// Dashboard for the /ws stream, see the Dashboard section of README.md.
+// The log keeps the newest MAX_LINES lines and only builds the rows in view,
+// so an hour of logs scrolls like a minute of them on a phone.
+(function () {
+	'use strict';
+
+	var ROW = 16;				// Row height in px, same as #rows div in style.css
+	var MAX_LINES = 20000;		// Oldest lines are dropped past this
+	var OVERSCAN = 10;			// Rows built above and below the view
+	var STATUS_MS = 10000;		// status poll interval
+
+	var $ = function (id) { return document.getElementById(id); };
+	var log = $('log'), spacer = $('spacer'), rows = $('rows');
+	var ANSI = /\x1b\[[0-9;]*m/g;
+
+	var lines = [];				// { text, cls }
+	var shown = lines;			// Lines matching the filter, lines itself when there is none
+	var filter = '';
+	var follow = true;
+	var queued = false;
+	var ws = null, nextId = 1, pending = {}, retry = 500, binaryFrames = 0;
+
+	function matches(line) {
+		return line.text.toLowerCase().indexOf(filter) >= 0;
+	}
+
+	function add(text, cls) {
+		var line = { text: text, cls: cls };
+		lines.push(line);
+		if (shown !== lines && matches(line)) {
+			shown.push(line);
+		}
+		// Trimmed in steps, so adding a line stays cheap
+		if (lines.length > MAX_LINES + MAX_LINES / 4) {
+			lines.splice(0, lines.length - MAX_LINES);
+			if (shown !== lines) {
+				shown = lines.filter(matches);
+			}
+		}
+		update();
+	}
+
+	function update() {
+		if (!queued) {
+			queued = true;
+			requestAnimationFrame(render);
+		}
+	}
+
+	function render() {
+		queued = false;
+		spacer.style.height = shown.length * ROW + 'px';
+		if (follow) {
+			log.scrollTop = log.scrollHeight;
+		}
+
+		var first = Math.max(0, Math.floor(log.scrollTop / ROW) - OVERSCAN);
+		var last = Math.min(shown.length, Math.ceil((log.scrollTop + log.clientHeight) / ROW) + OVERSCAN);
+
+		// The row elements are reused, only their text changes while scrolling
+		while (rows.childElementCount < last - first) {
+			rows.appendChild(document.createElement('div'));
+		}
+		while (rows.childElementCount > last - first) {
+			rows.removeChild(rows.lastChild);
+		}
+		for (var i = first; i < last; i++) {
+			var row = rows.children[i - first];
+			row.textContent = shown[i].text;
+			row.className = shown[i].cls;
+		}
+		rows.style.transform = 'translateY(' + first * ROW + 'px)';
+		$('count').textContent = shown.length + (shown !== lines ? ' of ' + lines.length : '') + ' lines' +
+			(binaryFrames ? ', ' + binaryFrames + ' binary frames' : '');
+	}
+
+	function level(text) {
+		var c = text.charAt(0);
+		return 'EWIDV'.indexOf(c) >= 0 && text.charAt(1) === ' ' ? c : '';
+	}
+
+	function send(command, onReply) {
+		if (!ws || ws.readyState !== WebSocket.OPEN) {
+			return false;
+		}
+		var id = nextId++;
+		pending[id] = onReply || function (ok, text) { add((ok ? '< ' : '! ') + text, ok ? 'R' : 'E'); };
+		ws.send(id + ' ' + command);
+		return true;
+	}
+
+	function subscribe() {
+		// The dashboard reads plain text, compressed frames are for tools/ws_log_lz.py
+		send('subscribe level=' + $('level').value + ' compress=none', function (ok, text) {
+			if (!ok) {
+				add('! subscribe ' + text, 'E');
+			}
+		});
+	}
+
+	function status() {
+		send('status', function (ok, text) {
+			$('status').textContent = text;
+		});
+	}
+
+	function receive(event) {
+		if (typeof event.data !== 'string') {
+			// Binary log records need the string table of the ELF, see tools/ws_log_decode.py
+			if (binaryFrames++ === 0) {
+				add('binary log frames, decode them with tools/ws_log_decode.py', 'R');
+			}
+			update();
+			return;
+		}
+
+		var reply = /^(\d+) (ok|err) ?([\s\S]*)$/.exec(event.data);
+		if (reply && pending[reply[1]]) {
+			var done = pending[reply[1]];
+			delete pending[reply[1]];
+			done(reply[2] === 'ok', reply[3]);
+			return;
+		}
+		if (event.data.indexOf('ota ') === 0) {
+			$('ota').textContent = event.data;
+			return;
+		}
+
+		var text = event.data.replace(ANSI, '').split('\n');
+		for (var i = 0; i < text.length; i++) {
+			if (text[i]) {
+				add(text[i], level(text[i]));
+			}
+		}
+	}
+
+	function connect() {
+		ws = new WebSocket((location.protocol === 'https:' ? 'wss://' : 'ws://') + location.host + '/ws');
+		ws.binaryType = 'arraybuffer';
+		ws.onopen = function () {
+			retry = 500;
+			pending = {};
+			$('link').textContent = 'online';
+			$('link').className = 'up';
+			subscribe();
+			status();
+		};
+		ws.onclose = function () {
+			$('link').textContent = 'offline';
+			$('link').className = 'down';
+			setTimeout(connect, retry);
+			retry = Math.min(retry * 2, 10000);
+		};
+		ws.onmessage = receive;
+	}
+
+	log.addEventListener('scroll', function () {
+		var bottom = log.scrollTop + log.clientHeight >= log.scrollHeight - ROW;
+		if (follow !== bottom) {
+			follow = bottom;
+			$('follow').className = follow ? 'on' : '';
+		}
+		update();
+	}, { passive: true });
+	window.addEventListener('resize', update);
+
+	$('follow').onclick = function () {
+		follow = !follow;
+		this.className = follow ? 'on' : '';
+		update();
+	};
+	$('clear').onclick = function () {
+		lines.length = 0;
+		shown = filter ? [] : lines;
+		update();
+	};
+	$('filter').oninput = function () {
+		filter = this.value.toLowerCase();
+		shown = filter ? lines.filter(matches) : lines;
+		update();
+	};
+	$('level').onchange = subscribe;
+	$('cmd').onsubmit = function (event) {
+		event.preventDefault();
+		var command = $('cmdline').value.trim();
+		if (command && send(command)) {
+			add('> ' + command, 'R');
+			$('cmdline').value = '';
+		}
+	};
+
+	setInterval(status, STATUS_MS);
+	connect();
+})();
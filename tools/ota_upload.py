@@ -0,0 +1,64 @@
+#!/usr/bin/env python
+#
+# ota_upload.py
+#
+#  Created on: May 24, 2022
+#      Author: Juan Sebastian Giraldo Duque
+#
+# Uploads a firmware image to POST /ota and reports the throughput.
+# The device restarts into the new image a few seconds after answering "ok".
+#
+# Usage:
+#   ota_upload.py build/main.bin [--host 192.168.5.1] [--chunk 16384]
+
+import argparse
+import os
+import sys
+import time
+
+try:
+    from http.client import HTTPConnection
+except ImportError:
+    from httplib import HTTPConnection
+
+
+def upload(host, path, chunk):
+    """Streams the image and returns (status, reply, bytes, seconds)."""
+    size = os.path.getsize(path)
+    conn = HTTPConnection(host, timeout=30)
+    conn.putrequest('POST', '/ota')
+    conn.putheader('Content-Type', 'application/octet-stream')
+    conn.putheader('Content-Length', str(size))
+    conn.endheaders()
+
+    sent = 0
+    start = time.time()
+    with open(path, 'rb') as image:
+        while True:
+            data = image.read(chunk)
+            if not data:
+                break
+            conn.send(data)
+            sent += len(data)
+            sys.stderr.write('\r%d / %d bytes' % (sent, size))
+    response = conn.getresponse()
+    elapsed = time.time() - start
+    sys.stderr.write('\n')
+    return response.status, response.read().decode('utf-8', 'replace'), sent, elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Uploads a firmware image over HTTP')
+    parser.add_argument('image', help='application binary, e.g. build/main.bin')
+    parser.add_argument('--host', default='192.168.5.1', help='device address')
+    parser.add_argument('--chunk', type=int, default=16384, help='bytes per socket write')
+    args = parser.parse_args()
+
+    status, reply, sent, elapsed = upload(args.host, args.image, args.chunk)
+    print('%d bytes in %.2f s, %.3f MB/s: %d %s' % (sent, elapsed, sent / elapsed / 1e6, status, reply.strip()))
+    if status != 200:
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
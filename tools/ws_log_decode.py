@@ -0,0 +1,174 @@
+#!/usr/bin/env python
+#
+# ws_log_decode.py
+#
+#  Created on: May 02, 2022
+#      Author: Juan Sebastian Giraldo Duque
+#
+# Renders binary websocket log records (CONFIG_WS_LOG_FORMAT_BINARY).
+# The string table comes from ws_log_strings.py, which runs after every build.
+#
+# Usage:
+#   ws_log_decode.py -s build/ws_log_strings.json capture.bin
+#   ws_log_decode.py -s build/ws_log_strings.json --url ws://192.168.5.1/ws
+#   ws_log_decode.py -s build/ws_log_strings.json --lz --url ws://192.168.5.1/ws
+#
+# Record layout (little endian), see main/APIs/LOG_BIN/log_bin.h:
+#   u16 len, u32 fmt, u32 timestamp, raw arguments or rendered text
+
+import argparse
+import bisect
+import json
+import re
+import struct
+import sys
+
+import ws_log_lz
+
+FMT_TEXT = 0
+HEADER = struct.Struct('<HII')
+
+CONVERSION = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|L|q|j|z|t)?([diouxXcspfFeEgGaAn%])')
+ANSI = re.compile(r'\x1b\[[0-9;]*m')
+
+
+class StringTable(object):
+    def __init__(self, path):
+        with open(path) as f:
+            table = json.load(f)
+        self.entries = sorted((int(addr, 16), text) for addr, text in table.items())
+        self.addresses = [addr for addr, _ in self.entries]
+
+    def lookup(self, addr):
+        # The linker merges string tails, so the ID may point inside a longer string
+        i = bisect.bisect_right(self.addresses, addr) - 1
+        if i >= 0:
+            start, text = self.entries[i]
+            if addr - start < len(text):
+                return text[addr - start:]
+        return None
+
+
+def render(fmt, args):
+    out = []
+    pos = 0
+    offset = 0
+
+    def take(size, code):
+        value, = struct.unpack_from(code, args, offset)
+        return value, offset + size
+
+    for m in CONVERSION.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, precision, length, conv = m.groups()
+
+        if conv == '%':
+            out.append('%')
+            continue
+
+        if width == '*':
+            width, offset = take(4, '<i')
+            width = str(width)
+        if precision == '*':
+            precision, offset = take(4, '<i')
+            precision = str(precision)
+
+        wide = length in ('ll', 'q', 'j')
+        if conv in 'di':
+            value, offset = take(8, '<q') if wide else take(4, '<i')
+            conv = 'd'
+        elif conv in 'uoxXc':
+            value, offset = take(8, '<Q') if wide else take(4, '<I')
+            conv = 'd' if conv == 'u' else conv
+        elif conv == 'p':
+            value, offset = take(4, '<I')
+            flags, conv = '#', 'x'
+        elif conv == 's':
+            end = args.index(b'\0', offset)
+            value, offset = args[offset:end].decode('latin-1'), end + 1
+        elif conv in 'fFeEgGaA':
+            value, offset = take(8, '<d')
+            if conv in 'aA':
+                value, conv = value.hex(), 's'
+            conv = conv.lower() if conv == 'F' else conv
+        else:
+            continue
+
+        spec = '%' + (flags or '') + (width or '') + ('.' + precision if precision is not None else '') + conv
+        out.append(spec % value)
+
+    out.append(fmt[pos:])
+    return ''.join(out)
+
+
+def decode(data, strings):
+    """Yields (timestamp, text) for every complete record in data."""
+    offset = 0
+    while offset + HEADER.size <= len(data):
+        length, fmt_id, timestamp = HEADER.unpack_from(data, offset)
+        payload = data[offset + HEADER.size:offset + 2 + length]
+        offset += 2 + length
+
+        if fmt_id == FMT_TEXT:
+            yield timestamp, payload.decode('latin-1')
+            continue
+
+        fmt = strings.lookup(fmt_id)
+        if fmt is None:
+            yield timestamp, '<unknown format 0x%08x, is the string table from this build?>\n' % fmt_id
+            continue
+
+        try:
+            yield timestamp, render(fmt, payload)
+        except (struct.error, ValueError, TypeError) as e:
+            yield timestamp, '<bad record for format %r: %s>\n' % (fmt, e)
+
+
+def frames_from_url(url, lz):
+    try:
+        import websocket
+    except ImportError:
+        raise SystemExit('--url needs the websocket-client package (pip install websocket-client)')
+
+    ws = websocket.create_connection(url)
+    if lz:
+        ws.send('1 subscribe compress=lz')
+    while True:
+        opcode, data = ws.recv_data()
+        if opcode == websocket.ABNF.OPCODE_BINARY:
+            yield data
+        elif opcode == websocket.ABNF.OPCODE_TEXT:
+            yield None
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Render binary websocket log records')
+    parser.add_argument('-s', '--strings', required=True, help='string table written by ws_log_strings.py')
+    parser.add_argument('--url', help='websocket endpoint to read frames from, e.g. ws://192.168.5.1/ws')
+    parser.add_argument('--no-color', action='store_true', help='strip ANSI color sequences')
+    parser.add_argument('--lz', action='store_true', help='frames are compressed, see ws_log_lz.py')
+    parser.add_argument('capture', nargs='*', help='files holding concatenated binary frames')
+    args = parser.parse_args()
+
+    strings = StringTable(args.strings)
+
+    if args.url:
+        frames = frames_from_url(args.url, args.lz)
+    else:
+        frames = (open(path, 'rb').read() for path in args.capture)
+
+    for frame in frames:
+        if frame is None:
+            continue
+        if args.lz:
+            frame = ws_log_lz.decompress(frame)
+        for _, text in decode(frame, strings):
+            if args.no_color:
+                text = ANSI.sub('', text)
+            sys.stdout.write(text)
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,117 @@
+#!/usr/bin/env python
+#
+# ws_log_lz.py
+#
+#  Created on: May 06, 2022
+#      Author: Juan Sebastian Giraldo Duque
+#
+# Decompresses websocket log frames sent to clients subscribed with compress=lz.
+# Also importable, ws_log_decode.py --lz uses decompress() for binary log mode.
+#
+# Usage:
+#   ws_log_lz.py --url ws://192.168.5.1/ws [--level W] [--tags [WIFI_APP]]
+#   ws_log_lz.py capture.bin
+#
+# Frame layout, see main/APIs/LOG_LZ/log_lz.h:
+#   u8 magic, u8 dict version, u16 uncompressed length, LZSS groups
+
+import argparse
+import struct
+import sys
+
+MAGIC = 0xA5
+HEADER = struct.Struct('<BBH')
+
+# Must match log_lz_dict in main/APIs/LOG_LZ/log_lz.c byte for byte
+DICTIONARIES = {
+    1: (b'wifi:esp_netif_handlers: sta ip: , mask: , gw: httpd_ws'
+        b'Handshake done, the new connection was opened'
+        b'frame len is Got packet with message: '
+        b'WIFI_EVENT_AP_STADISCONNECTEDWIFI_EVENT_STA_CONNECTED'
+        b'IP_EVENT_STA_GOT_IPWIFI_APP_MSG_STA_HTTP_MSG_WIFI_CONNECT_http_server_'
+        b') [ws_client]: ) [ws_rx_pool]: ) [ws_rpc]: ) nvs: '
+        b'\x1b[0;31mE (\x1b[0;33mW (\x1b[0;35m\x1b[0;36m'
+        b') [http_server]: ) [WIFI_APP]: \x1b[0m\n\x1b[0;32mI ('),
+}
+
+
+def decompress(frame):
+    """Returns the uncompressed payload of one frame."""
+    magic, version, length = HEADER.unpack_from(frame, 0)
+    if magic != MAGIC:
+        raise ValueError('not a compressed frame (magic 0x%02x)' % magic)
+    if version not in DICTIONARIES:
+        raise ValueError('unknown dictionary version %d, update ws_log_lz.py' % version)
+
+    out = bytearray(DICTIONARIES[version])
+    start = len(out)
+    end = start + length
+    pos = HEADER.size
+
+    while len(out) < end:
+        flags = frame[pos]
+        pos += 1
+        for item in range(8):
+            if len(out) >= end:
+                break
+            if flags & (1 << item):
+                b0, b1 = frame[pos], frame[pos + 1]
+                pos += 2
+                offset = (b0 | (b1 & 0x0F) << 8) + 1
+                src = len(out) - offset
+                # Byte by byte, a match may overlap its own output
+                for i in range((b1 >> 4) + 3):
+                    out.append(out[src + i])
+            else:
+                out.append(frame[pos])
+                pos += 1
+
+    return bytes(out[start:end])
+
+
+def frames_from_url(url, subscription):
+    try:
+        import websocket
+    except ImportError:
+        raise SystemExit('--url needs the websocket-client package (pip install websocket-client)')
+
+    ws = websocket.create_connection(url)
+    ws.send('1 subscribe compress=lz ' + subscription)
+    while True:
+        opcode, data = ws.recv_data()
+        if opcode == websocket.ABNF.OPCODE_BINARY:
+            yield data
+        elif opcode == websocket.ABNF.OPCODE_TEXT:
+            sys.stderr.write(data.decode('utf-8', 'replace') + '\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decompress websocket log frames')
+    parser.add_argument('--url', help='websocket endpoint to subscribe to, e.g. ws://192.168.5.1/ws')
+    parser.add_argument('--level', help='most verbose level to receive, E, W, I, D or V')
+    parser.add_argument('--tags', help='tag list as taken by the subscribe command')
+    parser.add_argument('capture', nargs='*', help='files holding one compressed frame each')
+    args = parser.parse_args()
+
+    if args.url:
+        subscription = ' '.join(arg for arg in (
+            'level=' + args.level if args.level else None,
+            'tags=' + args.tags if args.tags else None) if arg)
+        frames = frames_from_url(args.url, subscription)
+    else:
+        frames = (open(path, 'rb').read() for path in args.capture)
+
+    raw = compressed = 0
+    for frame in frames:
+        data = decompress(frame)
+        raw += len(data)
+        compressed += len(frame)
+        sys.stdout.write(data.decode('latin-1'))
+        sys.stdout.flush()
+
+    if compressed:
+        sys.stderr.write('%d bytes in %d bytes, ratio %.2f\n' % (raw, compressed, float(raw) / compressed))
+
+
+if __name__ == '__main__':
+    main()
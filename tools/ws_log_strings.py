@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+#
+# ws_log_strings.py
+#
+#  Created on: May 02, 2022
+#      Author: Juan Sebastian Giraldo Duque
+#
+# Extracts the string table used to render binary websocket logs.
+# Every NUL terminated string stored in the flash rodata of the ELF is written
+# to a JSON object keyed by its address, which is the format ID sent by the device.
+#
+# Usage: ws_log_strings.py build/main.elf -o build/ws_log_strings.json
+
+import argparse
+import json
+import struct
+
+# ESP32 data bus view of the flash (DROM), where format strings are placed
+DROM_LOW = 0x3F400000
+DROM_HIGH = 0x3F800000
+
+SHT_PROGBITS = 1
+SHF_ALLOC = 0x2
+
+PRINTABLE = set(range(0x20, 0x7F)) | {0x09, 0x0A, 0x0D, 0x1B}
+
+
+def elf_rodata_sections(path):
+    """Yields (address, bytes) for every allocated PROGBITS section in DROM."""
+    with open(path, 'rb') as f:
+        elf = f.read()
+
+    if elf[:4] != b'\x7fELF' or elf[4] != 1 or elf[5] != 1:
+        raise SystemExit('%s: not a little endian ELF32 file' % path)
+
+    e_shoff, = struct.unpack_from('<I', elf, 0x20)
+    e_shentsize, e_shnum = struct.unpack_from('<HH', elf, 0x2E)
+
+    for i in range(e_shnum):
+        _, sh_type, sh_flags, sh_addr, sh_offset, sh_size = struct.unpack_from('<IIIIII', elf, e_shoff + i * e_shentsize)
+        if sh_type == SHT_PROGBITS and sh_flags & SHF_ALLOC and DROM_LOW <= sh_addr < DROM_HIGH:
+            yield sh_addr, elf[sh_offset:sh_offset + sh_size]
+
+
+def extract_strings(path):
+    table = {}
+    for base, data in elf_rodata_sections(path):
+        start = 0
+        for i, byte in enumerate(data):
+            if byte == 0:
+                if i - start >= 2:
+                    table['0x%08x' % (base + start)] = data[start:i].decode('latin-1')
+                start = i + 1
+            elif byte not in PRINTABLE:
+                start = i + 1
+    return table
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('elf', help='firmware ELF file')
+    parser.add_argument('-o', '--output', required=True, help='JSON string table to write')
+    args = parser.parse_args()
+
+    table = extract_strings(args.elf)
+    with open(args.output, 'w') as f:
+        json.dump(table, f, separators=(',', ':'))
+    print('ws_log_strings: %d strings written to %s' % (len(table), args.output))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,143 @@
+#!/usr/bin/env python
+#
+# ws_ota.py
+#
+#  Created on: May 26, 2022
+#      Author: Juan Sebastian Giraldo Duque
+#
+# Uploads a firmware image as binary frames on /ws, for devices reached only
+# through the websocket. Keeps a window of chunks in flight, goes back on a nak
+# and resumes where the device stopped when the connection drops.
+#
+# Usage:
+#   ws_ota.py build/main.bin --url ws://192.168.5.1/ws [--chunk 4096] [--retries 5]
+#
+# Chunk frame, see main/APIs/OTA/ota_ws.h:
+#   header  "OTA1", u32 seq, u32 image offset, u32 CRC-32 of the image up to the end of the chunk
+#   data    image bytes, to the end of the frame
+
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+MAGIC = b'OTA1'
+HEADER = struct.Struct('<4sIII')
+
+
+def parse_position(text):
+    """Reads the seq=, offset= and window= fields of a device reply."""
+    fields = dict(item.split('=', 1) for item in text.split() if '=' in item)
+    return int(fields['seq']), int(fields['offset']), int(fields.get('window', 0))
+
+
+class Upload(object):
+    def __init__(self, image, chunk):
+        self.image = image
+        self.chunk = chunk
+        self.crc = zlib.crc32(image) & 0xffffffff
+        self.crcs = {0: 0}
+
+    def frame(self, seq, offset):
+        """Builds the chunk starting at offset, returns (frame, next offset)."""
+        end = min(offset + self.chunk, len(self.image))
+        start = self.crcs.get(offset)
+        if start is None:
+            start = zlib.crc32(self.image[:offset])
+        crc = zlib.crc32(self.image[offset:end], start) & 0xffffffff
+        self.crcs[end] = crc
+        return HEADER.pack(MAGIC, seq, offset, crc) + self.image[offset:end], end
+
+
+def next_text(ws, websocket):
+    """Waits for the next text frame."""
+    while True:
+        opcode, data = ws.recv_data()
+        if opcode == websocket.ABNF.OPCODE_TEXT:
+            return data.decode('utf-8', 'replace')
+
+
+def command(ws, websocket, id, text):
+    """Sends a command and waits for its reply, skipping the frames in between."""
+    ws.send('%d %s' % (id, text))
+    prefix = '%d ' % id
+    while True:
+        reply = next_text(ws, websocket)
+        if reply.startswith(prefix):
+            status, _, rest = reply[len(prefix):].partition(' ')
+            if status != 'ok':
+                raise SystemExit('%s: %s' % (text, rest))
+            return rest
+
+
+def send_image(ws, websocket, upload):
+    """Runs one connection of the upload, returns once the device acked every byte."""
+    size = len(upload.image)
+    ws.send('1 subscribe level=N')
+    reply = command(ws, websocket, 2, 'ota begin %d %08x' % (size, upload.crc))
+    seq, offset, window = parse_position(reply)
+    sys.stderr.write('%s at %d bytes\n' % ('resuming' if 'resumed=1' in reply else 'starting', offset))
+
+    acked_seq, acked_offset = seq, offset
+    rewound = None
+    while acked_offset < size:
+        # Keep a window of chunks past the last ack in flight, the device acks before it closes
+        while offset < size and seq - acked_seq < window:
+            data, offset = upload.frame(seq, offset)
+            ws.send_binary(data)
+            seq += 1
+
+        reply = next_text(ws, websocket)
+        if reply.startswith('ota failed'):
+            raise SystemExit(reply)
+        if reply.startswith('ota ack'):
+            acked_seq, acked_offset, _ = parse_position(reply)
+            rewound = None
+            sys.stderr.write('\r%d / %d bytes' % (acked_offset, size))
+        elif reply.startswith('ota nak'):
+            position = parse_position(reply)[0:2]
+            # Every chunk in flight behind the refused one is refused too, go back once
+            if position != rewound:
+                rewound = position
+                seq, offset = position
+                acked_seq, acked_offset = position
+    sys.stderr.write('\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Uploads a firmware image over the websocket')
+    parser.add_argument('image', help='application binary, e.g. build/main.bin')
+    parser.add_argument('--url', required=True, help='websocket endpoint, e.g. ws://192.168.5.1/ws')
+    parser.add_argument('--chunk', type=int, default=4096, help='image bytes per frame')
+    parser.add_argument('--retries', type=int, default=5, help='reconnects before giving up')
+    args = parser.parse_args()
+
+    try:
+        import websocket
+    except ImportError:
+        raise SystemExit('needs the websocket-client package (pip install websocket-client)')
+
+    with open(args.image, 'rb') as image:
+        upload = Upload(image.read(), args.chunk)
+
+    start = time.time()
+    for attempt in range(args.retries + 1):
+        try:
+            ws = websocket.create_connection(args.url, timeout=30)
+            send_image(ws, websocket, upload)
+            reply = command(ws, websocket, 3, 'ota end')
+            break
+        except (websocket.WebSocketException, OSError) as err:
+            sys.stderr.write('\nconnection lost (%s), resuming\n' % err)
+            time.sleep(1)
+    else:
+        raise SystemExit('gave up after %d reconnects' % args.retries)
+
+    elapsed = time.time() - start
+    size = len(upload.image)
+    print('%d bytes in %.2f s, %.3f MB/s: ok %s' % (size, elapsed, size / elapsed / 1e6, reply))
+
+
+if __name__ == '__main__':
+    main()
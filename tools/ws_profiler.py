@@ -0,0 +1,146 @@
+#!/usr/bin/env python
+#
+# ws_profiler.py
+#
+#  Created on: May 16, 2022
+#      Author: Juan Sebastian Giraldo Duque
+#
+# Top-like view of the task samples streamed by the firmware profiler.
+#
+# Usage:
+#   ws_profiler.py --url ws://192.168.5.1/ws [--sort cpu|stack|name] [--once]
+#
+# Frame layout, see main/APIs/PROFILER/profiler.h:
+#   header  "PROF", u8 version, u8 flags, u8 tasks, u8 cores,
+#           u32 interval_us, u32 uptime_ms, u32 free heap, u16 sample_us, u16 tasks left out
+#   tasks   u16 number, u16 cpu permille, u16 free stack, u8 core, u8 priority, u8 state, u8 reserved
+#   names   NUL terminated, one per task, when flags bit 0 is set
+
+import argparse
+import struct
+import sys
+
+MAGIC = b'PROF'
+VERSION = 1
+FLAG_NAMES = 0x01
+HEADER = struct.Struct('<4sBBBBIIIHH')
+TASK = struct.Struct('<HHHBBBx')
+STATES = {0: 'run', 1: 'ready', 2: 'block', 3: 'susp', 4: 'del'}
+
+
+class Sample(object):
+    def __init__(self, interval_us, uptime_ms, free_heap, sample_us, left_out, cores, tasks):
+        self.interval_us = interval_us
+        self.uptime_ms = uptime_ms
+        self.free_heap = free_heap
+        self.sample_us = sample_us
+        self.left_out = left_out
+        self.cores = cores
+        self.tasks = tasks
+
+
+class Decoder(object):
+    """Decodes frames, remembering task names across frames by task number."""
+
+    def __init__(self):
+        self.names = {}
+
+    def decode(self, frame):
+        magic, version, flags, count, cores, interval_us, uptime_ms, free_heap, sample_us, left_out = \
+            HEADER.unpack_from(frame, 0)
+        if magic != MAGIC:
+            return None
+        if version != VERSION:
+            raise ValueError('profiler frame version %d, update ws_profiler.py' % version)
+
+        tasks = []
+        pos = HEADER.size
+        for _ in range(count):
+            tasks.append(list(TASK.unpack_from(frame, pos)))
+            pos += TASK.size
+
+        if flags & FLAG_NAMES:
+            for task in tasks:
+                end = frame.index(b'\0', pos)
+                self.names[task[0]] = frame[pos:end].decode('latin-1')
+                pos = end + 1
+
+        rows = []
+        for number, permille, stack, core, priority, state, in tasks:
+            rows.append({
+                'number': number,
+                'name': self.names.get(number, '#%d' % number),
+                'cpu': permille / 10.0,
+                'stack': stack,
+                'core': '-' if core == 0xFF else str(core),
+                'priority': priority,
+                'state': STATES.get(state, '?'),
+            })
+        return Sample(interval_us, uptime_ms, free_heap, sample_us, left_out, cores, rows)
+
+
+def render(sample, sort):
+    keys = {
+        'cpu': lambda row: -row['cpu'],
+        'stack': lambda row: row['stack'],
+        'name': lambda row: row['name'],
+    }
+
+    # A pinned task only ever runs on its core, idle tasks tell what is left of each
+    load = []
+    for core in range(sample.cores):
+        idle = sum(row['cpu'] for row in sample.tasks
+                   if row['name'].startswith('IDLE') and row['core'] == str(core))
+        load.append('cpu%d %5.1f%%' % (core, 100.0 - idle))
+
+    lines = [
+        'up %ds  heap %d  interval %dms  sample %dus  %s%s' % (
+            sample.uptime_ms // 1000, sample.free_heap, sample.interval_us // 1000, sample.sample_us,
+            '  '.join(load), '  (%d tasks left out)' % sample.left_out if sample.left_out else ''),
+        '',
+        '%4s  %-16s %6s %4s %4s %-6s %7s' % ('NUM', 'NAME', 'CPU%', 'CORE', 'PRIO', 'STATE', 'STACK'),
+    ]
+    for row in sorted(sample.tasks, key=keys[sort]):
+        lines.append('%4d  %-16s %6.1f %4s %4d %-6s %7d' % (
+            row['number'], row['name'], row['cpu'], row['core'], row['priority'], row['state'], row['stack']))
+    return '\n'.join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Top-like view of the firmware task profiler')
+    parser.add_argument('--url', required=True, help='websocket endpoint, e.g. ws://192.168.5.1/ws')
+    parser.add_argument('--sort', choices=('cpu', 'stack', 'name'), default='cpu', help='row order')
+    parser.add_argument('--once', action='store_true', help='print one sample and exit')
+    args = parser.parse_args()
+
+    try:
+        import websocket
+    except ImportError:
+        raise SystemExit('needs the websocket-client package (pip install websocket-client)')
+
+    ws = websocket.create_connection(args.url)
+    # Quiet the log stream, only the profiler frames are wanted here
+    ws.send('1 subscribe level=N')
+    ws.send('2 profile on')
+
+    decoder = Decoder()
+    while True:
+        opcode, data = ws.recv_data()
+        if opcode == websocket.ABNF.OPCODE_TEXT:
+            reply = data.decode('utf-8', 'replace')
+            if ' err ' in reply:
+                sys.stderr.write(reply + '\n')
+            continue
+        if opcode != websocket.ABNF.OPCODE_BINARY or not data.startswith(MAGIC):
+            continue
+
+        sample = decoder.decode(data)
+        if args.once:
+            print(render(sample, args.sort))
+            break
+        sys.stdout.write('\x1b[H\x1b[2J' + render(sample, args.sort) + '\n')
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,145 @@
+#!/usr/bin/env python
+#
+# www_pack.py
+#
+#  Created on: May 27, 2022
+#      Author: Juan Sebastian Giraldo Duque
+#
+# Gzips the dashboard in main/www into a C table of www_asset_t, see
+# main/APIs/WWW/www.h, and reports the bytes a page load costs.
+#
+# index.html is served at / and revalidated on every load. The other assets
+# are referenced from it with their ETag as a query string and cached for good,
+# so a repeat load is one 304 and a new build never serves a stale script.
+#
+# Usage:
+#   www_pack.py main/www/* -o build/www_assets.c [--report build/www_size_report.txt]
+
+import argparse
+import gzip
+import hashlib
+import io
+import os
+import re
+import sys
+
+TYPES = {
+    '.html': 'text/html',
+    '.js': 'application/javascript',
+    '.css': 'text/css',
+    '.svg': 'image/svg+xml',
+    '.png': 'image/png',
+    '.ico': 'image/x-icon',
+    '.json': 'application/json',
+}
+REVALIDATE = 'no-cache'
+IMMUTABLE = 'public, max-age=31536000, immutable'
+
+
+def compress(data):
+    """Gzips with a fixed timestamp, so the output and its ETag only change with the input."""
+    out = io.BytesIO()
+    with gzip.GzipFile(fileobj=out, mode='wb', compresslevel=9, mtime=0) as gz:
+        gz.write(data)
+    return out.getvalue()
+
+
+def etag(data):
+    return '"%s"' % hashlib.sha256(data).hexdigest()[:16]
+
+
+class Asset(object):
+    def __init__(self, path, data):
+        name = os.path.basename(path)
+        ext = os.path.splitext(name)[1].lower()
+        if ext not in TYPES:
+            raise SystemExit('%s: unknown asset type' % path)
+        self.name = name
+        self.uri = '/' if name == 'index.html' else '/' + name
+        self.type = TYPES[ext]
+        self.raw = data
+        self.cache = REVALIDATE if ext == '.html' else IMMUTABLE
+        self.pack()
+
+    def pack(self):
+        self.gz = compress(self.raw)
+        self.etag = etag(self.gz)
+
+
+def fingerprint(page, assets):
+    """Points the src and href of a page at the current version of each asset."""
+    text = page.raw.decode('utf-8')
+    for asset in assets:
+        pattern = r'((?:src|href)=")/?%s(")' % re.escape(asset.name)
+        version = asset.etag.strip('"')
+        text = re.sub(pattern, r'\g<1>%s?v=%s\g<2>' % (asset.uri, version), text)
+    page.raw = text.encode('utf-8')
+    page.pack()
+
+
+def c_bytes(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append('\t' + ' '.join('0x%02x,' % b for b in bytearray(data[i:i + 16])))
+    return '\n'.join(lines)
+
+
+def c_source(assets):
+    out = ['// Generated by tools/www_pack.py from main/www, do not edit', '',
+           '#include "www.h"', '']
+    for i, asset in enumerate(assets):
+        out.append('// %s, %d bytes, %d gzipped' % (asset.name, len(asset.raw), len(asset.gz)))
+        out.append('static const uint8_t www_asset_%d[] =\n{\n%s\n};\n' % (i, c_bytes(asset.gz)))
+    out.append('const www_asset_t www_assets[] =\n{')
+    for i, asset in enumerate(assets):
+        out.append('\t{ "%s", "%s", "%s", "%s", www_asset_%d, sizeof(www_asset_%d) },' % (
+            asset.uri, asset.type, asset.etag.replace('"', '\\"'), asset.cache, i, i))
+    out.append('};\n')
+    out.append('const size_t www_asset_count = sizeof(www_assets) / sizeof(www_assets[0]);')
+    return '\n'.join(out) + '\n'
+
+
+def report(assets):
+    """Size table, the page load line counts index.html and everything it references."""
+    rows = ['%-16s %8s %8s  %s' % ('asset', 'bytes', 'gzipped', 'cache')]
+    for asset in assets:
+        rows.append('%-16s %8d %8d  %s' % (asset.uri, len(asset.raw), len(asset.gz), asset.cache))
+    pages = [a for a in assets if a.type == 'text/html']
+    for page in pages:
+        text = page.raw.decode('utf-8')
+        used = [page] + [a for a in assets if a is not page and '"%s?v=' % a.uri in text]
+        rows.append('page %s: %d bytes gzipped on the first load (%d uncompressed), '
+                    'a 304 with no body on repeat loads' % (
+                        page.uri, sum(len(a.gz) for a in used), sum(len(a.raw) for a in used)))
+    rows.append('flash: %d bytes' % sum(len(a.gz) for a in assets))
+    return '\n'.join(rows) + '\n'
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Packs the web dashboard into a C table')
+    parser.add_argument('files', nargs='+', help='assets, index.html is served at /')
+    parser.add_argument('-o', '--output', required=True, help='C source to write')
+    parser.add_argument('--report', help='also write the size report here')
+    args = parser.parse_args()
+
+    assets = []
+    for path in sorted(args.files):
+        with open(path, 'rb') as f:
+            assets.append(Asset(path, f.read()))
+
+    # Pages last, their text carries the versions of the other assets
+    for page in [a for a in assets if a.type == 'text/html']:
+        fingerprint(page, [a for a in assets if a.type != 'text/html'])
+
+    with open(args.output, 'w') as f:
+        f.write(c_source(assets))
+
+    text = report(assets)
+    sys.stdout.write(text)
+    if args.report:
+        with open(args.report, 'w') as f:
+            f.write(text)
+
+
+if __name__ == '__main__':
+    main()